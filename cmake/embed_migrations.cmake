@@ -0,0 +1,62 @@
+# Generates the header compiling a migrations directory into doorkeeper-embedded
+# Usage: cmake -DMIGRATIONS_DIR=<directory> -DOUTPUT=<header> -P embed_migrations.cmake
+# The header only holds the file contents; splitting and ordering are checked by the compiler (see embedded.h)
+
+if(NOT DEFINED MIGRATIONS_DIR OR NOT DEFINED OUTPUT)
+    message(FATAL_ERROR "Usage: cmake -DMIGRATIONS_DIR=<directory> -DOUTPUT=<header> -P embed_migrations.cmake")
+endif()
+
+set(DELIMITER "doorkeeper_sql")
+file(GLOB MIGRATION_FILES "${MIGRATIONS_DIR}/*.sql")
+list(SORT MIGRATION_FILES)
+list(LENGTH MIGRATION_FILES MIGRATION_COUNT)
+
+set(FILES "")
+set(CHECKS "")
+set(ENTRIES "")
+set(INDEX 0)
+foreach(MIGRATION_FILE IN LISTS MIGRATION_FILES)
+    get_filename_component(NAME "${MIGRATION_FILE}" NAME_WLE)
+    get_filename_component(FILE_NAME "${MIGRATION_FILE}" NAME)
+    file(READ "${MIGRATION_FILE}" SQL)
+    string(FIND "${SQL}" ")${DELIMITER}\"" CLASH)
+    if(NOT CLASH EQUAL -1)
+        message(FATAL_ERROR "${MIGRATION_FILE} contains the raw string delimiter )${DELIMITER}\"")
+    endif()
+
+    string(APPEND FILES "    inline constexpr std::string_view SQL_${INDEX} = R\"${DELIMITER}(${SQL})${DELIMITER}\";\n")
+    string(APPEND CHECKS "static_assert(is_valid_migration(embedded_bundle::SQL_${INDEX}), \"${FILE_NAME} has malformed migration tags\");\n")
+    string(APPEND ENTRIES "        make_embedded_migration(\"${NAME}\", SQL_${INDEX}),\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+set(HEADER "// Generated by cmake/embed_migrations.cmake from ${MIGRATIONS_DIR}, do not edit
+#ifndef EMBEDDED_BUNDLE_H
+#define EMBEDDED_BUNDLE_H
+#include <array>
+#include <string_view>
+
+#include \"migration-manager/embedded.h\"
+
+namespace embedded_bundle {
+${FILES}}
+
+${CHECKS}
+namespace embedded_bundle {
+    inline constexpr std::array<embedded_migration, ${MIGRATION_COUNT}> MIGRATIONS{{
+${ENTRIES}    }};
+}
+
+static_assert(is_ordered_bundle(embedded_bundle::MIGRATIONS), \"Embedded migrations are not in execution order\");
+
+#endif //EMBEDDED_BUNDLE_H
+")
+
+# Only touch the header when it changes, so unrelated reconfigures do not rebuild doorkeeper-embedded
+set(CURRENT "")
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" CURRENT)
+endif()
+if(NOT CURRENT STREQUAL HEADER)
+    file(WRITE "${OUTPUT}" "${HEADER}")
+endif()
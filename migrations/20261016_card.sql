@@ -0,0 +1,33 @@
+-- MIGRATION UP START
+CREATE TABLE IF NOT EXISTS card (
+    scryfall_id VARCHAR NOT NULL,
+    oracle_id VARCHAR,
+    name VARCHAR NOT NULL,
+    lang VARCHAR,
+    released_at DATE,
+    "set" VARCHAR,
+    collector_number VARCHAR,
+    rarity VARCHAR,
+    layout VARCHAR,
+    mana_cost VARCHAR,
+    cmc REAL,
+    type_line VARCHAR,
+    oracle_text TEXT,
+    colors VARCHAR(5),
+    color_identity VARCHAR(5),
+    power VARCHAR,
+    toughness VARCHAR,
+    digital BOOLEAN,
+    _id INTEGER PRIMARY KEY AUTOINCREMENT,
+    _created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    _modified_at TIMESTAMP
+);
+CREATE UNIQUE INDEX card_unique_scryfall_id ON card (scryfall_id);
+CREATE INDEX card_set_number ON card ("set", collector_number);
+-- MIGRATION UP END
+
+-- MIGRATION DOWN START
+DROP INDEX IF EXISTS card_set_number;
+DROP INDEX IF EXISTS card_unique_scryfall_id;
+DROP TABLE IF EXISTS card;
+-- MIGRATION DOWN END
@@ -0,0 +1,13 @@
+-- MIGRATION UP START
+------------------------------------------------------------------------------------------------------------------------
+UPDATE colors SET white = FALSE WHERE name IN ('Golgari', 'Simic');
+UPDATE colors SET blue = FALSE, red = TRUE WHERE name = 'Dune-Brood';
+------------------------------------------------------------------------------------------------------------------------
+-- MIGRATION UP END
+
+-- MIGRATION DOWN START
+------------------------------------------------------------------------------------------------------------------------
+UPDATE colors SET white = TRUE WHERE name IN ('Golgari', 'Simic');
+UPDATE colors SET blue = TRUE, red = FALSE WHERE name = 'Dune-Brood';
+------------------------------------------------------------------------------------------------------------------------
+-- MIGRATION DOWN END
@@ -0,0 +1,24 @@
+-- MIGRATION UP START
+CREATE TABLE IF NOT EXISTS import_file (
+    path VARCHAR NOT NULL,
+    hash VARCHAR NOT NULL,
+    size INTEGER NOT NULL,
+    rows INTEGER NOT NULL,
+    _id INTEGER PRIMARY KEY AUTOINCREMENT,
+    _imported_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+CREATE UNIQUE INDEX import_file_unique_path ON import_file (path);
+CREATE TABLE IF NOT EXISTS import_row (
+    file INTEGER NOT NULL,
+    key INTEGER NOT NULL,
+    fingerprint INTEGER NOT NULL,
+    row_id INTEGER NOT NULL,
+    PRIMARY KEY (file, key)
+) WITHOUT ROWID;
+-- MIGRATION UP END
+
+-- MIGRATION DOWN START
+DROP TABLE IF EXISTS import_row;
+DROP INDEX IF EXISTS import_file_unique_path;
+DROP TABLE IF EXISTS import_file;
+-- MIGRATION DOWN END
@@ -0,0 +1,639 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <nlohmann/json.hpp>
+
+#include "generator.h"
+#include "colors.h"
+#include "exceptions.h"
+
+namespace fs = std::filesystem;
+using namespace generator_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    constexpr uint64_t ROW_SALT = 0x526F7773ULL; ///< Seed salt of the per-row draws
+    constexpr uint64_t CARD_SALT = 0x43617264ULL; ///< Seed salt of the per-card draws
+    constexpr uint64_t PRINTING_SALT = 0x5072696EULL; ///< Seed salt of the per-printing draws
+    constexpr int FIRST_YEAR = 2019; ///< Year of the oldest collection entry
+    constexpr uint32_t DAYS = 2500; ///< Days collection entries were added over
+    constexpr uint64_t IMAGE_VERSION = 1700000000; ///< Cache buster of the image URLs
+
+    constexpr std::array<std::string_view, 48> FIRST_WORDS = {
+        "Ancient", "Ashen", "Blazing", "Bound", "Brazen", "Cinder", "Cloud", "Crypt", "Dawn", "Deep", "Dread",
+        "Dusk", "Ember", "Fae", "Feral", "Frost", "Gilded", "Glimmer", "Grave", "Hallowed", "Hollow", "Iron",
+        "Ivory", "Lost", "Moon", "Mystic", "Night", "Oath", "Primal", "Rune", "Sacred", "Shadow", "Silent", "Sky",
+        "Soul", "Spell", "Storm", "Sun", "Thorn", "Tide", "Twilight", "Vault", "Veiled", "Vine", "Void", "Wild",
+        "Wind", "Wrath"
+    }; ///< First word of the card names
+    constexpr std::array<std::string_view, 48> SECOND_WORDS = {
+        "Adept", "Angel", "Archon", "Bear", "Behemoth", "Champion", "Charm", "Colossus", "Command", "Courier",
+        "Drake", "Dragon", "Elemental", "Familiar", "Fury", "Giant", "Golem", "Guardian", "Harbinger", "Hydra",
+        "Invocation", "Knight", "Lancer", "Leviathan", "Mage", "Mentor", "Oracle", "Phoenix", "Pilgrim", "Reckoner",
+        "Revenant", "Rider", "Rogue", "Sage", "Scout", "Seer", "Serpent", "Shaman", "Sphinx", "Strike", "Titan",
+        "Tutor", "Vampire", "Visionary", "Warden", "Whisper", "Wurm", "Zealot"
+    }; ///< Second word of the card names
+    constexpr std::array<std::string_view, 8> TYPES = {
+        "Creature — Human Wizard", "Creature — Elf Warrior", "Creature — Spirit", "Creature — Dragon",
+        "Instant", "Sorcery", "Enchantment", "Artifact"
+    }; ///< Type lines (the first four are creatures)
+    constexpr std::array<std::string_view, 10> RULES = {
+        "Flying", "When this creature enters, draw a card.", "Destroy target creature with mana value 3 or less.",
+        "Counter target spell unless its controller pays {2}.", "Target player mills three cards.",
+        "Whenever you cast an instant or sorcery spell, scry 1.", "{T}: Add one mana of any color.",
+        "Creatures you control get +1/+1 until end of turn.", "Return target card from your graveyard to your hand.",
+        "Ward {2}"
+    }; ///< Sentences of the rules texts
+    constexpr std::array<std::string_view, 21> FORMATS = {
+        "standard", "future", "historic", "timeless", "gladiator", "pioneer", "explorer", "modern", "legacy",
+        "pauper", "vintage", "penny", "commander", "oathbreaker", "standardbrawl", "brawl", "alchemy",
+        "paupercommander", "duel", "oldschool", "premodern"
+    }; ///< Formats of the legalities
+    constexpr std::array<std::string_view, 4> IMAGE_SIZES = {"small", "normal", "large", "art_crop"}; ///< Images
+
+    /**
+     * Struct to hold the draws of a distinct card
+     */
+    struct card_profile {
+        std::string name; ///< Name (faces separated by " // ")
+        std::array<std::string, 2> faces; ///< Face names (the second is empty for single-faced cards)
+        uint8_t colors; ///< Color mask
+        uint8_t identity; ///< Color identity mask
+        uint32_t cmc; ///< Mana value
+        uint32_t type; ///< Index of the type line
+    };
+
+    /**
+     * Struct to hold the draws of a printing of a card
+     */
+    struct printing {
+        uint32_t set; ///< Set index (higher is more recent)
+        uint32_t number; ///< Collector number
+        char rarity; ///< Rarity letter
+    };
+
+    /**
+     * Derives the seed of a draw from the dataset seed and an index
+     * @param seed Dataset seed
+     * @param salt Salt of the kind of draw
+     * @param index Index of the drawn item
+     * @return Seed for a random source
+     */
+    uint64_t derive(const uint64_t seed, const uint64_t salt, const uint64_t index) {
+        random_source mixer(seed ^ salt * 0x9E3779B97F4A7C15ULL);
+        return mixer.next() ^ random_source(index).next();
+    }
+
+    /**
+     * Builds a unique name
+     * @param id Name number
+     * @return Two words, followed by a number once the combinations run out
+     */
+    std::string make_name(const uint64_t id) {
+        constexpr uint64_t combinations = FIRST_WORDS.size() * SECOND_WORDS.size();
+        std::string name;
+        name.append(FIRST_WORDS[id % FIRST_WORDS.size()]).append(" ");
+        name.append(SECOND_WORDS[id / FIRST_WORDS.size() % SECOND_WORDS.size()]);
+        if (id >= combinations) {
+            name.append(" ").append(std::to_string(id / combinations + 1));
+        }
+        return name;
+    }
+
+    /**
+     * Draws a distinct card
+     * @param seed Dataset seed
+     * @param card Card index
+     * @return Card draws
+     */
+    card_profile make_card(const uint64_t seed, const uint64_t card) {
+        random_source draw(derive(seed, CARD_SALT, card));
+        card_profile profile;
+        profile.faces[0] = make_name(card);
+        profile.name = profile.faces[0];
+        if (card % 20 == 19) {
+            profile.faces[1] = make_name(card * 31 + 7);
+            profile.name.append(" // ").append(profile.faces[1]);
+        }
+
+        // 10% colorless, 60% mono, 22% two colors, 8% three or more
+        const double shape = draw.uniform();
+        const int count = shape < 0.10 ? 0 : shape < 0.70 ? 1 : shape < 0.92 ? 2 : 3 + static_cast<int>(draw.below(3));
+        profile.colors = 0;
+        while (std::popcount(profile.colors) < count) {
+            profile.colors |= static_cast<uint8_t>(1u << draw.below(5));
+        }
+        profile.identity = profile.colors;
+        if (draw.below(10) == 0) {
+            profile.identity |= static_cast<uint8_t>(1u << draw.below(5));
+        }
+        profile.cmc = static_cast<uint32_t>(std::max<uint64_t>(count, draw.below(7)));
+        profile.type = static_cast<uint32_t>(draw.below(TYPES.size()));
+        return profile;
+    }
+
+    /**
+     * Draws a printing of a card
+     * @param seed Dataset seed
+     * @param card Card index
+     * @param version Printing of the card (0 for the first)
+     * @return Printing draws
+     */
+    printing make_printing(const uint64_t seed, const uint64_t card, const uint64_t version) {
+        random_source draw(derive(seed, PRINTING_SALT, card * 64 + version));
+        const double recency = draw.uniform();
+        const double rarity = draw.uniform();
+        printing print;
+        print.set = SETS - 1 - static_cast<uint32_t>(SETS * recency * recency);
+        // Different for every version of a card as long as it has fewer than NUMBERS_PER_SET versions, so the
+        // (name, set, number, foil) keys of the importer are unique
+        print.number = static_cast<uint32_t>((card + version * 7919) % NUMBERS_PER_SET + 1);
+        print.rarity = rarity < 0.45 ? 'C' : rarity < 0.75 ? 'U' : rarity < 0.92 ? 'R' : rarity < 0.98 ? 'M'
+                     : rarity < 0.99 ? 'S' : 'B';
+        return print;
+    }
+
+    /**
+     * Builds the code of a set
+     * @param set Set index
+     * @return Three letter code (a permutation of the indexes, so codes are unique)
+     */
+    std::string set_code(const uint32_t set) {
+        uint32_t value = set * 7919 % (26 * 26 * 26);
+        std::string code(3, 'A');
+        for (char& letter : code) {
+            letter = static_cast<char>('A' + value % 26);
+            value /= 26;
+        }
+        return code;
+    }
+
+    /**
+     * Formats a day as an ISO date
+     * @param day Days since the first of January of FIRST_YEAR
+     * @return Date (YYYY-MM-DD)
+     */
+    std::string iso_date(const uint32_t day) {
+        using namespace std::chrono;
+        const year_month_day date{sys_days{year{FIRST_YEAR} / January / 1} + days{day}};
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", static_cast<int>(date.year()),
+                      static_cast<unsigned>(date.month()), static_cast<unsigned>(date.day()));
+        return buffer;
+    }
+
+    /**
+     * Converts a rarity letter into the rarity of the Scryfall objects
+     * @param rarity Rarity letter
+     * @return Rarity name
+     */
+    std::string rarity_name(const char rarity) {
+        switch (rarity) {
+            case 'C': return "common";
+            case 'U': return "uncommon";
+            case 'R': return "rare";
+            case 'M': return "mythic";
+            case 'S': return "special";
+            default: return "bonus";
+        }
+    }
+
+    /**
+     * Builds a UUID from a draw
+     * @param draw Random source
+     * @return UUID string
+     */
+    std::string make_uuid(random_source& draw) {
+        std::ostringstream out;
+        out << std::hex << std::setfill('0');
+        const uint64_t high = draw.next();
+        const uint64_t low = draw.next();
+        out << std::setw(8) << (high >> 32) << "-" << std::setw(4) << (high >> 16 & 0xFFFF) << "-"
+            << std::setw(4) << ((high & 0x0FFF) | 0x4000) << "-" << std::setw(4) << ((low >> 48 & 0x3FFF) | 0x8000)
+            << "-" << std::setw(12) << (low & 0xFFFFFFFFFFFFULL);
+        return out.str();
+    }
+
+    /**
+     * Converts a color mask into the color array of the Scryfall objects
+     * @param mask Color mask
+     * @return Array of color letters in WUBRG order
+     */
+    nlohmann::json color_array(const uint8_t mask) {
+        nlohmann::json colors = nlohmann::json::array();
+        for (size_t bit = 0; bit < color_constants::LETTERS.size(); bit++) {
+            if (mask & (1u << bit)) {
+                colors.push_back(std::string(1, color_constants::LETTERS[bit]));
+            }
+        }
+        return colors;
+    }
+
+    /**
+     * Builds the mana cost of a card
+     * @param profile Card draws
+     * @return Generic mana followed by one symbol per color
+     */
+    std::string mana_cost(const card_profile& profile) {
+        std::string cost;
+        const int colored = std::popcount(profile.colors);
+        if (static_cast<int>(profile.cmc) > colored) {
+            cost = "{" + std::to_string(profile.cmc - colored) + "}";
+        }
+        for (size_t bit = 0; bit < color_constants::LETTERS.size(); bit++) {
+            if (profile.colors & (1u << bit)) {
+                cost.append("{").append(1, color_constants::LETTERS[bit]).append("}");
+            }
+        }
+        return cost;
+    }
+
+    /**
+     * Draws a price (most cards are cheap, a few are expensive)
+     * @param draw Random source
+     * @return Price with two decimals
+     */
+    std::string price(random_source& draw) {
+        const double value = 0.05 + draw.uniform() * draw.uniform() * 80.0;
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+        return buffer;
+    }
+
+    /**
+     * Builds the image URLs of a card face
+     * @param id Card id
+     * @param side Face of the card (front or back)
+     * @return Object with one URL per image size
+     */
+    nlohmann::json image_uris(const std::string& id, const std::string_view side) {
+        nlohmann::json uris = nlohmann::json::object();
+        for (const auto size : IMAGE_SIZES) {
+            uris[std::string(size)] = "https://cards.scryfall.io/" + std::string(size) + "/" + std::string(side) +
+                                      "/" + id.substr(0, 1) + "/" + id.substr(1, 1) + "/" + id + ".jpg?" +
+                                      std::to_string(IMAGE_VERSION);
+        }
+        return uris;
+    }
+
+    /**
+     * Builds the Scryfall object of a card, with the fields of the API responses
+     * @param seed Dataset seed
+     * @param card Card index
+     * @return Card object
+     */
+    nlohmann::json make_card_object(const uint64_t seed, const uint64_t card) {
+        const card_profile profile = make_card(seed, card);
+        const printing print = make_printing(seed, card, 0);
+        random_source draw(derive(seed, CARD_SALT ^ PRINTING_SALT, card));
+        const std::string id = make_uuid(draw);
+        const std::string code = set_code(print.set);
+        const std::string number = std::to_string(print.number);
+        const bool creature = profile.type < 4;
+
+        std::string text;
+        for (uint64_t sentences = 1 + draw.below(3); sentences > 0; sentences--) {
+            text.append(text.empty() ? "" : "\n").append(RULES[draw.below(RULES.size())]);
+        }
+
+        nlohmann::json object = {
+            {"object", "card"}, {"id", id}, {"oracle_id", make_uuid(draw)},
+            {"multiverse_ids", {draw.below(700000)}}, {"tcgplayer_id", draw.below(600000)},
+            {"name", profile.name}, {"lang", "en"},
+            {"released_at", iso_date(print.set * DAYS / SETS)},
+            {"uri", "https://api.scryfall.com/cards/" + id},
+            {"scryfall_uri", "https://scryfall.com/card/" + code + "/" + number + "?utm_source=api"},
+            {"layout", profile.faces[1].empty() ? "normal" : "transform"}, {"highres_image", true},
+            {"cmc", static_cast<double>(profile.cmc)}, {"type_line", TYPES[profile.type]},
+            {"color_identity", color_array(profile.identity)}, {"keywords", nlohmann::json::array()},
+            {"games", {"paper", "mtgo"}}, {"reserved", false}, {"foil", true}, {"nonfoil", true},
+            {"finishes", {"nonfoil", "foil"}}, {"oversized", false}, {"promo", false}, {"reprint", false},
+            {"set_id", make_uuid(draw)}, {"set", code}, {"set_name", "Set " + code}, {"set_type", "expansion"},
+            {"collector_number", number}, {"digital", false}, {"rarity", rarity_name(print.rarity)},
+            {"artist", make_name(draw.below(2304))}, {"border_color", "black"}, {"frame", "2015"},
+            {"booster", true}, {"edhrec_rank", draw.below(30000)}
+        };
+        nlohmann::json legalities = nlohmann::json::object();
+        for (const auto format : FORMATS) {
+            legalities[std::string(format)] = draw.below(3) == 0 ? "not_legal" : "legal";
+        }
+        object["legalities"] = std::move(legalities);
+
+        if (profile.faces[1].empty()) {
+            object["mana_cost"] = mana_cost(profile);
+            object["oracle_text"] = text;
+            object["colors"] = color_array(profile.colors);
+            object["image_uris"] = image_uris(id, "front");
+            if (creature) {
+                object["power"] = std::to_string(draw.below(7));
+                object["toughness"] = std::to_string(1 + draw.below(6));
+            }
+        } else {
+            nlohmann::json faces = nlohmann::json::array();
+            for (size_t face = 0; face < profile.faces.size(); face++) {
+                nlohmann::json face_object = {
+                    {"object", "card_face"}, {"name", profile.faces[face]},
+                    {"mana_cost", face == 0 ? mana_cost(profile) : ""}, {"type_line", TYPES[profile.type]},
+                    {"oracle_text", RULES[draw.below(RULES.size())]}, {"colors", color_array(profile.colors)},
+                    {"image_uris", image_uris(id, face == 0 ? "front" : "back")}
+                };
+                if (creature) {
+                    face_object["power"] = std::to_string(draw.below(7));
+                    face_object["toughness"] = std::to_string(1 + draw.below(6));
+                }
+                faces.push_back(std::move(face_object));
+            }
+            object["card_faces"] = std::move(faces);
+        }
+
+        nlohmann::json prices = {{"usd", price(draw)}, {"usd_foil", nullptr}, {"usd_etched", nullptr},
+                                 {"eur", price(draw)}, {"eur_foil", nullptr}, {"tix", price(draw)}};
+        if (draw.below(5) < 3) {
+            prices["usd_foil"] = price(draw);
+            prices["eur_foil"] = price(draw);
+        }
+        object["prices"] = std::move(prices);
+        object["purchase_uris"] = {
+            {"tcgplayer", "https://partner.tcgplayer.com/c/4931599/1830156/21018?u=" + id},
+            {"cardmarket", "https://www.cardmarket.com/en/Magic/Products/Search?searchString=" + code},
+            {"cardhoarder", "https://www.cardhoarder.com/cards/" + number}
+        };
+        return object;
+    }
+
+    /**
+     * Writes a file
+     * @param path Path of the file
+     * @param content Content of the file
+     * @throw bench_error if the file cannot be written
+     */
+    void write_file(const fs::path& path, const std::string_view content) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.write(content.data(), static_cast<std::streamsize>(content.size()))) {
+            throw bench_error("Unable to write " + path.string());
+        }
+    }
+
+    /**
+     * Appends a number to a string
+     * @param out String to append to
+     * @param value Number
+     */
+    void append_number(std::string& out, const uint64_t value) {
+        char buffer[24];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+
+    /**
+     * Writes the collection CSV files
+     * @param dir Directory of the files
+     * @param options Size of the dataset
+     * @param cards Distinct cards
+     */
+    void generate_collection(const fs::path& dir, const dataset_options& options, const uint64_t cards) {
+        fs::create_directories(dir);
+        std::vector<std::string> codes(SETS);
+        for (uint32_t set = 0; set < SETS; set++) {
+            codes[set] = set_code(set);
+        }
+        std::vector<std::string> dates(DAYS + 1);
+        for (uint32_t day = 0; day <= DAYS; day++) {
+            dates[day] = iso_date(day);
+        }
+
+        std::string content;
+        for (uint64_t first = 0, file = 0; first < options.rows; first += FILE_ROWS, file++) {
+            content.assign(CSV_HEADER).append("\n");
+            for (uint64_t row = first; row < std::min(first + FILE_ROWS, options.rows); row++) {
+                const uint64_t card = row % cards;
+                const card_profile profile = make_card(options.seed, card);
+                const printing print = make_printing(options.seed, card, row / cards);
+                random_source draw(derive(options.seed, ROW_SALT, row));
+                const double copies = draw.uniform();
+                const uint64_t quantity = copies < 0.60 ? 1 : copies < 0.75 ? 2 : copies < 0.85 ? 3
+                                        : copies < 0.97 ? 4 : 5 + draw.below(16);
+                const auto added = static_cast<uint32_t>(draw.below(DAYS));
+                const auto modified = static_cast<uint32_t>(std::min<uint64_t>(DAYS, added + draw.below(90)));
+
+                content.append(profile.name).append(";").append(codes[print.set]).append(";");
+                append_number(content, print.number);
+                content.append(";").append(1, print.rarity).append(";");
+                append_number(content, quantity);
+                content.append(";").append(dates[added]).append(";").append(dates[modified]).append(";");
+                content.append(draw.below(100) < 15 ? "True" : "False").append(";");
+                content.append(color_letters(profile.colors)).append(";");
+                content.append(color_letters(profile.identity)).append("\n");
+            }
+            char name[32];
+            std::snprintf(name, sizeof(name), "part-%04llu.csv", static_cast<unsigned long long>(file));
+            write_file(dir / name, content);
+        }
+    }
+
+    /**
+     * Writes the migration files
+     * @param dir Directory of the files
+     * @param options Size of the dataset
+     */
+    void generate_migrations(const fs::path& dir, const dataset_options& options) {
+        fs::create_directories(dir);
+        for (size_t idx = 1; idx <= options.migrations; idx++) {
+            random_source draw(derive(options.seed, ROW_SALT ^ CARD_SALT, idx));
+            const std::string table = "bench_table_" + std::to_string(idx);
+            std::ostringstream sql;
+            sql << "-- MIGRATION UP START\n"
+                << "CREATE TABLE IF NOT EXISTS " << table << " (\n"
+                << "    id INTEGER PRIMARY KEY AUTOINCREMENT,\n"
+                << "    name VARCHAR NOT NULL,\n"
+                << "    value REAL,\n";
+            for (uint64_t column = 0, columns = draw.below(8); column < columns; column++) {
+                sql << "    extra_" << column << " VARCHAR,\n";
+            }
+            sql << "    _created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP\n"
+                << ");\n"
+                << "CREATE INDEX " << table << "_name ON " << table << " (name);\n";
+            if (idx % SEED_EVERY == 0) {
+                sql << "INSERT INTO " << table << " (name, value) VALUES\n";
+                for (size_t row = 0; row < SEED_ROWS; row++) {
+                    sql << "    ('" << make_name(draw.below(1u << 20)) << "', " << draw.below(100000) << ")"
+                        << (row + 1 < SEED_ROWS ? ",\n" : ";\n");
+                }
+            }
+            sql << "-- MIGRATION UP END\n\n"
+                << "-- MIGRATION DOWN START\n"
+                << "DROP INDEX IF EXISTS " << table << "_name;\n"
+                << "DROP TABLE IF EXISTS " << table << ";\n"
+                << "-- MIGRATION DOWN END\n";
+
+            char name[48];
+            std::snprintf(name, sizeof(name), "%06zu_bench_table_%zu.sql", idx, idx);
+            write_file(dir / name, sql.str());
+        }
+    }
+
+    /**
+     * Writes the bulk-data dump and the listing pages
+     * @param dir Directory of the files
+     * @param options Size of the dataset
+     * @param bulk_cards Cards of the bulk dump
+     */
+    void generate_scryfall(const fs::path& dir, const dataset_options& options, const uint64_t bulk_cards) {
+        fs::create_directories(dir);
+
+        // Bulk-data dumps are an array with one card per line
+        std::ofstream bulk(dir / BULK_FILE, std::ios::binary | std::ios::trunc);
+        bulk << "[\n";
+        for (uint64_t card = 0; card < bulk_cards; card++) {
+            bulk << make_card_object(options.seed, card).dump() << (card + 1 < bulk_cards ? ",\n" : "\n");
+        }
+        bulk << "]\n";
+        if (!bulk.flush()) {
+            throw bench_error("Unable to write " + (dir / BULK_FILE).string());
+        }
+
+        const size_t pages = std::min<size_t>(PAGES_LIMIT, (bulk_cards + PAGE_CARDS - 1) / PAGE_CARDS);
+        for (size_t page = 0; page < pages; page++) {
+            nlohmann::json data = nlohmann::json::array();
+            for (uint64_t card = page * PAGE_CARDS; card < std::min<uint64_t>((page + 1) * PAGE_CARDS, bulk_cards);
+                 card++) {
+                data.push_back(make_card_object(options.seed, card));
+            }
+            nlohmann::json listing = {{"object", "list"}, {"total_cards", bulk_cards},
+                                      {"has_more", page + 1 < pages}};
+            if (page + 1 < pages) {
+                listing["next_page"] = "https://api.scryfall.com/cards/search?format=json&order=set&page=" +
+                                       std::to_string(page + 2) + "&q=game%3Apaper";
+            }
+            listing["data"] = std::move(data);
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "page-%04zu.json", page + 1);
+            write_file(dir / name, listing.dump());
+        }
+    }
+
+    /**
+     * Lists the files of a directory
+     * @param dir Directory
+     * @param bytes Incremented by the size of the files
+     * @return Sorted file paths
+     */
+    std::vector<std::string> list_files(const fs::path& dir, uint64_t* bytes = nullptr) {
+        std::vector<std::string> files;
+        if (fs::is_directory(dir)) {
+            for (const auto& entry : fs::directory_iterator(dir)) {
+                if (entry.is_regular_file()) {
+                    files.push_back(entry.path().string());
+                    if (bytes != nullptr) {
+                        *bytes += entry.file_size();
+                    }
+                }
+            }
+        }
+        std::ranges::sort(files);
+        return files;
+    }
+
+    /**
+     * Builds the manifest of a dataset
+     * @param data Dataset
+     * @return Manifest object
+     */
+    nlohmann::json manifest_of(const dataset& data) {
+        return {{"version", VERSION}, {"rows", data.options.rows}, {"seed", data.options.seed},
+                {"migrations", data.options.migrations}, {"cards", data.cards}, {"bulk_cards", data.bulk_cards}};
+    }
+
+    /**
+     * Checks whether a directory holds a complete dataset of the same options
+     * @param manifest Path of the manifest
+     * @param expected Manifest of the requested dataset
+     * @return True if the dataset can be reused
+     */
+    bool matches(const fs::path& manifest, const nlohmann::json& expected) {
+        std::ifstream file(manifest);
+        if (!file.is_open()) {
+            return false;
+        }
+        const nlohmann::json found = nlohmann::json::parse(file, nullptr, false);
+        return !found.is_discarded() && found == expected;
+    }
+}
+
+// Random source functions
+// ---------------------------------------------------------------------------------------------------------------------
+uint64_t random_source::next() {
+    uint64_t value = state += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+// Dataset functions
+// ---------------------------------------------------------------------------------------------------------------------
+dataset generate_dataset(const std::string& path, const dataset_options& options) {
+    if (options.rows < MIN_ROWS || options.rows > MAX_ROWS) {
+        throw bench_error("Collection rows must be between " + std::to_string(MIN_ROWS) + " and " +
+                          std::to_string(MAX_ROWS) + " (" + std::to_string(options.rows) + " requested)");
+    }
+
+    dataset data;
+    data.path = path;
+    data.options = options;
+    data.cards = std::max<uint64_t>(options.rows / PRINTINGS_PER_CARD, 1);
+    data.bulk_cards = std::min(data.cards, BULK_CARDS_LIMIT);
+
+    const fs::path root(path);
+    const nlohmann::json manifest = manifest_of(data);
+    try {
+        if (!matches(root / MANIFEST, manifest)) {
+            // Anything built from an older dataset goes with it
+            fs::remove(root / MANIFEST);
+            for (const char* dir : {COLLECTION_DIR, MIGRATIONS_DIR, SCRYFALL_DIR, DATABASE_DIR}) {
+                fs::remove_all(root / dir);
+            }
+            generate_collection(root / COLLECTION_DIR, options, data.cards);
+            generate_migrations(root / MIGRATIONS_DIR, options);
+            generate_scryfall(root / SCRYFALL_DIR, options, data.bulk_cards);
+            write_file(root / MANIFEST, manifest.dump(2) + "\n");
+            data.generated = true;
+        }
+    } catch (const fs::filesystem_error& e) {
+        throw bench_error(e.what());
+    }
+
+    data.collection_files = list_files(root / COLLECTION_DIR, &data.collection_bytes);
+    data.migration_files = list_files(root / MIGRATIONS_DIR, &data.migration_bytes);
+    data.bulk_file = (root / SCRYFALL_DIR / BULK_FILE).string();
+    for (auto& file : list_files(root / SCRYFALL_DIR)) {
+        if (file != data.bulk_file) {
+            data.page_files.push_back(std::move(file));
+        }
+    }
+    return data;
+}
+
+std::string print_dataset(const dataset& data) {
+    constexpr double megabyte = 1024.0 * 1024.0;
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << (data.generated ? "Generated" : "Reusing") << " dataset " << data.path << " (seed " << data.options.seed
+        << ")\n"
+        << "  Collection: " << data.options.rows << " rows of " << data.cards << " cards in "
+        << data.collection_files.size() << " files (" << static_cast<double>(data.collection_bytes) / megabyte
+        << " MB)\n"
+        << "  Migrations: " << data.migration_files.size() << " files ("
+        << static_cast<double>(data.migration_bytes) / megabyte << " MB)\n"
+        << "  Scryfall: " << data.bulk_cards << " cards in the bulk dump, " << data.page_files.size()
+        << " listing pages\n";
+    return out.str();
+}
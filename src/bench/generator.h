@@ -0,0 +1,125 @@
+/**
+ * Deterministic benchmark dataset generator header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace generator_constants {
+    inline constexpr uint32_t VERSION = 1; ///< Format of the generated data (older datasets are generated again)
+    inline const char* MANIFEST = "dataset.json"; ///< Manifest of a dataset, written once it is complete
+    inline const char* COLLECTION_DIR = "collection"; ///< Directory of the collection CSV files
+    inline const char* MIGRATIONS_DIR = "migrations"; ///< Directory of the migration files
+    inline const char* SCRYFALL_DIR = "scryfall"; ///< Directory of the Scryfall fixtures
+    inline const char* BULK_FILE = "cards.json"; ///< Bulk-data dump of the Scryfall fixtures
+    inline const char* DATABASE_DIR = "db"; ///< Directory of the databases built from the dataset
+    inline constexpr std::string_view CSV_HEADER = "Name;Set;Number;Rarity;Quantity;Added;Last modified;Foil;Colors;"
+                                                   "Color ID"; ///< Header of the collection exports
+    inline constexpr uint64_t MIN_ROWS = 10000; ///< Smallest collection generated
+    inline constexpr uint64_t MAX_ROWS = 10000000; ///< Largest collection generated
+    inline constexpr uint64_t FILE_ROWS = 100000; ///< Rows per collection file
+    inline constexpr uint64_t PRINTINGS_PER_CARD = 4; ///< Rows per distinct card, on average
+    inline constexpr uint32_t SETS = 400; ///< Set codes rows are spread over (recent sets are the most common)
+    inline constexpr uint32_t NUMBERS_PER_SET = 400; ///< Collector numbers of a set
+    inline constexpr uint64_t BULK_CARDS_LIMIT = 100000; ///< Cards of the bulk dump (about Scryfall's default_cards)
+    inline constexpr size_t PAGE_CARDS = 175; ///< Cards per listing page, as served by the Scryfall API
+    inline constexpr size_t PAGES_LIMIT = 100; ///< Listing pages written
+    inline constexpr size_t SEED_EVERY = 50; ///< Every n-th migration also seeds its table
+    inline constexpr size_t SEED_ROWS = 1000; ///< Rows inserted by a seeding migration
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * SplitMix64 generator. The standard distributions are implementation defined, so every draw is made from the raw
+ * 64-bit output instead and a seed gives the same dataset with any compiler or standard library
+ */
+class random_source {
+    uint64_t state; ///< Generator state
+public:
+    explicit random_source(const uint64_t seed) : state(seed) {}
+
+    /**
+     * Draws the next value
+     * @return Uniform 64-bit value
+     */
+    uint64_t next();
+
+    /**
+     * Draws a value below a bound
+     * @param bound Exclusive upper bound (greater than 0)
+     * @return Value in [0, bound)
+     */
+    uint64_t below(const uint64_t bound) {return next() % bound;}
+
+    /**
+     * Draws a real value
+     * @return Value in [0, 1)
+     */
+    double uniform() {return static_cast<double>(next() >> 11) * 0x1.0p-53;}
+};
+
+/**
+ * Struct to hold the size of a dataset
+ */
+struct dataset_options {
+    uint64_t rows = 100000; ///< Rows of the collection (MIN_ROWS to MAX_ROWS)
+    uint64_t seed = 1; ///< Seed of every draw
+    size_t migrations = 2000; ///< Migration files
+
+    bool operator==(const dataset_options&) const = default;
+};
+
+/**
+ * Struct to hold a generated dataset
+ */
+struct dataset {
+    std::string path; ///< Directory of the dataset
+    dataset_options options; ///< Size of the dataset
+    uint64_t cards = 0; ///< Distinct cards of the collection
+    uint64_t bulk_cards = 0; ///< Cards of the bulk dump
+    std::vector<std::string> collection_files; ///< Collection CSV files, sorted
+    std::vector<std::string> migration_files; ///< Migration files, sorted
+    std::vector<std::string> page_files; ///< Listing pages, sorted
+    std::string bulk_file; ///< Bulk-data dump
+    uint64_t collection_bytes = 0; ///< Size of the collection files
+    uint64_t migration_bytes = 0; ///< Size of the migration files
+    bool generated = false; ///< Whether the dataset was generated now instead of reused
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Generates a dataset, or reuses the one in the directory if its manifest matches the options:
+ *   collection/  CSV exports of the collection, FILE_ROWS rows each, in the format of the importer. Every card has
+ *                PRINTINGS_PER_CARD rows on average, in sets skewed towards the recent ones, and 1 in 20 cards is
+ *                multi-faced
+ *   migrations/  migration files creating one table each, every SEED_EVERY-th one also seeding it
+ *   scryfall/    bulk-data dump of the cards (up to BULK_CARDS_LIMIT) and listing pages of the API, with the fields,
+ *                nesting and sizes of the real responses
+ * Every file depends only on the options, so datasets generated from the same options are identical
+ * @param path Directory of the dataset
+ * @param options Size of the dataset
+ * @return Dataset
+ * @throw bench_error if the options are out of range or a file cannot be written
+ */
+dataset generate_dataset(const std::string& path, const dataset_options& options);
+
+/**
+ * Prints a dataset
+ * @param data Dataset
+ * @return String with the files and sizes of the dataset
+ */
+std::string print_dataset(const dataset& data);
+
+#endif //GENERATOR_H
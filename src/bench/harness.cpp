@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#include "harness.h"
+
+using namespace harness_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Reads the CPU time used by every thread of the process
+     * @return CPU time in seconds
+     */
+    double process_cpu_seconds() {
+        timespec now{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+        return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+    }
+
+    /**
+     * Builds the iteration run of a finished state
+     * @param name Benchmark name
+     * @param family Index of the benchmark
+     * @param state Finished state
+     * @return Run with the times per iteration and the rates per second
+     */
+    bench_run make_run(const std::string& name, const size_t family, const bench_state& state) {
+        bench_run run;
+        run.name = name;
+        run.family = family;
+        run.error = state.error_message();
+        run.iterations = state.iterations_done();
+        if (!run.error.empty() || run.iterations == 0) {
+            return run;
+        }
+        const auto iterations = static_cast<double>(run.iterations);
+        run.real_ns = state.real_time() * 1e9 / iterations;
+        run.cpu_ns = state.cpu_time() * 1e9 / iterations;
+        const double seconds = std::max(state.real_time(), 1e-12);
+        run.items_per_second = static_cast<double>(state.items_processed()) / seconds;
+        run.bytes_per_second = static_cast<double>(state.bytes_processed()) / seconds;
+        run.counters = state.counters();
+        return run;
+    }
+
+    /**
+     * Computes an aggregate of the repetitions of a benchmark
+     * @param runs Iteration runs of the benchmark
+     * @param aggregate Aggregate name (mean, median or stddev)
+     * @return Aggregate run
+     */
+    bench_run make_aggregate(const std::vector<bench_run>& runs, const std::string& aggregate) {
+        const auto reduce = [&runs, &aggregate](auto field) {
+            std::vector<double> values;
+            for (const auto& run : runs) {
+                values.push_back(field(run));
+            }
+            double mean = 0;
+            for (const double value : values) {
+                mean += value / static_cast<double>(values.size());
+            }
+            if (aggregate == "mean") {
+                return mean;
+            }
+            if (aggregate == "median") {
+                std::ranges::sort(values);
+                const size_t middle = values.size() / 2;
+                return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+            }
+            double squares = 0;
+            for (const double value : values) {
+                squares += (value - mean) * (value - mean);
+            }
+            return values.size() > 1 ? std::sqrt(squares / static_cast<double>(values.size() - 1)) : 0.0;
+        };
+
+        bench_run result;
+        result.name = runs.front().name;
+        result.family = runs.front().family;
+        result.repetitions = static_cast<unsigned int>(runs.size());
+        result.aggregate = aggregate;
+        result.iterations = runs.size();
+        result.real_ns = reduce([](const bench_run& run) {return run.real_ns;});
+        result.cpu_ns = reduce([](const bench_run& run) {return run.cpu_ns;});
+        result.items_per_second = reduce([](const bench_run& run) {return run.items_per_second;});
+        result.bytes_per_second = reduce([](const bench_run& run) {return run.bytes_per_second;});
+        for (const auto& [counter, _] : runs.front().counters) {
+            result.counters[counter] = reduce([&counter](const bench_run& run) {return run.counters.at(counter);});
+        }
+        return result;
+    }
+
+    /**
+     * Formats a time with a readable unit
+     * @param ns Time in nanoseconds
+     * @return Time with its unit
+     */
+    std::string format_time(const double ns) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(ns < 1e3 ? 1 : 3);
+        if (ns < 1e3) {
+            out << ns << " ns";
+        } else if (ns < 1e6) {
+            out << ns / 1e3 << " us";
+        } else if (ns < 1e9) {
+            out << ns / 1e6 << " ms";
+        } else {
+            out << ns / 1e9 << " s";
+        }
+        return out.str();
+    }
+
+    /**
+     * Formats a rate with a decimal prefix
+     * @param rate Rate per second
+     * @param unit Unit of the rate
+     * @return Rate with its prefix and unit
+     */
+    std::string format_rate(const double rate, const std::string& unit) {
+        constexpr std::array<const char*, 4> prefixes = {"", "k", "M", "G"};
+        size_t prefix = 0;
+        double value = rate;
+        while (value >= 1000 && prefix + 1 < prefixes.size()) {
+            value /= 1000;
+            prefix++;
+        }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << value << prefixes[prefix] << " " << unit << "/s";
+        return out.str();
+    }
+
+    /**
+     * Prints the console line of a run
+     * @param run Run
+     * @param progress Stream of the console report
+     */
+    void print_run(const bench_run& run, std::ostream& progress) {
+        const std::string name = run.aggregate.empty() ? run.name : run.name + "_" + run.aggregate;
+        progress << std::left << std::setw(48) << name << std::right;
+        if (!run.error.empty()) {
+            progress << " ERROR: " << run.error << "\n";
+            return;
+        }
+        progress << std::setw(14) << format_time(run.real_ns) << std::setw(14) << format_time(run.cpu_ns)
+                 << std::setw(12) << run.iterations;
+        if (run.items_per_second > 0) {
+            progress << "  " << format_rate(run.items_per_second, "items");
+        }
+        if (run.bytes_per_second > 0) {
+            progress << "  " << format_rate(run.bytes_per_second, "B");
+        }
+        for (const auto& [counter, value] : run.counters) {
+            progress << "  " << counter << "=" << value;
+        }
+        progress << "\n";
+    }
+}
+
+// Benchmark state functions
+// ---------------------------------------------------------------------------------------------------------------------
+void bench_state::start_clocks() {
+    if (!running) {
+        running = true;
+        cpu_start = process_cpu_seconds();
+        real_start = std::chrono::steady_clock::now();
+    }
+}
+
+void bench_state::stop_clocks() {
+    if (running) {
+        real_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - real_start).count();
+        cpu_seconds += process_cpu_seconds() - cpu_start;
+        running = false;
+    }
+}
+
+bool bench_state::keep_running() {
+    if (done == 0 && error.empty()) {
+        start_clocks();
+    }
+    if (done < iterations && error.empty()) {
+        done++;
+        return true;
+    }
+    stop_clocks();
+    return false;
+}
+
+void bench_state::skip(const std::string& message) {
+    stop_clocks();
+    error = message;
+}
+
+// Benchmark registry functions
+// ---------------------------------------------------------------------------------------------------------------------
+void bench_registry::add(std::string name, bench_body body) {
+    benchmarks.push_back({std::move(name), std::move(body)});
+}
+
+std::vector<bench_run> bench_registry::run(const bench_options& options, std::ostream& progress) const {
+    std::vector<bench_run> runs;
+    progress << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(14) << "Time" << std::setw(14)
+             << "CPU" << std::setw(12) << "Iterations" << "\n" << std::string(88, '-') << "\n";
+
+    for (size_t family = 0; family < benchmarks.size(); family++) {
+        const auto& [name, body] = benchmarks[family];
+        if (!std::regex_search(name, options.filter)) {
+            continue;
+        }
+
+        std::vector<bench_run> repetitions;
+        uint64_t iterations = 1;
+        for (unsigned int repetition = 0; repetition < std::max(options.repetitions, 1u); repetition++) {
+            bench_run result;
+            while (true) {
+                bench_state state(iterations);
+                body(state);
+                if (state.error_message().empty() && state.iterations_done() < iterations) {
+                    state.skip("The body returned before running its iterations");
+                }
+                result = make_run(name, family, state);
+                if (!result.error.empty() || repetition > 0 || state.real_time() >= options.min_time ||
+                    iterations >= MAX_ITERATIONS) {
+                    break;
+                }
+
+                // Grow towards min_time, the first repetition fixes the iterations of the next ones
+                const double growth = std::min(MAX_GROWTH, options.min_time * GROWTH_MARGIN /
+                                                           std::max(state.real_time(), 1e-9));
+                iterations = std::min(MAX_ITERATIONS, std::max(iterations + 1, static_cast<uint64_t>(
+                                          static_cast<double>(iterations) * growth)));
+            }
+            result.repetitions = std::max(options.repetitions, 1u);
+            result.repetition = repetition;
+            print_run(result, progress);
+            runs.push_back(result);
+            if (!result.error.empty()) {
+                break;
+            }
+            repetitions.push_back(std::move(result));
+        }
+
+        if (repetitions.size() > 1 && repetitions.size() == options.repetitions) {
+            for (const char* aggregate : {"mean", "median", "stddev"}) {
+                runs.push_back(make_aggregate(repetitions, aggregate));
+                print_run(runs.back(), progress);
+            }
+        }
+    }
+    return runs;
+}
+
+// Report functions
+// ---------------------------------------------------------------------------------------------------------------------
+nlohmann::json bench_context(const std::string& executable) {
+    char date[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+
+    // Nominal clock of the first CPU, when the kernel reports it
+    double mhz = 0;
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; mhz == 0 && std::getline(cpuinfo, line);) {
+        if (line.starts_with("cpu MHz")) {
+            mhz = std::atof(line.substr(line.find(':') + 1).c_str());
+        }
+    }
+    double load[3] = {};
+    const int samples = getloadavg(load, 3);
+
+#ifdef __OPTIMIZE__
+    const char* build_type = "release";
+#else
+    const char* build_type = "debug";
+#endif
+    return {
+        {"date", date}, {"host_name", host}, {"executable", executable},
+        {"num_cpus", std::thread::hardware_concurrency()}, {"mhz_per_cpu", static_cast<int>(mhz)},
+        {"cpu_scaling_enabled", false},
+        {"load_avg", std::vector<double>(load, load + std::max(samples, 0))},
+        {"library_build_type", build_type}
+    };
+}
+
+std::string print_bench_json(const nlohmann::json& context, const std::vector<bench_run>& runs) {
+    nlohmann::ordered_json benchmarks = nlohmann::ordered_json::array();
+    for (const auto& run : runs) {
+        nlohmann::ordered_json entry;
+        entry["name"] = run.aggregate.empty() ? run.name : run.name + "_" + run.aggregate;
+        entry["family_index"] = run.family;
+        entry["per_family_instance_index"] = 0;
+        entry["run_name"] = run.name;
+        entry["run_type"] = run.aggregate.empty() ? "iteration" : "aggregate";
+        entry["repetitions"] = run.repetitions;
+        if (run.aggregate.empty()) {
+            entry["repetition_index"] = run.repetition;
+        } else {
+            entry["aggregate_name"] = run.aggregate;
+            entry["aggregate_unit"] = "time";
+        }
+        entry["threads"] = 1;
+        if (!run.error.empty()) {
+            entry["error_occurred"] = true;
+            entry["error_message"] = run.error;
+        }
+        entry["iterations"] = run.iterations;
+        entry["real_time"] = run.real_ns;
+        entry["cpu_time"] = run.cpu_ns;
+        entry["time_unit"] = TIME_UNIT;
+        if (run.bytes_per_second > 0) {
+            entry["bytes_per_second"] = run.bytes_per_second;
+        }
+        if (run.items_per_second > 0) {
+            entry["items_per_second"] = run.items_per_second;
+        }
+        for (const auto& [counter, value] : run.counters) {
+            entry[counter] = value;
+        }
+        benchmarks.push_back(std::move(entry));
+    }
+
+    nlohmann::ordered_json document;
+    document["context"] = context;
+    document["benchmarks"] = std::move(benchmarks);
+    return document.dump(2) + "\n";
+}
@@ -0,0 +1,199 @@
+/**
+ * Micro-benchmark harness header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef HARNESS_H
+#define HARNESS_H
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace harness_constants {
+    inline constexpr uint64_t MAX_ITERATIONS = 1000000000; ///< Iterations a benchmark is never run beyond
+    inline constexpr double GROWTH_MARGIN = 1.4; ///< Overshoot of the iteration estimate (as Google Benchmark)
+    inline constexpr double MAX_GROWTH = 10; ///< Largest increase of the iterations between two attempts
+    inline const char* TIME_UNIT = "ns"; ///< Unit of the reported times
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * State of a running benchmark, in the manner of benchmark::State: the body runs its setup, then loops on
+ * keep_running() around the measured code. Only the time between the first call and the last one is measured, minus
+ * the sections between pause_timing() and resume_timing()
+ */
+class bench_state {
+    uint64_t iterations; ///< Iterations to run
+    uint64_t done = 0; ///< Iterations started
+    bool running = false; ///< Whether the clocks are running
+    std::chrono::steady_clock::time_point real_start; ///< Start of the measured section
+    double cpu_start = 0; ///< Process CPU time at the start of the measured section (seconds)
+    double real_seconds = 0; ///< Measured wall time
+    double cpu_seconds = 0; ///< Measured process CPU time
+    uint64_t items = 0; ///< Items processed
+    uint64_t bytes = 0; ///< Bytes processed
+    std::map<std::string, double> user_counters; ///< Counters set by the body
+    std::string error; ///< Reason the benchmark was skipped (empty if it ran)
+
+    /**
+     * Starts the clocks
+     */
+    void start_clocks();
+
+    /**
+     * Stops the clocks, adding the elapsed time to the measured time
+     */
+    void stop_clocks();
+public:
+    explicit bench_state(const uint64_t max_iterations) : iterations(max_iterations) {}
+
+    /**
+     * Starts the next iteration
+     * @return True while iterations are left (the clocks stop once it returns false)
+     */
+    bool keep_running();
+
+    /**
+     * Stops measuring (setup of the next iteration)
+     */
+    void pause_timing() {stop_clocks();}
+
+    /**
+     * Measures again after pause_timing()
+     */
+    void resume_timing() {start_clocks();}
+
+    /**
+     * Adds to the work done by the measured code (reported per second)
+     * @param item_count Items processed (rows, files, cards)
+     * @param byte_count Bytes processed
+     */
+    void processed(const uint64_t item_count, const uint64_t byte_count = 0) {
+        items += item_count;
+        bytes += byte_count;
+    }
+
+    /**
+     * Sets a counter reported with the benchmark
+     * @param name Counter name
+     * @param value Counter value
+     */
+    void counter(const std::string& name, const double value) {user_counters[name] = value;}
+
+    /**
+     * Skips the benchmark, reporting an error instead of its times. The body must return without looping again
+     * @param message Reason the benchmark was skipped
+     */
+    void skip(const std::string& message);
+
+    [[nodiscard]] uint64_t max_iterations() const {return iterations;} ///< Iterations to run
+    [[nodiscard]] uint64_t iterations_done() const {return done;} ///< Iterations run
+    [[nodiscard]] double real_time() const {return real_seconds;} ///< Measured wall time (seconds)
+    [[nodiscard]] double cpu_time() const {return cpu_seconds;} ///< Measured process CPU time (seconds)
+    [[nodiscard]] uint64_t items_processed() const {return items;} ///< Items processed
+    [[nodiscard]] uint64_t bytes_processed() const {return bytes;} ///< Bytes processed
+    [[nodiscard]] const std::map<std::string, double>& counters() const {return user_counters;} ///< Counters
+    [[nodiscard]] const std::string& error_message() const {return error;} ///< Skip reason
+};
+
+/**
+ * Struct to hold a reported run, an iteration run or an aggregate of the repetitions of a benchmark
+ */
+struct bench_run {
+    std::string name; ///< Benchmark name
+    size_t family = 0; ///< Index of the benchmark in registration order
+    uint64_t iterations = 0; ///< Iterations measured
+    double real_ns = 0; ///< Wall time per iteration
+    double cpu_ns = 0; ///< Process CPU time per iteration (above the wall time when several threads work)
+    double items_per_second = 0; ///< Items processed per second of wall time (0 if none were reported)
+    double bytes_per_second = 0; ///< Bytes processed per second of wall time (0 if none were reported)
+    std::map<std::string, double> counters; ///< Counters set by the body
+    unsigned int repetitions = 1; ///< Repetitions of the benchmark
+    unsigned int repetition = 0; ///< Index of the repetition (iteration runs)
+    std::string aggregate; ///< Aggregate name (mean, median or stddev; empty for iteration runs)
+    std::string error; ///< Reason the benchmark was skipped (empty if it ran)
+};
+
+/**
+ * Struct to hold the settings of a benchmark session
+ */
+struct bench_options {
+    std::regex filter{".*"}; ///< Benchmarks run (searched in their name)
+    double min_time = 0.5; ///< Wall time a run is grown to, in seconds
+    unsigned int repetitions = 1; ///< Runs of every benchmark (aggregates are added with several)
+};
+
+typedef std::function<void(bench_state&)> bench_body; ///< Body of a benchmark
+
+/**
+ * Registry of benchmarks. Every benchmark is run with one iteration, then with more until a run takes min_time, as
+ * Google Benchmark does, and the last run is reported
+ */
+class bench_registry {
+    /**
+     * Struct to hold a registered benchmark
+     */
+    struct benchmark {
+        std::string name; ///< Benchmark name (family/argument)
+        bench_body body; ///< Benchmark body
+    };
+
+    std::vector<benchmark> benchmarks; ///< Benchmarks in registration order
+public:
+    /**
+     * Registers a benchmark
+     * @param name Benchmark name
+     * @param body Benchmark body
+     */
+    void add(std::string name, bench_body body);
+
+    /**
+     * Runs the benchmarks matching the filter, printing a line per run
+     * @param options Session settings
+     * @param progress Stream of the console report
+     * @return Runs in registration order, each benchmark followed by its aggregates
+     * @throw std::exception thrown by a benchmark body
+     */
+    std::vector<bench_run> run(const bench_options& options, std::ostream& progress) const;
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Keeps the compiler from discarding the result of the measured code (benchmark::DoNotOptimize)
+ * @param value Result
+ */
+template <typename T>
+void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Builds the context of a session: date, host, CPUs, load and build type of the executable
+ * @param executable Path of the executable
+ * @return Context object
+ */
+nlohmann::json bench_context(const std::string& executable);
+
+/**
+ * Serializes a session in the JSON format of Google Benchmark (--benchmark_format=json), so its tools compare two
+ * sessions, e.g. compare.py benchmarks baseline.json contender.json
+ * @param context Context of the session (see bench_context)
+ * @param runs Runs of the session
+ * @return JSON document
+ */
+std::string print_bench_json(const nlohmann::json& context, const std::vector<bench_run>& runs);
+
+#endif //HARNESS_H
@@ -0,0 +1,170 @@
+/**
+ * Benchmarks and benchmark dataset generator for the fblthp archive
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#include <iostream>
+#include <regex>
+#include <string.h>
+#include <map>
+#include <cstdlib>
+#include <fstream>
+
+#include "generator.h"
+#include "harness.h"
+#include "suite.h"
+#include "exceptions.h"
+#include "env.h"
+
+const std::map<std::string, std::string> DEFAULT_ENV = {
+    {"FBLTHP_BENCH_ROWS", "100000"},
+    {"FBLTHP_BENCH_SEED", "1"},
+    {"FBLTHP_BENCH_MIGRATIONS", "2000"},
+    {"FBLTHP_BENCH_SCHEMA", "migrations"},
+    {"FBLTHP_BENCH_FIXTURES", ""},
+    {"FBLTHP_BENCH_FILTER", ".*"},
+    {"FBLTHP_BENCH_MIN_TIME", "0.5"},
+    {"FBLTHP_BENCH_REPETITIONS", "1"},
+    {"FBLTHP_BENCH_THREADS", "0"},
+    {"FBLTHP_BENCH_OUT", "bench.json"}
+}; ///< Default environment variables
+const char* HELP_MESSAGE =
+    "fblthp-bench <command> [argument] [options]\n"
+    "Commands:\n"
+    "  generate <directory>\tGenerate the benchmark dataset into <directory> (FBLTHP_BENCH_ROWS collection rows,\n"
+    "\t\t\tfrom 10000 to 10000000)\n"
+    "  run <directory>\tRun the benchmarks matching FBLTHP_BENCH_FILTER on the dataset of <directory> (generated\n"
+    "\t\t\tfirst if missing) and write the results as JSON into FBLTHP_BENCH_OUT\n"
+    "Options:\n"
+    "  -h, --help\t\tShow this help message\n"
+    "  -e, --environment\tUse custom environment\n"
+    "Arguments for environment:\n"
+    "  <file>\t\tPath to environment file\n"; ///< Help message
+enum OPTIONS {HELP, ENVIRONMENT, GENERATE, RUN}; ///< Benchmark commands and options
+
+bool str_eq(const char* str1, const char* str2) {return strcmp(str1, str2) == 0;} ///< Compare if two strings are equal
+int get_option(const char* argument); ///< Check if an argument is an option and returns the option or -1 if false
+dataset_options dataset_options_from_env(); ///< Build the dataset size from the environment
+
+int main(int argc, const char* argv[]) {
+    // Parse command line arguments
+    if (argc < 2) {
+        std::cout << HELP_MESSAGE;
+        return EXIT_FAILURE;
+    }
+
+    std::map<int, std::string> commands;
+    for (int i = 1; i < argc; i++) {
+        const int option = get_option(argv[i]);
+        if (option == HELP) {
+            commands.insert({option, ""});
+        } else if (option == ENVIRONMENT || option == GENERATE || option == RUN) {
+            if (++i >= argc) { // Next argument
+                std::cout << "Error: Missing argument" << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (!commands.insert({option, argv[i]}).second) {
+                std::cout << "Error: Duplicate option" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            std::cout << "Error: Invalid argument: " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Execute help if present and exit
+    if (commands.contains(HELP)) {
+        std::cout << HELP_MESSAGE;
+        return EXIT_SUCCESS;
+    }
+
+    // Execute environment
+    std::string env_file;
+    if (const auto env = commands.find(ENVIRONMENT); env != commands.end()) {
+        env_file = env->second;
+        commands.erase(env);
+    }
+    load_env(env_file, DEFAULT_ENV);
+
+    // Check only 1 command and get command
+    if (commands.size() > 1) {
+        std::cout << "Error: Too many commands" << std::endl;
+        return EXIT_FAILURE;
+    } else if (commands.empty()) {
+        std::cout << "Error: No command provided" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const int option = commands.begin()->first;
+    const std::string argument = commands.begin()->second;
+
+    // Perform the requested command
+    try {
+        const dataset data = generate_dataset(argument, dataset_options_from_env());
+        std::cout << print_dataset(data);
+        if (option == GENERATE) {
+            return EXIT_SUCCESS;
+        }
+
+        bench_options options;
+        options.filter = std::regex(std::getenv("FBLTHP_BENCH_FILTER"));
+        options.min_time = std::stod(std::getenv("FBLTHP_BENCH_MIN_TIME"));
+        options.repetitions = static_cast<unsigned int>(std::stoul(std::getenv("FBLTHP_BENCH_REPETITIONS")));
+        bench_fixtures fixtures(data, std::getenv("FBLTHP_BENCH_SCHEMA"),
+                                static_cast<unsigned int>(std::stoul(std::getenv("FBLTHP_BENCH_THREADS"))));
+        bench_registry registry;
+        register_migration_benchmarks(registry, fixtures);
+        register_import_benchmarks(registry, fixtures);
+        register_scryfall_benchmarks(registry, fixtures, std::getenv("FBLTHP_BENCH_FIXTURES"));
+        register_collection_benchmarks(registry, fixtures);
+
+        std::cout << std::endl;
+        const std::vector<bench_run> runs = registry.run(options, std::cout);
+        nlohmann::json context = bench_context(argv[0]);
+        context["dataset"] = {{"rows", data.options.rows}, {"seed", data.options.seed},
+                              {"migrations", data.options.migrations}, {"cards", data.cards},
+                              {"bulk_cards", data.bulk_cards}};
+
+        const std::string out_path = std::getenv("FBLTHP_BENCH_OUT");
+        std::ofstream out(out_path, std::ios::trunc);
+        if (!(out << print_bench_json(context, runs))) {
+            std::cout << "Error: Unable to write " << out_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "\nResults written to " << out_path << std::endl;
+    } catch (const std::regex_error& e) {
+        std::cout << "Error: Invalid benchmark filter - " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int get_option(const char* argument) {
+    if (str_eq(argument, "-h") || str_eq(argument, "--help")) {
+        return HELP;
+    }
+    if (str_eq(argument, "-e") || str_eq(argument, "--environment")) {
+        return ENVIRONMENT;
+    }
+    if (str_eq(argument, "generate")) {
+        return GENERATE;
+    }
+    if (str_eq(argument, "run")) {
+        return RUN;
+    }
+    return -1;
+}
+
+dataset_options dataset_options_from_env() {
+    dataset_options options;
+    options.rows = std::stoull(std::getenv("FBLTHP_BENCH_ROWS"));
+    options.seed = std::stoull(std::getenv("FBLTHP_BENCH_SEED"));
+    options.migrations = std::stoul(std::getenv("FBLTHP_BENCH_MIGRATIONS"));
+    return options;
+}
@@ -0,0 +1,360 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <nlohmann/json.hpp>
+
+#include "suite.h"
+#include "bulk.h"
+#include "csv.h"
+#include "database.h"
+#include "exceptions.h"
+#include "hash.h"
+#include "importer.h"
+#include "mapped_file.h"
+#include "migrations.h"
+
+namespace fs = std::filesystem;
+using namespace suite_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Reads a whole file
+     * @param path Path of the file
+     * @return Contents of the file
+     * @throw bench_error if the file cannot be read
+     */
+    std::string read_file(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw bench_error("Unable to read " + path);
+        }
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    /**
+     * Removes a database and its journals
+     * @param path Path of the database
+     */
+    void remove_database(const std::string& path) {
+        for (const char* suffix : {"", "-journal", "-wal", "-shm"}) {
+            fs::remove(path + suffix);
+        }
+    }
+
+    /**
+     * Counts the rows of a table
+     * @param path Path of the database
+     * @param table Table name
+     * @return Rows of the table
+     */
+    uint64_t count_rows(const std::string& path, const std::string& table) {
+        const db_connection connection(path);
+        return std::stoull(query_value(connection.get(), "SELECT COUNT(*) FROM " + table + ";"));
+    }
+}
+
+// Fixture functions
+// ---------------------------------------------------------------------------------------------------------------------
+bench_fixtures::bench_fixtures(const dataset& dataset_data, std::string schema_dir, const unsigned int import_threads)
+    : data(dataset_data), schema(std::move(schema_dir)), threads(import_threads),
+      database_dir((fs::path(dataset_data.path) / generator_constants::DATABASE_DIR).string()) {}
+
+std::string bench_fixtures::schema_database() {
+    const std::string path = (fs::path(database_dir) / SCHEMA_DB).string();
+    if (fs::exists(path)) {
+        return path;
+    }
+
+    // Built aside and renamed, so an interrupted session never leaves half a schema behind
+    const std::vector<migration> migrations = scan_local_migrations(schema);
+    if (migrations.empty()) {
+        throw bench_error("No migrations found in " + schema);
+    }
+    fs::create_directories(database_dir);
+    const std::string tmp_path = path + ".tmp";
+    remove_database(tmp_path);
+    {
+        const db_connection connection(tmp_path);
+        if (!init_migration_table(connection.get())) {
+            throw bench_error("Unable to create the migrations table in " + tmp_path);
+        }
+        manager schema_manager = create_migration_manager(migrations, connection.get());
+        schema_manager.quiet = true;
+        try {
+            execute_migration(schema_manager, migration_constants::UPGRADE, migration_constants::HEAD);
+        } catch (const std::exception& e) {
+            close_migration_manager(schema_manager);
+            throw bench_error(e.what());
+        }
+        close_migration_manager(schema_manager);
+    }
+    fs::rename(tmp_path, path);
+    return path;
+}
+
+std::string bench_fixtures::fresh_database(const std::string& name) {
+    const std::string schema_path = schema_database();
+    const std::string path = (fs::path(database_dir) / name).string();
+    remove_database(path);
+    fs::copy_file(schema_path, path);
+    return path;
+}
+
+const std::string& bench_fixtures::collection_database() {
+    if (collection_path.empty()) {
+        const std::string path = (fs::path(database_dir) / COLLECTION_DB).string();
+        if (!fs::exists(path)) {
+            const std::string tmp_path = fresh_database(std::string(COLLECTION_DB) + ".tmp");
+            {
+                const db_connection connection(tmp_path, database_profiles::BULK_LOAD);
+                import_collection(connection.get(), (fs::path(data.path) / generator_constants::COLLECTION_DIR)
+                                  .string(), threads, true);
+            }
+            fs::rename(tmp_path, path);
+        }
+        collection_path = path;
+    }
+    return collection_path;
+}
+
+const collection_store& bench_fixtures::collection() {
+    if (!store) {
+        const db_connection connection(collection_database());
+        store = load_collection(connection.get());
+    }
+    return *store;
+}
+
+const std::vector<std::string>& bench_fixtures::migrations() {
+    if (migration_sql.empty()) {
+        for (const auto& file : data.migration_files) {
+            migration_sql.push_back(read_file(file));
+        }
+    }
+    return migration_sql;
+}
+
+const std::vector<std::string>& bench_fixtures::pages(const std::string& recorded) {
+    if (page_json.empty()) {
+        std::vector<std::string> files = data.page_files;
+        if (!recorded.empty()) {
+            files.clear();
+            if (fs::is_directory(recorded)) {
+                for (const auto& entry : fs::directory_iterator(recorded)) {
+                    if (entry.is_regular_file() && entry.path().extension() == ".json") {
+                        files.push_back(entry.path().string());
+                    }
+                }
+            }
+            std::ranges::sort(files);
+        }
+        if (files.empty()) {
+            throw bench_error("No Scryfall responses found in " + (recorded.empty() ? data.path : recorded));
+        }
+        for (const auto& file : files) {
+            page_json.push_back(read_file(file));
+        }
+    }
+    return page_json;
+}
+
+// Benchmark registration functions
+// ---------------------------------------------------------------------------------------------------------------------
+void register_migration_benchmarks(bench_registry& registry, bench_fixtures& fixtures) {
+    const dataset& data = fixtures.files();
+    const std::string dir = (fs::path(data.path) / generator_constants::MIGRATIONS_DIR).string();
+
+    registry.add("migrations/parse_migration", [&data](bench_state& state) {
+        while (state.keep_running()) {
+            for (const auto& file : data.migration_files) {
+                do_not_optimize(parse_migration(file));
+            }
+            state.processed(data.migration_files.size(), data.migration_bytes);
+        }
+    });
+
+    registry.add("migrations/parse_migration_sql", [&data, &fixtures](bench_state& state) {
+        const std::vector<std::string>& contents = fixtures.migrations();
+        while (state.keep_running()) {
+            for (size_t idx = 0; idx < contents.size(); idx++) {
+                do_not_optimize(parse_migration_sql(contents[idx], data.migration_files[idx]));
+            }
+            state.processed(contents.size(), data.migration_bytes);
+        }
+    });
+
+    registry.add("migrations/hash_file", [&data](bench_state& state) {
+        while (state.keep_running()) {
+            for (const auto& file : data.migration_files) {
+                do_not_optimize(hash_file(file));
+            }
+            state.processed(data.migration_files.size(), data.migration_bytes);
+        }
+    });
+
+    // Half the migrations applied, every file in the scan index, as on a machine that ran doorkeeper before
+    registry.add("migrations/scan_migrations", [&data, dir](bench_state& state) {
+        const db_connection connection(":memory:");
+        if (!init_migration_table(connection.get())) {
+            state.skip("Unable to create the migrations table");
+            return;
+        }
+        migration_index index;
+        std::vector<migration> local = scan_local_migrations(dir);
+        db_statement insert = connection.prepare(migration_constants::INSERT_MIGRATION);
+        connection.exec("BEGIN;");
+        for (size_t idx = 0; idx < local.size(); idx++) {
+            const uint64_t checksum = hash_file(local[idx].path);
+            index.insert({local[idx].name, index_entry{local[idx].size, local[idx].mtime, checksum}});
+            if (idx < local.size() / 2) {
+                insert.bind(1, local[idx].name).bind(2, hash_to_hex(checksum)).step();
+                insert.reset();
+            }
+        }
+        connection.exec("COMMIT;");
+
+        while (state.keep_running()) {
+            do_not_optimize(scan_migrations(dir, connection.get(), index));
+            state.processed(data.migration_files.size());
+        }
+    });
+}
+
+void register_import_benchmarks(bench_registry& registry, bench_fixtures& fixtures) {
+    const dataset& data = fixtures.files();
+    const std::string dir = (fs::path(data.path) / generator_constants::COLLECTION_DIR).string();
+
+    registry.add("csv/next_record", [&data](bench_state& state) {
+        std::vector<std::string_view> fields;
+        while (state.keep_running()) {
+            uint64_t records = 0;
+            for (const auto& file : data.collection_files) {
+                mapped_file mapping(file, true);
+                csv_cursor cursor{mapping.data(), mapping.data() + mapping.size()};
+                while (next_record(cursor, fields)) {
+                    records++;
+                }
+            }
+            state.processed(records, data.collection_bytes);
+        }
+    });
+
+    registry.add("import/import_collection", [&fixtures, &data, dir](bench_state& state) {
+        while (state.keep_running()) {
+            state.pause_timing();
+            const std::string path = fixtures.fresh_database(SCRATCH_DB);
+            {
+                const db_connection connection(path, database_profiles::BULK_LOAD);
+                state.resume_timing();
+                const import_stats stats = import_collection(connection.get(), dir, fixtures.import_threads(), true);
+                state.processed(stats.rows, stats.bytes);
+                state.pause_timing();
+            }
+            state.resume_timing();
+        }
+        state.counter("rows", static_cast<double>(data.options.rows));
+    });
+
+    // Every file matches its last import, so this is the cost of hashing the files and skipping them
+    registry.add("import/import_collection/unchanged", [&fixtures, &data, dir](bench_state& state) {
+        const db_connection connection(fixtures.collection_database(), database_profiles::BULK_LOAD);
+        while (state.keep_running()) {
+            const import_stats stats = import_collection(connection.get(), dir, fixtures.import_threads(), true);
+            state.processed(stats.unchanged_files, data.collection_bytes);
+        }
+    });
+}
+
+void register_scryfall_benchmarks(bench_registry& registry, bench_fixtures& fixtures, const std::string& recorded) {
+    const dataset& data = fixtures.files();
+
+    registry.add("scryfall/parse_page", [&fixtures, recorded](bench_state& state) {
+        const std::vector<std::string>& pages = fixtures.pages(recorded);
+        uint64_t bytes = 0;
+        for (const auto& page : pages) {
+            bytes += page.size();
+        }
+        while (state.keep_running()) {
+            uint64_t cards = 0;
+            for (const auto& page : pages) {
+                const nlohmann::json document = nlohmann::json::parse(page);
+                cards += document.contains("data") ? document["data"].size() : 1;
+            }
+            state.processed(cards, bytes);
+        }
+    });
+
+    registry.add("scryfall/ingest_bulk_cards", [&fixtures, &data](bench_state& state) {
+        while (state.keep_running()) {
+            state.pause_timing();
+            const std::string path = fixtures.fresh_database(SCRATCH_DB);
+            {
+                const db_connection connection(path, database_profiles::BULK_LOAD);
+                state.resume_timing();
+                const ingest_stats stats = ingest_bulk_cards(connection.get(), data.bulk_file);
+                state.processed(stats.cards, stats.bytes);
+                state.pause_timing();
+            }
+            state.resume_timing();
+        }
+    });
+}
+
+void register_collection_benchmarks(bench_registry& registry, bench_fixtures& fixtures) {
+    registry.add("collection/load_collection", [&fixtures](bench_state& state) {
+        const db_connection connection(fixtures.collection_database());
+        while (state.keep_running()) {
+            const collection_store store = load_collection(connection.get());
+            state.processed(store.size());
+        }
+    });
+
+    for (const auto& [filter, sql] : QUERIES) {
+        const std::string argument = filter.empty() ? "all" : std::string(filter);
+
+        registry.add("collection/sum_quantity/" + argument, [&fixtures, filter](bench_state& state) {
+            const collection_store& store = fixtures.collection();
+            const collection_filter parsed = parse_filter(filter, store);
+            while (state.keep_running()) {
+                do_not_optimize(sum_quantity(store, parsed));
+                state.processed(store.size());
+            }
+        });
+
+        registry.add("collection/sql/" + argument, [&fixtures, sql](bench_state& state) {
+            const std::string& path = fixtures.collection_database();
+            const uint64_t rows = count_rows(path, "raw_collection");
+            db_connection connection(path, database_profiles::READ_ONLY, SQLITE_OPEN_READONLY);
+            while (state.keep_running()) {
+                sqlite3_stmt* stmt = connection.cached(sql);
+                if (sqlite3_step(stmt) == SQLITE_ROW) {
+                    do_not_optimize(sqlite3_column_int64(stmt, 0));
+                }
+                sqlite3_reset(stmt);
+                state.processed(rows);
+            }
+        });
+    }
+
+    registry.add("collection/select_rows/colors=G", [&fixtures](bench_state& state) {
+        const collection_store& store = fixtures.collection();
+        const collection_filter parsed = parse_filter("colors=G", store);
+        while (state.keep_running()) {
+            do_not_optimize(select_rows(store, parsed).size());
+            state.processed(store.size());
+        }
+    });
+
+    registry.add("collection/sum_quantity_by_set/foil=true", [&fixtures](bench_state& state) {
+        const collection_store& store = fixtures.collection();
+        const collection_filter parsed = parse_filter("foil=true", store);
+        while (state.keep_running()) {
+            do_not_optimize(sum_quantity_by_set(store, parsed).size());
+            state.processed(store.size());
+        }
+    });
+}
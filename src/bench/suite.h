@@ -0,0 +1,160 @@
+/**
+ * Benchmarks of the project binaries header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef SUITE_H
+#define SUITE_H
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "collection.h"
+#include "database.h"
+#include "generator.h"
+#include "harness.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace suite_constants {
+    inline const char* SCHEMA_DB = "schema.db"; ///< Empty database with every migration applied (copied per run)
+    inline const char* COLLECTION_DB = "collection.db"; ///< Database with the collection imported
+    inline const char* SCRATCH_DB = "scratch.db"; ///< Database rebuilt by the benchmarks that write
+
+    /**
+     * Struct to hold a collection query, as a filter of the columnar store and as the equivalent SQL
+     */
+    struct query {
+        std::string_view filter; ///< Filter of parse_filter (also the benchmark argument)
+        const char* sql; ///< Equivalent SQL statement
+    };
+
+    inline constexpr std::array<query, 4> QUERIES = {{
+        {"", "SELECT SUM(quantity) FROM raw_collection;"},
+        {"rarity=RM", "SELECT SUM(quantity) FROM raw_collection WHERE rarity IN ('R', 'M');"},
+        {"foil=true,identity=WU", "SELECT SUM(quantity) FROM raw_collection "
+                                  "WHERE foil = 1 AND color_id NOT GLOB '*[BRG]*';"},
+        {"colors=G", "SELECT SUM(quantity) FROM raw_collection WHERE colors = 'G';"}
+    }}; ///< Queries run against the collection
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Inputs shared by the benchmarks, built on first use and outside the measured sections, so a filtered session only
+ * pays for the inputs of the benchmarks it runs
+ */
+class bench_fixtures {
+    const dataset& data; ///< Generated dataset
+    std::string schema; ///< Directory of the project migrations
+    unsigned int threads; ///< Import workers (0 for one per available core)
+    std::string database_dir; ///< Directory of the databases
+    std::optional<collection_store> store; ///< Collection loaded from the collection database
+    std::vector<std::string> migration_sql; ///< Contents of the migration files
+    std::vector<std::string> page_json; ///< Contents of the listing pages
+    std::string collection_path; ///< Path of the collection database (empty until it is imported)
+
+    /**
+     * Builds the schema database if it does not exist yet
+     * @return Path of the schema database
+     * @throw bench_error if the project migrations cannot be applied
+     */
+    std::string schema_database();
+public:
+    /**
+     * Creates the fixtures of a dataset
+     * @param dataset_data Generated dataset (must outlive the fixtures)
+     * @param schema_dir Directory of the project migrations
+     * @param import_threads Import workers (0 for one per available core)
+     */
+    bench_fixtures(const dataset& dataset_data, std::string schema_dir, unsigned int import_threads);
+
+    /**
+     * Generated dataset
+     * @return Dataset
+     */
+    [[nodiscard]] const dataset& files() const {return data;}
+
+    /**
+     * Import workers
+     * @return Workers (0 for one per available core)
+     */
+    [[nodiscard]] unsigned int import_threads() const {return threads;}
+
+    /**
+     * Replaces a database with an empty one holding the project schema
+     * @param name File name of the database in the database directory
+     * @return Path of the database
+     * @throw bench_error if the schema cannot be built or copied
+     */
+    std::string fresh_database(const std::string& name);
+
+    /**
+     * Database with the whole collection imported, imported on the first call
+     * @return Path of the database
+     * @throw bench_error if the schema cannot be built
+     */
+    const std::string& collection_database();
+
+    /**
+     * Collection of the collection database in a columnar store
+     * @return Collection store
+     */
+    const collection_store& collection();
+
+    /**
+     * Contents of the migration files
+     * @return Contents in file order
+     */
+    const std::vector<std::string>& migrations();
+
+    /**
+     * Contents of the Scryfall listing pages: the recorded responses of a directory when one is given, else the
+     * generated pages
+     * @param recorded Directory of recorded responses (*.json, empty for the generated pages)
+     * @return Contents of the responses
+     * @throw bench_error if the directory has no responses
+     */
+    const std::vector<std::string>& pages(const std::string& recorded);
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Registers the benchmarks of the migration manager: parsing and hashing the migration files and scanning their
+ * directory against a database
+ * @param registry Benchmark registry
+ * @param fixtures Shared inputs
+ */
+void register_migration_benchmarks(bench_registry& registry, bench_fixtures& fixtures);
+
+/**
+ * Registers the benchmarks of the collection importer: CSV parsing, full imports into an empty database and
+ * incremental imports of unchanged files
+ * @param registry Benchmark registry
+ * @param fixtures Shared inputs
+ */
+void register_import_benchmarks(bench_registry& registry, bench_fixtures& fixtures);
+
+/**
+ * Registers the benchmarks of the Scryfall parsers: listing pages into documents and the bulk dump into the card table
+ * @param registry Benchmark registry
+ * @param fixtures Shared inputs
+ * @param recorded Directory of recorded responses parsed instead of the generated pages (empty for none)
+ */
+void register_scryfall_benchmarks(bench_registry& registry, bench_fixtures& fixtures, const std::string& recorded);
+
+/**
+ * Registers the benchmarks of the collection queries: loading the columnar store, the QUERIES on it and the same
+ * queries in SQL
+ * @param registry Benchmark registry
+ * @param fixtures Shared inputs
+ */
+void register_collection_benchmarks(bench_registry& registry, bench_fixtures& fixtures);
+
+#endif //SUITE_H
@@ -0,0 +1,222 @@
+#include <utility>
+
+#include "database.h"
+#include "profiler.h"
+#include "exceptions.h"
+
+using namespace database_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Prepares a statement
+     * @param DB Sqlite database object
+     * @param sql SQL text of a single statement
+     * @param flags sqlite3_prepare_v3 flags
+     * @return Prepared statement
+     * @throw database_error if the statement cannot be prepared
+     */
+    sqlite3_stmt* prepare_or_throw(sqlite3* DB, const std::string_view sql, const unsigned int flags) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v3(DB, sql.data(), static_cast<int>(sql.size()), flags, &stmt, nullptr) != SQLITE_OK) {
+            const std::string err_msg = "Preparing \"" + std::string(sql) + "\" (" + sqlite3_errmsg(DB) + ")";
+            throw database_error(err_msg);
+        }
+        return stmt;
+    }
+
+    /**
+     * Opens a database
+     * @param path Path of the database
+     * @param flags sqlite3_open_v2 flags
+     * @return Sqlite database object
+     * @throw database_error if the database cannot be opened
+     */
+    sqlite3* open_or_throw(const std::string& path, const int flags) {
+        sqlite3* DB;
+        if (sqlite3_open_v2(path.c_str(), &DB, flags, nullptr) != SQLITE_OK) {
+            const std::string err_msg = "Opening " + path + " (" + sqlite3_errmsg(DB) + ")";
+            sqlite3_close(DB);
+            throw database_error(err_msg);
+        }
+        sqlite3_busy_timeout(DB, BUSY_TIMEOUT_MS);
+        return DB;
+    }
+}
+
+// Statement
+// ---------------------------------------------------------------------------------------------------------------------
+db_statement& db_statement::operator=(db_statement&& other) noexcept {
+    if (this != &other) {
+        sqlite3_finalize(stmt);
+        stmt = std::exchange(other.stmt, nullptr);
+    }
+    return *this;
+}
+
+db_statement& db_statement::bind(const int idx, const int64_t value) {
+    sqlite3_bind_int64(stmt, idx, value);
+    return *this;
+}
+
+db_statement& db_statement::bind(const int idx, const double value) {
+    sqlite3_bind_double(stmt, idx, value);
+    return *this;
+}
+
+db_statement& db_statement::bind(const int idx, const std::string_view value) {
+    sqlite3_bind_text(stmt, idx, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+    return *this;
+}
+
+db_statement& db_statement::bind(const int idx, std::nullptr_t) {
+    sqlite3_bind_null(stmt, idx);
+    return *this;
+}
+
+bool db_statement::step() {
+    const int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        return true;
+    }
+    if (rc != SQLITE_DONE) {
+        const std::string err_msg = std::string("Running \"") + sqlite3_sql(stmt) + "\" (" +
+                                    sqlite3_errmsg(sqlite3_db_handle(stmt)) + ")";
+        sqlite3_reset(stmt);
+        throw database_error(err_msg);
+    }
+    return false;
+}
+
+void db_statement::reset() {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+std::string_view db_statement::column_text(const int column) const {
+    const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    return text != nullptr ? std::string_view(text, sqlite3_column_bytes(stmt, column)) : std::string_view();
+}
+
+// Statement cache
+// ---------------------------------------------------------------------------------------------------------------------
+statement_cache::statement_cache(statement_cache&& other) noexcept
+    : DB(other.DB), capacity(other.capacity), entries(std::move(other.entries)), index(std::move(other.index)),
+      hit_count(other.hit_count), miss_count(other.miss_count) {
+    other.entries.clear();
+    other.index.clear();
+}
+
+statement_cache& statement_cache::operator=(statement_cache&& other) noexcept {
+    if (this != &other) {
+        clear();
+        DB = other.DB;
+        capacity = other.capacity;
+        entries = std::move(other.entries); // List nodes move along, so the index keys stay valid
+        index = std::move(other.index);
+        hit_count = other.hit_count;
+        miss_count = other.miss_count;
+        other.entries.clear();
+        other.index.clear();
+    }
+    return *this;
+}
+
+sqlite3_stmt* statement_cache::get(const std::string_view sql) {
+    if (const auto cached = index.find(sql); cached != index.end()) {
+        hit_count++;
+        entries.splice(entries.begin(), entries, cached->second);
+        sqlite3_reset(cached->second->stmt);
+        return cached->second->stmt;
+    }
+
+    miss_count++;
+    sqlite3_stmt* stmt = prepare_or_throw(DB, sql, SQLITE_PREPARE_PERSISTENT);
+    entries.push_front({std::string(sql), stmt});
+    index.emplace(entries.front().sql, entries.begin());
+    if (entries.size() > capacity) {
+        index.erase(entries.back().sql);
+        sqlite3_finalize(entries.back().stmt);
+        entries.pop_back();
+    }
+    return stmt;
+}
+
+void statement_cache::clear() {
+    for (const entry& cached : entries) {
+        sqlite3_finalize(cached.stmt);
+    }
+    entries.clear();
+    index.clear();
+}
+
+// Connection
+// ---------------------------------------------------------------------------------------------------------------------
+db_connection::db_connection(const std::string& path, const pragma_profile& profile, const int flags)
+    : DB(open_or_throw(path, flags)), statements(DB) {
+    try {
+        apply(profile);
+    } catch (...) {
+        sqlite3_close(DB);
+        throw;
+    }
+    if (statement_profiler* profiler = statement_profiler::installed(); profiler != nullptr) {
+        trace = std::make_unique<statement_trace>(DB, *profiler);
+    }
+}
+
+db_connection::~db_connection() {
+    statements.clear(); // Finalizing reports the statements left mid-run to the trace, so it is stopped afterwards
+    trace.reset();
+    sqlite3_close_v2(DB); // Statements still held by the caller keep the connection alive until they are finalized
+}
+
+void db_connection::apply(const pragma_profile& profile) const {
+    std::string sql;
+    if (!profile.journal_mode.empty()) {
+        sql += "PRAGMA journal_mode = " + std::string(profile.journal_mode) + ";";
+    }
+    if (!profile.synchronous.empty()) {
+        sql += "PRAGMA synchronous = " + std::string(profile.synchronous) + ";";
+    }
+    if (profile.cache_size > 0) {
+        sql += "PRAGMA cache_size = -" + std::to_string(profile.cache_size) + ";"; // Negative: KiB instead of pages
+    }
+    if (profile.mmap_size >= 0) {
+        sql += "PRAGMA mmap_size = " + std::to_string(profile.mmap_size) + ";";
+    }
+    if (!profile.temp_store.empty()) {
+        sql += "PRAGMA temp_store = " + std::string(profile.temp_store) + ";";
+    }
+    if (!sql.empty()) {
+        exec(sql.c_str());
+    }
+}
+
+void db_connection::exec(const char* sql) const {
+    if (sqlite3_exec(DB, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        const std::string err_msg = std::string(sql) + " (" + sqlite3_errmsg(DB) + ")";
+        throw database_error(err_msg);
+    }
+}
+
+db_statement db_connection::prepare(const std::string_view sql) const {
+    return db_statement(prepare_or_throw(DB, sql, 0));
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::optional<pragma_profile> find_profile(const std::string_view name) {
+    for (const pragma_profile& profile : database_profiles::ALL) {
+        if (profile.name == name) {
+            return profile;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string query_value(sqlite3* DB, const std::string_view sql) {
+    db_statement stmt(prepare_or_throw(DB, sql, 0));
+    return stmt.step() ? std::string(stmt.column_text(0)) : std::string();
+}
@@ -0,0 +1,305 @@
+/**
+ * SQLite connection layer shared by the project binaries header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.2
+ */
+
+#ifndef DATABASE_H
+#define DATABASE_H
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace database_constants {
+    inline constexpr size_t STATEMENT_CACHE_SIZE = 64; ///< Prepared statements kept per connection
+    inline constexpr int BUSY_TIMEOUT_MS = 5000; ///< Time a statement waits for a lock held by another connection
+    inline constexpr int OPEN_FLAGS = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE; ///< Default open flags
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the pragmas a connection is tuned with. Empty or negative fields leave the setting of the database
+ * as it is
+ */
+struct pragma_profile {
+    std::string_view name; ///< Name of the profile
+    std::string_view journal_mode; ///< journal_mode (persistent: WAL stays on after the connection closes)
+    std::string_view synchronous; ///< synchronous (durability against power loss)
+    int64_t cache_size = 0; ///< cache_size in KiB (0 to leave it)
+    int64_t mmap_size = -1; ///< mmap_size in bytes (-1 to leave it)
+    std::string_view temp_store; ///< temp_store (where temporary tables and indexes live)
+};
+
+namespace database_profiles {
+    /**
+     * SQLite defaults: full durability, for migrations and anything without a better profile
+     */
+    inline constexpr pragma_profile DEFAULT = {"default", "", "", 0, -1, ""};
+
+    /**
+     * Bulk loads: the sources are still on disk, so syncing every commit buys nothing. The rollback journal stays, so
+     * a crashed load still rolls back to its last commit, but a power loss may corrupt the database
+     */
+    inline constexpr pragma_profile BULK_LOAD = {"bulk", "", "OFF", 256 * 1024, 256LL << 20, "MEMORY"};
+
+    /**
+     * Serving reads next to an occasional writer: WAL lets readers run while a write is in progress and syncs only
+     * at checkpoints. doorkeeper --online refuses WAL databases, switch back to a rollback journal before using it
+     */
+    inline constexpr pragma_profile SERVING = {"serving", "WAL", "NORMAL", 64 * 1024, 1LL << 30, "MEMORY"};
+
+    /**
+     * Read-only connections next to a SERVING one: its caches without the journal settings, which a read-only
+     * connection cannot change. Not selectable by name, as the main connection of a command may write
+     */
+    inline constexpr pragma_profile READ_ONLY = {"readonly", "", "", SERVING.cache_size, SERVING.mmap_size,
+                                                 SERVING.temp_store};
+
+    inline constexpr std::array<pragma_profile, 3> ALL = {DEFAULT, BULK_LOAD, SERVING}; ///< Profiles by name
+}
+
+/**
+ * Owning wrapper of a prepared statement (finalized on destruction)
+ */
+class db_statement {
+    sqlite3_stmt* stmt = nullptr; ///< Prepared statement
+public:
+    db_statement() = default;
+    explicit db_statement(sqlite3_stmt* prepared) : stmt(prepared) {}
+    ~db_statement() {sqlite3_finalize(stmt);}
+    db_statement(const db_statement&) = delete;
+    db_statement& operator=(const db_statement&) = delete;
+    db_statement(db_statement&& other) noexcept : stmt(other.stmt) {other.stmt = nullptr;}
+    db_statement& operator=(db_statement&& other) noexcept;
+
+    /**
+     * Prepared statement
+     * @return Statement handle (owned by the wrapper)
+     */
+    [[nodiscard]] sqlite3_stmt* get() const {return stmt;}
+
+    /**
+     * Binds an integer parameter
+     * @param idx Parameter index (1-based)
+     * @param value Value
+     * @return This statement
+     */
+    db_statement& bind(int idx, int64_t value);
+
+    /**
+     * Binds a real parameter
+     * @param idx Parameter index (1-based)
+     * @param value Value
+     * @return This statement
+     */
+    db_statement& bind(int idx, double value);
+
+    /**
+     * Binds a text parameter without copying it
+     * @param idx Parameter index (1-based)
+     * @param value Value (must outlive the next step)
+     * @return This statement
+     */
+    db_statement& bind(int idx, std::string_view value);
+
+    /**
+     * Binds a NULL parameter
+     * @param idx Parameter index (1-based)
+     * @return This statement
+     */
+    db_statement& bind(int idx, std::nullptr_t);
+
+    /**
+     * Steps the statement
+     * @return True if a row is available, false when the statement is done
+     * @throw database_error if the step fails
+     */
+    bool step();
+
+    /**
+     * Resets the statement and clears its bindings, so it can run again
+     */
+    void reset();
+
+    /**
+     * Reads an integer column of the current row
+     * @param column Column index
+     * @return Value (0 for NULL)
+     */
+    [[nodiscard]] int64_t column_int64(const int column) const {return sqlite3_column_int64(stmt, column);}
+
+    /**
+     * Reads a text column of the current row
+     * @param column Column index
+     * @return Value (empty for NULL), valid until the next step
+     */
+    [[nodiscard]] std::string_view column_text(int column) const;
+
+    /**
+     * Checks whether a column of the current row is NULL
+     * @param column Column index
+     * @return True if the column is NULL
+     */
+    [[nodiscard]] bool column_null(const int column) const {return sqlite3_column_type(stmt, column) == SQLITE_NULL;}
+};
+
+/**
+ * Least recently used cache of prepared statements keyed by their SQL text. Statements are prepared as persistent on
+ * the first request and finalized when they fall out of the cache, so hot statements are compiled once per connection
+ */
+class statement_cache {
+    /**
+     * Struct to hold a cached statement
+     */
+    struct entry {
+        std::string sql; ///< SQL text (the index keys point into it)
+        sqlite3_stmt* stmt; ///< Prepared statement
+    };
+
+    sqlite3* DB; ///< Sqlite database object
+    size_t capacity; ///< Maximum number of statements
+    std::list<entry> entries; ///< Statements from most to least recently used
+    std::unordered_map<std::string_view, std::list<entry>::iterator> index; ///< Statements by SQL text
+    size_t hit_count = 0; ///< Requests served from the cache
+    size_t miss_count = 0; ///< Requests that prepared a statement
+public:
+    explicit statement_cache(sqlite3* db, size_t max_statements = database_constants::STATEMENT_CACHE_SIZE)
+        : DB(db), capacity(std::max<size_t>(max_statements, 1)) {}
+    ~statement_cache() {clear();}
+    statement_cache(const statement_cache&) = delete;
+    statement_cache& operator=(const statement_cache&) = delete;
+    statement_cache(statement_cache&& other) noexcept;
+    statement_cache& operator=(statement_cache&& other) noexcept;
+
+    /**
+     * Retrieves the statement for a SQL text, preparing it if it is not cached. The statement is reset (its bindings
+     * are kept) and stays valid until capacity other statements are requested or the cache is cleared
+     * @param sql SQL text of a single statement
+     * @return Prepared statement (owned by the cache)
+     * @throw database_error if the statement cannot be prepared
+     */
+    sqlite3_stmt* get(std::string_view sql);
+
+    /**
+     * Finalizes every cached statement
+     */
+    void clear();
+
+    /**
+     * Number of cached statements
+     * @return Statements in the cache
+     */
+    [[nodiscard]] size_t size() const {return entries.size();}
+
+    /**
+     * Number of requests served from the cache
+     * @return Cache hits
+     */
+    [[nodiscard]] size_t hits() const {return hit_count;}
+
+    /**
+     * Number of requests that prepared a statement
+     * @return Cache misses
+     */
+    [[nodiscard]] size_t misses() const {return miss_count;}
+};
+
+class statement_trace;
+
+/**
+ * Owning wrapper of a database connection (closed on destruction, after its cached statements are finalized). The
+ * connection waits up to BUSY_TIMEOUT_MS for locks held by other connections instead of failing at once, and its
+ * statements are traced into the installed statement_profiler, if any
+ */
+class db_connection {
+    sqlite3* DB = nullptr; ///< Sqlite database object
+    statement_cache statements; ///< Prepared statements of the connection
+    std::unique_ptr<statement_trace> trace; ///< Profiler trace (null when profiling is off)
+public:
+    /**
+     * Opens a database and tunes the connection
+     * @param path Path of the database
+     * @param profile Pragmas of the connection
+     * @param flags sqlite3_open_v2 flags
+     * @throw database_error if the database cannot be opened or tuned
+     */
+    explicit db_connection(const std::string& path, const pragma_profile& profile = database_profiles::DEFAULT,
+                           int flags = database_constants::OPEN_FLAGS);
+    ~db_connection();
+    db_connection(const db_connection&) = delete;
+    db_connection& operator=(const db_connection&) = delete;
+
+    /**
+     * Sqlite database object
+     * @return Connection handle (owned by the wrapper)
+     */
+    [[nodiscard]] sqlite3* get() const {return DB;}
+
+    /**
+     * Applies a pragma profile
+     * @param profile Pragmas to apply
+     * @throw database_error if a pragma fails
+     */
+    void apply(const pragma_profile& profile) const;
+
+    /**
+     * Executes SQL statements that return no rows
+     * @param sql SQL statements
+     * @throw database_error if a statement fails
+     */
+    void exec(const char* sql) const;
+
+    /**
+     * Prepares a statement owned by the caller (for statements run once; use cached for repeated ones)
+     * @param sql SQL text of a single statement
+     * @return Prepared statement
+     * @throw database_error if the statement cannot be prepared
+     */
+    [[nodiscard]] db_statement prepare(std::string_view sql) const;
+
+    /**
+     * Retrieves a statement from the statement cache of the connection
+     * @param sql SQL text of a single statement
+     * @return Prepared statement (owned by the cache)
+     * @throw database_error if the statement cannot be prepared
+     */
+    sqlite3_stmt* cached(const std::string_view sql) {return statements.get(sql);}
+
+    /**
+     * Statement cache of the connection
+     * @return Statement cache
+     */
+    statement_cache& cache() {return statements;}
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Looks up a pragma profile by name
+ * @param name Name of the profile (default, bulk or serving)
+ * @return Profile, or nullopt for an unknown name
+ */
+std::optional<pragma_profile> find_profile(std::string_view name);
+
+/**
+ * Reads the value of a single row, single column query (a pragma, a count)
+ * @param DB Sqlite database object
+ * @param sql SQL statement
+ * @return Text of the first column of the first row (empty if there is none)
+ * @throw database_error if the statement fails
+ */
+std::string query_value(sqlite3* DB, std::string_view sql);
+
+#endif //DATABASE_H
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "profiler.h"
+
+using namespace profiler_constants;
+using clock_type = std::chrono::steady_clock;
+
+std::atomic<statement_profiler*> statement_profiler::active{nullptr};
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS; ///< Buckets per power of two
+
+    /**
+     * Checks whether a character can be part of an identifier or keyword
+     * @param c Character
+     * @return True for ASCII alphanumerics, _, $ and every non-ASCII byte
+     */
+    bool is_word_char(const char c) {
+        const auto byte = static_cast<unsigned char>(c);
+        return std::isalnum(byte) || c == '_' || c == '$' || byte >= 0x80;
+    }
+
+    /**
+     * Escapes a string for a JSON document
+     * @param text Text to escape
+     * @return Escaped text, without quotes
+     */
+    std::string json_escape(const std::string_view text) {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                std::ostringstream code;
+                code << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                escaped += code.str();
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    /**
+     * Converts nanoseconds to microseconds
+     * @param ns Nanoseconds
+     * @return Microseconds
+     */
+    double to_us(const uint64_t ns) {
+        return static_cast<double>(ns) / 1000.0;
+    }
+}
+
+// Latency histogram
+// ---------------------------------------------------------------------------------------------------------------------
+size_t latency_histogram::bucket_of(const uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    const auto exponent = static_cast<size_t>(std::bit_width(value)) - SUB_BUCKET_BITS;
+    return exponent * SUB_BUCKETS + static_cast<size_t>(value >> (exponent - 1)) - SUB_BUCKETS;
+}
+
+uint64_t latency_histogram::bucket_low(const size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const size_t exponent = bucket / SUB_BUCKETS;
+    return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - 1);
+}
+
+void latency_histogram::record(const uint64_t value) {
+    const size_t bucket = bucket_of(value);
+    if (bucket >= buckets.size()) {
+        buckets.resize(bucket + 1);
+    }
+    buckets[bucket]++;
+    total++;
+    min_value = std::min(min_value, value);
+    max_value = std::max(max_value, value);
+}
+
+uint64_t latency_histogram::percentile(const double quantile) const {
+    if (total == 0) {
+        return 0;
+    }
+    const auto rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total))), 1);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            const uint64_t low = bucket_low(bucket);
+            const uint64_t middle = low + (bucket_low(bucket + 1) - low) / 2;
+            return std::clamp(middle, min_value, max_value);
+        }
+    }
+    return max_value;
+}
+
+// Statement profiler
+// ---------------------------------------------------------------------------------------------------------------------
+void statement_profiler::record(const std::string_view sql, const uint64_t ns, const uint64_t rows) {
+    const std::lock_guard lock(mutex);
+    auto raw = raw_index.find(sql);
+    if (raw == raw_index.end()) {
+        std::string normalized = normalize_statement(sql);
+        const auto [entry, inserted] = normalized_index.try_emplace(normalized, stats.size());
+        if (inserted) {
+            stats.emplace_back().sql = std::move(normalized);
+        }
+        raw = raw_index.emplace(std::string(sql), entry->second).first;
+    }
+
+    statement_stats& entry = stats[raw->second];
+    entry.count++;
+    entry.total_ns += ns;
+    entry.rows += rows;
+    entry.latency.record(ns);
+}
+
+std::vector<statement_stats> statement_profiler::report() const {
+    std::vector<statement_stats> copy;
+    {
+        const std::lock_guard lock(mutex);
+        copy = stats;
+    }
+    std::ranges::sort(copy, [](const auto& a, const auto& b) {return a.total_ns > b.total_ns;});
+    return copy;
+}
+
+// Statement trace
+// ---------------------------------------------------------------------------------------------------------------------
+statement_trace::statement_trace(sqlite3* db, statement_profiler& target) : DB(db), profiler(target) {
+    sqlite3_trace_v2(DB, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, callback, this);
+}
+
+statement_trace::~statement_trace() {
+    sqlite3_trace_v2(DB, 0, nullptr, nullptr);
+}
+
+int statement_trace::callback(const unsigned int event, void* context, void* p, void* x) {
+    auto* trace = static_cast<statement_trace*>(context);
+    auto* stmt = static_cast<sqlite3_stmt*>(p);
+    switch (event) {
+        case SQLITE_TRACE_STMT: {
+            if (x != sqlite3_sql(stmt)) {
+                break; // A trigger starting inside the statement (its text is a comment naming the trigger)
+            }
+            trace->runs[stmt] = {clock_type::now(), sqlite3_total_changes64(trace->DB), 0};
+            break;
+        }
+        case SQLITE_TRACE_ROW:
+            if (stmt != trace->last_stmt) {
+                const auto run = trace->runs.find(stmt);
+                trace->last_stmt = stmt;
+                trace->last_run = run != trace->runs.end() ? &run->second : nullptr;
+            }
+            if (trace->last_run != nullptr) {
+                trace->last_run->rows++;
+            }
+            break;
+        case SQLITE_TRACE_PROFILE: {
+            const auto now = clock_type::now();
+            auto ns = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(x));
+            uint64_t rows = 0;
+            if (const auto run = trace->runs.find(stmt); run != trace->runs.end()) {
+                ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - run->second.start).count());
+                rows = run->second.rows +
+                       static_cast<uint64_t>(sqlite3_total_changes64(trace->DB) - run->second.changes);
+                if (trace->last_stmt == stmt) {
+                    trace->last_stmt = nullptr;
+                    trace->last_run = nullptr;
+                }
+                trace->runs.erase(run);
+            }
+            const char* sql = sqlite3_sql(stmt);
+            trace->profiler.record(sql != nullptr ? sql : "", ns, rows);
+            break;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
+// Profiler session
+// ---------------------------------------------------------------------------------------------------------------------
+profiler_session::profiler_session(std::string output) : target(std::move(output)) {
+    if (!target.empty()) {
+        statement_profiler::install(&profiler);
+    }
+}
+
+profiler_session::~profiler_session() {
+    if (target.empty()) {
+        return;
+    }
+    statement_profiler::install(nullptr);
+    const std::vector<statement_stats> stats = profiler.report();
+    std::cout << print_profile_report(stats);
+    if (target == STDOUT_TARGET) {
+        return;
+    }
+    std::ofstream file(target, std::ios::trunc);
+    file << profile_report_json(stats);
+    if (file.good()) {
+        std::cout << "Profile written to " << target << std::endl;
+    } else {
+        std::cout << "Warning: Unable to write the profile to " << target << std::endl;
+    }
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string normalize_statement(const std::string_view sql) {
+    std::string normalized;
+    normalized.reserve(sql.size());
+    bool space = false; // Whitespace (or a comment) is pending before the next token
+    const auto emit = [&](const std::string_view token) {
+        if (space && !normalized.empty() && normalized.back() != '(' && token != ")" && token != ",") {
+            normalized += ' ';
+        }
+        space = false;
+        normalized += token;
+    };
+
+    size_t i = 0;
+    while (i < sql.size()) {
+        const char c = sql[i];
+        const char next = i + 1 < sql.size() ? sql[i + 1] : '\0';
+        if (c == '-' && next == '-') {
+            i = std::min(sql.find('\n', i), sql.size());
+            space = true;
+        } else if (c == '/' && next == '*') {
+            const size_t end = sql.find("*/", i + 2);
+            i = end == std::string_view::npos ? sql.size() : end + 2;
+            space = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+            space = true;
+        } else if (c == '\'') {
+            // String literal, with '' as an escaped quote
+            for (i++; i < sql.size(); i++) {
+                if (sql[i] == '\'') {
+                    if (i + 1 < sql.size() && sql[i + 1] == '\'') {
+                        i++;
+                    } else {
+                        i++;
+                        break;
+                    }
+                }
+            }
+            emit("?");
+        } else if (c == '"' || c == '`' || c == '[') {
+            // Quoted identifier, kept as it is
+            const size_t end = sql.find(c == '[' ? ']' : c, i + 1);
+            const size_t stop = end == std::string_view::npos ? sql.size() : end + 1;
+            emit(sql.substr(i, stop - i));
+            i = stop;
+        } else if (std::isdigit(static_cast<unsigned char>(c)) && (i == 0 || !is_word_char(sql[i - 1]))) {
+            // Numeric literal (integers, reals, hexadecimals), not a digit inside an identifier
+            while (i < sql.size() && (is_word_char(sql[i]) || sql[i] == '.')) {
+                i++;
+            }
+            emit("?");
+        } else if (is_word_char(c)) {
+            const size_t start = i;
+            while (i < sql.size() && is_word_char(sql[i])) {
+                i++;
+            }
+            emit(sql.substr(start, i - start));
+        } else {
+            emit(sql.substr(i, 1));
+            i++;
+        }
+    }
+    while (!normalized.empty() && (normalized.back() == ';' || normalized.back() == ' ')) {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+std::string print_profile_report(const std::vector<statement_stats>& stats) {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    for (const statement_stats& entry : stats) {
+        calls += entry.count;
+        total_ns += entry.total_ns;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "Profiled " << calls << " statements (" << stats.size() << " distinct) in "
+        << static_cast<double>(total_ns) / 1e6 << " ms\n";
+    out << std::setw(10) << "calls" << std::setw(12) << "total ms" << std::setw(12) << "p50 us" << std::setw(12)
+        << "p99 us" << std::setw(12) << "max us" << std::setw(12) << "rows" << "  statement\n";
+    for (const statement_stats& entry : stats) {
+        std::string sql = entry.sql;
+        if (sql.size() > REPORT_SQL_WIDTH) {
+            sql.resize(REPORT_SQL_WIDTH - 3);
+            sql += "...";
+        }
+        out << std::setw(10) << entry.count << std::setw(12) << static_cast<double>(entry.total_ns) / 1e6
+            << std::setw(12) << to_us(entry.latency.percentile(0.5)) << std::setw(12)
+            << to_us(entry.latency.percentile(0.99)) << std::setw(12) << to_us(entry.latency.max()) << std::setw(12)
+            << entry.rows << "  " << sql << "\n";
+    }
+    return out.str();
+}
+
+std::string profile_report_json(const std::vector<statement_stats>& stats) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"statements\": [";
+    for (size_t i = 0; i < stats.size(); i++) {
+        const statement_stats& entry = stats[i];
+        out << (i == 0 ? "\n" : ",\n") << "  {\"sql\": \"" << json_escape(entry.sql) << "\", \"count\": "
+            << entry.count << ", \"total_us\": " << to_us(entry.total_ns) << ", \"mean_us\": "
+            << to_us(entry.total_ns) / static_cast<double>(std::max<uint64_t>(entry.count, 1)) << ", \"p50_us\": "
+            << to_us(entry.latency.percentile(0.5)) << ", \"p99_us\": " << to_us(entry.latency.percentile(0.99))
+            << ", \"max_us\": " << to_us(entry.latency.max()) << ", \"rows\": " << entry.rows << "}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
@@ -0,0 +1,228 @@
+/**
+ * Per-statement SQLite profiler header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace profiler_constants {
+    inline constexpr int SUB_BUCKET_BITS = 5; ///< Buckets per power of two (as bits): 32 buckets, ~3% error
+    inline constexpr size_t REPORT_SQL_WIDTH = 72; ///< Characters of SQL shown per statement in the report
+    inline const char* STDOUT_TARGET = "-"; ///< Profile target that prints the report without a JSON dump
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * HDR-style latency histogram: values below 2^SUB_BUCKET_BITS get a bucket each, and every power of two above is
+ * split into 2^SUB_BUCKET_BITS buckets, so percentiles keep the same relative precision from microseconds to minutes
+ * in a few KB
+ */
+class latency_histogram {
+    std::vector<uint64_t> buckets; ///< Counts by bucket (grown up to the largest bucket used)
+    uint64_t total = 0; ///< Recorded values
+    uint64_t min_value = UINT64_MAX; ///< Smallest recorded value
+    uint64_t max_value = 0; ///< Largest recorded value
+
+    /**
+     * Finds the bucket of a value
+     * @param value Value
+     * @return Bucket index
+     */
+    static size_t bucket_of(uint64_t value);
+
+    /**
+     * Lowest value of a bucket
+     * @param bucket Bucket index
+     * @return Lower bound of the bucket
+     */
+    static uint64_t bucket_low(size_t bucket);
+public:
+    /**
+     * Records a value
+     * @param value Value (nanoseconds for latencies)
+     */
+    void record(uint64_t value);
+
+    /**
+     * Estimates a percentile
+     * @param quantile Quantile between 0 and 1 (0.99 for p99)
+     * @return Midpoint of the bucket holding the percentile, within the recorded range (0 if empty)
+     */
+    [[nodiscard]] uint64_t percentile(double quantile) const;
+
+    /**
+     * Number of recorded values
+     * @return Recorded values
+     */
+    [[nodiscard]] uint64_t count() const {return total;}
+
+    /**
+     * Largest recorded value
+     * @return Maximum (0 if empty)
+     */
+    [[nodiscard]] uint64_t max() const {return max_value;}
+};
+
+/**
+ * Struct to hold the statistics of a normalized statement
+ */
+struct statement_stats {
+    std::string sql; ///< Normalized SQL text
+    uint64_t count = 0; ///< Executions
+    uint64_t total_ns = 0; ///< Time spent running it
+    uint64_t rows = 0; ///< Rows returned plus rows changed (including changes made by triggers)
+    latency_histogram latency; ///< Latency of each execution in nanoseconds
+};
+
+/**
+ * Transparent string hash, so the raw SQL of a finished statement is looked up without copying it
+ */
+struct sql_hash {
+    using is_transparent = void;
+    size_t operator()(const std::string_view sql) const {return std::hash<std::string_view>{}(sql);}
+};
+
+/**
+ * Aggregates the statements run by every connection it is attached to, by normalized SQL text (literals replaced
+ * with ?, comments dropped and whitespace collapsed), so migrations that differ only in values share an entry.
+ * Connections opened through db_connection attach to the installed profiler; with none installed they are not traced
+ * at all, so profiling costs nothing when it is off
+ */
+class statement_profiler {
+    mutable std::mutex mutex; ///< Guards the statistics (connections on several threads record into them)
+    std::vector<statement_stats> stats; ///< Statistics by entry
+    std::unordered_map<std::string, size_t, sql_hash, std::equal_to<>> raw_index; ///< Entries by raw SQL
+    std::unordered_map<std::string, size_t> normalized_index; ///< Entries by normalized SQL
+    static std::atomic<statement_profiler*> active; ///< Installed profiler
+
+public:
+    /**
+     * Records a finished statement
+     * @param sql Raw SQL text of the statement
+     * @param ns Time it ran for
+     * @param rows Rows it returned or changed
+     */
+    void record(std::string_view sql, uint64_t ns, uint64_t rows);
+
+    /**
+     * Copies the statistics
+     * @return Statistics from the most to the least total time
+     */
+    [[nodiscard]] std::vector<statement_stats> report() const;
+
+    /**
+     * Installs a profiler for the connections opened from now on
+     * @param profiler Profiler (nullptr to stop profiling new connections)
+     */
+    static void install(statement_profiler* profiler) {active.store(profiler);}
+
+    /**
+     * Installed profiler
+     * @return Profiler, or nullptr if profiling is off
+     */
+    static statement_profiler* installed() {return active.load(std::memory_order_relaxed);}
+};
+
+/**
+ * Traces the statements of one connection into a profiler with sqlite3_trace_v2. Statements are timed from their
+ * first step (STMT event) to their completion or reset (PROFILE event) with the steady clock, as the time SQLite
+ * reports has millisecond resolution, and their rows are counted with ROW events
+ */
+class statement_trace {
+    /**
+     * Struct to hold a statement in progress
+     */
+    struct running {
+        std::chrono::steady_clock::time_point start; ///< First step
+        sqlite3_int64 changes = 0; ///< Total changes of the connection at the first step
+        uint64_t rows = 0; ///< Rows returned so far
+    };
+
+    sqlite3* DB; ///< Sqlite database object
+    statement_profiler& profiler; ///< Profiler receiving the finished statements
+    std::unordered_map<sqlite3_stmt*, running> runs; ///< Statements in progress
+    sqlite3_stmt* last_stmt = nullptr; ///< Statement of the last row event
+    running* last_run = nullptr; ///< Progress of last_stmt (map nodes are stable)
+
+    /**
+     * sqlite3_trace_v2 callback
+     * @param event Trace event
+     * @param context Trace object
+     * @param p Statement
+     * @param x SQL text (STMT) or elapsed nanoseconds (PROFILE)
+     * @return 0
+     */
+    static int callback(unsigned int event, void* context, void* p, void* x);
+public:
+    /**
+     * Starts tracing a connection
+     * @param db Sqlite database object
+     * @param target Profiler receiving the finished statements
+     */
+    statement_trace(sqlite3* db, statement_profiler& target);
+    ~statement_trace();
+    statement_trace(const statement_trace&) = delete;
+    statement_trace& operator=(const statement_trace&) = delete;
+};
+
+/**
+ * Profiles the statements of a whole run: installs a profiler when a target is given and, when the session ends,
+ * prints the report and dumps it as JSON to the target (unless it is STDOUT_TARGET). Declare it before the
+ * connections so they are closed, and their last statements recorded, before the report
+ */
+class profiler_session {
+    std::string target; ///< JSON path, STDOUT_TARGET, or empty when profiling is off
+    statement_profiler profiler; ///< Profiler of the session
+public:
+    /**
+     * Starts a session
+     * @param output JSON path, STDOUT_TARGET to only print the report, or empty to leave profiling off
+     */
+    explicit profiler_session(std::string output);
+    ~profiler_session();
+    profiler_session(const profiler_session&) = delete;
+    profiler_session& operator=(const profiler_session&) = delete;
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Normalizes a statement: comments are dropped, string and numeric literals become ?, whitespace runs become one
+ * space and the trailing semicolon is removed
+ * @param sql SQL text
+ * @return Normalized SQL text
+ */
+std::string normalize_statement(std::string_view sql);
+
+/**
+ * Prints the statistics of a profiler
+ * @param stats Statistics
+ * @return String with a table of the statements
+ */
+std::string print_profile_report(const std::vector<statement_stats>& stats);
+
+/**
+ * Serializes the statistics of a profiler as JSON
+ * @param stats Statistics
+ * @return JSON document with one object per statement (times in microseconds)
+ */
+std::string profile_report_json(const std::vector<statement_stats>& stats);
+
+#endif //PROFILER_H
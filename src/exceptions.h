@@ -0,0 +1,261 @@
+/**
+ * Custom exceptions for the project
+ * @author diagmatrix
+ * @date 2024
+ * @version 1.0
+ */
+
+#ifndef EXCEPTIONS_H
+#define EXCEPTIONS_H
+#include <exception>
+#include <string>
+
+/**
+ * Exception raised when the migration numbers are inconsistent between the database and the local directory
+ */
+class inconsistent_migrations_error final: public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Error: Inconsistent migrations between DB and migrations directory";
+    }
+};
+
+/**
+ * Exception raised when an error occurs while executing a migration
+ */
+class migration_execution_error final: public std::exception {
+    std::string msg;
+public:
+    explicit migration_execution_error(const std::string& message) {
+        this->msg = "Error: Migration execution failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when an error occurs while parsing a migration
+ */
+class parse_migration_error final: public std::exception {
+    std::string msg;
+public:
+    explicit parse_migration_error(const std::string& message) {
+        this->msg = "Error: Migration parsing failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a schema snapshot cannot be created or restored
+ */
+class snapshot_error final: public std::exception {
+    std::string msg;
+public:
+    explicit snapshot_error(const std::string& message) {
+        this->msg = "Error: Snapshot failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when an online migration cannot copy, migrate or swap the database
+ */
+class online_migration_error final: public std::exception {
+    std::string msg;
+public:
+    explicit online_migration_error(const std::string& message) {
+        this->msg = "Error: Online migration failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a file cannot be memory mapped
+ */
+class file_mapping_error final: public std::exception {
+    std::string msg;
+public:
+    explicit file_mapping_error(const std::string& message) {
+        this->msg = "Error: File mapping failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a CSV file cannot be parsed
+ */
+class csv_parse_error final: public std::exception {
+    std::string msg;
+public:
+    explicit csv_parse_error(const std::string& message) {
+        this->msg = "Error: CSV parsing failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when an error occurs while importing the collection
+ */
+class import_error final: public std::exception {
+    std::string msg;
+public:
+    explicit import_error(const std::string& message) {
+        this->msg = "Error: Collection import failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a Scryfall bulk-data file cannot be ingested
+ */
+class ingest_error final: public std::exception {
+    std::string msg;
+public:
+    explicit ingest_error(const std::string& message) {
+        this->msg = "Error: Card ingestion failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when the Scryfall client cannot be set up or its event loop fails
+ */
+class scryfall_error final: public std::exception {
+    std::string msg;
+public:
+    explicit scryfall_error(const std::string& message) {
+        this->msg = "Error: Scryfall request failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when the HTTP cache file cannot be opened or written
+ */
+class cache_error final: public std::exception {
+    std::string msg;
+public:
+    explicit cache_error(const std::string& message) {
+        this->msg = "Error: HTTP cache failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when the collection cannot be loaded or a query is malformed
+ */
+class query_error final: public std::exception {
+    std::string msg;
+public:
+    explicit query_error(const std::string& message) {
+        this->msg = "Error: Collection query failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a database cannot be opened or a statement fails
+ */
+class database_error final: public std::exception {
+    std::string msg;
+public:
+    explicit database_error(const std::string& message) {
+        this->msg = "Error: Database operation failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when the price store cannot be read or written
+ */
+class price_error final: public std::exception {
+    std::string msg;
+public:
+    explicit price_error(const std::string& message) {
+        this->msg = "Error: Price store operation failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a decklist cannot be read
+ */
+class deck_error final: public std::exception {
+    std::string msg;
+public:
+    explicit deck_error(const std::string& message) {
+        this->msg = "Error: Decklist check failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a columnar export cannot be written
+ */
+class export_error final: public std::exception {
+    std::string msg;
+public:
+    explicit export_error(const std::string& message) {
+        this->msg = "Error: Columnar export failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when a benchmark dataset cannot be generated or a benchmark cannot run
+ */
+class bench_error final: public std::exception {
+    std::string msg;
+public:
+    explicit bench_error(const std::string& message) {
+        this->msg = "Error: Benchmark failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+/**
+ * Exception raised when the collection server cannot start
+ */
+class server_error final: public std::exception {
+    std::string msg;
+public:
+    explicit server_error(const std::string& message) {
+        this->msg = "Error: Collection server failed - " + message;
+    }
+    const char* what() const noexcept override {
+        return this->msg.c_str();
+    }
+};
+
+#endif //EXCEPTIONS_H
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "assets.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+using namespace asset_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Path of an object, fanned out by the first two hex digits of its hash
+     * @param root Root directory of the store
+     * @param key Object key
+     * @return Path of the object file
+     */
+    fs::path object_path(const fs::path& root, const std::string& key) {
+        return root / OBJECTS_DIR / key.substr(0, 2) / key;
+    }
+
+    /**
+     * Extension of the file a URL points at
+     * @param url Asset URL
+     * @return Extension with the dot, or empty if the URL has none (or an odd one)
+     */
+    std::string url_extension(const std::string& url) {
+        const std::string path = url.substr(0, url.find_first_of("?#"));
+        const size_t dot = path.find_last_of("./");
+        if (dot == std::string::npos || path[dot] != '.' || path.size() - dot > 6) {
+            return "";
+        }
+        std::string extension = path.substr(dot);
+        if (!std::all_of(extension.begin() + 1, extension.end(), [](const unsigned char c) {return std::isalnum(c);})) {
+            return "";
+        }
+        return extension;
+    }
+
+    /**
+     * Checks whether an asset name stays under the root and fits in the index
+     * @param name Asset name
+     * @return True if the name can be stored
+     */
+    bool valid_name(const std::string& name) {
+        const fs::path path(name);
+        if (name.empty() || path.is_absolute() || name.find_first_of("\t\n") != std::string::npos) {
+            return false;
+        }
+        return std::none_of(path.begin(), path.end(), [](const fs::path& part) {return part == "..";});
+    }
+
+    /**
+     * Removes a file, ignoring errors
+     * @param path Path of the file
+     */
+    void remove_quietly(const fs::path& path) {
+        std::error_code error;
+        fs::remove(path, error);
+    }
+}
+
+// Asset store
+// ---------------------------------------------------------------------------------------------------------------------
+asset_store::asset_store(fs::path store_root, const uint64_t quota_bytes)
+    : root(std::move(store_root)), quota(quota_bytes) {
+    fs::create_directories(root / OBJECTS_DIR);
+    fs::remove_all(root / TMP_DIR); // Leftovers of an interrupted run
+    fs::create_directories(root / TMP_DIR);
+    load();
+    evict(); // The quota may have been lowered since the last run
+}
+
+asset_store::~asset_store() {
+    try {
+        save();
+    } catch (const std::exception&) {
+        // The objects are still on disk; names missing from the index are downloaded again
+    }
+}
+
+void asset_store::load() {
+    std::ifstream index(root / INDEX_FILE);
+    std::string line;
+    while (std::getline(index, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        std::string size;
+        if (!std::getline(fields, key, '\t') || !std::getline(fields, size, '\t') ||
+            !fs::exists(object_path(root, key))) {
+            continue;
+        }
+        asset_object& object = objects[key];
+        object.size = std::stoull(size);
+        object.position = recency.insert(recency.end(), key);
+        counters.bytes_stored += object.size;
+        std::string name;
+        while (std::getline(fields, name, '\t')) {
+            if (fs::is_symlink(root / name)) {
+                object.links.push_back(name);
+                links[name] = key;
+            }
+        }
+    }
+}
+
+void asset_store::save() const {
+    const fs::path index_path = root / INDEX_FILE;
+    const fs::path tmp_path = root / TMP_DIR / INDEX_FILE;
+    {
+        std::ofstream index(tmp_path, std::ios::trunc);
+        for (const std::string& key : recency) {
+            const asset_object& object = objects.at(key);
+            index << key << '\t' << object.size;
+            for (const std::string& name : object.links) {
+                index << '\t' << name;
+            }
+            index << '\n';
+        }
+    }
+    fs::rename(tmp_path, index_path);
+}
+
+void asset_store::touch(const std::string& key) {
+    asset_object& object = objects.at(key);
+    recency.splice(recency.end(), recency, object.position);
+}
+
+void asset_store::link(const std::string& name, const std::string& key) {
+    if (const auto previous = links.find(name); previous != links.end()) {
+        auto& names = objects.at(previous->second).links;
+        names.erase(std::remove(names.begin(), names.end(), name), names.end());
+    }
+
+    const fs::path path = root / name;
+    fs::create_directories(path.parent_path());
+    remove_quietly(path);
+    fs::create_symlink(fs::relative(object_path(root, key), path.parent_path()), path);
+    links[name] = key;
+    objects.at(key).links.push_back(name);
+}
+
+void asset_store::fetch(scryfall_client& client, const std::string& url, const std::string& name) {
+    if (!valid_name(name)) {
+        counters.failed++;
+        return;
+    }
+    if (const auto stored = links.find(name); stored != links.end() && fs::exists(root / name)) {
+        touch(stored->second);
+        counters.reused++;
+        return;
+    }
+
+    const fs::path download = root / TMP_DIR / std::to_string(next_download++);
+    client.download(url, download.string(), [this, download, extension = url_extension(url), name]
+                    (const scryfall_response& response) {
+        if (!response.ok()) {
+            counters.failed++;
+            return;
+        }
+        admit(download, extension, name);
+    });
+}
+
+void asset_store::admit(const fs::path& download, const std::string& extension, const std::string& name) {
+    try {
+        std::string key;
+        uint64_t size;
+        {
+            const mapped_file file(download.string());
+            key = hash_to_hex(xxh64(file.view())) + extension;
+            size = file.size();
+        }
+        counters.bytes_downloaded += size;
+
+        if (objects.contains(key)) {
+            fs::remove(download);
+            counters.deduplicated++;
+        } else {
+            const fs::path path = object_path(root, key);
+            fs::create_directories(path.parent_path());
+            fs::rename(download, path);
+            asset_object& object = objects[key];
+            object.size = size;
+            object.position = recency.insert(recency.end(), key);
+            counters.bytes_stored += size;
+            counters.downloaded++;
+        }
+        touch(key);
+        link(name, key);
+        evict();
+    } catch (const std::exception&) {
+        remove_quietly(download);
+        counters.failed++;
+    }
+}
+
+void asset_store::evict() {
+    while (counters.bytes_stored > quota && recency.size() > 1) {
+        const std::string key = recency.front();
+        const asset_object& object = objects.at(key);
+        for (const std::string& name : object.links) {
+            remove_quietly(root / name);
+            links.erase(name);
+        }
+        remove_quietly(object_path(root, key));
+        counters.bytes_stored -= object.size;
+        counters.bytes_evicted += object.size;
+        counters.evicted++;
+        recency.pop_front();
+        objects.erase(key);
+    }
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string print_asset_stats(const asset_stats& stats) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Assets: " << stats.downloaded << " downloaded, " << stats.deduplicated << " deduplicated, "
+        << stats.reused << " reused, " << stats.failed << " failed\n"
+        << static_cast<double>(stats.bytes_downloaded) / (1 << 20) << " MB downloaded, "
+        << stats.evicted << " objects evicted (" << static_cast<double>(stats.bytes_evicted) / (1 << 20)
+        << " MB), " << static_cast<double>(stats.bytes_stored) / (1 << 20) << " MB stored\n";
+    return out.str();
+}
@@ -0,0 +1,143 @@
+/**
+ * Asset store header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef ASSETS_H
+#define ASSETS_H
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "scryfall.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace asset_constants {
+    inline const char* INDEX_FILE = "assets.index"; ///< Index of the store (objects from least to most recently used)
+    inline const char* OBJECTS_DIR = "objects"; ///< Directory of the content addressed files
+    inline const char* TMP_DIR = "tmp"; ///< Directory of the downloads in progress
+    inline const char* SETS_SOURCE = "sets"; ///< Source name that mirrors the set icons
+    inline constexpr long TRANSFERS = 16; ///< Transfers in flight
+    inline constexpr uint64_t QUOTA_MB = 1024; ///< Disk quota of the stored objects
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the statistics of an asset run
+ */
+struct asset_stats {
+    size_t downloaded = 0; ///< Assets downloaded and stored as new content
+    size_t deduplicated = 0; ///< Assets downloaded whose content was already stored under another name
+    size_t reused = 0; ///< Assets already stored under their name (no transfer)
+    size_t failed = 0; ///< Assets that could not be downloaded or stored
+    size_t evicted = 0; ///< Objects evicted to stay within the quota
+    uint64_t bytes_downloaded = 0; ///< Bytes transferred
+    uint64_t bytes_evicted = 0; ///< Bytes freed by evictions
+    uint64_t bytes_stored = 0; ///< Bytes held by the store at the end of the run
+};
+
+/**
+ * Content addressed asset store with an LRU disk quota. Assets are downloaded concurrently through a Scryfall client
+ * (streamed straight to disk), hashed and kept once under objects/<xx>/<hash>.<ext>; every name asking for them is a
+ * relative symlink to that object, so identical files shared by several sets take the space of one. Objects are kept
+ * in least recently used order and evicted, together with their links, when the store goes over its quota
+ */
+class asset_store {
+    /**
+     * Struct to hold a stored object
+     */
+    struct asset_object {
+        uint64_t size = 0; ///< Size of the file
+        std::vector<std::string> links; ///< Names linking to the object
+        std::list<std::string>::iterator position; ///< Position in the recency list
+    };
+
+    std::filesystem::path root; ///< Root directory of the store
+    uint64_t quota; ///< Maximum bytes held by the objects
+    std::list<std::string> recency; ///< Object keys from least to most recently used
+    std::unordered_map<std::string, asset_object> objects; ///< Objects by key (<hash>.<ext>)
+    std::unordered_map<std::string, std::string> links; ///< Object key by name
+    size_t next_download = 0; ///< Counter naming the downloads in progress
+    asset_stats counters; ///< Statistics of the run
+
+    /**
+     * Reads the index, dropping entries whose files are gone
+     */
+    void load();
+
+    /**
+     * Marks an object as the most recently used
+     * @param key Object key
+     */
+    void touch(const std::string& key);
+
+    /**
+     * Points a name at an object, replacing its previous target
+     * @param name Asset name
+     * @param key Object key
+     */
+    void link(const std::string& name, const std::string& key);
+
+    /**
+     * Adds a completed download to the store
+     * @param download Path of the downloaded file
+     * @param extension Extension of the asset (with the dot, may be empty)
+     * @param name Asset name
+     */
+    void admit(const std::filesystem::path& download, const std::string& extension, const std::string& name);
+
+    /**
+     * Evicts the least recently used objects until the store is within its quota (the newest object always stays)
+     */
+    void evict();
+public:
+    /**
+     * Opens (or creates) a store
+     * @param store_root Root directory of the store
+     * @param quota_bytes Maximum bytes held by the objects
+     * @throw std::filesystem::filesystem_error if the directories cannot be created
+     */
+    asset_store(std::filesystem::path store_root, uint64_t quota_bytes);
+
+    /**
+     * Saves the index
+     */
+    ~asset_store();
+    asset_store(const asset_store&) = delete;
+    asset_store& operator=(const asset_store&) = delete;
+
+    /**
+     * Queues an asset. Names already stored are served from disk; others are downloaded when the client runs
+     * @param client Scryfall client
+     * @param url URL of the asset
+     * @param name Relative path of the asset under the root (no "..")
+     */
+    void fetch(scryfall_client& client, const std::string& url, const std::string& name);
+
+    /**
+     * Writes the index (least recently used objects first)
+     */
+    void save() const;
+
+    /**
+     * Statistics of the run
+     * @return Statistics so far
+     */
+    [[nodiscard]] const asset_stats& stats() const {return counters;}
+};
+
+/**
+ * Prints the statistics of an asset run
+ * @param stats Asset statistics
+ * @return String with the transfers, deduplications and evictions
+ */
+std::string print_asset_stats(const asset_stats& stats);
+
+#endif //ASSETS_H
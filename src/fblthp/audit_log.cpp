@@ -0,0 +1,171 @@
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
+#include "audit_log.h"
+#include "database.h"
+#include "exceptions.h"
+
+using namespace audit_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Formats the current time the way SQLite's CURRENT_TIMESTAMP does
+     * @return UTC time as YYYY-MM-DD HH:MM:SS
+     */
+    std::string utc_timestamp() {
+        const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm utc{};
+        gmtime_r(&now, &utc);
+        char buffer[20];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &utc);
+        return buffer;
+    }
+
+    /**
+     * Binds a text parameter, empty strings as NULL
+     * @param stmt Statement
+     * @param param Parameter index
+     * @param text Text to bind (must outlive the step)
+     */
+    void bind_optional_text(sqlite3_stmt* stmt, const int param, const std::string& text) {
+        if (text.empty()) {
+            sqlite3_bind_null(stmt, param);
+        } else {
+            sqlite3_bind_text(stmt, param, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+        }
+    }
+}
+
+// Audit log
+// ---------------------------------------------------------------------------------------------------------------------
+audit_log::audit_log(std::string path) : db_path(std::move(path)) {
+    writer = std::jthread([this] {run();});
+}
+
+audit_log::~audit_log() {
+    close();
+}
+
+void audit_log::record(audit_entry entry) {
+    // Announced before the check (both sequentially consistent), so close either refuses the entry or waits for it
+    recording.fetch_add(1);
+    if (!stopping.load()) {
+        if (entry.requested_at.empty()) {
+            entry.requested_at = utc_timestamp();
+        }
+        buffer.push(std::move(entry));
+        if (waiting.fetch_add(1, std::memory_order_relaxed) + 1 == FLUSH_ROWS) {
+            { const std::lock_guard lock(wake_mutex); } // Pairs with the writer's wait so the wake up is not missed
+            wake.notify_one();
+        }
+    }
+    if (recording.fetch_sub(1) == 1) {
+        recording.notify_all();
+    }
+}
+
+audit_stats audit_log::close() {
+    if (!stopping.exchange(true)) {
+        // The writer keeps draining meanwhile, so callers waiting on a full buffer still get through
+        for (size_t active = recording.load(); active != 0; active = recording.load()) {
+            recording.wait(active);
+        }
+        {
+            const std::lock_guard lock(wake_mutex);
+            drained.store(true);
+        }
+        wake.notify_one();
+        if (writer.joinable()) {
+            writer.join();
+        }
+    }
+    return stats;
+}
+
+void audit_log::run() {
+    std::optional<db_connection> connection;
+    sqlite3_stmt* stmt = nullptr;
+    try {
+        connection.emplace(db_path);
+        stmt = connection->cached(INSERT_HISTORY);
+    } catch (const database_error&) {
+        // Without a statement every flush fails, and the entries are reported as lost on close
+    }
+    sqlite3* DB = connection ? connection->get() : nullptr;
+
+    std::vector<audit_entry> batch;
+    batch.reserve(FLUSH_ROWS);
+    bool last = false;
+    while (!last) {
+        {
+            std::unique_lock lock(wake_mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] {
+                return drained.load(std::memory_order_relaxed) ||
+                       waiting.load(std::memory_order_relaxed) >= FLUSH_ROWS;
+            });
+        }
+        last = drained.load();
+
+        audit_entry entry;
+        while (buffer.try_pop(entry)) {
+            waiting.fetch_sub(1, std::memory_order_relaxed);
+            batch.push_back(std::move(entry));
+        }
+        if (!batch.empty() && !flush(DB, stmt, batch)) {
+            stats.failed_flushes++;
+            if (last && !flush(DB, stmt, batch)) {
+                stats.lost = batch.size();
+            }
+        }
+    }
+}
+
+bool audit_log::flush(sqlite3* DB, sqlite3_stmt* stmt, std::vector<audit_entry>& batch) {
+    if (stmt == nullptr || sqlite3_exec(DB, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    for (const auto& entry : batch) {
+        sqlite3_bind_text(stmt, 1, entry.url.data(), static_cast<int>(entry.url.size()), SQLITE_STATIC);
+        bind_optional_text(stmt, 2, entry.headers);
+        sqlite3_bind_int64(stmt, 3, entry.response_code);
+        bind_optional_text(stmt, 4, entry.error);
+        sqlite3_bind_text(stmt, 5, entry.requested_at.data(), static_cast<int>(entry.requested_at.size()),
+                          SQLITE_STATIC);
+        const int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            sqlite3_exec(DB, "ROLLBACK", nullptr, nullptr, nullptr);
+            return false;
+        }
+    }
+    sqlite3_clear_bindings(stmt);
+    if (sqlite3_exec(DB, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_exec(DB, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    stats.rows += batch.size();
+    stats.transactions++;
+    batch.clear();
+    return true;
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string print_audit_stats(const audit_stats& stats) {
+    std::ostringstream out;
+    out << "Logged " << stats.rows << " requests in " << stats.transactions << " transactions";
+    if (stats.failed_flushes > 0) {
+        out << " (" << stats.failed_flushes << " flushes retried)";
+    }
+    out << "\n";
+    if (stats.lost > 0) {
+        out << "Warning: " << stats.lost << " requests could not be logged\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,119 @@
+/**
+ * Scryfall request audit log header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace audit_constants {
+    inline const char* INSERT_HISTORY = "INSERT INTO scryfall_history (url, headers, response_code, error, "
+                                        "_requested_at) VALUES (?, ?, ?, ?, ?);"; ///< SQL statement to log a request
+    inline constexpr size_t CAPACITY = 4096; ///< Entries the ring buffer holds before callers wait for the writer
+    inline constexpr size_t FLUSH_ROWS = 256; ///< Entries that trigger a flush without waiting for the interval
+    inline constexpr int FLUSH_INTERVAL_MS = 200; ///< Longest time an entry waits in the buffer
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold a logged request
+ */
+struct audit_entry {
+    std::string url; ///< Requested URL
+    std::string headers; ///< Request headers
+    long response_code = 0; ///< HTTP status (0 if the transfer failed)
+    std::string error; ///< Error of the request (empty on success)
+    std::string requested_at; ///< UTC time of the request (YYYY-MM-DD HH:MM:SS, as CURRENT_TIMESTAMP)
+};
+
+/**
+ * Struct to hold the statistics of an audit log
+ */
+struct audit_stats {
+    size_t rows = 0; ///< Entries written
+    size_t transactions = 0; ///< Transactions committed
+    size_t failed_flushes = 0; ///< Flushes that failed and were retried
+    size_t lost = 0; ///< Entries that could not be written before shutdown
+};
+
+/**
+ * Asynchronous writer of the scryfall_history table. Callers hand entries to a lock-free ring buffer and return
+ * immediately; a background thread with its own connection drains the buffer in grouped transactions, flushing when
+ * FLUSH_ROWS entries are waiting or FLUSH_INTERVAL_MS has passed. A full buffer makes callers wait instead of dropping
+ * entries, a failed flush keeps its entries for the next attempt, and closing the log waits for the callers already
+ * recording before the writer flushes everything left
+ */
+class audit_log {
+    std::string db_path; ///< Path of the database
+    bounded_queue<audit_entry> buffer{audit_constants::CAPACITY}; ///< Entries waiting for the writer
+    std::atomic<size_t> waiting{0}; ///< Entries in the buffer
+    std::atomic<bool> stopping{false}; ///< Set when the log is closed (further entries are refused)
+    std::atomic<size_t> recording{0}; ///< Callers between the stopping check and the end of their push
+    std::atomic<bool> drained{false}; ///< Set once no caller is recording (the writer's last pass follows)
+    std::mutex wake_mutex; ///< Guards the writer wake up
+    std::condition_variable wake; ///< Wakes the writer early for a size flush or shutdown
+    audit_stats stats; ///< Statistics (owned by the writer until it is joined)
+    std::jthread writer; ///< Background writer
+
+    /**
+     * Drains the buffer until the log is closed
+     */
+    void run();
+
+    /**
+     * Writes a batch of entries in one transaction
+     * @param DB Sqlite database object
+     * @param stmt Insert statement
+     * @param batch Entries to write (cleared on success)
+     * @return True if the batch was committed
+     */
+    bool flush(sqlite3* DB, sqlite3_stmt* stmt, std::vector<audit_entry>& batch);
+public:
+    /**
+     * Opens the log and starts its writer
+     * @param path Path of the database holding the scryfall_history table
+     */
+    explicit audit_log(std::string path);
+
+    /**
+     * Closes the log, flushing every recorded entry
+     */
+    ~audit_log();
+    audit_log(const audit_log&) = delete;
+    audit_log& operator=(const audit_log&) = delete;
+
+    /**
+     * Records a request without touching the disk (waits only if the buffer is full)
+     * @param entry Logged request (its time is filled in if empty)
+     */
+    void record(audit_entry entry);
+
+    /**
+     * Flushes every recorded entry and stops the writer (further entries are not recorded)
+     * @return Statistics of the log
+     */
+    audit_stats close();
+};
+
+/**
+ * Prints the statistics of an audit log
+ * @param stats Audit log statistics
+ * @return String with the rows and transactions written
+ */
+std::string print_audit_stats(const audit_stats& stats);
+
+#endif //AUDIT_LOG_H
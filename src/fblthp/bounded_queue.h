@@ -0,0 +1,145 @@
+/**
+ * Bounded lock-free queue header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+ * Bounded multi-producer multi-consumer lock-free queue (Vyukov's array based design). Every slot carries a sequence
+ * number telling producers and consumers whose turn it is, so both sides only contend on their own position counter.
+ * The blocking push and pop back off when the queue is full or empty, which gives producers natural backpressure.
+ * @tparam T Movable element type
+ */
+template<typename T>
+class bounded_queue {
+    /**
+     * Struct to hold a queue slot
+     */
+    struct slot {
+        std::atomic<size_t> sequence; ///< Turn of the slot (position for producers, position + 1 for consumers)
+        T value; ///< Stored element
+    };
+
+    std::unique_ptr<slot[]> slots; ///< Ring of slots
+    size_t mask; ///< Capacity - 1 (capacity is a power of two)
+    alignas(64) std::atomic<size_t> enqueue_pos{0}; ///< Next position to push into
+    alignas(64) std::atomic<size_t> dequeue_pos{0}; ///< Next position to pop from
+
+    /**
+     * Waits a little before retrying a full or empty queue: spin first, then yield and finally sleep
+     * @param attempt Number of failed attempts so far
+     */
+    static void backoff(const unsigned int attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+public:
+    /**
+     * Creates a queue
+     * @param capacity Maximum number of elements (rounded up to a power of two)
+     */
+    explicit bounded_queue(const size_t capacity)
+        : slots(std::make_unique<slot[]>(std::bit_ceil(std::max<size_t>(capacity, 2)))),
+          mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1) {
+        for (size_t i = 0; i <= mask; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    /**
+     * Tries to push an element
+     * @param value Element to push (only moved from on success)
+     * @return True if the element was pushed, false if the queue is full
+     */
+    bool try_push(T& value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            slot& cell = slots[pos & mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Tries to pop an element
+     * @param value Destination of the element
+     * @return True if an element was popped, false if the queue is empty
+     */
+    bool try_pop(T& value) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            slot& cell = slots[pos & mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Empty
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Pushes an element, waiting while the queue is full
+     * @param value Element to push
+     */
+    void push(T value) {
+        for (unsigned int attempt = 0; !try_push(value); attempt++) {
+            backoff(attempt);
+        }
+    }
+
+    /**
+     * Pops an element, waiting while the queue is empty
+     * @return Popped element
+     */
+    T pop() {
+        T value;
+        for (unsigned int attempt = 0; !try_pop(value); attempt++) {
+            backoff(attempt);
+        }
+        return value;
+    }
+
+    size_t capacity() const noexcept { return mask + 1; } ///< Maximum number of elements
+};
+
+#endif //BOUNDED_QUEUE_H
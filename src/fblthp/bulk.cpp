@@ -0,0 +1,509 @@
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <vector>
+#include <sys/resource.h>
+#include <nlohmann/json.hpp>
+
+#include "bulk.h"
+#include "exceptions.h"
+
+using namespace bulk_constants;
+using json = nlohmann::json;
+
+// Helper types and functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * How a card field is bound to the upsert statement
+     */
+    enum column_kind : unsigned char {TEXT, REAL, BOOLEAN, COLORS};
+
+    /**
+     * Struct to hold the mapping of a card field to its column
+     */
+    struct card_column {
+        std::string_view key; ///< Key of the field in the Scryfall card object
+        const char* column; ///< Column of the card table
+        column_kind kind; ///< Binding of the field
+        const char* face_join; ///< How the faces of a multi-faced card fill a missing field (nullptr: first face)
+    };
+
+    constexpr std::array<card_column, 18> COLUMNS = {{
+        {"id", "scryfall_id", TEXT, nullptr},
+        {"oracle_id", "oracle_id", TEXT, nullptr},
+        {"name", "name", TEXT, FACE_SEPARATOR},
+        {"lang", "lang", TEXT, nullptr},
+        {"released_at", "released_at", TEXT, nullptr},
+        {"set", "\"set\"", TEXT, nullptr},
+        {"collector_number", "collector_number", TEXT, nullptr},
+        {"rarity", "rarity", TEXT, nullptr},
+        {"layout", "layout", TEXT, nullptr},
+        {"mana_cost", "mana_cost", TEXT, FACE_SEPARATOR},
+        {"cmc", "cmc", REAL, nullptr},
+        {"type_line", "type_line", TEXT, FACE_SEPARATOR},
+        {"oracle_text", "oracle_text", TEXT, FACE_TEXT_SEPARATOR},
+        {"colors", "colors", COLORS, nullptr},
+        {"color_identity", "color_identity", COLORS, nullptr},
+        {"power", "power", TEXT, nullptr},
+        {"toughness", "toughness", TEXT, nullptr},
+        {"digital", "digital", BOOLEAN, nullptr},
+    }}; ///< Ingested card fields, in binding order
+    constexpr std::string_view FACES_KEY = "card_faces"; ///< Key of the faces of a multi-faced card
+    constexpr std::string_view DATA_KEY = "data"; ///< Key of the cards of a list object
+    constexpr std::string_view PRICES_KEY = "prices"; ///< Key of the prices of a card
+    constexpr std::string_view COLOR_ORDER = "WUBRG"; ///< Order of the colors in the stored strings
+    constexpr int NO_COLUMN = -1; ///< Key that is not ingested
+
+    /**
+     * Finds the column of a card field
+     * @param key Key of the field
+     * @return Index of the column, NO_COLUMN if the field is not ingested
+     */
+    int find_column(const std::string_view key) {
+        for (size_t i = 0; i < COLUMNS.size(); i++) {
+            if (COLUMNS[i].key == key) {
+                return static_cast<int>(i);
+            }
+        }
+        return NO_COLUMN;
+    }
+
+    /**
+     * Converts a color symbol to its bit
+     * @param symbol Color symbol (W, U, B, R or G)
+     * @return Color bit (0 for anything else)
+     */
+    unsigned char color_bit(const std::string_view symbol) {
+        if (symbol.size() != 1) {
+            return 0;
+        }
+        const size_t idx = COLOR_ORDER.find(symbol[0]);
+        return idx == std::string_view::npos ? 0 : static_cast<unsigned char>(1u << idx);
+    }
+
+    /**
+     * Builds the upsert statement of the card table
+     * @return SQL statement
+     */
+    std::string build_upsert_query() {
+        std::string columns;
+        std::string values;
+        std::string updates;
+        for (const auto& column : COLUMNS) {
+            if (!columns.empty()) {
+                columns += ", ";
+                values += ", ";
+            }
+            columns += column.column;
+            values += "?";
+            if (column.column != std::string_view(KEY_COLUMN)) {
+                updates += std::string(column.column) + " = excluded." + column.column + ", ";
+            }
+        }
+        return "INSERT INTO " + std::string(TABLE) + " (" + columns + ") VALUES (" + values + ") ON CONFLICT(" +
+               KEY_COLUMN + ") DO UPDATE SET " + updates + "_modified_at = CURRENT_TIMESTAMP;";
+    }
+
+    /**
+     * Executes a statement without results
+     * @param DB Sqlite database object
+     * @param sql SQL statement
+     * @throw ingest_error if the statement fails
+     */
+    void exec_or_throw(sqlite3* DB, const char* sql) {
+        if (sqlite3_exec(DB, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            throw ingest_error(std::string(sql) + " (" + sqlite3_errmsg(DB) + ")");
+        }
+    }
+
+    /**
+     * Reads a file in fixed size chunks, one character at a time for the parser
+     */
+    class chunk_reader {
+        std::FILE* file; ///< Open file
+        std::unique_ptr<char[]> buffer; ///< Current chunk
+        size_t pos = 0; ///< Position in the chunk
+        size_t len = 0; ///< Length of the chunk
+        size_t consumed = 0; ///< Bytes of the previous chunks
+    public:
+        explicit chunk_reader(std::FILE* input) : file(input), buffer(std::make_unique<char[]>(READ_BUFFER_SIZE)) {}
+
+        /**
+         * Checks whether the file is exhausted, reading the next chunk if needed
+         * @return True at the end of the file
+         */
+        bool at_end() {
+            if (pos < len) {
+                return false;
+            }
+            consumed += len;
+            pos = 0;
+            len = std::fread(buffer.get(), 1, READ_BUFFER_SIZE, file);
+            return len == 0;
+        }
+
+        [[nodiscard]] const char& current() const {return buffer[pos];} ///< Current character
+        void advance() {pos++;} ///< Moves to the next character
+        [[nodiscard]] size_t offset() const {return consumed + pos;} ///< Bytes read so far
+    };
+
+    /**
+     * Input iterator over a chunk reader, the shape the JSON parser expects from an input source
+     */
+    struct chunk_iterator {
+        using iterator_category = std::input_iterator_tag;
+        using value_type = char;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const char*;
+        using reference = const char&;
+
+        chunk_reader* reader = nullptr; ///< Shared reader (nullptr for the end iterator)
+
+        reference operator*() const {return reader->current();}
+        chunk_iterator& operator++() {
+            reader->advance();
+            return *this;
+        }
+        bool operator==(const chunk_iterator& other) const {return done() == other.done();}
+        [[nodiscard]] bool done() const {return reader == nullptr || reader->at_end();}
+    };
+
+    /**
+     * Struct to hold the fields of the card (or face) being parsed. Buffers are reused from card to card
+     */
+    struct card_fields {
+        std::array<std::string, COLUMNS.size()> text; ///< Text fields
+        std::array<double, COLUMNS.size()> number{}; ///< Numeric and boolean fields
+        std::array<unsigned char, COLUMNS.size()> colors{}; ///< Color fields (bit per color)
+        std::array<bool, COLUMNS.size()> present{}; ///< Whether each field was found
+
+        void clear() {
+            present.fill(false);
+            colors.fill(0);
+        }
+    };
+
+    /**
+     * Where the parser is in the document
+     */
+    enum context : unsigned char {LIST, CARDS, CARD, CARD_COLORS, FACES, FACE, FACE_COLORS, PRICES, SKIP};
+
+    /**
+     * SAX handler mapping the card objects of a dump onto the upsert statement. Only the current card is held in
+     * memory; nested objects that are not ingested (legalities, image URIs...) are skipped as they stream by, and the
+     * prices go to the price store when there is one
+     */
+    class card_handler {
+        sqlite3* DB; ///< Sqlite database object
+        sqlite3_stmt* stmt; ///< Upsert statement
+        const chunk_reader& reader; ///< Input (for error positions)
+        std::vector<context> stack; ///< Enclosing objects and arrays
+        int card_key = NO_COLUMN; ///< Column of the last key of the card
+        int face_key = NO_COLUMN; ///< Column of the last key of the current face
+        bool faces_key = false; ///< Whether the last key of the card was the faces array
+        bool data_key = false; ///< Whether the last key of a list object was its data array
+        bool prices_key = false; ///< Whether the last key of the card was its prices object
+        int price_kind = NO_COLUMN; ///< Kind of the last key of the prices object
+        std::array<std::optional<int32_t>, price_constants::KINDS.size()> prices; ///< Prices of the current card
+        price_store* price_series; ///< Price store (nullptr to skip the prices)
+        int32_t day; ///< Day the prices are recorded for
+        card_fields card; ///< Fields of the current card
+        card_fields face; ///< Fields of the current face
+        card_fields faces; ///< Fields merged from the faces of the current card
+
+        /**
+         * Stores a scalar value in the field of the current context
+         * @param set Assigns the value to a field set and column
+         */
+        template<typename F>
+        void store(F&& set) {
+            if (stack.empty()) {
+                return;
+            }
+            if (stack.back() == CARD && card_key != NO_COLUMN) {
+                set(card, card_key);
+            } else if (stack.back() == FACE && face_key != NO_COLUMN) {
+                set(face, face_key);
+            }
+        }
+
+        /**
+         * Merges the current face into the fields taken from the faces
+         */
+        void merge_face() {
+            for (size_t i = 0; i < COLUMNS.size(); i++) {
+                if (!face.present[i] || (COLUMNS[i].kind == TEXT && face.text[i].empty())) {
+                    continue; // Back faces without a cost have an empty mana_cost
+                }
+                if (COLUMNS[i].kind == COLORS) {
+                    faces.colors[i] |= face.colors[i];
+                } else if (COLUMNS[i].kind != TEXT) {
+                    if (!faces.present[i]) {
+                        faces.number[i] = face.number[i];
+                    }
+                } else if (!faces.present[i]) {
+                    faces.text[i] = face.text[i];
+                } else if (COLUMNS[i].face_join != nullptr) {
+                    faces.text[i].append(COLUMNS[i].face_join).append(face.text[i]);
+                }
+                faces.present[i] = true;
+            }
+        }
+
+        /**
+         * Upserts the current card, filling its missing fields from its faces
+         * @throw ingest_error if the card cannot be stored
+         */
+        void store_card() {
+            for (size_t i = 0; i < COLUMNS.size(); i++) {
+                const int param = static_cast<int>(i) + 1;
+                const card_fields& source = card.present[i] || !faces.present[i] ? card : faces;
+                if (!source.present[i]) {
+                    sqlite3_bind_null(stmt, param);
+                    continue;
+                }
+                switch (COLUMNS[i].kind) {
+                    case TEXT:
+                        sqlite3_bind_text(stmt, param, source.text[i].data(), static_cast<int>(source.text[i].size()),
+                                          SQLITE_STATIC);
+                        break;
+                    case REAL:
+                        sqlite3_bind_double(stmt, param, source.number[i]);
+                        break;
+                    case BOOLEAN:
+                        sqlite3_bind_int(stmt, param, source.number[i] != 0);
+                        break;
+                    case COLORS: {
+                        std::string& text = card.text[i]; // Scratch buffer, the color strings are rebuilt here
+                        text.clear();
+                        for (size_t bit = 0; bit < COLOR_ORDER.size(); bit++) {
+                            if (source.colors[i] & (1u << bit)) {
+                                text += COLOR_ORDER[bit];
+                            }
+                        }
+                        sqlite3_bind_text(stmt, param, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+                        break;
+                    }
+                }
+            }
+            const int rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            if (rc != SQLITE_DONE) {
+                const std::string id = card.present[0] ? card.text[0] : "without id";
+                throw ingest_error("Card " + id + " near byte " + std::to_string(reader.offset()) + " (" +
+                                   sqlite3_errmsg(DB) + ")");
+            }
+            cards++;
+            if (price_series != nullptr && card.present[0]) {
+                for (size_t kind = 0; kind < prices.size(); kind++) {
+                    if (prices[kind]) {
+                        const std::string key = series_key(card.text[0], price_constants::KINDS[kind]);
+                        price_series->append(price_series->series(key), day, *prices[kind]);
+                        recorded_prices++;
+                    }
+                }
+            }
+            if (cards % BATCH_CARDS == 0) {
+                exec_or_throw(DB, "COMMIT");
+                exec_or_throw(DB, "BEGIN");
+            }
+        }
+    public:
+        size_t cards = 0; ///< Cards stored so far
+        size_t recorded_prices = 0; ///< Prices appended to the price store so far
+        std::string error; ///< Parse error message
+
+        card_handler(sqlite3* db, sqlite3_stmt* upsert, const chunk_reader& input, price_store* prices_store,
+                     const int32_t prices_day)
+            : DB(db), stmt(upsert), reader(input), price_series(prices_store), day(prices_day) {
+            stack.reserve(16);
+        }
+
+        bool null() {return true;}
+        bool boolean(const bool value) {
+            store([value](card_fields& fields, const int col) {
+                fields.number[col] = value ? 1 : 0;
+                fields.present[col] = COLUMNS[col].kind == BOOLEAN;
+            });
+            return true;
+        }
+        bool number_integer(const json::number_integer_t value) {
+            return number_float(static_cast<double>(value), {});
+        }
+        bool number_unsigned(const json::number_unsigned_t value) {
+            return number_float(static_cast<double>(value), {});
+        }
+        bool number_float(const json::number_float_t value, const json::string_t&) {
+            store([value](card_fields& fields, const int col) {
+                fields.number[col] = value;
+                fields.present[col] = COLUMNS[col].kind == REAL;
+            });
+            return true;
+        }
+        bool string(json::string_t& value) {
+            if (!stack.empty() && stack.back() == PRICES) {
+                if (price_kind != NO_COLUMN) {
+                    prices[price_kind] = parse_cents(value);
+                }
+                return true;
+            }
+            if (!stack.empty() && (stack.back() == CARD_COLORS || stack.back() == FACE_COLORS)) {
+                card_fields& fields = stack.back() == CARD_COLORS ? card : face;
+                const int col = stack.back() == CARD_COLORS ? card_key : face_key;
+                fields.colors[col] |= color_bit(value);
+                return true;
+            }
+            store([&value](card_fields& fields, const int col) {
+                if (COLUMNS[col].kind == TEXT) {
+                    fields.text[col].swap(value); // The parser clears the string before reusing it
+                    fields.present[col] = true;
+                }
+            });
+            return true;
+        }
+        bool binary(json::binary_t&) {return true;}
+        bool key(json::string_t& value) {
+            if (stack.empty()) {
+                return true;
+            }
+            if (stack.back() == CARD) {
+                card_key = find_column(value);
+                faces_key = value == FACES_KEY;
+                prices_key = value == PRICES_KEY;
+            } else if (stack.back() == PRICES) {
+                const auto kind = std::ranges::find(price_constants::KINDS, value);
+                price_kind = kind != price_constants::KINDS.end() ?
+                             static_cast<int>(kind - price_constants::KINDS.begin()) : NO_COLUMN;
+            } else if (stack.back() == FACE) {
+                face_key = find_column(value);
+            } else if (stack.back() == LIST) {
+                data_key = value == DATA_KEY;
+            }
+            return true;
+        }
+        bool start_object(std::size_t) {
+            const context parent = stack.empty() ? SKIP : stack.back();
+            if (stack.empty()) {
+                stack.push_back(LIST); // A single list object ({"data": [...]}), as returned by the API
+            } else if (parent == CARDS) {
+                stack.push_back(CARD);
+                card.clear();
+                faces.clear();
+                card_key = NO_COLUMN;
+                faces_key = false;
+                prices_key = false;
+                prices.fill(std::nullopt);
+            } else if (parent == CARD && prices_key) {
+                stack.push_back(PRICES);
+                price_kind = NO_COLUMN;
+            } else if (parent == FACES) {
+                stack.push_back(FACE);
+                face.clear();
+                face_key = NO_COLUMN;
+            } else {
+                stack.push_back(SKIP);
+            }
+            return true;
+        }
+        bool end_object() {
+            const context closed = stack.back();
+            stack.pop_back();
+            if (closed == CARD) {
+                store_card();
+            } else if (closed == FACE) {
+                merge_face();
+            }
+            return true;
+        }
+        bool start_array(std::size_t) {
+            if (stack.empty()) {
+                stack.push_back(CARDS); // A bulk-data dump ([...])
+            } else if (stack.back() == LIST && data_key) {
+                stack.push_back(CARDS);
+            } else if (stack.back() == CARD && faces_key) {
+                stack.push_back(FACES);
+            } else if (stack.back() == CARD && card_key != NO_COLUMN && COLUMNS[card_key].kind == COLORS) {
+                stack.push_back(CARD_COLORS);
+                card.present[card_key] = true;
+            } else if (stack.back() == FACE && face_key != NO_COLUMN && COLUMNS[face_key].kind == COLORS) {
+                stack.push_back(FACE_COLORS);
+                face.present[face_key] = true;
+            } else {
+                stack.push_back(SKIP);
+            }
+            return true;
+        }
+        bool end_array() {
+            stack.pop_back();
+            return true;
+        }
+        bool parse_error(const std::size_t position, const std::string&, const nlohmann::detail::exception& e) {
+            error = "Byte " + std::to_string(position) + ": " + e.what();
+            return false;
+        }
+    };
+}
+
+// Ingestion functions
+// ---------------------------------------------------------------------------------------------------------------------
+ingest_stats ingest_bulk_cards(sqlite3* DB, const std::string& path, price_store* prices, const int32_t day) {
+    ingest_stats stats;
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::unique_ptr<std::FILE, int(*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), std::fclose);
+    if (file == nullptr) {
+        throw ingest_error("Unable to open " + path);
+    }
+    sqlite3_stmt* stmt;
+    const std::string query = build_upsert_query();
+    if (sqlite3_prepare_v2(DB, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw ingest_error("Preparing upsert (" + std::string(sqlite3_errmsg(DB)) + ")");
+    }
+
+    chunk_reader reader(file.get());
+    card_handler handler(DB, stmt, reader, prices, day);
+    try {
+        exec_or_throw(DB, "BEGIN");
+        if (!json::sax_parse(chunk_iterator{&reader}, chunk_iterator{}, &handler)) {
+            throw ingest_error("In " + path + " (" + handler.error + ")");
+        }
+        exec_or_throw(DB, "COMMIT");
+    } catch (...) {
+        sqlite3_exec(DB, "ROLLBACK", nullptr, nullptr, nullptr);
+        sqlite3_finalize(stmt);
+        throw;
+    }
+    sqlite3_finalize(stmt);
+
+    stats.cards = handler.cards;
+    stats.prices = handler.recorded_prices;
+    stats.bytes = reader.offset();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats.peak_rss_kb = usage.ru_maxrss;
+    }
+    return stats;
+}
+
+std::string print_ingest_stats(const ingest_stats& stats) {
+    std::ostringstream out;
+    const double mb = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+    const double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+    out << std::fixed << std::setprecision(2);
+    out << "Ingested " << stats.cards << " cards (" << mb << " MB) in " << stats.seconds << " s\n";
+    if (stats.prices > 0) {
+        out << "Recorded " << stats.prices << " prices\n";
+    }
+    out << "Throughput: " << static_cast<double>(stats.cards) / seconds << " cards/s, " << mb / seconds << " MB/s\n";
+    out << "Peak memory: " << static_cast<double>(stats.peak_rss_kb) / 1024.0 << " MB\n";
+    return out.str();
+}
@@ -0,0 +1,63 @@
+/**
+ * Scryfall bulk-data ingestion header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef BULK_H
+#define BULK_H
+#include <sqlite3.h>
+#include <string>
+
+#include "prices.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace bulk_constants {
+    inline const char* TABLE = "card"; ///< Table the cards are ingested into
+    inline const char* KEY_COLUMN = "scryfall_id"; ///< Column identifying a card (re-ingested cards are updated)
+    inline constexpr const char* FACE_SEPARATOR = " // "; ///< Separator of the faces of multi-faced names and mana costs
+    inline constexpr const char* FACE_TEXT_SEPARATOR = "\n//\n"; ///< Separator of the rules text of multi-faced cards
+    inline constexpr size_t BATCH_CARDS = 10000; ///< Cards inserted per transaction
+    inline constexpr size_t READ_BUFFER_SIZE = 1 << 20; ///< Bytes read from the dump at once
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the statistics of an ingestion
+ */
+struct ingest_stats {
+    size_t cards = 0; ///< Number of cards inserted or updated
+    size_t prices = 0; ///< Number of prices appended to the price store
+    size_t bytes = 0; ///< Number of bytes parsed
+    double seconds = 0; ///< Wall time of the ingestion
+    long peak_rss_kb = 0; ///< Peak resident memory of the process
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Ingests a Scryfall bulk-data dump (a JSON array of card objects) into the card table. The file is read in fixed
+ * size chunks and parsed with SAX events mapped straight onto the bound parameters of a prepared upsert, so no JSON
+ * document or card list is ever built and memory stays flat whatever the size of the dump
+ * @param DB Sqlite database object
+ * @param path Path of the dump
+ * @param prices Price store receiving the prices of the cards (nullptr to skip them; the caller flushes it)
+ * @param day Day the prices are recorded for
+ * @return Statistics of the ingestion
+ * @throw ingest_error if the file cannot be read, is not valid JSON or a card cannot be inserted (the open batch is
+ * rolled back, committed batches are kept and simply updated by a rerun)
+ */
+ingest_stats ingest_bulk_cards(sqlite3* DB, const std::string& path, price_store* prices = nullptr, int32_t day = 0);
+
+/**
+ * Prints the statistics of an ingestion
+ * @param stats Ingestion statistics
+ * @return String with the throughput report
+ */
+std::string print_ingest_stats(const ingest_stats& stats);
+
+#endif //BULK_H
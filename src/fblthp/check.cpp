@@ -0,0 +1,366 @@
+/**
+ * Checks run by make check and ctest: the compile-time color tables against the colors table built by the migrations,
+ * and the Scryfall client against a local stand-in server
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sqlite3.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "colors.h"
+#include "database.h"
+#include "scryfall.h"
+#include "embedded_bundle.h" // Generated from the migrations directory by cmake/embed_migrations.cmake
+
+const char* COLORS_QUERY = "SELECT _id, name, white, blue, black, red, green FROM colors ORDER BY _id;"; ///< Colors rows
+const char* CASES = "colors, scryfall"; ///< Names of the checks
+constexpr int PAGES = 3; ///< Pages of the stand-in paginated listing
+constexpr int PAGE_OBJECTS = 2; ///< Objects of every page of the listing
+constexpr int RATE_REQUESTS = 6; ///< Requests sent to check the rate limiter
+constexpr double RATE = 20; ///< Requests per second of the rate limited client
+constexpr int POLL_MS = 50; ///< Longest time the stand-in server waits before checking whether it is stopped
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * Reason phrase of a status the stand-in server answers with
+     * @param status HTTP status
+     * @return Reason phrase
+     */
+    const char* status_reason(const int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 404: return "Not Found";
+            case 429: return "Too Many Requests";
+            default: return "Internal Server Error";
+        }
+    }
+
+    /**
+     * Minimal HTTP/1.1 server on a loopback port standing in for the Scryfall API, one request per connection.
+     * Serves a paginated listing (cards), a listing failing on its second page (broken), a rate limited endpoint
+     * answering 429 once (limited), an always available endpoint (ping) and 404 for anything else
+     */
+    class stand_in_server {
+        int listen_fd = -1; ///< Listening socket
+        int port = 0; ///< Port the socket is bound to
+        std::atomic<bool> stopping{false}; ///< Set to stop the server
+        std::mutex requests_mutex; ///< Guards the request log
+        std::vector<std::pair<std::string, clock_type::time_point>> requests; ///< Requested targets and arrival times
+        bool limited_once = false; ///< Whether the rate limited endpoint already answered 429
+        std::jthread worker; ///< Accepting thread
+
+        /**
+         * Builds the response to a request
+         * @param target Request target (path and query)
+         * @return Full HTTP response
+         */
+        std::string respond(const std::string& target) {
+            int status = 200;
+            std::string headers;
+            std::string body = R"({"object":"list","has_more":false,"data":[]})";
+            if (target.starts_with("/cards?page=")) {
+                const int page = std::stoi(target.substr(target.find('=') + 1));
+                std::string data;
+                for (int i = 0; i < PAGE_OBJECTS; i++) {
+                    data += std::string(i > 0 ? "," : "") + R"({"object":"card","name":"Card )" +
+                            std::to_string(page * PAGE_OBJECTS + i) + "\"}";
+                }
+                body = R"({"object":"list","has_more":)" + std::string(page < PAGES ? "true" : "false") +
+                       R"(,"next_page":")" + url("cards?page=" + std::to_string(page + 1)) + R"(","data":[)" + data +
+                       "]}";
+            } else if (target == "/broken?page=1") {
+                body = R"({"object":"list","has_more":true,"next_page":")" + url("broken?page=2") +
+                       R"(","data":[{"object":"card"}]})";
+            } else if (target == "/broken?page=2") {
+                status = 500;
+                body = R"({"object":"error","status":500,"details":"Stand-in failure"})";
+            } else if (target == "/limited" && !limited_once) {
+                limited_once = true;
+                status = 429;
+                headers = "Retry-After: 1\r\n";
+                body = R"({"object":"error","status":429,"details":"Too many requests"})";
+            } else if (target != "/limited" && !target.starts_with("/ping")) {
+                status = 404;
+                body = R"({"object":"error","status":404,"details":"Not found"})";
+            }
+            return "HTTP/1.1 " + std::to_string(status) + " " + status_reason(status) + "\r\n" +
+                   "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" +
+                   "Connection: close\r\n" + headers + "\r\n" + body;
+        }
+
+        /**
+         * Reads a request from a connection and answers it
+         * @param fd Connection socket (closed by the caller)
+         */
+        void serve(const int fd) {
+            std::string request;
+            char buffer[4096];
+            while (request.find("\r\n\r\n") == std::string::npos) {
+                const ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+                if (received <= 0) {
+                    return;
+                }
+                request.append(buffer, static_cast<size_t>(received));
+            }
+            const size_t target_start = request.find(' ') + 1;
+            const std::string target = request.substr(target_start, request.find(' ', target_start) - target_start);
+            std::string response;
+            {
+                const std::lock_guard lock(requests_mutex);
+                requests.emplace_back(target, clock_type::now());
+                response = respond(target);
+            }
+            for (size_t sent = 0; sent < response.size();) {
+                const ssize_t written = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    return;
+                }
+                sent += static_cast<size_t>(written);
+            }
+        }
+
+        /**
+         * Accepts connections until the server is stopped
+         */
+        void run() {
+            while (!stopping.load()) {
+                pollfd listening{listen_fd, POLLIN, 0};
+                if (::poll(&listening, 1, POLL_MS) <= 0) {
+                    continue;
+                }
+                if (const int fd = ::accept(listen_fd, nullptr, nullptr); fd >= 0) {
+                    serve(fd);
+                    ::close(fd);
+                }
+            }
+        }
+    public:
+        /**
+         * Binds a loopback port and starts serving
+         * @throw std::runtime_error if the socket cannot be bound
+         */
+        stand_in_server() {
+            listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t size = sizeof(address);
+            if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), size) != 0 ||
+                ::listen(listen_fd, SOMAXCONN) != 0 ||
+                ::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &size) != 0) {
+                const std::string error = std::strerror(errno);
+                if (listen_fd >= 0) {
+                    ::close(listen_fd);
+                }
+                throw std::runtime_error("Error: Stand-in server failed - " + error);
+            }
+            port = ntohs(address.sin_port);
+            worker = std::jthread([this] {run();});
+        }
+
+        ~stand_in_server() {
+            stopping.store(true);
+            if (worker.joinable()) {
+                worker.join();
+            }
+            ::close(listen_fd);
+        }
+        stand_in_server(const stand_in_server&) = delete;
+        stand_in_server& operator=(const stand_in_server&) = delete;
+
+        /**
+         * URL of an endpoint of the server
+         * @param endpoint Endpoint (empty for the root, used as the client's base URL)
+         * @return Absolute URL
+         */
+        [[nodiscard]] std::string url(const std::string& endpoint = "") const {
+            return "http://127.0.0.1:" + std::to_string(port) + "/" + endpoint;
+        }
+
+        /**
+         * Arrival times of the requests to a path
+         * @param prefix Start of the request targets
+         * @return Arrival times in order
+         */
+        std::vector<clock_type::time_point> arrivals(const std::string& prefix) {
+            const std::lock_guard lock(requests_mutex);
+            std::vector<clock_type::time_point> times;
+            for (const auto& [target, time] : requests) {
+                if (target.starts_with(prefix)) {
+                    times.push_back(time);
+                }
+            }
+            return times;
+        }
+    };
+
+    /**
+     * Checks the compile-time color tables against the colors table the migrations build
+     * @return Number of mismatches
+     * @throw database_error if the migrations cannot be replayed
+     */
+    size_t check_colors() {
+        using namespace color_constants;
+        size_t mismatches = 0;
+        size_t rows = 0;
+
+        // Replay every migration on an empty database, the same way doorkeeper upgrades to head
+        const db_connection DB(":memory:");
+        for (const auto& mig : embedded_bundle::MIGRATIONS) {
+            DB.exec(std::string(mig.up_stmt).c_str());
+        }
+
+        // Rows in _id order, each one matched with the same position of color_tables::NAMED
+        const db_statement stmt = DB.prepare(COLORS_QUERY);
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            const std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+            uint8_t mask = COLORLESS;
+            for (int bit = 0; bit < static_cast<int>(LETTERS.size()); bit++) {
+                mask |= sqlite3_column_int(stmt.get(), 2 + bit) != 0 ? static_cast<uint8_t>(1 << bit) : 0;
+            }
+            const int64_t id = sqlite3_column_int64(stmt.get(), 0);
+            if (rows >= color_tables::NAMED.size()) {
+                std::cout << "Row " << id << " (" << name << ") is missing from color_tables::NAMED\n";
+                mismatches++;
+            } else if (const auto& [named, named_mask] = color_tables::NAMED[rows];
+                       id != static_cast<int64_t>(rows + 1) || name != named || mask != named_mask) {
+                std::cout << "Row " << id << " (" << name << ", " << color_letters(mask) << ") differs from "
+                          << "color_tables::NAMED[" << rows << "] (" << named << ", " << color_letters(named_mask)
+                          << ")\n";
+                mismatches++;
+            }
+            rows++;
+        }
+        for (size_t i = rows; i < color_tables::NAMED.size(); i++) {
+            std::cout << color_tables::NAMED[i].name << " is missing from the colors table\n";
+            mismatches++;
+        }
+
+        std::cout << "Checked " << rows << " colors rows against " << color_tables::NAMED.size()
+                  << " named identities: " << mismatches << " mismatches" << std::endl;
+        return mismatches;
+    }
+
+    /**
+     * Checks the Scryfall client against a stand-in server on a loopback port (the base URL FBLTHP_SCRYFALL_URL
+     * points the client at): pagination, retries of rate limited requests, the request rate, and errors reaching the
+     * callers
+     * @return Number of failed expectations
+     * @throw std::runtime_error if the stand-in server cannot start
+     * @throw scryfall_error if the client fails
+     */
+    size_t check_scryfall() {
+        stand_in_server server;
+        size_t checked = 0;
+        size_t failures = 0;
+        auto expect = [&](const bool passed, const std::string& expectation) {
+            checked++;
+            if (!passed) {
+                std::cout << "Expected " << expectation << "\n";
+                failures++;
+            }
+        };
+
+        // Listings and errors, with the rate limiter out of the way
+        scryfall_options options;
+        options.base_url = server.url();
+        options.requests_per_second = 0;
+        {
+            scryfall_client client(options);
+            page_summary cards;
+            page_summary broken;
+            scryfall_response missing;
+            scryfall_response limited;
+            fetch_all_pages(client, "cards?page=1", nullptr, [&](const page_summary& summary) {cards = summary;});
+            fetch_all_pages(client, "broken?page=1", nullptr, [&](const page_summary& summary) {broken = summary;});
+            client.get("missing", [&](scryfall_response& response) {missing = std::move(response);});
+            client.get("limited", [&](scryfall_response& response) {limited = std::move(response);});
+            client.run();
+
+            expect(cards.error.empty() && cards.pages == PAGES, "every page of cards to be followed, got " +
+                   std::to_string(cards.pages) + " pages (" + cards.error + ")");
+            expect(cards.objects == static_cast<size_t>(PAGES * PAGE_OBJECTS), "the objects of every page of cards, "
+                   "got " + std::to_string(cards.objects));
+            expect(broken.pages == 1 && broken.status == 500, "broken to stop at its failed second page, got " +
+                   std::to_string(broken.pages) + " pages and status " + std::to_string(broken.status));
+            expect(broken.error.find("Stand-in failure") != std::string::npos, "the body of the failed page of "
+                   "broken as its error, got \"" + broken.error + "\"");
+            expect(missing.status == 404 && !missing.ok() && missing.error.find("Not found") != std::string::npos,
+                   "missing to fail with 404 and the server's error, got " + std::to_string(missing.status) + " \"" +
+                   missing.error + "\"");
+            expect(limited.ok() && limited.retries == 1, "limited to succeed after one retry, got status " +
+                   std::to_string(limited.status) + " after " + std::to_string(limited.retries) + " retries");
+            expect(limited.ms >= 900, "limited to wait the second its Retry-After asks for, got " +
+                   std::to_string(limited.ms) + " ms");
+        }
+
+        // Request rate: one request at a time, then one every 1 / RATE seconds
+        options.requests_per_second = RATE;
+        options.burst = 1;
+        {
+            scryfall_client client(options);
+            int answered = 0;
+            for (int i = 0; i < RATE_REQUESTS; i++) {
+                client.get("ping?" + std::to_string(i), [&](const scryfall_response& response) {
+                    answered += response.ok();
+                });
+            }
+            client.run();
+            expect(answered == RATE_REQUESTS, "every rate limited request to succeed, got " +
+                   std::to_string(answered));
+        }
+        const std::vector<clock_type::time_point> pings = server.arrivals("/ping");
+        const double span_ms = pings.size() < 2 ? 0 :
+                               std::chrono::duration<double, std::milli>(pings.back() - pings.front()).count();
+        const double minimum_ms = (RATE_REQUESTS - 1) * 1000.0 / RATE * 0.9; // Timer slack
+        expect(pings.size() == static_cast<size_t>(RATE_REQUESTS) && span_ms >= minimum_ms,
+               std::to_string(RATE_REQUESTS) + " requests spread over at least " + std::to_string(minimum_ms) +
+               " ms, got " + std::to_string(pings.size()) + " over " + std::to_string(span_ms) + " ms");
+
+        std::cout << "Checked " << checked << " Scryfall client expectations against a stand-in server: " << failures
+                  << " failures" << std::endl;
+        return failures;
+    }
+}
+
+int main(const int argc, const char* argv[]) {
+    const std::string only = argc > 1 ? argv[1] : "";
+    if (!only.empty() && only != "colors" && only != "scryfall") {
+        std::cout << "Usage: fblthp-check [case] (cases: " << CASES << ", all when omitted)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t failures = 0;
+    try {
+        if (only.empty() || only == "colors") {
+            failures += check_colors();
+        }
+        if (only.empty() || only == "scryfall") {
+            failures += check_scryfall();
+        }
+    } catch (const std::exception& e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <numeric>
+#include <sstream>
+
+#include "collection.h"
+#include "exceptions.h"
+
+using namespace collection_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Reads a text column as a string view
+     * @param stmt Statement positioned on a row
+     * @param column Column index
+     * @return Text of the column (empty for NULL)
+     */
+    std::string_view column_view(sqlite3_stmt* stmt, const int column) {
+        const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text != nullptr ? std::string_view(text, sqlite3_column_bytes(stmt, column)) : std::string_view();
+    }
+
+    /**
+     * Reads a boolean column stored either as an integer or as text (True/False, yes/no, 1/0)
+     * @param stmt Statement positioned on a row
+     * @param column Column index
+     * @return Value of the column (false for NULL)
+     */
+    bool column_bool(sqlite3_stmt* stmt, const int column) {
+        if (sqlite3_column_type(stmt, column) == SQLITE_INTEGER) {
+            return sqlite3_column_int64(stmt, column) != 0;
+        }
+        const std::string_view text = column_view(stmt, column);
+        return !text.empty() && (text[0] == 't' || text[0] == 'T' || text[0] == 'y' || text[0] == 'Y' ||
+                                 text[0] == '1');
+    }
+
+    /**
+     * Parses a boolean query value
+     * @param value Query value
+     * @return Boolean value
+     * @throw query_error if the value is not true or false
+     */
+    bool parse_bool(const std::string_view value) {
+        if (value == "true" || value == "1") {
+            return true;
+        }
+        if (value == "false" || value == "0") {
+            return false;
+        }
+        throw query_error("Invalid boolean: " + std::string(value));
+    }
+}
+
+// String pool
+// ---------------------------------------------------------------------------------------------------------------------
+uint32_t string_pool::intern(const std::string_view value) {
+    if (const auto entry = ids.find(value); entry != ids.end()) {
+        return entry->second;
+    }
+    const auto id = static_cast<uint32_t>(values.size());
+    values.emplace_back(value);
+    ids.emplace(values.back(), id);
+    return id;
+}
+
+std::optional<uint32_t> string_pool::find(const std::string_view value) const {
+    const auto entry = ids.find(value);
+    return entry != ids.end() ? std::optional(entry->second) : std::nullopt;
+}
+
+// Collection store
+// ---------------------------------------------------------------------------------------------------------------------
+void collection_store::append(const std::string_view card_name, const std::string_view set_code,
+                              const std::string_view collector_number, const ::rarity card_rarity,
+                              const uint32_t copies, const bool is_foil, const uint8_t color_mask,
+                              const uint8_t identity_mask) {
+    name.push_back(names.intern(card_name));
+    set.push_back(sets.intern(set_code));
+    number.push_back(numbers.intern(collector_number));
+    rarity.push_back(static_cast<uint8_t>(card_rarity));
+    quantity.push_back(copies);
+    foil.push_back(is_foil ? 1 : 0);
+    colors.push_back(color_mask);
+    color_identity.push_back(identity_mask);
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+rarity parse_rarity(const std::string_view letter) {
+    if (letter.size() != 1) {
+        return rarity::UNKNOWN;
+    }
+    switch (std::toupper(static_cast<unsigned char>(letter[0]))) {
+        case 'C': return rarity::COMMON;
+        case 'U': return rarity::UNCOMMON;
+        case 'R': return rarity::RARE;
+        case 'M': return rarity::MYTHIC;
+        case 'S': return rarity::SPECIAL;
+        case 'B': return rarity::BONUS;
+        default: return rarity::UNKNOWN;
+    }
+}
+
+collection_store load_collection(sqlite3* DB) {
+    collection_store store;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(DB, LOAD_QUERY, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw query_error(sqlite3_errmsg(DB));
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        store.append(column_view(stmt, 0), column_view(stmt, 1), column_view(stmt, 2),
+                     parse_rarity(column_view(stmt, 3)),
+                     static_cast<uint32_t>(std::max<sqlite3_int64>(sqlite3_column_int64(stmt, 4), 0)),
+                     column_bool(stmt, 5), parse_colors(column_view(stmt, 6)).value_or(color_constants::COLORLESS),
+                     parse_colors(column_view(stmt, 7)).value_or(color_constants::COLORLESS));
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw query_error(sqlite3_errmsg(DB));
+    }
+    return store;
+}
+
+collection_filter parse_filter(const std::string_view query, const collection_store& store) {
+    collection_filter filter;
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find(',', start);
+        if (end == std::string_view::npos) {
+            end = query.size();
+        }
+        const std::string_view predicate = query.substr(start, end - start);
+        start = end + 1;
+        if (predicate.empty()) {
+            continue;
+        }
+
+        const size_t equals = predicate.find('=');
+        if (equals == std::string_view::npos) {
+            throw query_error("Missing value in " + std::string(predicate));
+        }
+        const std::string_view key = predicate.substr(0, equals);
+        const std::string_view value = predicate.substr(equals + 1);
+        if (key == "rarity") {
+            filter.rarities = 0;
+            for (const char letter : value) {
+                const rarity parsed = parse_rarity(std::string_view(&letter, 1));
+                if (parsed == rarity::UNKNOWN) {
+                    throw query_error("Invalid rarity: " + std::string(1, letter));
+                }
+                filter.rarities |= static_cast<uint8_t>(1u << static_cast<uint8_t>(parsed));
+            }
+        } else if (key == "foil") {
+            filter.foil = parse_bool(value);
+        } else if (key == "identity" || key == "colors") {
+            const std::optional<uint8_t> mask = color_mask(value) ? color_mask(value) : parse_colors(value);
+            if (!mask) {
+                throw query_error("Invalid colors: " + std::string(value));
+            }
+            if (key == "identity") {
+                filter.identity_within = *mask;
+            } else {
+                filter.colors = *mask;
+            }
+        } else if (key == "set") {
+            // A set missing from the collection matches nothing: use an id no row has
+            filter.set = store.sets.find(value).value_or(static_cast<uint32_t>(store.sets.values.size()));
+        } else {
+            throw query_error("Unknown predicate: " + std::string(key));
+        }
+    }
+    return filter;
+}
+
+void filter_block(const collection_store& store, const collection_filter& filter, const size_t begin,
+                  const size_t end, uint8_t* keep) {
+    const size_t rows = end - begin;
+    const uint8_t* rarities = store.rarity.data() + begin;
+    const uint32_t accepted = filter.rarities;
+    for (size_t i = 0; i < rows; i++) {
+        keep[i] = static_cast<uint8_t>((accepted >> rarities[i]) & 1u);
+    }
+    if (filter.identity_within != color_constants::ALL_COLORS) {
+        const uint8_t* identities = store.color_identity.data() + begin;
+        const auto outside = static_cast<uint8_t>(~filter.identity_within & color_constants::ALL_COLORS);
+        for (size_t i = 0; i < rows; i++) {
+            keep[i] &= static_cast<uint8_t>((identities[i] & outside) == 0);
+        }
+    }
+    if (filter.colors) {
+        const uint8_t* colors = store.colors.data() + begin;
+        const uint8_t wanted = *filter.colors;
+        for (size_t i = 0; i < rows; i++) {
+            keep[i] &= static_cast<uint8_t>(colors[i] == wanted);
+        }
+    }
+    if (filter.foil) {
+        const uint8_t* foils = store.foil.data() + begin;
+        const uint8_t wanted = *filter.foil ? 1 : 0;
+        for (size_t i = 0; i < rows; i++) {
+            keep[i] &= static_cast<uint8_t>(foils[i] == wanted);
+        }
+    }
+    if (filter.set) {
+        const uint32_t* sets = store.set.data() + begin;
+        const uint32_t wanted = *filter.set;
+        for (size_t i = 0; i < rows; i++) {
+            keep[i] &= static_cast<uint8_t>(sets[i] == wanted);
+        }
+    }
+}
+
+std::vector<uint32_t> select_rows(const collection_store& store, const collection_filter& filter) {
+    std::vector<uint32_t> selected(store.size());
+    std::array<uint8_t, BLOCK_ROWS> keep{};
+    size_t count = 0;
+    for (size_t begin = 0; begin < store.size(); begin += BLOCK_ROWS) {
+        const size_t end = std::min(begin + BLOCK_ROWS, store.size());
+        filter_block(store, filter, begin, end, keep.data());
+        for (size_t i = 0; i < end - begin; i++) {
+            selected[count] = static_cast<uint32_t>(begin + i); // Branch-free compaction
+            count += keep[i];
+        }
+    }
+    selected.resize(count);
+    return selected;
+}
+
+uint64_t sum_quantity(const collection_store& store, const collection_filter& filter) {
+    std::array<uint8_t, BLOCK_ROWS> keep{};
+    uint64_t total = 0;
+    for (size_t begin = 0; begin < store.size(); begin += BLOCK_ROWS) {
+        const size_t end = std::min(begin + BLOCK_ROWS, store.size());
+        filter_block(store, filter, begin, end, keep.data());
+        const uint32_t* quantities = store.quantity.data() + begin;
+        for (size_t i = 0; i < end - begin; i++) {
+            total += static_cast<uint64_t>(keep[i]) * quantities[i];
+        }
+    }
+    return total;
+}
+
+std::vector<uint64_t> sum_quantity_by_set(const collection_store& store, const collection_filter& filter) {
+    std::vector<uint64_t> by_set(store.sets.values.size());
+    std::array<uint8_t, BLOCK_ROWS> keep{};
+    for (size_t begin = 0; begin < store.size(); begin += BLOCK_ROWS) {
+        const size_t end = std::min(begin + BLOCK_ROWS, store.size());
+        filter_block(store, filter, begin, end, keep.data());
+        const uint32_t* sets = store.set.data() + begin;
+        const uint32_t* quantities = store.quantity.data() + begin;
+        for (size_t i = 0; i < end - begin; i++) {
+            by_set[sets[i]] += static_cast<uint64_t>(keep[i]) * quantities[i];
+        }
+    }
+    return by_set;
+}
+
+std::string print_quantity_by_set(const collection_store& store, const std::vector<uint64_t>& by_set) {
+    std::vector<uint32_t> order(by_set.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) {
+        return by_set[a] != by_set[b] ? by_set[a] > by_set[b] : store.sets.values[a] < store.sets.values[b];
+    });
+
+    std::ostringstream out;
+    for (const uint32_t id : order) {
+        if (by_set[id] == 0) {
+            break;
+        }
+        out << "  " << store.sets.values[id] << ": " << by_set[id] << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,186 @@
+/**
+ * Columnar in-memory collection store header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef COLLECTION_H
+#define COLLECTION_H
+#include <cstdint>
+#include <optional>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "colors.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace collection_constants {
+    inline const char* LOAD_QUERY = "SELECT name, \"set\", number, rarity, quantity, foil, colors, color_id "
+                                    "FROM raw_collection;"; ///< SQL statement reading the collection
+    inline constexpr size_t BLOCK_ROWS = 4096; ///< Rows filtered at once (the block mask stays in L1)
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Rarity of a collection row (the bit of a rarity in a rarity set is 1 << value)
+ */
+enum class rarity : uint8_t {COMMON, UNCOMMON, RARE, MYTHIC, SPECIAL, BONUS, UNKNOWN};
+
+/**
+ * Transparent string hash, so string views are looked up without building a string
+ */
+struct string_hash {
+    using is_transparent = void;
+    size_t operator()(const std::string_view value) const {return std::hash<std::string_view>{}(value);}
+};
+
+/**
+ * String interning pool: every distinct string is stored once and referred to by a dense id
+ */
+struct string_pool {
+    std::vector<std::string> values; ///< Strings by id
+    std::unordered_map<std::string, uint32_t, string_hash, std::equal_to<>> ids; ///< Ids by string
+
+    /**
+     * Interns a string
+     * @param value String to intern
+     * @return Id of the string
+     */
+    uint32_t intern(std::string_view value);
+
+    /**
+     * Looks up an interned string
+     * @param value String to look up
+     * @return Id of the string, or nullopt if it was never interned
+     */
+    [[nodiscard]] std::optional<uint32_t> find(std::string_view value) const;
+};
+
+/**
+ * Struct of arrays holding the collection, one entry per row in every column. Colors are 5-bit WUBRG masks with the
+ * semantics of the colors table (bit 0 white to bit 4 green, 0 colorless)
+ */
+struct collection_store {
+    std::vector<uint32_t> name; ///< Interned card name
+    std::vector<uint32_t> set; ///< Interned set code
+    std::vector<uint32_t> number; ///< Interned collector number
+    std::vector<uint8_t> rarity; ///< Rarity (value of the rarity enum)
+    std::vector<uint32_t> quantity; ///< Number of copies
+    std::vector<uint8_t> foil; ///< 1 if the copies are foil
+    std::vector<uint8_t> colors; ///< Color mask
+    std::vector<uint8_t> color_identity; ///< Color identity mask
+    string_pool names; ///< Card names
+    string_pool sets; ///< Set codes
+    string_pool numbers; ///< Collector numbers
+
+    /**
+     * Number of rows
+     * @return Rows in the store
+     */
+    [[nodiscard]] size_t size() const {return rarity.size();}
+
+    /**
+     * Appends a row
+     * @param card_name Card name
+     * @param set_code Set code
+     * @param collector_number Collector number
+     * @param card_rarity Rarity
+     * @param copies Number of copies
+     * @param is_foil Whether the copies are foil
+     * @param color_mask Color mask
+     * @param identity_mask Color identity mask
+     */
+    void append(std::string_view card_name, std::string_view set_code, std::string_view collector_number,
+                ::rarity card_rarity, uint32_t copies, bool is_foil, uint8_t color_mask, uint8_t identity_mask);
+};
+
+/**
+ * Struct to hold the predicates of a query (a row matches when it passes all of them)
+ */
+struct collection_filter {
+    uint8_t rarities = 0x7F; ///< Set of accepted rarities (bit 1 << rarity)
+    std::optional<bool> foil; ///< Required finish (nullopt for any)
+    uint8_t identity_within = color_constants::ALL_COLORS; ///< Color identity must be a subset of this mask
+    std::optional<uint8_t> colors; ///< Exact color mask (nullopt for any)
+    std::optional<uint32_t> set; ///< Required set id (nullopt for any)
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Converts a rarity letter of the collection exports into a rarity
+ * @param letter Rarity letter (C, U, R, M, S or B, any case)
+ * @return Rarity (UNKNOWN for anything else)
+ */
+rarity parse_rarity(std::string_view letter);
+
+/**
+ * Loads the collection table into a columnar store
+ * @param DB Sqlite database object
+ * @return Collection store
+ * @throw query_error if the collection cannot be read
+ */
+collection_store load_collection(sqlite3* DB);
+
+/**
+ * Parses a query of comma separated predicates: rarity=<letters>, foil=<true|false>, identity=<colors> (identity
+ * within), colors=<colors> (exact) and set=<code>. Colors are letters or a name of the colors table (Temur)
+ * @param query Query string (empty matches every row)
+ * @param store Collection store (to resolve set codes)
+ * @return Filter of the query
+ * @throw query_error if a predicate is malformed
+ */
+collection_filter parse_filter(std::string_view query, const collection_store& store);
+
+/**
+ * Evaluates a filter over a block of rows into a byte mask. Every predicate is a branch-free pass over one column
+ * combined into the mask, which the compiler turns into SIMD loops
+ * @param store Collection store
+ * @param filter Filter to evaluate
+ * @param begin First row of the block
+ * @param end End of the block (at most BLOCK_ROWS after begin)
+ * @param keep Mask with one byte per row of the block (1 if the row matches)
+ */
+void filter_block(const collection_store& store, const collection_filter& filter, size_t begin, size_t end,
+                  uint8_t* keep);
+
+/**
+ * Selects the rows matching a filter
+ * @param store Collection store
+ * @param filter Filter to evaluate
+ * @return Matching row indexes in ascending order
+ */
+std::vector<uint32_t> select_rows(const collection_store& store, const collection_filter& filter);
+
+/**
+ * Sums the copies of the rows matching a filter
+ * @param store Collection store
+ * @param filter Filter to evaluate
+ * @return Total number of copies
+ */
+uint64_t sum_quantity(const collection_store& store, const collection_filter& filter);
+
+/**
+ * Sums the copies of the rows matching a filter grouped by set
+ * @param store Collection store
+ * @param filter Filter to evaluate
+ * @return Copies by set id
+ */
+std::vector<uint64_t> sum_quantity_by_set(const collection_store& store, const collection_filter& filter);
+
+/**
+ * Prints the copies by set of a query, largest first
+ * @param store Collection store
+ * @param by_set Copies by set id
+ * @return String with one line per set with copies
+ */
+std::string print_quantity_by_set(const collection_store& store, const std::vector<uint64_t>& by_set);
+
+#endif //COLLECTION_H
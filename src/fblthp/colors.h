@@ -0,0 +1,271 @@
+/**
+ * Compile-time color identity tables
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.2
+ */
+
+#ifndef COLORS_H
+#define COLORS_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace color_constants {
+    inline constexpr uint8_t WHITE = 1 << 0; ///< White bit of a color mask
+    inline constexpr uint8_t BLUE = 1 << 1; ///< Blue bit of a color mask
+    inline constexpr uint8_t BLACK = 1 << 2; ///< Black bit of a color mask
+    inline constexpr uint8_t RED = 1 << 3; ///< Red bit of a color mask
+    inline constexpr uint8_t GREEN = 1 << 4; ///< Green bit of a color mask
+    inline constexpr uint8_t COLORLESS = 0; ///< Mask without colors
+    inline constexpr uint8_t ALL_COLORS = WHITE | BLUE | BLACK | RED | GREEN; ///< Mask with the five colors
+    inline constexpr std::string_view LETTERS = "WUBRG"; ///< Letters of the colors, in mask bit order
+    inline constexpr uint8_t INVALID = 0x80; ///< Flag of a character that is not a color in the letter table
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold a named color combination (a row of the colors table)
+ */
+struct color_identity {
+    std::string_view name; ///< Name of the combination
+    uint8_t mask; ///< Color mask
+};
+
+// Tables
+// -----------------------------------------------------------------------------------------------------------------
+namespace color_tables {
+    using namespace color_constants;
+
+    /**
+     * Rows of the colors table in _id order (compared with the table the migrations build by fblthp-check)
+     */
+    inline constexpr std::array<color_identity, 32> NAMED = {{
+        {"Colorless", COLORLESS},
+        {"White", WHITE}, {"Blue", BLUE}, {"Black", BLACK}, {"Red", RED}, {"Green", GREEN},
+        {"Azorius", WHITE | BLUE}, {"Dimir", BLUE | BLACK}, {"Rakdos", BLACK | RED}, {"Gruul", RED | GREEN},
+        {"Selesnya", WHITE | GREEN}, {"Orzhov", WHITE | BLACK}, {"Izzet", BLUE | RED}, {"Golgari", BLACK | GREEN},
+        {"Boros", WHITE | RED}, {"Simic", BLUE | GREEN},
+        {"Esper", WHITE | BLUE | BLACK}, {"Grixis", BLUE | BLACK | RED}, {"Jund", BLACK | RED | GREEN},
+        {"Naya", WHITE | RED | GREEN}, {"Bant", WHITE | BLUE | GREEN}, {"Abzan", WHITE | BLACK | GREEN},
+        {"Jeskai", WHITE | BLUE | RED}, {"Sultai", BLUE | BLACK | GREEN}, {"Mardu", WHITE | BLACK | RED},
+        {"Temur", BLUE | RED | GREEN},
+        {"Yore-Tiller", WHITE | BLUE | BLACK | RED}, {"Glint-Eye", BLUE | BLACK | RED | GREEN},
+        {"Dune-Brood", WHITE | BLACK | RED | GREEN}, {"Ink-Treader", WHITE | BLUE | RED | GREEN},
+        {"Witch-Maw", WHITE | BLUE | BLACK | GREEN},
+        {"WUBRG", ALL_COLORS}
+    }};
+
+    /**
+     * Builds the mask to name table
+     * @return Name of every mask
+     */
+    consteval std::array<std::string_view, 32> make_names() {
+        std::array<std::string_view, 32> names{};
+        for (const auto& [name, mask] : NAMED) {
+            names[mask] = name;
+        }
+        return names;
+    }
+
+    /**
+     * Builds the mask to letters table
+     * @return Letters of every mask in WUBRG order ("C" for colorless), padded with NULs
+     */
+    consteval std::array<std::array<char, 6>, 32> make_letters() {
+        std::array<std::array<char, 6>, 32> letters{};
+        for (uint8_t mask = 0; mask < 32; mask++) {
+            size_t size = 0;
+            for (size_t bit = 0; bit < LETTERS.size(); bit++) {
+                if (mask & (1u << bit)) {
+                    letters[mask][size++] = LETTERS[bit];
+                }
+            }
+            if (size == 0) {
+                letters[mask][0] = 'C';
+            }
+        }
+        return letters;
+    }
+
+    /**
+     * Builds the character to color bit table. Colorless markers and separators map to no bit, anything else to
+     * INVALID, so a whole string is parsed by OR-ing lookups
+     * @return Bit of every character
+     */
+    consteval std::array<uint8_t, 256> make_letter_bits() {
+        std::array<uint8_t, 256> bits{};
+        bits.fill(INVALID);
+        for (size_t bit = 0; bit < LETTERS.size(); bit++) {
+            bits[static_cast<unsigned char>(LETTERS[bit])] = static_cast<uint8_t>(1u << bit);
+            bits[static_cast<unsigned char>(LETTERS[bit] - 'A' + 'a')] = static_cast<uint8_t>(1u << bit);
+        }
+        for (const char ignored : std::string_view("Cc ,/{}")) {
+            bits[static_cast<unsigned char>(ignored)] = 0;
+        }
+        return bits;
+    }
+
+    /**
+     * Builds the name to mask table
+     * @return Named combinations sorted by name, for a binary search
+     */
+    consteval std::array<color_identity, 32> make_by_name() {
+        std::array<color_identity, 32> by_name = NAMED;
+        std::ranges::sort(by_name, {}, &color_identity::name);
+        return by_name;
+    }
+
+    inline constexpr std::array<std::string_view, 32> NAMES = make_names(); ///< Name by mask
+    inline constexpr std::array<color_identity, 32> BY_NAME = make_by_name(); ///< Named combinations by name
+    inline constexpr std::array<std::array<char, 6>, 32> MASK_LETTERS = make_letters(); ///< Letters by mask
+    inline constexpr std::array<uint8_t, 256> LETTER_BITS = make_letter_bits(); ///< Color bit by character
+}
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Name of a color combination
+ * @param mask Color mask
+ * @return Name of the combination (as in the colors table)
+ */
+constexpr std::string_view color_name(const uint8_t mask) {
+    return color_tables::NAMES[mask & color_constants::ALL_COLORS];
+}
+
+/**
+ * Color mask of a named combination
+ * @param name Name of the combination (as in the colors table, case sensitive)
+ * @return Color mask, or nullopt for an unknown name
+ */
+constexpr std::optional<uint8_t> color_mask(const std::string_view name) {
+    const auto found = std::ranges::lower_bound(color_tables::BY_NAME, name, {}, &color_identity::name);
+    if (found == color_tables::BY_NAME.end() || found->name != name) {
+        return std::nullopt;
+    }
+    return found->mask;
+}
+
+/**
+ * Parses color letters (raw_collection.colors style: WUBRG in any order and case, C or empty for colorless,
+ * separators and mana braces ignored) into a color mask
+ * @param letters Color letters
+ * @return Color mask, or nullopt if a character is not a color
+ */
+constexpr std::optional<uint8_t> parse_colors(const std::string_view letters) {
+    uint8_t bits = 0;
+    for (const char letter : letters) {
+        bits |= color_tables::LETTER_BITS[static_cast<unsigned char>(letter)];
+    }
+    return bits & color_constants::INVALID ? std::nullopt : std::optional<uint8_t>(bits);
+}
+
+/**
+ * Letters of a color mask
+ * @param mask Color mask
+ * @return Letters in WUBRG order ("C" for colorless)
+ */
+constexpr std::string_view color_letters(const uint8_t mask) {
+    return color_tables::MASK_LETTERS[mask & color_constants::ALL_COLORS].data();
+}
+
+/**
+ * Checks whether a color identity fits within another one (a card in a commander's identity)
+ * @param identity Identity to check
+ * @param within Enclosing identity
+ * @return True if every color of identity is in within
+ */
+constexpr bool identity_within(const uint8_t identity, const uint8_t within) {
+    return (identity & ~within & color_constants::ALL_COLORS) == 0;
+}
+
+/**
+ * Checks whether a color identity contains every color of another one
+ * @param identity Identity to check
+ * @param covered Identity that must be covered
+ * @return True if every color of covered is in identity
+ */
+constexpr bool identity_covers(const uint8_t identity, const uint8_t covered) {
+    return identity_within(covered, identity);
+}
+
+/**
+ * Number of colors of a mask
+ * @param mask Color mask
+ * @return Number of colors
+ */
+constexpr int color_count(const uint8_t mask) {
+    return std::popcount(static_cast<uint8_t>(mask & color_constants::ALL_COLORS));
+}
+
+// Checks
+// -----------------------------------------------------------------------------------------------------------------
+namespace color_tables {
+    /**
+     * Checks that the named table holds every mask exactly once under a distinct name
+     * @return True if the table is a bijection
+     */
+    consteval bool is_bijection() {
+        std::array<int, 32> seen{};
+        for (size_t i = 0; i < NAMED.size(); i++) {
+            if (NAMED[i].mask > ALL_COLORS || seen[NAMED[i].mask]++ > 0) {
+                return false;
+            }
+            for (size_t j = i + 1; j < NAMED.size(); j++) {
+                if (NAMED[i].name == NAMED[j].name) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Checks that the rows follow the colors table layout: grouped by number of colors
+     * @return True if the number of colors never decreases from one row to the next
+     */
+    consteval bool is_grouped_by_count() {
+        for (size_t i = 1; i < NAMED.size(); i++) {
+            if (color_count(NAMED[i].mask) < color_count(NAMED[i - 1].mask)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Checks that the name lookup finds every named combination with its mask
+     * @return True if every name of the colors table resolves to its own mask
+     */
+    consteval bool is_searchable() {
+        if (!std::ranges::is_sorted(BY_NAME, {}, &color_identity::name)) {
+            return false;
+        }
+        return std::ranges::all_of(NAMED, [](const color_identity& identity) {
+            return color_mask(identity.name) == identity.mask;
+        });
+    }
+}
+
+static_assert(color_tables::is_bijection(), "Every color mask needs exactly one distinct name");
+static_assert(color_tables::is_grouped_by_count(), "Color rows must keep the colors table order");
+static_assert(color_tables::is_searchable(), "Every color name must be found by color_mask");
+static_assert(!color_mask("golgari") && !color_mask("") && !color_mask("Zzz"));
+static_assert(color_mask("Golgari") == (color_constants::BLACK | color_constants::GREEN));
+static_assert(color_mask("Simic") == (color_constants::BLUE | color_constants::GREEN));
+static_assert(color_mask("Dune-Brood") == (color_constants::ALL_COLORS & ~color_constants::BLUE));
+static_assert(color_mask("Witch-Maw") == (color_constants::ALL_COLORS & ~color_constants::RED));
+static_assert(color_name(*parse_colors("gur")) == "Temur");
+static_assert(color_letters(*parse_colors("{G}{W}")) == "WG" && color_letters(0) == "C");
+static_assert(parse_colors("") == color_constants::COLORLESS && !parse_colors("WX"));
+static_assert(identity_within(*parse_colors("UG"), *color_mask("Temur")) &&
+              !identity_within(*parse_colors("WU"), *color_mask("Temur")));
+
+#endif //COLORS_H
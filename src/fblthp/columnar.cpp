@@ -0,0 +1,565 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <sys/resource.h>
+
+#include "columnar.h"
+#include "colors.h"
+#include "exceptions.h"
+#include "hash.h"
+
+namespace fs = std::filesystem;
+using namespace columnar_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Struct to hold the values of a column for the row group being read
+     */
+    struct column_buffer {
+        column_type type; ///< Logical type
+        std::vector<uint8_t> valid; ///< 1 for every row with a value
+        std::vector<int64_t> ints; ///< INT64 and BOOL values (0 for nulls)
+        std::vector<double> reals; ///< DOUBLE values (0 for nulls)
+        std::string bytes; ///< STRING and COLORS values back to back
+        std::vector<uint32_t> ends; ///< End of every string in bytes
+        uint32_t nulls = 0; ///< Null values
+
+        /**
+         * Empties the buffer for the next row group
+         */
+        void clear() {
+            valid.clear();
+            ints.clear();
+            reals.clear();
+            bytes.clear();
+            ends.clear();
+            nulls = 0;
+        }
+
+        /**
+         * String of a row
+         * @param row Row of the group
+         * @return Value (empty for nulls)
+         */
+        [[nodiscard]] std::string_view text(const size_t row) const {
+            const uint32_t begin = row > 0 ? ends[row - 1] : 0;
+            return std::string_view(bytes).substr(begin, ends[row] - begin);
+        }
+    };
+
+    /**
+     * Struct to hold the rows of a group until it is written
+     */
+    struct row_group {
+        std::vector<column_buffer> columns; ///< Values by column
+        uint32_t rows = 0; ///< Rows read
+
+        /**
+         * Empties the group for the next rows, keeping the capacity of its buffers
+         */
+        void clear() {
+            for (column_buffer& column : columns) {
+                column.clear();
+            }
+            rows = 0;
+        }
+    };
+
+    /**
+     * Appends a little-endian field to a buffer
+     * @param out Buffer
+     * @param value Value of the field
+     */
+    template<typename T>
+    void put(std::string& out, const T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    /**
+     * Appends a length-prefixed string to a buffer
+     * @param out Buffer
+     * @param value String
+     */
+    void put_string(std::string& out, const std::string_view value) {
+        put(out, static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    /**
+     * Pads a buffer with zeros up to ALIGNMENT
+     * @param out Buffer
+     */
+    void pad(std::string& out) {
+        out.append((ALIGNMENT - out.size() % ALIGNMENT) % ALIGNMENT, '\0');
+    }
+
+    /**
+     * Rounds a size up to ALIGNMENT
+     * @param bytes Size
+     * @return Padded size
+     */
+    size_t padded(const size_t bytes) {
+        return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /**
+     * Bytes taken by bit-packed values
+     * @param count Number of values
+     * @param width Bits per value
+     * @return Size of the packed words
+     */
+    size_t packed_bytes(const size_t count, const unsigned int width) {
+        return (count * width + 63) / 64 * sizeof(uint64_t);
+    }
+
+    /**
+     * Bit-packs values into u64 words, lowest bits first, so a value never needs more than two word reads
+     * @param out Buffer
+     * @param values Values (each below 2^width)
+     * @param width Bits per value (0 to 64)
+     */
+    void pack(std::string& out, const std::vector<uint64_t>& values, const unsigned int width) {
+        uint64_t word = 0;
+        unsigned int used = 0;
+        for (const uint64_t value : values) {
+            if (width == 0) {
+                break;
+            }
+            word |= value << used;
+            used += width;
+            if (used >= 64) {
+                put(out, word);
+                used -= 64;
+                word = used > 0 ? value >> (width - used) : 0;
+            }
+        }
+        if (used > 0) {
+            put(out, word);
+        }
+    }
+
+    /**
+     * Appends a validity bitmap, one bit per row, lowest bits first
+     * @param out Buffer
+     * @param valid Validity of the rows
+     */
+    void put_validity(std::string& out, const std::vector<uint8_t>& valid) {
+        std::string bitmap((valid.size() + 7) / 8, '\0');
+        for (size_t row = 0; row < valid.size(); row++) {
+            bitmap[row / 8] = static_cast<char>(bitmap[row / 8] | valid[row] << (row % 8));
+        }
+        out += bitmap;
+        pad(out);
+    }
+
+    /**
+     * Encodes integers relative to their minimum in the bits their range needs (plain when it needs all 64)
+     * @param out Buffer
+     * @param column Column buffer
+     * @param chunk Chunk metadata (encoding and bit width are set)
+     */
+    void encode_integers(std::string& out, const column_buffer& column, column_chunk& chunk) {
+        int64_t low = INT64_MAX;
+        int64_t high = INT64_MIN;
+        for (size_t row = 0; row < column.ints.size(); row++) {
+            if (column.valid[row] != 0) {
+                low = std::min(low, column.ints[row]);
+                high = std::max(high, column.ints[row]);
+            }
+        }
+        if (low > high) {
+            low = high = 0; // Only nulls
+        }
+        const unsigned int width = std::bit_width(static_cast<uint64_t>(high) - static_cast<uint64_t>(low));
+        if (width == 64) {
+            chunk.encoding = column_encoding::PLAIN;
+            for (const int64_t value : column.ints) {
+                put(out, value);
+            }
+            return;
+        }
+        chunk.encoding = column_encoding::BIT_PACKED;
+        chunk.bit_width = static_cast<uint8_t>(width);
+        std::vector<uint64_t> deltas(column.ints.size());
+        for (size_t row = 0; row < deltas.size(); row++) {
+            deltas[row] = column.valid[row] != 0 ? static_cast<uint64_t>(column.ints[row]) - static_cast<uint64_t>(low)
+                                                 : 0;
+        }
+        put(out, low);
+        pack(out, deltas, width);
+    }
+
+    /**
+     * Encodes strings with a dictionary of the distinct values of the group, or plain when that is smaller
+     * @param out Buffer
+     * @param column Column buffer
+     * @param chunk Chunk metadata (encoding and bit width are set)
+     */
+    void encode_strings(std::string& out, const column_buffer& column, column_chunk& chunk) {
+        const size_t rows = column.ends.size();
+        // Open-addressing index of the entries (entry plus one, 0 for an empty slot) at a load factor below one half
+        std::vector<uint32_t> slots(std::bit_ceil(rows * 2 + 1), 0);
+        const size_t mask = slots.size() - 1;
+        std::vector<std::string_view> entries;
+        std::vector<uint64_t> codes(rows);
+        size_t entry_bytes = 0;
+        for (size_t row = 0; row < rows; row++) {
+            const std::string_view value = column.text(row);
+            size_t slot = xxh64(value) & mask;
+            while (slots[slot] != 0 && entries[slots[slot] - 1] != value) {
+                slot = (slot + 1) & mask;
+            }
+            if (slots[slot] == 0) {
+                entries.push_back(value);
+                entry_bytes += value.size();
+                slots[slot] = static_cast<uint32_t>(entries.size());
+            }
+            codes[row] = slots[slot] - 1;
+        }
+        const auto width = static_cast<unsigned int>(std::bit_width(entries.size() > 1 ? entries.size() - 1 : 0));
+        const size_t dictionary_size = padded(sizeof(uint32_t) * (entries.size() + 2)) + padded(entry_bytes) +
+                                       packed_bytes(rows, width);
+        const size_t plain_size = padded(sizeof(uint32_t) * (rows + 1)) + padded(column.bytes.size());
+
+        if (dictionary_size < plain_size) {
+            chunk.encoding = column_encoding::DICTIONARY;
+            chunk.bit_width = static_cast<uint8_t>(width);
+            put(out, static_cast<uint32_t>(entries.size()));
+            uint32_t end = 0;
+            put(out, end);
+            for (const std::string_view entry : entries) {
+                end += static_cast<uint32_t>(entry.size());
+                put(out, end);
+            }
+            pad(out);
+            for (const std::string_view entry : entries) {
+                out += entry;
+            }
+            pad(out);
+            pack(out, codes, width);
+            return;
+        }
+        chunk.encoding = column_encoding::PLAIN;
+        put(out, uint32_t{0});
+        for (const uint32_t end : column.ends) {
+            put(out, end);
+        }
+        pad(out);
+        out += column.bytes;
+        pad(out);
+    }
+
+    /**
+     * Encodes a column chunk
+     * @param column Column buffer
+     * @param chunk Chunk metadata (encoding, bit width and null count are set)
+     * @return Bytes of the chunk
+     */
+    std::string encode_chunk(const column_buffer& column, column_chunk& chunk) {
+        std::string out;
+        chunk.null_count = column.nulls;
+        chunk.bit_width = 0;
+        if (column.nulls > 0) {
+            put_validity(out, column.valid);
+        }
+        switch (column.type) {
+            case column_type::INT64:
+                encode_integers(out, column, chunk);
+                break;
+            case column_type::DOUBLE:
+                chunk.encoding = column_encoding::PLAIN;
+                for (const double value : column.reals) {
+                    put(out, value);
+                }
+                break;
+            case column_type::BOOL: {
+                chunk.encoding = column_encoding::BIT_PACKED;
+                chunk.bit_width = 1;
+                put(out, int64_t{0});
+                pack(out, std::vector<uint64_t>(column.ints.begin(), column.ints.end()), 1);
+                break;
+            }
+            case column_type::COLORS: {
+                // Masks only when every value is written as the mask prints it ("WU", not "UW" or "W,U")
+                std::vector<uint64_t> masks(column.ends.size());
+                bool exact = true;
+                for (size_t row = 0; row < masks.size() && exact; row++) {
+                    if (column.valid[row] == 0) {
+                        continue;
+                    }
+                    const std::string_view value = column.text(row);
+                    const std::optional<uint8_t> mask = parse_colors(value);
+                    exact = mask && color_letters(*mask) == value;
+                    masks[row] = mask.value_or(0);
+                }
+                if (exact) {
+                    chunk.encoding = column_encoding::BIT_PACKED;
+                    chunk.bit_width = COLOR_BITS;
+                    put(out, int64_t{0});
+                    pack(out, masks, COLOR_BITS);
+                    break;
+                }
+                encode_strings(out, column, chunk);
+                break;
+            }
+            case column_type::STRING:
+                encode_strings(out, column, chunk);
+                break;
+        }
+        pad(out);
+        return out;
+    }
+
+    /**
+     * Reads a boolean cell stored either as a number or as text (True/False, yes/no, 1/0)
+     * @param stmt Statement positioned on a row
+     * @param column Column index
+     * @return Boolean value
+     */
+    bool cell_bool(sqlite3_stmt* stmt, const int column) {
+        const int type = sqlite3_column_type(stmt, column);
+        if (type == SQLITE_INTEGER || type == SQLITE_FLOAT) {
+            return sqlite3_column_double(stmt, column) != 0;
+        }
+        const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text != nullptr && (text[0] == 't' || text[0] == 'T' || text[0] == 'y' || text[0] == 'Y' ||
+                                   text[0] == '1');
+    }
+
+    /**
+     * Appends the current row of the cursor to a row group
+     * @param stmt Statement positioned on a row
+     * @param group Row group
+     */
+    void read_row(sqlite3_stmt* stmt, row_group& group) {
+        for (int i = 0; i < static_cast<int>(group.columns.size()); i++) {
+            column_buffer& column = group.columns[i];
+            const bool is_null = sqlite3_column_type(stmt, i) == SQLITE_NULL;
+            column.valid.push_back(is_null ? 0 : 1);
+            column.nulls += is_null ? 1 : 0;
+            switch (column.type) {
+                case column_type::INT64:
+                    column.ints.push_back(sqlite3_column_int64(stmt, i));
+                    break;
+                case column_type::BOOL:
+                    column.ints.push_back(!is_null && cell_bool(stmt, i) ? 1 : 0);
+                    break;
+                case column_type::DOUBLE:
+                    column.reals.push_back(sqlite3_column_double(stmt, i));
+                    break;
+                case column_type::STRING:
+                case column_type::COLORS: {
+                    const auto* text = static_cast<const char*>(sqlite3_column_blob(stmt, i));
+                    column.bytes.append(text != nullptr ? text : "", sqlite3_column_bytes(stmt, i));
+                    column.ends.push_back(static_cast<uint32_t>(column.bytes.size()));
+                    break;
+                }
+            }
+        }
+        group.rows++;
+    }
+}
+
+// Writer functions
+// ---------------------------------------------------------------------------------------------------------------------
+columnar_writer::columnar_writer(std::string file) : path(std::move(file)), tmp_path(path + ".tmp") {
+    out.open(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw export_error("Unable to create " + tmp_path);
+    }
+    write(MAGIC);
+}
+
+columnar_writer::~columnar_writer() {
+    if (out.is_open()) {
+        out.close();
+        std::error_code error;
+        fs::remove(tmp_path, error);
+    }
+}
+
+void columnar_writer::write(const std::string_view bytes) {
+    static constexpr char ZEROS[ALIGNMENT] = {};
+    const size_t padding = (ALIGNMENT - bytes.size() % ALIGNMENT) % ALIGNMENT;
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    out.write(ZEROS, static_cast<std::streamsize>(padding));
+    if (!out) {
+        throw export_error("Writing " + tmp_path);
+    }
+    offset += bytes.size() + padding;
+}
+
+void columnar_writer::write_table(sqlite3* DB, const std::string& table) {
+    sqlite3_stmt* stmt;
+    const std::string query = "SELECT * FROM \"" + table + "\";";
+    if (sqlite3_prepare_v2(DB, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw export_error("Reading " + table + " (" + sqlite3_errmsg(DB) + ")");
+    }
+
+    table_meta& meta = tables.emplace_back();
+    meta.name = table;
+    row_group group;
+    for (int i = 0; i < sqlite3_column_count(stmt); i++) {
+        meta.columns.emplace_back(sqlite3_column_name(stmt, i));
+        meta.types.push_back(column_type_of(meta.columns.back(), sqlite3_column_decltype(stmt, i)));
+        group.columns.emplace_back().type = meta.types.back();
+    }
+
+    // Row groups are encoded and written as soon as they fill, reusing the buffers of the previous group
+    const auto flush = [&]() {
+        for (const column_buffer& column : group.columns) {
+            column_chunk chunk{};
+            const std::string bytes = encode_chunk(column, chunk);
+            chunk.offset = offset;
+            chunk.bytes = bytes.size();
+            write(bytes);
+            meta.chunks.push_back(chunk);
+        }
+        meta.group_rows.push_back(group.rows);
+        meta.rows += group.rows;
+        group.clear();
+    };
+    int rc;
+    try {
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            read_row(stmt, group);
+            if (group.rows == ROW_GROUP_ROWS) {
+                flush();
+            }
+        }
+        if (group.rows > 0) {
+            flush();
+        }
+    } catch (...) {
+        sqlite3_finalize(stmt);
+        throw;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw export_error("Reading " + table + " (" + sqlite3_errmsg(DB) + ")");
+    }
+}
+
+std::vector<table_meta> columnar_writer::close() {
+    const uint64_t footer_offset = offset;
+    std::string footer;
+    put(footer, static_cast<uint32_t>(tables.size()));
+    for (const table_meta& table : tables) {
+        put_string(footer, table.name);
+        put(footer, static_cast<uint32_t>(table.columns.size()));
+        for (size_t i = 0; i < table.columns.size(); i++) {
+            put_string(footer, table.columns[i]);
+            put(footer, static_cast<uint8_t>(table.types[i]));
+        }
+        put(footer, table.rows);
+        put(footer, static_cast<uint32_t>(table.group_rows.size()));
+        for (size_t group = 0; group < table.group_rows.size(); group++) {
+            put(footer, table.group_rows[group]);
+            for (size_t i = 0; i < table.columns.size(); i++) {
+                const column_chunk& chunk = table.chunks[group * table.columns.size() + i];
+                put(footer, static_cast<uint8_t>(chunk.encoding));
+                put(footer, chunk.bit_width);
+                put(footer, chunk.offset);
+                put(footer, chunk.bytes);
+                put(footer, chunk.null_count);
+            }
+        }
+    }
+    write(footer);
+    std::string trailer;
+    put(trailer, footer_offset);
+    trailer += MAGIC;
+    write(trailer);
+    out.close();
+    if (!out) {
+        throw export_error("Writing " + tmp_path);
+    }
+
+    std::error_code error;
+    fs::rename(tmp_path, path, error);
+    if (error) {
+        throw export_error("Renaming " + tmp_path + " (" + error.message() + ")");
+    }
+    return std::move(tables);
+}
+
+// Export functions
+// ---------------------------------------------------------------------------------------------------------------------
+column_type column_type_of(const std::string_view column, const char* declared) {
+    if (std::ranges::find(COLOR_COLUMNS, column) != COLOR_COLUMNS.end()) {
+        return column_type::COLORS;
+    }
+    std::string type = declared != nullptr ? declared : "";
+    std::ranges::transform(type, type.begin(), [](const unsigned char c) {return std::toupper(c);});
+    // SQLite affinity rules, with booleans told apart from other integers
+    if (type.find("BOOL") != std::string::npos) {
+        return column_type::BOOL;
+    }
+    if (type.find("INT") != std::string::npos) {
+        return column_type::INT64;
+    }
+    if (type.find("REAL") != std::string::npos || type.find("FLOA") != std::string::npos ||
+        type.find("DOUB") != std::string::npos) {
+        return column_type::DOUBLE;
+    }
+    return column_type::STRING;
+}
+
+export_stats export_collection(sqlite3* DB, const std::string& path) {
+    export_stats stats;
+    const auto start = std::chrono::steady_clock::now();
+
+    columnar_writer writer(path);
+    for (const char* table : TABLES) {
+        writer.write_table(DB, table);
+    }
+    stats.tables = writer.close();
+
+    stats.bytes = fs::file_size(path);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats.peak_rss_kb = usage.ru_maxrss;
+    }
+    return stats;
+}
+
+std::string print_export_stats(const export_stats& stats) {
+    static constexpr std::array<const char*, 3> ENCODING_NAMES = {"plain", "bit-packed", "dictionary"};
+    std::ostringstream out;
+    const double mb = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+    const double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+    uint64_t rows = 0;
+    out << std::fixed << std::setprecision(2);
+    for (const table_meta& table : stats.tables) {
+        rows += table.rows;
+        out << table.name << ": " << table.rows << " rows in " << table.group_rows.size() << " row groups\n";
+        for (size_t i = 0; i < table.columns.size(); i++) {
+            uint64_t bytes = 0;
+            std::array<size_t, ENCODING_NAMES.size()> encodings{};
+            for (size_t group = 0; group < table.group_rows.size(); group++) {
+                const column_chunk& chunk = table.chunks[group * table.columns.size() + i];
+                bytes += chunk.bytes;
+                encodings[static_cast<size_t>(chunk.encoding)]++;
+            }
+            out << "  " << table.columns[i] << ": " << static_cast<double>(bytes) / 1024.0 << " KB";
+            for (size_t encoding = 0; encoding < encodings.size(); encoding++) {
+                if (encodings[encoding] > 0) {
+                    out << ", " << encodings[encoding] << " " << ENCODING_NAMES[encoding];
+                }
+            }
+            out << "\n";
+        }
+    }
+    out << "Exported " << rows << " rows (" << mb << " MB) in " << stats.seconds << " s: "
+        << std::setprecision(0) << static_cast<double>(rows) / seconds << " rows/s, " << std::setprecision(2)
+        << mb / seconds << " MB/s\n"
+        << "Peak memory: " << static_cast<double>(stats.peak_rss_kb) / 1024.0 << " MB\n";
+    return out.str();
+}
@@ -0,0 +1,159 @@
+/**
+ * Streaming columnar export of the collection header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace columnar_constants {
+    inline constexpr std::string_view MAGIC = {"FBLCOL1\0", 8}; ///< First and last bytes of an export file
+    inline constexpr size_t ALIGNMENT = 8; ///< Alignment of every buffer in the file
+    inline constexpr size_t ROW_GROUP_ROWS = 64 * 1024; ///< Rows buffered and written at once
+    inline constexpr std::array<const char*, 2> TABLES = {"raw_collection", "mtg_set"}; ///< Tables exported
+    inline constexpr std::array<std::string_view, 3> COLOR_COLUMNS = {"colors", "color_id",
+                                                                      "color_identity"}; ///< Columns of color letters
+    inline constexpr unsigned int COLOR_BITS = 5; ///< Bits of a bit-packed color mask
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Logical type of an exported column, from its declared SQL type
+ */
+enum class column_type : uint8_t {INT64, DOUBLE, BOOL, STRING, COLORS};
+
+/**
+ * Physical encoding of a column chunk
+ */
+enum class column_encoding : uint8_t {
+    PLAIN, ///< INT64/DOUBLE: 8 bytes per value; STRING/COLORS: u32 offsets (rows + 1), then the bytes
+    BIT_PACKED, ///< INT64/BOOL/COLORS: i64 base, then value - base in bit_width bits, LSB first in u64 words
+    DICTIONARY ///< STRING/COLORS: u32 entries, u32 offsets (entries + 1), bytes, then bit-packed entry indexes
+};
+
+/**
+ * Struct to hold the location of a column chunk in the file
+ */
+struct column_chunk {
+    column_encoding encoding; ///< Encoding of the values
+    uint8_t bit_width; ///< Bits per value of the bit-packed values or indexes
+    uint64_t offset; ///< Offset of the chunk (validity bitmap first, when there are nulls)
+    uint64_t bytes; ///< Length of the chunk
+    uint32_t null_count; ///< Null values
+};
+
+/**
+ * Struct to hold the metadata of an exported table
+ */
+struct table_meta {
+    std::string name; ///< Table name
+    std::vector<std::string> columns; ///< Column names
+    std::vector<column_type> types; ///< Column types
+    std::vector<uint32_t> group_rows; ///< Rows of every row group
+    std::vector<column_chunk> chunks; ///< Chunks by row group, then by column
+    uint64_t rows = 0; ///< Rows exported
+};
+
+/**
+ * Struct to hold the statistics of an export
+ */
+struct export_stats {
+    std::vector<table_meta> tables; ///< Exported tables
+    uint64_t bytes = 0; ///< Size of the file
+    double seconds = 0; ///< Wall time of the export
+    long peak_rss_kb = 0; ///< Peak resident memory of the process
+};
+
+/**
+ * Writes tables into a self-contained columnar file, one row group at a time while the SQLite cursor is read, so
+ * memory use depends on ROW_GROUP_ROWS and not on the size of the tables. Every buffer is 8-byte aligned, so a reader
+ * maps the file and uses the columns in place:
+ *   file:   MAGIC, column chunks, footer, footer offset (u64), MAGIC
+ *   chunk:  validity bitmap (1 bit per row, only when there are nulls), values in the encoding of the chunk, every
+ *           section padded to 8 bytes
+ *   footer: u32 tables; per table its name, u32 columns with their name and type (u8), u64 rows, u32 row groups;
+ *           per row group u32 rows and per column encoding (u8), bit width (u8), offset, bytes (u64) and nulls (u32)
+ * Strings in the footer are a u32 length and their bytes, and every integer is little-endian. Strings are dictionary
+ * encoded when that is smaller (names, set codes, rarities), and booleans, color masks and integers are bit-packed
+ * with the width their row group needs
+ */
+class columnar_writer {
+    std::string path; ///< Path of the export
+    std::string tmp_path; ///< Path written until the export is complete
+    std::ofstream out; ///< Export file
+    uint64_t offset = 0; ///< Bytes written
+    std::vector<table_meta> tables; ///< Tables written
+
+    /**
+     * Writes bytes, padded to ALIGNMENT
+     * @param bytes Bytes to write
+     * @throw export_error if the file cannot be written
+     */
+    void write(std::string_view bytes);
+public:
+    /**
+     * Starts an export (an export that is never closed is removed)
+     * @param file Path of the export (replaced once the export is closed)
+     * @throw export_error if the file cannot be created
+     */
+    explicit columnar_writer(std::string file);
+    ~columnar_writer();
+    columnar_writer(const columnar_writer&) = delete;
+    columnar_writer& operator=(const columnar_writer&) = delete;
+
+    /**
+     * Exports a table
+     * @param DB Sqlite database object
+     * @param table Table name
+     * @throw export_error if the table cannot be read or the file cannot be written
+     */
+    void write_table(sqlite3* DB, const std::string& table);
+
+    /**
+     * Writes the footer and moves the export into place
+     * @return Exported tables
+     * @throw export_error if the file cannot be written
+     */
+    std::vector<table_meta> close();
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Maps a declared SQL type onto a column type
+ * @param column Column name
+ * @param declared Declared type (nullptr for expressions)
+ * @return Column type
+ */
+column_type column_type_of(std::string_view column, const char* declared);
+
+/**
+ * Exports the collection tables (see TABLES)
+ * @param DB Sqlite database object
+ * @param path Path of the export
+ * @return Statistics of the export
+ * @throw export_error if a table cannot be read or the file cannot be written
+ */
+export_stats export_collection(sqlite3* DB, const std::string& path);
+
+/**
+ * Prints the statistics of an export
+ * @param stats Export statistics
+ * @return String with the tables, sizes and throughput
+ */
+std::string print_export_stats(const export_stats& stats);
+
+#endif //COLUMNAR_H
@@ -0,0 +1,112 @@
+#include <bit>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "csv.h"
+#include "exceptions.h"
+
+using namespace csv_constants;
+
+// CSV functions
+// ---------------------------------------------------------------------------------------------------------------------
+const char* find_field_end(const char* begin, const char* end, const char delimiter) {
+    const char* p = begin;
+
+#if defined(__AVX2__)
+    const __m256i delimiters = _mm256_set1_epi8(delimiter);
+    const __m256i newlines = _mm256_set1_epi8(NEWLINE);
+    for (; end - p >= 32; p += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(block, delimiters), _mm256_cmpeq_epi8(block, newlines));
+        if (const auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(matches)); mask != 0) {
+            return p + std::countr_zero(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i newlines = _mm_set1_epi8(NEWLINE);
+    for (; end - p >= 16; p += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(block, delimiters), _mm_cmpeq_epi8(block, newlines));
+        if (const auto mask = static_cast<unsigned int>(_mm_movemask_epi8(matches)); mask != 0) {
+            return p + std::countr_zero(mask);
+        }
+    }
+#endif
+
+    // Scalar tail (or whole buffer without SIMD support)
+    for (; p < end; p++) {
+        if (*p == delimiter || *p == NEWLINE) {
+            return p;
+        }
+    }
+    return end;
+}
+
+bool next_record(csv_cursor& cursor, std::vector<std::string_view>& fields) {
+    fields.clear();
+    if (cursor.pos >= cursor.end) {
+        return false;
+    }
+
+    while (true) {
+        char* start = cursor.pos;
+        const char* field_end;
+        if (start == cursor.end) {
+            // Trailing delimiter at the end of the buffer
+            fields.emplace_back();
+            break;
+        }
+        if (*start == QUOTE) {
+            // Quoted field: unescape doubled quotes in place, shifting the contents left
+            char* in = start + 1;
+            char* out = start + 1;
+            while (true) {
+                auto* quote = static_cast<char*>(std::memchr(in, QUOTE, cursor.end - in));
+                if (quote == nullptr) {
+                    const std::string err_msg = "Unterminated quoted field in record " + std::to_string(cursor.record + 1);
+                    throw csv_parse_error(err_msg);
+                }
+                if (out != in) {
+                    std::memmove(out, in, quote - in);
+                }
+                out += quote - in;
+                if (quote + 1 < cursor.end && quote[1] == QUOTE) {
+                    *out++ = QUOTE;
+                    in = quote + 2;
+                } else {
+                    in = quote + 1;
+                    break;
+                }
+            }
+            fields.emplace_back(start + 1, out - (start + 1));
+            field_end = find_field_end(in, cursor.end, cursor.delimiter);
+        } else {
+            field_end = find_field_end(start, cursor.end, cursor.delimiter);
+            size_t length = field_end - start;
+            // Strip the carriage return of CRLF line endings
+            if ((field_end == cursor.end || *field_end == NEWLINE) && length > 0 && start[length - 1] == '\r') {
+                length--;
+            }
+            fields.emplace_back(start, length);
+        }
+
+        if (field_end >= cursor.end) {
+            cursor.pos = cursor.end;
+            break;
+        }
+        cursor.pos = const_cast<char*>(field_end) + 1;
+        if (*field_end == NEWLINE) {
+            break;
+        }
+    }
+
+    cursor.record++;
+    return true;
+}
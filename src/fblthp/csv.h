@@ -0,0 +1,55 @@
+/**
+ * Zero-copy CSV parsing header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef CSV_H
+#define CSV_H
+#include <string_view>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace csv_constants {
+    inline constexpr char DELIMITER = ';'; ///< Field delimiter used by the collection exports
+    inline constexpr char QUOTE = '"'; ///< Quote character for fields containing delimiters or line breaks
+    inline constexpr char NEWLINE = '\n'; ///< Record terminator
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Cursor over a CSV buffer. The buffer must be writable because quoted fields with escaped quotes are unescaped in
+ * place (use a private mapping to keep the file on disk untouched).
+ */
+struct csv_cursor {
+    char* pos = nullptr; ///< Current position in the buffer
+    char* end = nullptr; ///< End of the buffer
+    char delimiter = csv_constants::DELIMITER; ///< Field delimiter
+    size_t record = 0; ///< Number of records read so far
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Finds the first delimiter or line break in a buffer, scanning 16 or 32 bytes at a time when SIMD is available
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param delimiter Field delimiter
+ * @return Pointer to the first delimiter or line break, end if none was found
+ */
+const char* find_field_end(const char* begin, const char* end, char delimiter);
+
+/**
+ * Reads the next record of a CSV buffer. The fields point into the buffer, so they are only valid while it is alive
+ * @param cursor Cursor over the buffer
+ * @param fields Fields of the record (cleared before reading)
+ * @return True if a record was read, false if the end of the buffer was reached
+ * @throw csv_parse_error if a quoted field is not terminated
+ */
+bool next_record(csv_cursor& cursor, std::vector<std::string_view>& fields);
+
+#endif //CSV_H
@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "decks.h"
+#include "exceptions.h"
+#include "hash.h"
+
+namespace fs = std::filesystem;
+using namespace deck_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    constexpr size_t INITIAL_SLOTS = 1024; ///< Slots of an empty table
+    constexpr std::string_view FACE_SEPARATOR = " // "; ///< Separator of the faces in a multi-faced card name
+
+    /**
+     * Struct to hold a line of a decklist
+     */
+    struct requirement {
+        std::string card; ///< Card as written in the decklist
+        std::string name; ///< Card name
+        std::string set; ///< Set code (empty for any set)
+        std::optional<bool> foil; ///< Finish (nullopt for any finish)
+        std::string key; ///< Copy key of the line
+        std::string name_key; ///< Copy key of the card name (any set and finish)
+        uint32_t quantity; ///< Copies needed
+    };
+
+    /**
+     * Struct to hold the copies a deck needs from a key: those of the lines with that key and of the more specific
+     * lines of the same card, whose copies are among the key's
+     */
+    struct key_demand {
+        std::string key; ///< Copy key
+        std::string card; ///< Card as shown in the report
+        std::string_view name_key; ///< Copy key of the card name (points into the line)
+        uint32_t needed = 0; ///< Copies needed
+    };
+
+    /**
+     * Struct to hold the scratch space of a worker, reused from one decklist to the next
+     */
+    struct deck_scratch {
+        std::vector<requirement> lines; ///< Lines of the decklist, repeated keys added up
+        std::unordered_map<std::string, size_t> line_index; ///< Lines by key
+        std::vector<key_demand> demand; ///< Demand by key, in decklist order
+        std::unordered_map<std::string, size_t> demand_index; ///< Demand by key
+        std::unordered_map<std::string_view, size_t> shortfall_index; ///< Missing cards of the deck by name key
+    };
+
+    /**
+     * Struct to hold the demand of the decks for every name entry, kept per worker
+     */
+    struct name_demand {
+        std::vector<uint64_t> needed; ///< Copies needed by entry id
+        std::vector<uint32_t> decks; ///< Decks needing the entry by entry id
+        std::vector<uint32_t> owned; ///< Copies owned by entry id (set for the entries with demand)
+        std::vector<size_t> last_deck; ///< Last deck (plus one) that needed the entry, to count every deck once
+    };
+
+    /**
+     * Struct to hold the state shared by the workers of a batch
+     */
+    struct batch {
+        const copy_table& table; ///< Copies owned
+        const std::vector<std::string>& paths; ///< Decklist paths
+        std::vector<deck_result> results; ///< Results by decklist
+        std::atomic<size_t> next = 0; ///< Next decklist to check
+        std::atomic<size_t> lines = 0; ///< Lines resolved
+        std::atomic<bool> failed = false; ///< Whether a worker failed
+        std::mutex error_mutex; ///< Guards error
+        std::exception_ptr error; ///< First failure
+
+        batch(const copy_table& owned, const std::vector<std::string>& decklists)
+            : table(owned), paths(decklists), results(decklists.size()) {}
+    };
+
+    /**
+     * Writes the key of a copy into a buffer, so building the table reuses one allocation (see copy_key)
+     * @param key Destination (overwritten)
+     * @param name Card name
+     * @param set Set code
+     * @param foil Finish
+     */
+    void write_key(std::string& key, const std::string_view name, const std::string_view set,
+                   const std::optional<bool> foil) {
+        key.clear();
+        bool space = false;
+        for (const char c : name) {
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                space = !key.empty();
+                continue;
+            }
+            if (space) {
+                key += ' ';
+                space = false;
+            }
+            key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        key += KEY_SEPARATOR;
+        for (const char c : set) {
+            key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        key += KEY_SEPARATOR;
+        key += foil ? (*foil ? '1' : '0') : ANY_FOIL;
+    }
+
+    /**
+     * Removes the leading and trailing whitespace of a string
+     * @param text Text
+     * @return Trimmed text
+     */
+    std::string_view trim(std::string_view text) {
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    /**
+     * Writes a card the way a decklist line specifies it
+     * @param name Card name
+     * @param set Set code (empty for any set)
+     * @param foil Finish (nullopt for any finish)
+     * @return Card with its set in parentheses and the foil marker
+     */
+    std::string card_label(const std::string_view name, const std::string_view set, const std::optional<bool> foil) {
+        std::string card(name);
+        if (!set.empty()) {
+            card += " (" + std::string(set) + ")";
+        }
+        if (foil) {
+            card += " " + std::string(FOIL_MARKER);
+        }
+        return card;
+    }
+
+    /**
+     * Parses a decklist line
+     * @param line Line without its end of line
+     * @param lines Destination of the requirement
+     * @param error Reason the line is malformed (left empty for valid lines)
+     * @return False if the line holds no card (blank, header or comment) or is malformed
+     */
+    bool parse_line(std::string_view line, std::vector<requirement>& lines, std::string_view& error) {
+        line = trim(line);
+        if (line.starts_with(SIDEBOARD_PREFIX)) {
+            line = trim(line.substr(SIDEBOARD_PREFIX.size()));
+        }
+        if (line.empty() || !std::isdigit(static_cast<unsigned char>(line.front()))) {
+            return false;
+        }
+
+        uint32_t quantity = 0;
+        const auto [end, ec] = std::from_chars(line.data(), line.data() + line.size(), quantity);
+        line.remove_prefix(end - line.data());
+        if (ec != std::errc() || quantity == 0) {
+            error = "invalid quantity";
+            return false;
+        }
+        if (!line.empty() && (line.front() == 'x' || line.front() == 'X')) {
+            line.remove_prefix(1);
+        }
+        if (line.empty() || !std::isspace(static_cast<unsigned char>(line.front()))) {
+            error = "missing space after the quantity";
+            return false;
+        }
+        line = trim(line);
+
+        std::optional<bool> foil;
+        if (line.ends_with(FOIL_MARKER)) {
+            foil = true;
+            line = trim(line.substr(0, line.size() - FOIL_MARKER.size()));
+        }
+        std::string_view set;
+        if (const size_t open = line.rfind(" ("); open != std::string_view::npos) {
+            if (const size_t close = line.find(')', open); close != std::string_view::npos) {
+                set = trim(line.substr(open + 2, close - open - 2));
+                line = trim(line.substr(0, open));
+            }
+        }
+        if (line.empty()) {
+            error = "missing card name";
+            return false;
+        }
+
+        requirement& entry = lines.emplace_back();
+        entry.card = card_label(line, set, foil);
+        entry.name = std::string(line);
+        entry.set = std::string(set);
+        entry.foil = foil;
+        entry.key = copy_key(line, set, foil);
+        entry.name_key = copy_key(line, "", std::nullopt);
+        entry.quantity = quantity;
+        return true;
+    }
+
+    /**
+     * Parses a decklist, adding up repeated cards
+     * @param path Decklist path
+     * @param lines Destination of the requirements (cleared first)
+     * @param index Scratch map of the requirements by key
+     * @throw deck_error if the file cannot be read or has a malformed line
+     */
+    void parse_decklist(const std::string& path, std::vector<requirement>& lines,
+                        std::unordered_map<std::string, size_t>& index) {
+        lines.clear();
+        index.clear();
+        std::ifstream file(path);
+        if (!file) {
+            throw deck_error("Unable to open " + path);
+        }
+        std::string line;
+        size_t number = 0;
+        while (std::getline(file, line)) {
+            number++;
+            std::string_view error;
+            if (!parse_line(line, lines, error)) {
+                if (!error.empty()) {
+                    throw deck_error(path + ":" + std::to_string(number) + " " + std::string(trim(line)) + " (" +
+                                     std::string(error) + ")");
+                }
+                continue;
+            }
+            const auto [existing, inserted] = index.try_emplace(lines.back().key, lines.size() - 1);
+            if (!inserted) {
+                lines[existing->second].quantity += lines.back().quantity;
+                lines.pop_back();
+            }
+        }
+    }
+
+    /**
+     * Checks the lines of a decklist against the copies owned. A line draws on its own key and on the less specific
+     * keys of its card (its set in any finish, its finish in any set, the name alone), so the lines of a card are
+     * added up on each of those keys: "4 Lightning Bolt" and "1 Lightning Bolt (M10)" need 5 copies of the name and 1
+     * of M10. A card misses the copies of its worst key
+     * @param table Copies owned
+     * @param scratch Scratch space holding the parsed lines
+     * @param result Result of the decklist
+     */
+    void check_deck(const copy_table& table, deck_scratch& scratch, deck_result& result) {
+        scratch.demand.clear();
+        scratch.demand_index.clear();
+        scratch.shortfall_index.clear();
+        for (const requirement& line : scratch.lines) {
+            result.cards += line.quantity;
+            for (const bool any_set : {false, true}) {
+                for (const bool any_foil : {false, true}) {
+                    if ((any_set && line.set.empty()) || (any_foil && !line.foil)) {
+                        continue; // Same key as a more specific one
+                    }
+                    const std::string_view set = any_set ? std::string_view() : std::string_view(line.set);
+                    const std::optional<bool> foil = any_foil ? std::nullopt : line.foil;
+                    std::string key = copy_key(line.name, set, foil);
+                    const auto [position, inserted] = scratch.demand_index.try_emplace(key, scratch.demand.size());
+                    if (inserted) {
+                        scratch.demand.push_back({std::move(key), card_label(line.name, set, foil), line.name_key});
+                    }
+                    scratch.demand[position->second].needed += line.quantity;
+                }
+            }
+        }
+
+        // Probe side of the join: every key looks its copies up in the table built from the collection
+        for (const key_demand& wanted : scratch.demand) {
+            const std::optional<copy_entry> entry = table.find(wanted.key);
+            const uint32_t owned = entry ? entry->quantity : 0;
+            if (owned >= wanted.needed) {
+                continue;
+            }
+            const auto [position, inserted] = scratch.shortfall_index.try_emplace(wanted.name_key,
+                                                                                  result.missing_cards.size());
+            if (inserted) {
+                result.missing_cards.push_back({wanted.card, wanted.needed, owned});
+            } else if (missing_card& worst = result.missing_cards[position->second];
+                       wanted.needed - owned > worst.needed - worst.owned) {
+                worst = {wanted.card, wanted.needed, owned};
+            }
+        }
+        for (const missing_card& card : result.missing_cards) {
+            result.missing += card.needed - card.owned;
+        }
+    }
+
+    /**
+     * Checks decklists until there are none left
+     * @param state Batch state
+     * @param demand Demand of the worker
+     */
+    void check_worker(batch& state, name_demand& demand) {
+        deck_scratch scratch;
+        size_t resolved = 0;
+        while (!state.failed.load(std::memory_order_relaxed)) {
+            const size_t i = state.next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= state.paths.size()) {
+                break;
+            }
+            try {
+                parse_decklist(state.paths[i], scratch.lines, scratch.line_index);
+            } catch (...) {
+                const std::lock_guard lock(state.error_mutex);
+                if (!state.error) {
+                    state.error = std::current_exception();
+                }
+                state.failed.store(true, std::memory_order_relaxed);
+                break;
+            }
+
+            deck_result& result = state.results[i];
+            result.name = state.paths[i];
+            check_deck(state.table, scratch, result);
+            for (const requirement& line : scratch.lines) {
+                if (const std::optional<copy_entry> name_entry = state.table.find(line.name_key)) {
+                    demand.needed[name_entry->id] += line.quantity;
+                    if (demand.last_deck[name_entry->id] != i + 1) {
+                        demand.last_deck[name_entry->id] = i + 1;
+                        demand.decks[name_entry->id]++;
+                    }
+                    demand.owned[name_entry->id] = name_entry->quantity;
+                }
+            }
+            resolved += scratch.lines.size();
+        }
+        state.lines.fetch_add(resolved, std::memory_order_relaxed);
+    }
+}
+
+// Table functions
+// ---------------------------------------------------------------------------------------------------------------------
+copy_table::copy_table(const collection_store& store) : slots(INITIAL_SLOTS, slot{0, 0, 0, 0}) {
+    std::string key;
+    for (size_t row = 0; row < store.size(); row++) {
+        const std::string& name = store.names.values[store.name[row]];
+        const std::string_view set = store.sets.values[store.set[row]];
+        const bool foil = store.foil[row] != 0;
+        const uint32_t copies = store.quantity[row];
+        const size_t face = name.find(FACE_SEPARATOR);
+        for (const std::string_view alias : {std::string_view(name), std::string_view(name).substr(0, face)}) {
+            for (const auto& [key_set, key_foil] : {std::pair<std::string_view, std::optional<bool>>{"", std::nullopt},
+                                                    {"", foil}, {set, std::nullopt}, {set, foil}}) {
+                write_key(key, alias, key_set, key_foil);
+                add(key, alias, copies);
+            }
+            if (face == std::string::npos) {
+                break;
+            }
+        }
+    }
+}
+
+size_t copy_table::probe(const std::string_view key, const uint64_t hash) const {
+    const auto tag = static_cast<uint32_t>(hash >> 32);
+    const size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    for (; slots[i].entry != 0; i = (i + 1) & mask) {
+        const slot& current = slots[i];
+        // Keys are NUL terminated in the arena, so a stored key that only starts with the key does not match
+        if (current.tag == tag && arena.compare(current.offset, key.size(), key) == 0 &&
+            arena[current.offset + key.size()] == '\0') {
+            break;
+        }
+    }
+    return i;
+}
+
+void copy_table::add(const std::string_view key, const std::string_view name, const uint32_t quantity) {
+    const uint64_t hash = xxh64(key);
+    slot& current = slots[probe(key, hash)];
+    if (current.entry != 0) {
+        current.quantity += quantity;
+        return;
+    }
+    current = {static_cast<uint32_t>(hash >> 32), static_cast<uint32_t>(offsets.size() + 1),
+               static_cast<uint32_t>(arena.size()), quantity};
+    offsets.push_back(current.offset);
+    arena.append(key).append(1, '\0').append(name).append(1, '\0');
+    if (offsets.size() * 2 > slots.size()) {
+        grow();
+    }
+}
+
+void copy_table::grow() {
+    std::vector<slot> old(slots.size() * 2, slot{0, 0, 0, 0});
+    old.swap(slots);
+    const size_t mask = slots.size() - 1;
+    for (const slot& moved : old) {
+        if (moved.entry == 0) {
+            continue;
+        }
+        size_t i = xxh64(arena.c_str() + moved.offset) & mask;
+        while (slots[i].entry != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = moved;
+    }
+}
+
+std::optional<copy_entry> copy_table::find(const std::string_view key) const {
+    const slot& found = slots[probe(key, xxh64(key))];
+    if (found.entry == 0) {
+        return std::nullopt;
+    }
+    return copy_entry{found.entry - 1, found.quantity};
+}
+
+std::string_view copy_table::name(const uint32_t id) const {
+    const char* key = arena.c_str() + offsets[id];
+    return key + std::strlen(key) + 1;
+}
+
+// Check functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string copy_key(const std::string_view name, const std::string_view set, const std::optional<bool> foil) {
+    std::string key;
+    write_key(key, name, set, foil);
+    return key;
+}
+
+std::vector<std::string> scan_decklists(const std::string& path) {
+    std::vector<std::string> paths;
+    if (fs::is_regular_file(path)) {
+        paths.push_back(path);
+    } else if (fs::is_directory(path)) {
+        for (const auto& entry : fs::directory_iterator(path)) {
+            if (entry.is_regular_file()) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::ranges::sort(paths);
+    } else {
+        throw deck_error("Unable to find " + path);
+    }
+    return paths;
+}
+
+deck_report check_decks(const copy_table& table, const std::vector<std::string>& paths, unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads = std::clamp(threads, 1u, static_cast<unsigned int>(std::max<size_t>(paths.size(), 1)));
+
+    batch state(table, paths);
+    std::vector<name_demand> demands(threads);
+    for (name_demand& demand : demands) {
+        demand.needed.assign(table.size(), 0);
+        demand.decks.assign(table.size(), 0);
+        demand.owned.assign(table.size(), 0);
+        demand.last_deck.assign(table.size(), 0);
+    }
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(threads);
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back(check_worker, std::ref(state), std::ref(demands[i]));
+        }
+    }
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+
+    // Merge the demand of the workers into the contention of every name
+    deck_report report;
+    report.lines = state.lines.load();
+    name_demand& total = demands.front();
+    for (size_t i = 1; i < demands.size(); i++) {
+        for (size_t entry = 0; entry < table.size(); entry++) {
+            total.needed[entry] += demands[i].needed[entry];
+            total.decks[entry] += demands[i].decks[entry];
+            total.owned[entry] = std::max(total.owned[entry], demands[i].owned[entry]);
+        }
+    }
+    for (uint32_t entry = 0; entry < table.size(); entry++) {
+        if (total.decks[entry] > 1 && total.owned[entry] > 0 && total.needed[entry] > total.owned[entry]) {
+            report.contended.push_back({std::string(table.name(entry)), total.owned[entry], total.needed[entry],
+                                        total.decks[entry]});
+        }
+    }
+    std::ranges::sort(report.contended, [](const contended_card& a, const contended_card& b) {
+        const uint64_t short_a = a.needed - a.owned;
+        const uint64_t short_b = b.needed - b.owned;
+        return short_a != short_b ? short_a > short_b : a.card < b.card;
+    });
+    report.decks = std::move(state.results);
+    return report;
+}
+
+std::string print_deck_report(const deck_report& report) {
+    std::ostringstream out;
+    size_t buildable = 0;
+    for (const deck_result& deck : report.decks) {
+        if (deck.missing == 0) {
+            buildable++;
+            out << "  " << deck.name << ": buildable (" << deck.cards << " cards)\n";
+            continue;
+        }
+        out << "  " << deck.name << ": missing " << deck.missing << " of " << deck.cards << " cards:";
+        const size_t shown = std::min(deck.missing_cards.size(), MISSING_SHOWN);
+        for (size_t i = 0; i < shown; i++) {
+            const missing_card& card = deck.missing_cards[i];
+            out << (i > 0 ? ", " : " ") << card.needed - card.owned << " " << card.card;
+        }
+        if (deck.missing_cards.size() > shown) {
+            out << " and " << deck.missing_cards.size() - shown << " more";
+        }
+        out << "\n";
+    }
+    if (!report.contended.empty()) {
+        out << "Contended cards (" << report.contended.size() << "):\n";
+        const size_t shown = std::min(report.contended.size(), CONTENTION_ROWS);
+        for (size_t i = 0; i < shown; i++) {
+            const contended_card& card = report.contended[i];
+            out << "  " << card.card << ": " << card.needed << " needed by " << card.decks << " decks, "
+                << card.owned << " owned\n";
+        }
+    }
+    out << report.decks.size() << " decks checked, " << buildable << " buildable\n";
+    return out.str();
+}
@@ -0,0 +1,189 @@
+/**
+ * Batch decklist availability checker header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef DECKS_H
+#define DECKS_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "collection.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace deck_constants {
+    inline constexpr char KEY_SEPARATOR = '\x1f'; ///< Separator of the name, set and finish of a copy key
+    inline constexpr char ANY_FOIL = '*'; ///< Finish of a key matching foil and non-foil copies
+    inline constexpr std::string_view FOIL_MARKER = "*F*"; ///< Suffix of a foil decklist line
+    inline constexpr std::string_view SIDEBOARD_PREFIX = "SB:"; ///< Prefix of a sideboard line in MTGO lists
+    inline constexpr size_t MISSING_SHOWN = 5; ///< Missing cards listed per deck
+    inline constexpr size_t CONTENTION_ROWS = 10; ///< Contended cards listed in a report
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold an entry of the copy table
+ */
+struct copy_entry {
+    uint32_t id; ///< Entry id (dense, from 0)
+    uint32_t quantity; ///< Copies owned
+};
+
+/**
+ * Open-addressing hash table of the copies owned, built once from the collection. Every row is counted under four
+ * keys (name; name and finish; name and set; name, set and finish) so a decklist line resolves with a single probe
+ * whatever it specifies, and multi-faced cards are also counted under their front face name. The slots are 16 bytes
+ * holding a hash tag, the entry id and the copies, and the keys live back to back in one arena, so a probe touches
+ * one slot and one key; linear probing at a load factor of at most one half keeps the probes short
+ */
+class copy_table {
+    /**
+     * Struct to hold a slot of the table
+     */
+    struct slot {
+        uint32_t tag; ///< High bits of the hash of the key
+        uint32_t entry; ///< Entry id plus one (0 for an empty slot)
+        uint32_t offset; ///< Offset of the key in the arena
+        uint32_t quantity; ///< Copies
+    };
+
+    std::vector<slot> slots; ///< Slots (a power of two)
+    std::string arena; ///< Keys, each followed by the card name as written in the collection (NUL terminated)
+    std::vector<uint32_t> offsets; ///< Arena offsets by entry id
+
+    /**
+     * Finds the slot of a key
+     * @param key Copy key
+     * @param hash Hash of the key
+     * @return Index of the slot holding the key, or of the empty slot ending its probe sequence
+     */
+    [[nodiscard]] size_t probe(std::string_view key, uint64_t hash) const;
+
+    /**
+     * Adds copies to a key, creating its entry if needed
+     * @param key Copy key
+     * @param name Card name
+     * @param quantity Copies
+     */
+    void add(std::string_view key, std::string_view name, uint32_t quantity);
+
+    /**
+     * Doubles the slots and reinserts the entries
+     */
+    void grow();
+public:
+    /**
+     * Builds the table from a collection
+     * @param store Collection store
+     */
+    explicit copy_table(const collection_store& store);
+
+    /**
+     * Looks up a key
+     * @param key Copy key (see copy_key)
+     * @return Entry, or nullopt if no copy matches
+     */
+    [[nodiscard]] std::optional<copy_entry> find(std::string_view key) const;
+
+    /**
+     * Card name of an entry
+     * @param id Entry id
+     * @return Name as written in the collection
+     */
+    [[nodiscard]] std::string_view name(uint32_t id) const;
+
+    /**
+     * Number of entries
+     * @return Distinct keys
+     */
+    [[nodiscard]] size_t size() const {return offsets.size();}
+};
+
+/**
+ * Struct to hold a card a deck cannot get from the collection
+ */
+struct missing_card {
+    std::string card; ///< Card as written in the decklist
+    uint32_t needed; ///< Copies the deck needs
+    uint32_t owned; ///< Copies owned
+};
+
+/**
+ * Struct to hold the result of a decklist
+ */
+struct deck_result {
+    std::string name; ///< Name of the decklist (its path)
+    uint32_t cards = 0; ///< Copies the deck needs
+    uint32_t missing = 0; ///< Copies that are not owned
+    std::vector<missing_card> missing_cards; ///< Cards with missing copies (the key they miss most copies of)
+};
+
+/**
+ * Struct to hold a card several decks compete for
+ */
+struct contended_card {
+    std::string card; ///< Card name
+    uint32_t owned; ///< Copies owned (any set and finish)
+    uint64_t needed; ///< Copies the decks need in total
+    uint32_t decks; ///< Decks needing it
+};
+
+/**
+ * Struct to hold the result of a batch of decklists
+ */
+struct deck_report {
+    std::vector<deck_result> decks; ///< Results in the order of the decklists
+    std::vector<contended_card> contended; ///< Cards needed by several decks beyond the copies owned, worst first
+    size_t lines = 0; ///< Decklist lines resolved
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Builds the key of a copy
+ * @param name Card name (case insensitive)
+ * @param set Set code (case insensitive, empty for any set)
+ * @param foil Finish (nullopt for any finish)
+ * @return Copy key
+ */
+std::string copy_key(std::string_view name, std::string_view set, std::optional<bool> foil);
+
+/**
+ * Lists the decklists of a path
+ * @param path Decklist file, or directory whose regular files are all decklists
+ * @return Paths of the decklists in lexicographic order
+ * @throw deck_error if the path does not exist
+ */
+std::vector<std::string> scan_decklists(const std::string& path);
+
+/**
+ * Checks decklists against the collection. Workers take the decklists one at a time, parse them and probe the table
+ * for every line (the hash join), keeping the demand of each card in a local array that is merged at the end.
+ * Decklist lines are "<quantity>[x] <name> [(<set>) [<number>]] [*F*]"; lines that do not start with a quantity
+ * (blank lines, section headers, comments) are skipped, and repeated cards are added up. The lines of a card are also
+ * added up on every less specific key they draw on, so a deck asking for the same card with and without a set or
+ * finish needs the copies of all its lines from the card name
+ * @param table Copies owned
+ * @param paths Decklist paths
+ * @param threads Number of workers (0 for the hardware concurrency)
+ * @return Report of the batch
+ * @throw deck_error if a decklist cannot be read or has a malformed line
+ */
+deck_report check_decks(const copy_table& table, const std::vector<std::string>& paths, unsigned int threads);
+
+/**
+ * Prints the report of a batch of decklists
+ * @param report Report
+ * @return String with one line per deck and the most contended cards
+ */
+std::string print_deck_report(const deck_report& report);
+
+#endif //DECKS_H
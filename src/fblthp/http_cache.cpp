@@ -0,0 +1,290 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "http_cache.h"
+#include "exceptions.h"
+
+namespace fs = std::filesystem;
+using namespace http_cache_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Struct to hold the fixed size header of a record, followed by the URL, the validators and the compressed body
+     */
+    struct record_header {
+        uint32_t url_size; ///< Size of the URL
+        uint32_t etag_size; ///< Size of the ETag
+        uint32_t last_modified_size; ///< Size of the Last-Modified value
+        uint32_t reserved; ///< Padding (zero)
+        int64_t fetched_at; ///< Unix time the response was last fetched or revalidated (rewritten in place)
+        uint64_t size; ///< Size of the body
+        uint64_t compressed_size; ///< Size of the compressed body
+    };
+
+    /**
+     * Current Unix time
+     * @return Seconds since the epoch
+     */
+    int64_t unix_now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Writes a whole buffer at an offset
+     * @param fd File descriptor
+     * @param data Buffer
+     * @param size Size of the buffer
+     * @param offset Offset in the file
+     * @return True if every byte was written
+     */
+    bool write_at(const int fd, const char* data, size_t size, off_t offset) {
+        while (size > 0) {
+            const ssize_t written = pwrite(fd, data, size, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += written;
+        }
+        return true;
+    }
+
+    /**
+     * Size of the record of an entry
+     * @param url URL of the entry
+     * @param entry Cached entry
+     * @return Size in bytes
+     */
+    uint64_t record_size(const std::string& url, const cache_entry& entry) {
+        return sizeof(record_header) + url.size() + entry.etag.size() + entry.last_modified.size() +
+               entry.compressed_size;
+    }
+}
+
+// HTTP cache
+// ---------------------------------------------------------------------------------------------------------------------
+http_cache::http_cache(std::string cache_path, const std::chrono::seconds time_to_live)
+    : path(std::move(cache_path)), ttl(time_to_live) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw cache_error("Unable to open " + path + " (" + std::strerror(errno) + ")");
+    }
+    try {
+        load();
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+http_cache::~http_cache() {
+    if (dead > 0 && dead * 2 > end) {
+        compact();
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void http_cache::load() {
+    mapping.emplace(path);
+    const char* data = mapping->data();
+    const uint64_t size = mapping->size();
+    if (size == 0) {
+        if (!write_at(fd, MAGIC, sizeof(MAGIC), 0)) {
+            throw cache_error("Unable to write " + path + " (" + std::strerror(errno) + ")");
+        }
+        end = sizeof(MAGIC);
+        return;
+    }
+    if (size < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        throw cache_error(path + " is not a cache file");
+    }
+
+    uint64_t offset = sizeof(MAGIC);
+    while (offset + sizeof(record_header) <= size) {
+        record_header header{};
+        std::memcpy(&header, data + offset, sizeof(header));
+        const uint64_t strings = static_cast<uint64_t>(header.url_size) + header.etag_size +
+                                 header.last_modified_size;
+        const uint64_t next = offset + sizeof(header) + strings + header.compressed_size;
+        if (next > size || next < offset) {
+            break; // Torn record
+        }
+
+        const char* cursor = data + offset + sizeof(header);
+        std::string url(cursor, header.url_size);
+        cursor += header.url_size;
+        cache_entry entry;
+        entry.etag.assign(cursor, header.etag_size);
+        cursor += header.etag_size;
+        entry.last_modified.assign(cursor, header.last_modified_size);
+        entry.fetched_at = header.fetched_at;
+        entry.record = offset;
+        entry.body = offset + sizeof(header) + strings;
+        entry.size = header.size;
+        entry.compressed_size = header.compressed_size;
+
+        if (const auto previous = index.find(url); previous != index.end()) {
+            dead += record_size(url, previous->second);
+            previous->second = std::move(entry);
+        } else {
+            index.emplace(std::move(url), std::move(entry));
+        }
+        offset = next;
+    }
+    end = offset;
+    if (end < size && ftruncate(fd, static_cast<off_t>(end)) != 0) {
+        throw cache_error("Unable to truncate " + path + " (" + std::strerror(errno) + ")");
+    }
+}
+
+void http_cache::remap(const uint64_t needed) {
+    if (!mapping || mapping->size() < needed) {
+        mapping.reset();
+        mapping.emplace(path);
+    }
+}
+
+void http_cache::compact() {
+    const std::string compact_path = path + COMPACT_SUFFIX;
+    try {
+        remap(end);
+        const int out = open(compact_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out < 0) {
+            return;
+        }
+        bool written = write_at(out, MAGIC, sizeof(MAGIC), 0);
+        uint64_t offset = sizeof(MAGIC);
+        for (auto& [url, entry] : index) {
+            if (!written) {
+                break;
+            }
+            const uint64_t size = record_size(url, entry);
+            written = write_at(out, mapping->data() + entry.record, size, static_cast<off_t>(offset));
+            entry.body = offset + (entry.body - entry.record);
+            entry.record = offset;
+            offset += size;
+        }
+        close(out);
+        std::error_code error;
+        if (written) {
+            fs::rename(compact_path, path, error);
+        }
+        if (!written || error) {
+            fs::remove(compact_path, error);
+        }
+    } catch (const std::exception&) {
+        std::error_code error;
+        fs::remove(compact_path, error); // The uncompacted file is still valid
+    }
+}
+
+const cache_entry* http_cache::find(const std::string& url) const {
+    const auto entry = index.find(url);
+    return entry != index.end() ? &entry->second : nullptr;
+}
+
+bool http_cache::fresh(const cache_entry& entry) const {
+    return unix_now() - entry.fetched_at < ttl.count();
+}
+
+bool http_cache::serve(const std::string& url, std::string& body, const bool revalidated) {
+    const auto found = index.find(url);
+    if (found == index.end()) {
+        return false;
+    }
+    cache_entry& entry = found->second;
+
+    remap(entry.body + entry.compressed_size);
+    body.resize(entry.size);
+    auto size = static_cast<uLongf>(entry.size);
+    const int rc = uncompress(reinterpret_cast<Bytef*>(body.data()), &size,
+                              reinterpret_cast<const Bytef*>(mapping->data() + entry.body),
+                              static_cast<uLong>(entry.compressed_size));
+    if (rc != Z_OK || size != entry.size) {
+        dead += record_size(url, entry);
+        index.erase(found);
+        body.clear();
+        return false;
+    }
+
+    if (revalidated) {
+        entry.fetched_at = unix_now();
+        write_at(fd, reinterpret_cast<const char*>(&entry.fetched_at), sizeof(entry.fetched_at),
+                 static_cast<off_t>(entry.record + offsetof(record_header, fetched_at)));
+        counters.revalidated++;
+    } else {
+        counters.hits++;
+    }
+    counters.bytes_served += body.size();
+    return true;
+}
+
+void http_cache::store(const std::string& url, const std::string& etag, const std::string& last_modified,
+                       const std::string& body) {
+    counters.misses++;
+    counters.bytes_fetched += body.size();
+
+    auto compressed_size = compressBound(static_cast<uLong>(body.size()));
+    std::vector<char> compressed(compressed_size);
+    if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+                  reinterpret_cast<const Bytef*>(body.data()), static_cast<uLong>(body.size()),
+                  COMPRESSION_LEVEL) != Z_OK) {
+        throw cache_error("Unable to compress the response of " + url);
+    }
+
+    cache_entry entry;
+    entry.etag = etag;
+    entry.last_modified = last_modified;
+    entry.fetched_at = unix_now();
+    entry.record = end;
+    entry.body = end + sizeof(record_header) + url.size() + etag.size() + last_modified.size();
+    entry.size = body.size();
+    entry.compressed_size = compressed_size;
+
+    const record_header header{static_cast<uint32_t>(url.size()), static_cast<uint32_t>(etag.size()),
+                               static_cast<uint32_t>(last_modified.size()), 0, entry.fetched_at, entry.size,
+                               entry.compressed_size};
+    std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record.append(url).append(etag).append(last_modified).append(compressed.data(), compressed_size);
+    if (!write_at(fd, record.data(), record.size(), static_cast<off_t>(end))) {
+        throw cache_error("Unable to write " + path + " (" + std::strerror(errno) + ")");
+    }
+    end += record.size();
+    counters.bytes_stored += compressed_size;
+
+    if (const auto previous = index.find(url); previous != index.end()) {
+        dead += record_size(url, previous->second);
+        previous->second = std::move(entry);
+    } else {
+        index.emplace(url, std::move(entry));
+    }
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string print_cache_stats(const cache_stats& stats) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Cache: " << stats.hits << " hits, " << stats.revalidated << " revalidated, " << stats.misses
+        << " misses; " << static_cast<double>(stats.bytes_served) / (1 << 20) << " MB served locally, "
+        << static_cast<double>(stats.bytes_fetched) / (1 << 20) << " MB fetched, "
+        << static_cast<double>(stats.bytes_stored) / (1 << 20) << " MB stored\n";
+    return out.str();
+}
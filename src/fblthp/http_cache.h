@@ -0,0 +1,150 @@
+/**
+ * Persistent HTTP response cache header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "mapped_file.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace http_cache_constants {
+    inline constexpr char MAGIC[8] = {'F', 'B', 'L', 'T', 'H', 'P', 'C', '1'}; ///< First bytes of a cache file
+    inline constexpr long long TTL_S = 86400; ///< Time a response is served without asking the server
+    inline constexpr int COMPRESSION_LEVEL = 6; ///< zlib level of the stored bodies
+    inline const char* COMPACT_SUFFIX = ".compact"; ///< Suffix of the cache file while it is compacted
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold a cached response
+ */
+struct cache_entry {
+    std::string etag; ///< ETag of the response (empty if the server sent none)
+    std::string last_modified; ///< Last-Modified of the response (empty if the server sent none)
+    int64_t fetched_at = 0; ///< Unix time the response was last fetched or revalidated
+    uint64_t record = 0; ///< Offset of the record in the cache file
+    uint64_t body = 0; ///< Offset of the compressed body in the cache file
+    uint64_t size = 0; ///< Size of the body
+    uint64_t compressed_size = 0; ///< Size of the compressed body
+};
+
+/**
+ * Struct to hold the counters of a cache
+ */
+struct cache_stats {
+    size_t hits = 0; ///< Responses served without a request
+    size_t revalidated = 0; ///< Responses served after a 304 Not Modified
+    size_t misses = 0; ///< Responses fetched in full
+    size_t bytes_served = 0; ///< Body bytes served from the cache (hits and revalidations)
+    size_t bytes_fetched = 0; ///< Body bytes received in full responses
+    size_t bytes_stored = 0; ///< Compressed bytes appended to the cache file
+};
+
+/**
+ * Persistent cache of HTTP responses keyed by URL. Bodies are zlib compressed and appended to a single log structured
+ * file, read back through a memory mapping; the index (URL to validators and body location) is rebuilt on open by
+ * walking the record headers, so no body is touched until it is served. Entries younger than the TTL are served
+ * without a request, older ones are revalidated with If-None-Match / If-Modified-Since. Superseded records are
+ * dropped by compacting the file when they make up more than half of it
+ */
+class http_cache {
+    std::string path; ///< Path of the cache file
+    int fd = -1; ///< Cache file opened for appending
+    uint64_t end = 0; ///< Size of the valid part of the file
+    uint64_t dead = 0; ///< Bytes taken by superseded records
+    std::chrono::seconds ttl; ///< Time an entry is fresh
+    std::unordered_map<std::string, cache_entry> index; ///< Entries by URL
+    std::optional<mapped_file> mapping; ///< Mapping of the file (remapped when a body past its end is read)
+    cache_stats counters; ///< Counters
+
+    /**
+     * Rebuilds the index from the record headers, truncating a torn record left by an interrupted write
+     */
+    void load();
+
+    /**
+     * Maps the file again if the current mapping does not reach an offset
+     * @param needed Offset the mapping must reach
+     */
+    void remap(uint64_t needed);
+
+    /**
+     * Rewrites the file with only the live records
+     */
+    void compact();
+public:
+    /**
+     * Opens (or creates) a cache file
+     * @param cache_path Path of the cache file
+     * @param time_to_live Time an entry is served without revalidation
+     * @throw cache_error if the file cannot be opened or is not a cache file
+     */
+    http_cache(std::string cache_path, std::chrono::seconds time_to_live);
+
+    /**
+     * Closes the cache, compacting it if most of it is superseded records
+     */
+    ~http_cache();
+    http_cache(const http_cache&) = delete;
+    http_cache& operator=(const http_cache&) = delete;
+
+    /**
+     * Looks up a URL
+     * @param url Requested URL
+     * @return Cached entry or nullptr
+     */
+    [[nodiscard]] const cache_entry* find(const std::string& url) const;
+
+    /**
+     * Checks whether an entry can be served without a request
+     * @param entry Cached entry
+     * @return True if the entry is younger than the TTL
+     */
+    [[nodiscard]] bool fresh(const cache_entry& entry) const;
+
+    /**
+     * Serves a cached body, counting it as a hit or a revalidation
+     * @param url Requested URL
+     * @param body Destination of the body
+     * @param revalidated Whether the server confirmed the entry (304), which also restarts its TTL
+     * @return True if the body was served, false if the entry is missing or damaged (it is dropped)
+     */
+    bool serve(const std::string& url, std::string& body, bool revalidated);
+
+    /**
+     * Stores a full response, superseding any previous entry of the URL
+     * @param url Requested URL
+     * @param etag ETag of the response
+     * @param last_modified Last-Modified of the response
+     * @param body Body of the response
+     * @throw cache_error if the record cannot be written
+     */
+    void store(const std::string& url, const std::string& etag, const std::string& last_modified,
+               const std::string& body);
+
+    /**
+     * Counters of the cache
+     * @return Counters so far
+     */
+    [[nodiscard]] const cache_stats& stats() const {return counters;}
+};
+
+/**
+ * Prints the counters of a cache
+ * @param stats Cache counters
+ * @return String with the hits, misses and bytes
+ */
+std::string print_cache_stats(const cache_stats& stats);
+
+#endif //HTTP_CACHE_H
@@ -0,0 +1,673 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "importer.h"
+#include "bounded_queue.h"
+#include "csv.h"
+#include "database.h"
+#include "exceptions.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+using namespace import_constants;
+
+// Helper types and functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * How a CSV field is bound to the insert statement
+     */
+    enum field_kind : unsigned char {NULL_FIELD, FALSE_FIELD, TRUE_FIELD, TEXT_FIELD};
+
+    /**
+     * Struct to hold a parsed CSV field
+     */
+    struct csv_field {
+        std::string_view text; ///< Field contents (points into the mapped file)
+        field_kind kind; ///< Binding of the field
+    };
+
+    /**
+     * Struct to hold the identity of a parsed row
+     */
+    struct row_fingerprint {
+        uint64_t key; ///< Hash of the key columns (and of the occurrence, for repeated keys in a file)
+        uint64_t fingerprint; ///< Hash of every field
+    };
+
+    /**
+     * Struct to hold a batch of parsed rows on its way from a parser worker to the writer
+     */
+    struct row_batch {
+        std::shared_ptr<const mapped_file> file; ///< Keeps the file mapped while its fields are in flight
+        size_t file_idx = 0; ///< Index of the file in the import list
+        uint64_t hash = 0; ///< Content hash of the file
+        std::string query; ///< Insert statement for the file header
+        std::string update; ///< Update statement for the file header
+        size_t columns = 0; ///< Number of fields per row
+        std::vector<csv_field> fields; ///< Row-major fields of the batch
+        std::vector<row_fingerprint> fingerprints; ///< Identity of every row of the batch
+        size_t rows = 0; ///< Number of rows in the batch
+        bool unchanged = false; ///< Whether the file matches its last import (the batch holds no rows)
+        bool last = false; ///< Whether this is the last batch of the file
+    };
+
+    /**
+     * Struct to hold a file imported before
+     */
+    struct known_file {
+        sqlite3_int64 id; ///< Id of the file in import_file
+        std::string hash; ///< Content hash of the file at its last import (empty if it never finished)
+    };
+
+    /**
+     * Struct to hold a row imported from a file before
+     */
+    struct stored_row {
+        sqlite3_int64 key; ///< Key of the row
+        uint64_t fingerprint; ///< Fingerprint of the row when it was imported
+        sqlite3_int64 row_id; ///< Collection row
+        bool seen = false; ///< Whether the file still has the row
+    };
+
+    /**
+     * Struct to hold the writer state of a file being synchronized
+     */
+    struct file_sync {
+        sqlite3_int64 id = 0; ///< Id of the file in import_file
+        std::vector<stored_row> rows; ///< Rows imported from the file before, sorted by key
+        size_t parsed = 0; ///< Rows parsed
+        size_t inserted = 0; ///< Rows inserted
+        size_t updated = 0; ///< Rows updated
+        size_t deleted = 0; ///< Rows deleted
+    };
+
+    typedef std::unique_ptr<row_batch> batch_ptr; ///< Queue element (nullptr marks a finished worker)
+
+    /**
+     * Struct to hold the state shared by the parser workers and the writer
+     */
+    struct pipeline {
+        const std::vector<std::string>& files; ///< Files to import
+        const std::vector<std::string>& paths; ///< Absolute paths of the files, as recorded in import_file
+        const std::unordered_map<std::string, known_file>& known; ///< Files imported before, by absolute path
+        bounded_queue<batch_ptr> queue{QUEUE_BATCHES}; ///< Parsed batches waiting to be written
+        std::atomic<size_t> next_file{0}; ///< Next file to be claimed by a worker
+        std::atomic<bool> failed{false}; ///< Set when any stage fails, so the workers stop early
+        std::mutex error_mutex; ///< Guards error
+        std::exception_ptr error; ///< First error raised by any stage
+
+        pipeline(const std::vector<std::string>& import_files, const std::vector<std::string>& import_paths,
+                 const std::unordered_map<std::string, known_file>& known_files)
+            : files(import_files), paths(import_paths), known(known_files) {}
+
+        /**
+         * Records an error, keeping only the first one
+         * @param e Error raised
+         */
+        void fail(const std::exception_ptr& e) {
+            const std::lock_guard lock(error_mutex);
+            if (!error) {
+                error = e;
+            }
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * Executes a transaction control statement
+     * @param DB Sqlite database object
+     * @param sql Statement to execute
+     * @throw import_error if the statement fails
+     */
+    void exec_or_throw(sqlite3* DB, const char* sql) {
+        if (sqlite3_exec(DB, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            const std::string err_msg = std::string(sql) + " (" + sqlite3_errmsg(DB) + ")";
+            throw import_error(err_msg);
+        }
+    }
+
+    /**
+     * Classifies a CSV field. Empty fields are bound as NULL and boolean literals as integers, the rest as text
+     * (column affinity takes care of numbers)
+     * @param field CSV field
+     * @return Parsed field
+     */
+    csv_field classify_field(const std::string_view field) {
+        if (field.empty()) {
+            return {field, NULL_FIELD};
+        }
+        auto iequals = [&field](const std::string_view literal) {
+            return std::ranges::equal(field, literal, [](const char a, const char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == b;
+            });
+        };
+        if (iequals("true")) {
+            return {field, TRUE_FIELD};
+        }
+        if (iequals("false")) {
+            return {field, FALSE_FIELD};
+        }
+        return {field, TEXT_FIELD};
+    }
+
+    /**
+     * Binds a parsed field to a statement parameter without copying it
+     * @param stmt Prepared statement
+     * @param idx Parameter index (1-based)
+     * @param field Parsed field (must outlive the statement step)
+     * @return Sqlite result code
+     */
+    int bind_field(sqlite3_stmt* stmt, const int idx, const csv_field& field) {
+        switch (field.kind) {
+            case NULL_FIELD:
+                return sqlite3_bind_null(stmt, idx);
+            case FALSE_FIELD:
+                return sqlite3_bind_int(stmt, idx, 0);
+            case TRUE_FIELD:
+                return sqlite3_bind_int(stmt, idx, 1);
+            default:
+                return sqlite3_bind_text(stmt, idx, field.text.data(), static_cast<int>(field.text.size()), SQLITE_STATIC);
+        }
+    }
+
+    /**
+     * Steps a statement that returns no rows and resets it
+     * @param DB Sqlite database object
+     * @param stmt Bound statement
+     * @param context Description of the statement for the error message
+     * @throw import_error if the statement fails
+     */
+    void step_or_throw(sqlite3* DB, sqlite3_stmt* stmt, const std::string& context) {
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            const std::string err_msg = "In " + context + " (" + sqlite3_errmsg(DB) + ")";
+            sqlite3_reset(stmt);
+            throw import_error(err_msg);
+        }
+        sqlite3_reset(stmt);
+    }
+
+    /**
+     * Reads the files imported before
+     * @param DB Sqlite database object
+     * @return Ids and content hashes by absolute path
+     * @throw import_error if the import state cannot be read
+     */
+    std::unordered_map<std::string, known_file> load_known_files(sqlite3* DB) {
+        std::unordered_map<std::string, known_file> known;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(DB, FILES_QUERY, -1, &stmt, nullptr) != SQLITE_OK) {
+            const std::string err_msg = std::string("Reading the import state (") + sqlite3_errmsg(DB) + ")";
+            throw import_error(err_msg);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            known.insert_or_assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                                   known_file{sqlite3_column_int64(stmt, 0),
+                                              reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))});
+        }
+        sqlite3_finalize(stmt);
+        return known;
+    }
+
+    /**
+     * Reads the rows imported from a file before (in key order, so they are looked up by binary search instead of
+     * being hashed again)
+     * @param DB Sqlite database object
+     * @param stmt Rows statement
+     * @param sync Writer state of the file
+     * @throw import_error if the rows cannot be read
+     */
+    void load_file_rows(sqlite3* DB, sqlite3_stmt* stmt, file_sync& sync) {
+        sqlite3_bind_int64(stmt, 1, sync.id);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            sync.rows.push_back({sqlite3_column_int64(stmt, 0), static_cast<uint64_t>(sqlite3_column_int64(stmt, 1)),
+                                 sqlite3_column_int64(stmt, 2)});
+        }
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            const std::string err_msg = std::string("Reading the imported rows (") + sqlite3_errmsg(DB) + ")";
+            throw import_error(err_msg);
+        }
+    }
+
+    /**
+     * Parses and validates one file, pushing its rows to the writer in batches
+     * @param state Pipeline state
+     * @param file_idx Index of the file in the import list
+     * @throw csv_parse_error if the file is malformed
+     */
+    void parse_file(pipeline& state, const size_t file_idx) {
+        const std::string& file_path = state.files[file_idx];
+        // Private writable mapping so quoted fields can be unescaped in place
+        auto file = std::make_shared<mapped_file>(file_path, true);
+        auto batch = std::make_unique<row_batch>();
+        batch->file = file;
+        batch->file_idx = file_idx;
+        batch->hash = xxh64(file->view()); // Before quoted fields are unescaped
+
+        // Unchanged since the last import: nothing to parse
+        if (const auto known = state.known.find(state.paths[file_idx]);
+            known != state.known.end() && known->second.hash == hash_to_hex(batch->hash)) {
+            batch->unchanged = true;
+            batch->last = true;
+            state.queue.push(std::move(batch));
+            return;
+        }
+
+        csv_cursor cursor{file->data(), file->data() + file->size()};
+        if (file->view().starts_with("\xEF\xBB\xBF")) {
+            cursor.pos += 3; // UTF-8 byte order mark
+        }
+
+        // Header
+        std::vector<std::string_view> fields;
+        std::vector<size_t> key_columns;
+        if (next_record(cursor, fields)) {
+            batch->query = build_insert_query(fields);
+            batch->update = build_update_query(fields);
+            batch->columns = fields.size();
+            batch->fields.reserve(batch->columns * BATCH_ROWS_PER_CHUNK);
+            batch->fingerprints.reserve(BATCH_ROWS_PER_CHUNK);
+            for (const char* key : KEY_COLUMNS) {
+                for (size_t i = 0; i < fields.size(); i++) {
+                    if (column_parse(fields[i]) == key) {
+                        key_columns.push_back(i);
+                        break;
+                    }
+                }
+            }
+        }
+        std::unordered_map<uint64_t, uint32_t> occurrences; // Keys repeated in the file get one key per occurrence
+        occurrences.reserve(file->size() / 64);
+        std::string key_bytes;
+
+        // Rows
+        const char* record_start = cursor.pos;
+        for (; batch->columns > 0 && next_record(cursor, fields); record_start = cursor.pos) {
+            if (fields.size() == 1 && fields[0].empty()) {
+                continue; // Blank line
+            }
+            if (fields.size() != batch->columns) {
+                const std::string err_msg = "In " + file_path + " (Record " + std::to_string(cursor.record) +
+                                            " has " + std::to_string(fields.size()) + " fields, expected " +
+                                            std::to_string(batch->columns) + ")";
+                throw csv_parse_error(err_msg);
+            }
+            const size_t first_field = batch->fields.size();
+            for (const auto& field : fields) {
+                batch->fields.push_back(classify_field(field));
+            }
+            // Key fields are packed behind their kind (so booleans match whatever their spelling) and hashed at once
+            const csv_field* row = batch->fields.data() + first_field;
+            key_bytes.clear();
+            for (const size_t column : key_columns) {
+                key_bytes += static_cast<char>(row[column].kind);
+                key_bytes += row[column].kind == TEXT_FIELD ? row[column].text : std::string_view();
+                key_bytes += '\x1F';
+            }
+            uint64_t key = xxh64(key_bytes);
+            if (const uint32_t occurrence = occurrences[key]++; occurrence > 0) {
+                key = xxh64(&occurrence, sizeof(occurrence), key);
+            }
+            // The fingerprint is the hash of the raw record, line break excluded
+            const char* record_end = cursor.pos;
+            while (record_end > record_start && (record_end[-1] == '\n' || record_end[-1] == '\r')) {
+                record_end--;
+            }
+            batch->fingerprints.push_back({key, xxh64(record_start, static_cast<size_t>(record_end - record_start))});
+
+            if (++batch->rows == BATCH_ROWS_PER_CHUNK) {
+                if (state.failed.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                auto next = std::make_unique<row_batch>();
+                next->file = file;
+                next->file_idx = file_idx;
+                next->hash = batch->hash;
+                next->query = batch->query;
+                next->update = batch->update;
+                next->columns = batch->columns;
+                next->fields.reserve(next->columns * BATCH_ROWS_PER_CHUNK);
+                next->fingerprints.reserve(BATCH_ROWS_PER_CHUNK);
+                state.queue.push(std::move(batch));
+                batch = std::move(next);
+            }
+        }
+
+        batch->last = true;
+        state.queue.push(std::move(batch));
+    }
+
+    /**
+     * Parser worker loop: claims files until there are none left, then signals the writer
+     * @param state Pipeline state
+     */
+    void parse_worker(pipeline& state) {
+        while (!state.failed.load(std::memory_order_relaxed)) {
+            const size_t file_idx = state.next_file.fetch_add(1, std::memory_order_relaxed);
+            if (file_idx >= state.files.size()) {
+                break;
+            }
+            try {
+                parse_file(state, file_idx);
+            } catch (...) {
+                state.fail(std::current_exception());
+            }
+        }
+        state.queue.push(nullptr);
+    }
+}
+
+// Import functions
+// ---------------------------------------------------------------------------------------------------------------------
+import_stats import_collection(sqlite3* DB, const std::string& path, unsigned int threads, const bool quiet) {
+    import_stats stats;
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::vector<std::string> files = scan_import_files(path);
+    std::vector<std::string> paths;
+    paths.reserve(files.size());
+    for (const auto& file : files) {
+        paths.push_back(fs::weakly_canonical(file).string()); // The same file under any spelling of the directory
+    }
+    const std::unordered_map<std::string, known_file> known = load_known_files(DB);
+    if (threads == 0) {
+        // One core is left for the writer
+        threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    threads = std::clamp(threads, 1u, static_cast<unsigned int>(std::max<size_t>(files.size(), 1)));
+
+    pipeline state(files, paths, known);
+    std::vector<std::jthread> workers;
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; i++) {
+        workers.emplace_back(parse_worker, std::ref(state));
+    }
+
+    // The calling thread is the single writer: it is the only one touching the database handle
+    statement_cache statements(DB);
+    std::unordered_map<size_t, file_sync> syncs; // Files with batches in flight
+    size_t pending_rows = 0;
+    bool in_transaction = false;
+    const auto begin_transaction = [&]() {
+        if (!in_transaction) {
+            exec_or_throw(DB, "BEGIN");
+            in_transaction = true;
+        }
+    };
+
+    // The rows of a collection filled before imports were tracked cannot be matched to their files (nothing recorded
+    // their keys), so the first tracked import replaces them instead of inserting every row a second time
+    if (known.empty() && !files.empty()) {
+        try {
+            begin_transaction();
+            step_or_throw(DB, statements.get(UNTRACKED_DELETE_QUERY), "Replacing the untracked collection rows");
+            const auto untracked = static_cast<size_t>(sqlite3_changes(DB));
+            stats.deleted += untracked;
+            if (!quiet && untracked > 0) {
+                std::cout << "Replacing " << untracked << " rows imported before imports were tracked" << std::endl;
+            }
+        } catch (...) {
+            state.fail(std::current_exception());
+        }
+    }
+
+    unsigned int finished_workers = 0;
+    while (finished_workers < threads) {
+        batch_ptr batch = state.queue.pop();
+        if (batch == nullptr) {
+            finished_workers++;
+            continue;
+        }
+        if (state.failed.load(std::memory_order_relaxed)) {
+            continue; // Keep draining so no worker stays blocked on a full queue
+        }
+
+        try {
+            const std::string& file_path = paths[batch->file_idx];
+            if (batch->unchanged) {
+                stats.unchanged_files++;
+                if (!quiet) {
+                    std::cout << "Unchanged " << files[batch->file_idx] << std::endl;
+                }
+                continue;
+            }
+
+            auto sync = syncs.find(batch->file_idx);
+            if (sync == syncs.end()) {
+                sync = syncs.try_emplace(batch->file_idx).first;
+                if (const auto previous = known.find(file_path); previous != known.end()) {
+                    sync->second.id = previous->second.id;
+                    load_file_rows(DB, statements.get(ROWS_QUERY), sync->second);
+                } else {
+                    // Registered before its rows, which refer to it. The hash stays empty until the file is done
+                    begin_transaction();
+                    sqlite3_stmt* insert = statements.get(FILE_INSERT_QUERY);
+                    sqlite3_bind_text(insert, 1, file_path.c_str(), static_cast<int>(file_path.size()), SQLITE_STATIC);
+                    step_or_throw(DB, insert, files[batch->file_idx]);
+                    sync->second.id = sqlite3_last_insert_rowid(DB);
+                }
+            }
+            file_sync& file = sync->second;
+
+            if (batch->rows > 0) {
+                begin_transaction();
+                sqlite3_stmt* insert = statements.get(batch->query);
+                sqlite3_stmt* update = statements.get(batch->update);
+                sqlite3_stmt* record = statements.get(ROW_UPSERT_QUERY);
+                sqlite3_bind_int64(record, 1, file.id);
+                for (size_t row = 0; row < batch->rows; row++) {
+                    const csv_field* fields = batch->fields.data() + row * batch->columns;
+                    const auto [key, fingerprint] = batch->fingerprints[row];
+                    sqlite3_int64 row_id = 0;
+                    const auto stored = std::ranges::lower_bound(file.rows, static_cast<sqlite3_int64>(key), {},
+                                                                 &stored_row::key);
+                    if (stored != file.rows.end() && stored->key == static_cast<sqlite3_int64>(key)) {
+                        stored->seen = true;
+                        if (stored->fingerprint == fingerprint) {
+                            continue;
+                        }
+                        for (size_t i = 0; i < batch->columns; i++) {
+                            bind_field(update, static_cast<int>(i) + 1, fields[i]);
+                        }
+                        sqlite3_bind_int64(update, static_cast<int>(batch->columns) + 1, stored->row_id);
+                        step_or_throw(DB, update, files[batch->file_idx]);
+                        if (sqlite3_changes(DB) > 0) {
+                            row_id = stored->row_id;
+                            file.updated++;
+                        }
+                    }
+                    if (row_id == 0) {
+                        // New row, or one deleted from the collection behind the importer's back
+                        for (size_t i = 0; i < batch->columns; i++) {
+                            bind_field(insert, static_cast<int>(i) + 1, fields[i]);
+                        }
+                        step_or_throw(DB, insert, files[batch->file_idx]);
+                        row_id = sqlite3_last_insert_rowid(DB);
+                        file.inserted++;
+                    }
+                    sqlite3_bind_int64(record, 2, static_cast<sqlite3_int64>(key));
+                    sqlite3_bind_int64(record, 3, static_cast<sqlite3_int64>(fingerprint));
+                    sqlite3_bind_int64(record, 4, row_id);
+                    step_or_throw(DB, record, files[batch->file_idx]);
+                }
+                // Bound fields point into the mapping, which may go away with the batch
+                sqlite3_clear_bindings(insert);
+                sqlite3_clear_bindings(update);
+                file.parsed += batch->rows;
+
+                pending_rows += batch->rows;
+                if (pending_rows >= BATCH_ROWS) {
+                    exec_or_throw(DB, "COMMIT");
+                    in_transaction = false;
+                    pending_rows = 0;
+                }
+            }
+            if (batch->last) {
+                // Rows the file no longer has, then the hash that lets the next import skip the file
+                begin_transaction();
+                sqlite3_stmt* erase = statements.get(COLLECTION_DELETE_QUERY);
+                sqlite3_stmt* forget = statements.get(ROW_DELETE_QUERY);
+                sqlite3_bind_int64(forget, 1, file.id);
+                for (const stored_row& stored : file.rows) {
+                    if (!stored.seen) {
+                        sqlite3_bind_int64(erase, 1, stored.row_id);
+                        step_or_throw(DB, erase, files[batch->file_idx]);
+                        sqlite3_bind_int64(forget, 2, stored.key);
+                        step_or_throw(DB, forget, files[batch->file_idx]);
+                        file.deleted++;
+                    }
+                }
+                const std::string hash = hash_to_hex(batch->hash);
+                sqlite3_stmt* done = statements.get(FILE_UPDATE_QUERY);
+                sqlite3_bind_text(done, 1, hash.c_str(), static_cast<int>(hash.size()), SQLITE_STATIC);
+                sqlite3_bind_int64(done, 2, static_cast<sqlite3_int64>(batch->file->size()));
+                sqlite3_bind_int64(done, 3, static_cast<sqlite3_int64>(file.parsed));
+                sqlite3_bind_int64(done, 4, file.id);
+                step_or_throw(DB, done, files[batch->file_idx]);
+
+                stats.files++;
+                stats.rows += file.parsed;
+                stats.inserted += file.inserted;
+                stats.updated += file.updated;
+                stats.deleted += file.deleted;
+                stats.bytes += batch->file->size();
+                if (!quiet) {
+                    std::cout << "Imported " << files[batch->file_idx] << " (" << file.parsed << " rows: "
+                              << file.inserted << " inserted, " << file.updated << " updated, " << file.deleted
+                              << " deleted)" << std::endl;
+                }
+                syncs.erase(sync);
+            }
+        } catch (...) {
+            state.fail(std::current_exception());
+        }
+    }
+    workers.clear(); // Join
+
+    // Files imported from this directory before that are gone now
+    try {
+        if (!state.error && fs::is_directory(path)) {
+            const std::string root = fs::weakly_canonical(path).string() + "/";
+            const std::unordered_set<std::string> present(paths.begin(), paths.end());
+            for (const auto& [known_path, previous] : known) {
+                if (!known_path.starts_with(root) || present.contains(known_path)) {
+                    continue;
+                }
+                begin_transaction();
+                size_t deleted = 0;
+                for (size_t i = 0; i < std::size(FILE_REMOVE_QUERIES); i++) {
+                    sqlite3_stmt* stmt = statements.get(FILE_REMOVE_QUERIES[i]);
+                    sqlite3_bind_int64(stmt, 1, previous.id);
+                    step_or_throw(DB, stmt, known_path);
+                    if (i == 0) {
+                        deleted = static_cast<size_t>(sqlite3_changes(DB));
+                    }
+                }
+                stats.removed_files++;
+                stats.deleted += deleted;
+                if (!quiet) {
+                    std::cout << "Removed " << known_path << " (" << deleted << " rows deleted)" << std::endl;
+                }
+            }
+        }
+    } catch (...) {
+        state.fail(std::current_exception());
+    }
+
+    if (state.error) {
+        if (in_transaction) {
+            sqlite3_exec(DB, "ROLLBACK", nullptr, nullptr, nullptr);
+        }
+        std::rethrow_exception(state.error);
+    }
+    if (in_transaction) {
+        exec_or_throw(DB, "COMMIT");
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+std::string print_import_stats(const import_stats& stats) {
+    const double seconds = std::max(stats.seconds, 1e-9);
+    const double megabytes = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+
+    std::ostringstream report;
+    report << std::fixed << "Imported " << stats.rows << " rows from " << stats.files << " files ("
+           << std::setprecision(2) << megabytes << " MB) in " << std::setprecision(3) << stats.seconds << " s: "
+           << std::setprecision(0) << static_cast<double>(stats.rows) / seconds << " rows/s, "
+           << std::setprecision(2) << megabytes / seconds << " MB/s\n"
+           << "  " << stats.inserted << " inserted, " << stats.updated << " updated, " << stats.deleted
+           << " deleted, " << stats.unchanged_files << " files unchanged, " << stats.removed_files
+           << " files removed\n";
+    return report.str();
+}
+
+std::vector<std::string> scan_import_files(const std::string& path) {
+    std::vector<std::string> files;
+    if (fs::exists(path) && fs::is_directory(path)) {
+        for (const auto& entry : fs::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == EXTENSION) {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    std::ranges::sort(files);
+
+    return files;
+}
+
+std::string column_parse(const std::string_view header) {
+    std::string column;
+    column.reserve(header.size() + 2);
+    for (const char c : header) {
+        column += c == ' ' ? '_' : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (column == "set") {
+        column = "\"set\"";
+    }
+
+    return column;
+}
+
+std::string build_insert_query(const std::vector<std::string_view>& header) {
+    std::string columns;
+    std::string values;
+    for (const auto& field : header) {
+        if (!columns.empty()) {
+            columns += ", ";
+            values += ", ";
+        }
+        columns += column_parse(field);
+        values += "?";
+    }
+
+    return std::string("INSERT INTO ") + TABLE + " (" + columns + ") VALUES (" + values + ");";
+}
+
+std::string build_update_query(const std::vector<std::string_view>& header) {
+    std::string assignments;
+    for (const auto& field : header) {
+        if (!assignments.empty()) {
+            assignments += ", ";
+        }
+        assignments += column_parse(field) + " = ?";
+    }
+
+    return std::string("UPDATE ") + TABLE + " SET " + assignments + " WHERE _id = ?;";
+}
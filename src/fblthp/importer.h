@@ -0,0 +1,120 @@
+/**
+ * Collection importer header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.4
+ */
+
+#ifndef IMPORTER_H
+#define IMPORTER_H
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace import_constants {
+    inline const char* TABLE = "raw_collection"; ///< Table the collection is imported into
+    inline const char* EXTENSION = ".csv"; ///< Extension of the collection exports
+    inline constexpr size_t BATCH_ROWS = 100000; ///< Rows inserted per transaction
+    inline constexpr size_t BATCH_ROWS_PER_CHUNK = 8192; ///< Rows handed from a parser worker to the writer at once
+    inline constexpr size_t QUEUE_BATCHES = 64; ///< Chunks waiting for the writer before the parsers block
+    inline const char* KEY_COLUMNS[] = {"name", "\"set\"", "number", "foil"}; ///< Columns identifying a row
+    inline const char* FILES_QUERY = "SELECT _id, path, hash FROM import_file;"; ///< SQL statement reading the files
+    inline const char* FILE_INSERT_QUERY = "INSERT INTO import_file (path, hash, size, rows) "
+                                           "VALUES (?, '', 0, 0);"; ///< SQL statement registering a new file
+    inline const char* FILE_UPDATE_QUERY = "UPDATE import_file SET hash = ?, size = ?, rows = ?, _imported_at = "
+                                           "CURRENT_TIMESTAMP WHERE _id = ?;"; ///< SQL statement recording a file
+    inline const char* ROWS_QUERY = "SELECT key, fingerprint, row_id FROM import_row "
+                                    "WHERE file = ? ORDER BY key;"; ///< SQL statement reading the rows of a file
+    inline const char* ROW_UPSERT_QUERY = "INSERT OR REPLACE INTO import_row (file, key, fingerprint, row_id) "
+                                          "VALUES (?, ?, ?, ?);"; ///< SQL statement recording an imported row
+    inline const char* ROW_DELETE_QUERY = "DELETE FROM import_row "
+                                          "WHERE file = ? AND key = ?;"; ///< SQL statement forgetting an imported row
+    inline const char* COLLECTION_DELETE_QUERY = "DELETE FROM raw_collection "
+                                                 "WHERE _id = ?;"; ///< SQL statement deleting a collection row
+    inline const char* UNTRACKED_DELETE_QUERY = "DELETE FROM raw_collection WHERE _id NOT IN (SELECT row_id "
+                                                "FROM import_row);"; ///< SQL statement deleting untracked rows
+    inline const char* FILE_REMOVE_QUERIES[] = {
+        "DELETE FROM raw_collection WHERE _id IN (SELECT row_id FROM import_row WHERE file = ?);",
+        "DELETE FROM import_row WHERE file = ?;",
+        "DELETE FROM import_file WHERE _id = ?;"
+    }; ///< SQL statements removing a file gone from the directory (the first one deletes its collection rows)
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the statistics of an import
+ */
+struct import_stats {
+    size_t files = 0; ///< Number of files imported
+    size_t unchanged_files = 0; ///< Number of files skipped because they match their last import
+    size_t removed_files = 0; ///< Number of files gone from the directory since their last import
+    size_t rows = 0; ///< Number of rows parsed
+    size_t inserted = 0; ///< Number of rows inserted
+    size_t updated = 0; ///< Number of rows updated
+    size_t deleted = 0; ///< Number of rows deleted
+    size_t bytes = 0; ///< Number of bytes parsed
+    double seconds = 0; ///< Wall time of the import
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Imports every CSV file found (recursively) in a directory into the collection table. Files are parsed and validated
+ * concurrently by a pool of workers, which hand row chunks through a bounded lock-free queue to the calling thread,
+ * the only one writing to the database.
+ * The import is incremental: files whose content hash matches their last import are skipped, and the rows of changed
+ * files are matched by key (name, set, number and foil) against the rows imported from them before, so only new rows
+ * are inserted, rows with a different fingerprint (hash of every field, last_modified included) updated and missing
+ * rows deleted. Files gone from the directory lose their rows. The first import into a collection filled before
+ * imports were tracked (no import_file rows yet) replaces the untracked rows instead of adding the files next to them
+ * @param DB Sqlite database object
+ * @param path Path of the directory
+ * @param threads Number of parser workers (0 to use one per available core minus the writer)
+ * @param quiet Whether to skip the line printed for every file
+ * @return Statistics of the import
+ * @throw import_error if a file cannot be inserted
+ * @throw csv_parse_error if a file is malformed
+ */
+import_stats import_collection(sqlite3* DB, const std::string& path, unsigned int threads = 0, bool quiet = false);
+
+/**
+ * Prints the statistics of an import
+ * @param stats Import statistics
+ * @return String with the throughput report
+ */
+std::string print_import_stats(const import_stats& stats);
+
+/**
+ * Retrieves the CSV files found (recursively) in a directory
+ * @param path Path of the directory
+ * @return Sorted list of CSV file paths
+ */
+std::vector<std::string> scan_import_files(const std::string& path);
+
+/**
+ * Converts a CSV header into a collection column name (lowercase, underscores instead of spaces, quoted "set")
+ * @param header CSV header
+ * @return Column name
+ */
+std::string column_parse(std::string_view header);
+
+/**
+ * Builds the insert statement for a CSV header
+ * @param header Fields of the CSV header
+ * @return SQL insert statement with one parameter per field
+ */
+std::string build_insert_query(const std::vector<std::string_view>& header);
+
+/**
+ * Builds the update statement for a CSV header
+ * @param header Fields of the CSV header
+ * @return SQL update statement with one parameter per field followed by the _id of the row
+ */
+std::string build_update_query(const std::vector<std::string_view>& header);
+
+#endif //IMPORTER_H
@@ -1,3 +1,409 @@
-int main() {
-    exit EXIT_SUCCESS;
-}
\ No newline at end of file
+/**
+ * Collection manager for the fblthp archive
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.13
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sqlite3.h>
+#include <string.h>
+#include <map>
+#include <cstdlib>
+#include <optional>
+#include <fstream>
+
+#include "importer.h"
+#include "bulk.h"
+#include "scryfall.h"
+#include "audit_log.h"
+#include "http_cache.h"
+#include "assets.h"
+#include "collection.h"
+#include "trigram.h"
+#include "prices.h"
+#include "decks.h"
+#include "columnar.h"
+#include "server.h"
+#include "database.h"
+#include "profiler.h"
+#include "exceptions.h"
+#include "env.h"
+
+const std::map<std::string, std::string> DEFAULT_ENV = {
+    {"FBLTHP_DB", "archive.db"},
+    {"FBLTHP_DB_PROFILE", "auto"},
+    {"FBLTHP_TRACE", ""},
+    {"FBLTHP_IMPORT_THREADS", "0"},
+    {"FBLTHP_SCRYFALL_URL", scryfall_constants::BASE_URL},
+    {"FBLTHP_SCRYFALL_RATE", "10"},
+    {"FBLTHP_SCRYFALL_BURST", "1"},
+    {"FBLTHP_SCRYFALL_CONNECTIONS", "8"},
+    {"FBLTHP_CACHE", "scryfall.cache"},
+    {"FBLTHP_CACHE_TTL", "86400"},
+    {"FBLTHP_ASSETS", "data"},
+    {"FBLTHP_ASSET_TRANSFERS", "16"},
+    {"FBLTHP_ASSET_QUOTA_MB", "1024"},
+    {"FBLTHP_PRICES", "prices"},
+    {"FBLTHP_PRICE_DAY", ""},
+    {"FBLTHP_PRICE_CURRENCY", "usd"},
+    {"FBLTHP_DECK_THREADS", "0"},
+    {"FBLTHP_SERVE_READERS", "0"}
+}; ///< Default environment variables
+const char* HELP_MESSAGE =
+    "fblthp <command> [argument] [options]\n"
+    "Commands:\n"
+    "  import <directory>\tImport the collection CSV files found in <directory>\n"
+    "  ingest <file>\t\tIngest a Scryfall bulk-data card dump\n"
+    "  fetch <endpoints>\tFetch comma separated Scryfall endpoints concurrently, following their pages\n"
+    "  assets <source>\tMirror the set icons (sets) or the <url> <name> lines of a manifest file\n"
+    "  query <filter>\tCount the copies matching comma separated predicates by set (rarity=<CURMSB>,\n"
+    "\t\t\tfoil=<true|false>, identity=<WUBRG>, colors=<WUBRG>, set=<code>)\n"
+    "  search <name>\t\tFind card and set names by partial or misspelled name\n"
+    "  value <days>\t\tShow the value of the collection over the last <days> days of recorded prices\n"
+    "  decks <path>\t\tCheck which decklists (a file, or every file of a directory) the collection can build\n"
+    "  export <file>\t\tExport the collection and set tables into a memory-mappable columnar file\n"
+    "  serve <socket>\tKeep the collection resident and answer JSON line requests on the Unix socket <socket>\n"
+    "\t\t\t(ping, query, search, owned, printings, card, stats) until interrupted\n"
+    "Options:\n"
+    "  -h, --help\t\tShow this help message\n"
+    "  -e, --environment\tUse custom environment\n"
+    "Arguments for environment:\n"
+    "  <file>\t\tPath to environment file\n"; ///< Help message
+enum OPTIONS {HELP, ENVIRONMENT, IMPORT, INGEST, FETCH, ASSETS, QUERY, SEARCH, VALUE, DECKS, EXPORT,
+              SERVE}; ///< Collection manager commands and options
+
+bool str_eq(const char* str1, const char* str2) {return strcmp(str1, str2) == 0;} ///< Compare if two strings are equal
+int get_option(const char* argument); ///< Check if an argument is an option and returns the option or -1 if false
+scryfall_options scryfall_options_from_env(); ///< Build the Scryfall client settings from the environment
+
+int main(int argc, const char* argv[]) {
+    // Parse command line arguments
+    if (argc < 2) {
+        std::cout << HELP_MESSAGE;
+        return EXIT_FAILURE;
+    }
+
+    std::map<int, std::string> commands;
+    for (int i = 1; i < argc; i++) {
+        const int option = get_option(argv[i]);
+        if (option == HELP) {
+            commands.insert({option, ""});
+        } else if (option == ENVIRONMENT || option == IMPORT || option == INGEST || option == FETCH ||
+                   option == ASSETS || option == QUERY || option == SEARCH || option == VALUE ||
+                   option == DECKS || option == EXPORT || option == SERVE) {
+            if (++i >= argc) { // Next argument
+                std::cout << "Error: Missing argument" << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (!commands.insert({option, argv[i]}).second) {
+                std::cout << "Error: Duplicate option" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            std::cout << "Error: Invalid argument: " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Execute help if present and exit
+    if (commands.contains(HELP)) {
+        std::cout << HELP_MESSAGE;
+        return EXIT_SUCCESS;
+    }
+
+    // Execute environment
+    std::string env_file;
+    if (const auto env = commands.find(ENVIRONMENT); env != commands.end()) {
+        env_file = env->second;
+        commands.erase(env);
+    }
+    load_env(env_file, DEFAULT_ENV);
+
+    // Check only 1 command and get command
+    if (commands.size() > 1) {
+        std::cout << "Error: Too many commands" << std::endl;
+        return EXIT_FAILURE;
+    } else if (commands.empty()) {
+        std::cout << "Error: No command provided" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const auto command = commands.begin();
+    const int option = command->first;
+    const std::string argument = command->second;
+
+    // Profile the statements of every connection when requested (reported when main returns)
+    const profiler_session profiling(std::getenv("FBLTHP_TRACE"));
+
+    // Open the database, tuned for bulk loads when importing and for readers when serving unless a profile is set
+    const std::string profile_name = std::getenv("FBLTHP_DB_PROFILE");
+    const std::optional<pragma_profile> profile =
+        profile_name != "auto" ? find_profile(profile_name)
+                               : option == IMPORT || option == INGEST ? database_profiles::BULK_LOAD
+                               : option == SERVE ? database_profiles::SERVING
+                                                 : database_profiles::DEFAULT;
+    if (!profile) {
+        std::cout << "Error: Unknown database profile " << profile_name << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::optional<db_connection> connection;
+    try {
+        connection.emplace(std::getenv("FBLTHP_DB"), *profile);
+    } catch (const database_error& e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    sqlite3* DB = connection->get();
+
+    // Perform the requested command
+    try {
+        switch (option) {
+            case IMPORT: {
+                const auto threads = static_cast<unsigned int>(std::stoul(std::getenv("FBLTHP_IMPORT_THREADS")));
+                std::cout << print_import_stats(import_collection(DB, argument, threads));
+                break;
+            }
+            case INGEST: {
+                std::optional<price_store> prices;
+                if (const std::string prices_path = std::getenv("FBLTHP_PRICES"); !prices_path.empty()) {
+                    prices.emplace(prices_path);
+                }
+                const int32_t day = parse_day(std::getenv("FBLTHP_PRICE_DAY"));
+                std::cout << print_ingest_stats(ingest_bulk_cards(DB, argument, prices ? &*prices : nullptr, day));
+                if (prices) {
+                    prices->flush();
+                    std::cout << print_price_stats(prices->stats());
+                }
+                break;
+            }
+            case FETCH:
+            case ASSETS: {
+                std::optional<http_cache> cache;
+                if (const std::string cache_path = std::getenv("FBLTHP_CACHE"); !cache_path.empty()) {
+                    cache.emplace(cache_path, std::chrono::seconds(std::stoll(std::getenv("FBLTHP_CACHE_TTL"))));
+                }
+                scryfall_options options = scryfall_options_from_env();
+                if (option == ASSETS) {
+                    options.max_connections = std::stol(std::getenv("FBLTHP_ASSET_TRANSFERS"));
+                }
+                scryfall_client client(options);
+                client.set_cache(cache ? &*cache : nullptr);
+                audit_log history(std::getenv("FBLTHP_DB"));
+                client.set_observer([&history, headers = scryfall_client::request_headers()]
+                                    (const scryfall_response& response) {
+                    history.record({response.url, headers, response.status, response.error, ""});
+                });
+                bool failed = false;
+                const auto on_done = [&failed](const page_summary& summary) {
+                    failed = failed || !summary.error.empty();
+                    std::cout << print_page_summary(summary);
+                };
+                std::optional<asset_store> store;
+                if (option == ASSETS) {
+                    store.emplace(std::getenv("FBLTHP_ASSETS"),
+                                  std::stoull(std::getenv("FBLTHP_ASSET_QUOTA_MB")) << 20);
+                    if (argument == asset_constants::SETS_SOURCE) {
+                        fetch_all_pages(client, argument, [&client, &store](const nlohmann::json& page) {
+                            for (const auto& set : page.value("data", nlohmann::json::array())) {
+                                const std::string code = set.value("code", "");
+                                const std::string icon = set.value("icon_svg_uri", "");
+                                if (!code.empty() && !icon.empty()) {
+                                    store->fetch(client, icon, code + "/icon.svg");
+                                }
+                            }
+                        }, on_done);
+                    } else {
+                        std::ifstream manifest(argument);
+                        if (!manifest) {
+                            std::cout << "Error: Unable to open " << argument << std::endl;
+                            return EXIT_FAILURE;
+                        }
+                        std::string url;
+                        std::string name;
+                        while (manifest >> url >> name) {
+                            store->fetch(client, url, name);
+                        }
+                    }
+                }
+                size_t start = 0;
+                while (option == FETCH && start <= argument.size()) {
+                    size_t end = argument.find(',', start);
+                    if (end == std::string::npos) {
+                        end = argument.size();
+                    }
+                    if (end > start) {
+                        fetch_all_pages(client, argument.substr(start, end - start), nullptr, on_done);
+                    }
+                    start = end + 1;
+                }
+                client.run();
+                std::cout << client.requests() << " requests sent" << std::endl;
+                std::cout << print_audit_stats(history.close());
+                if (cache) {
+                    std::cout << print_cache_stats(cache->stats());
+                }
+                if (store) {
+                    store->save();
+                    std::cout << print_asset_stats(store->stats());
+                    failed = failed || store->stats().failed > 0;
+                }
+                if (failed) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case QUERY: {
+                using clock = std::chrono::steady_clock;
+                const auto load_start = clock::now();
+                const collection_store store = load_collection(DB);
+                const auto query_start = clock::now();
+                const collection_filter filter = parse_filter(argument, store);
+                const size_t rows = select_rows(store, filter).size();
+                const std::vector<uint64_t> by_set = sum_quantity_by_set(store, filter);
+                const auto query_end = clock::now();
+                std::cout << rows << " rows, " << sum_quantity(store, filter) << " copies\n"
+                          << print_quantity_by_set(store, by_set) << std::fixed << std::setprecision(2)
+                          << "Loaded " << store.size() << " rows in "
+                          << std::chrono::duration<double, std::milli>(query_start - load_start).count()
+                          << " ms, queried in "
+                          << std::chrono::duration<double, std::milli>(query_end - query_start).count() << " ms"
+                          << std::endl;
+                break;
+            }
+            case SEARCH: {
+                using clock = std::chrono::steady_clock;
+                const auto build_start = clock::now();
+                trigram_index index;
+                index.refresh(DB);
+                const auto search_start = clock::now();
+                const std::vector<search_hit> hits = index.search(argument);
+                const auto search_end = clock::now();
+                std::cout << print_search_hits(hits) << std::fixed << std::setprecision(2) << "Indexed "
+                          << index.size() << " names (" << static_cast<double>(index.posting_bytes()) / 1024
+                          << " KB of postings) in "
+                          << std::chrono::duration<double, std::milli>(search_start - build_start).count()
+                          << " ms, searched in "
+                          << std::chrono::duration<double, std::micro>(search_end - search_start).count() << " us"
+                          << std::endl;
+                break;
+            }
+            case VALUE: {
+                using clock = std::chrono::steady_clock;
+                const int32_t days = std::stoi(argument);
+                if (days < 1) {
+                    std::cout << "Error: Invalid number of days " << argument << std::endl;
+                    return EXIT_FAILURE;
+                }
+                price_store prices(std::getenv("FBLTHP_PRICES"));
+                const int32_t to = parse_day(std::getenv("FBLTHP_PRICE_DAY"));
+                const int32_t from = to - days + 1;
+                const auto value_start = clock::now();
+                const std::vector<holding> holdings = load_holdings(DB, prices, std::getenv("FBLTHP_PRICE_CURRENCY"));
+                const std::vector<int64_t> values = prices.value(holdings, from, to);
+                const auto value_end = clock::now();
+                std::cout << print_value_history(from, values) << std::fixed << std::setprecision(2) << "Valued "
+                          << holdings.size() << " printings over " << days << " days in "
+                          << std::chrono::duration<double, std::milli>(value_end - value_start).count() << " ms ("
+                          << prices.stats().decoded_blocks << " blocks decoded)" << std::endl;
+                break;
+            }
+            case DECKS: {
+                using clock = std::chrono::steady_clock;
+                const auto load_start = clock::now();
+                const std::vector<std::string> paths = scan_decklists(argument);
+                const collection_store store = load_collection(DB);
+                const copy_table table(store);
+                const auto check_start = clock::now();
+                const auto threads = static_cast<unsigned int>(std::stoul(std::getenv("FBLTHP_DECK_THREADS")));
+                const deck_report report = check_decks(table, paths, threads);
+                const auto check_end = clock::now();
+                const double check_seconds = std::chrono::duration<double>(check_end - check_start).count();
+                std::cout << print_deck_report(report) << std::fixed << std::setprecision(2) << "Loaded "
+                          << store.size() << " rows (" << table.size() << " keys) in "
+                          << std::chrono::duration<double, std::milli>(check_start - load_start).count()
+                          << " ms, checked " << report.lines << " lines in " << check_seconds * 1000 << " ms ("
+                          << std::setprecision(0) << static_cast<double>(paths.size()) / std::max(check_seconds, 1e-9)
+                          << " decks/s)" << std::endl;
+                break;
+            }
+            case EXPORT:
+                std::cout << print_export_stats(export_collection(DB, argument));
+                break;
+            case SERVE: {
+                server_options settings;
+                settings.db_path = std::getenv("FBLTHP_DB");
+                settings.socket_path = argument;
+                settings.readers = static_cast<unsigned int>(std::stoul(std::getenv("FBLTHP_SERVE_READERS")));
+                collection_server server(settings);
+                const std::shared_ptr<const server_snapshot> resident = server.resident();
+                std::cout << "Serving " << settings.db_path << " on " << argument << " with " << server.reader_count()
+                          << " readers (" << resident->store.size() << " rows and " << resident->names.size()
+                          << " names loaded in " << std::fixed << std::setprecision(2) << resident->load_ms
+                          << " ms)" << std::endl;
+                server.run();
+                std::cout << print_server_stats(server.stats());
+                break;
+            }
+            default:
+                std::cout << "Error: This should be unreachable\n";
+                return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int get_option(const char* argument) {
+    if (str_eq(argument, "-h") || str_eq(argument, "--help")) {
+        return HELP;
+    }
+    if (str_eq(argument, "-e") || str_eq(argument, "--environment")) {
+        return ENVIRONMENT;
+    }
+    if (str_eq(argument, "import")) {
+        return IMPORT;
+    }
+    if (str_eq(argument, "ingest")) {
+        return INGEST;
+    }
+    if (str_eq(argument, "fetch")) {
+        return FETCH;
+    }
+    if (str_eq(argument, "assets")) {
+        return ASSETS;
+    }
+    if (str_eq(argument, "query")) {
+        return QUERY;
+    }
+    if (str_eq(argument, "search")) {
+        return SEARCH;
+    }
+    if (str_eq(argument, "value")) {
+        return VALUE;
+    }
+    if (str_eq(argument, "decks")) {
+        return DECKS;
+    }
+    if (str_eq(argument, "export")) {
+        return EXPORT;
+    }
+    if (str_eq(argument, "serve")) {
+        return SERVE;
+    }
+    return -1;
+}
+
+scryfall_options scryfall_options_from_env() {
+    scryfall_options options;
+    options.base_url = std::getenv("FBLTHP_SCRYFALL_URL");
+    options.requests_per_second = std::stod(std::getenv("FBLTHP_SCRYFALL_RATE"));
+    options.burst = std::stod(std::getenv("FBLTHP_SCRYFALL_BURST"));
+    options.max_connections = std::stol(std::getenv("FBLTHP_SCRYFALL_CONNECTIONS"));
+    return options;
+}
@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "prices.h"
+#include "exceptions.h"
+
+namespace fs = std::filesystem;
+using namespace price_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    constexpr size_t HEADER_BYTES = 6 * sizeof(uint32_t); ///< Size of the segment header
+    constexpr size_t ENTRY_BYTES = 7 * sizeof(uint32_t); ///< Size of a segment index entry
+    constexpr int32_t MAX_CENTS = 1 << 30; ///< Prices above this are rejected, so deltas fit in 32 bits
+
+    /**
+     * Reads a 32-bit field of a mapped file
+     * @param data Start of the field
+     * @return Value of the field
+     */
+    uint32_t read_u32(const char* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    /**
+     * Appends a 32-bit field to a buffer
+     * @param out Buffer
+     * @param value Value of the field
+     */
+    void write_u32(std::string& out, const uint32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    /**
+     * Zigzag encodes a signed value, so small magnitudes of either sign get small codes
+     * @param value Signed value
+     * @return Unsigned code
+     */
+    uint64_t zigzag(const int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    /**
+     * Decodes a zigzag encoded value
+     * @param code Unsigned code
+     * @return Signed value
+     */
+    int64_t unzigzag(const uint64_t code) {
+        return static_cast<int64_t>(code >> 1) ^ -static_cast<int64_t>(code & 1);
+    }
+
+    /**
+     * Writes a bit stream, most significant bit first
+     */
+    class bit_writer {
+        std::string& out; ///< Destination
+        uint64_t buffer = 0; ///< Bits not written yet (the lowest ones)
+        int pending = 0; ///< Number of bits in the buffer
+    public:
+        explicit bit_writer(std::string& destination) : out(destination) {}
+
+        /**
+         * Writes bits
+         * @param value Bits to write (the lowest count ones)
+         * @param count Number of bits, up to 32
+         */
+        void write(const uint64_t value, const int count) {
+            buffer = buffer << count | (value & ((uint64_t{1} << count) - 1));
+            pending += count;
+            while (pending >= 8) {
+                pending -= 8;
+                out.push_back(static_cast<char>(buffer >> pending));
+            }
+        }
+
+        /**
+         * Writes a signed value with a prefix code: 0 takes one bit, small magnitudes 8 or 16 bits, the rest 35
+         * @param value Value to write (its zigzag code must fit in 32 bits)
+         */
+        void write_signed(const int64_t value) {
+            const uint64_t code = zigzag(value);
+            if (code == 0) {
+                write(0b0, 1);
+            } else if (code < uint64_t{1} << 6) {
+                write(0b10, 2);
+                write(code, 6);
+            } else if (code < uint64_t{1} << 13) {
+                write(0b110, 3);
+                write(code, 13);
+            } else {
+                write(0b111, 3);
+                write(code, 32);
+            }
+        }
+
+        /**
+         * Pads the last byte with zeros
+         */
+        void finish() {
+            if (pending > 0) {
+                out.push_back(static_cast<char>(buffer << (8 - pending)));
+                pending = 0;
+            }
+        }
+    };
+
+    /**
+     * Reads a bit stream written by bit_writer
+     */
+    class bit_reader {
+        const unsigned char* data; ///< Stream
+        size_t size; ///< Length of the stream in bytes
+        size_t position = 0; ///< Next bit
+    public:
+        bit_reader(const char* stream, const size_t bytes)
+            : data(reinterpret_cast<const unsigned char*>(stream)), size(bytes) {}
+
+        /**
+         * Reads bits
+         * @param count Number of bits, 1 to 32
+         * @return Bits read (zeros past the end of the stream)
+         */
+        uint64_t read(const int count) {
+            const size_t byte = position >> 3;
+            uint64_t window = 0;
+            if (byte + sizeof(window) <= size) {
+                std::memcpy(&window, data + byte, sizeof(window));
+                if constexpr (std::endian::native == std::endian::little) {
+                    window = std::byteswap(window);
+                }
+            } else {
+                for (size_t i = 0; byte + i < size && i < sizeof(window); i++) {
+                    window |= static_cast<uint64_t>(data[byte + i]) << (56 - 8 * i);
+                }
+            }
+            const auto shift = static_cast<int>(position & 7);
+            position += static_cast<size_t>(count);
+            return window << shift >> (64 - count);
+        }
+
+        /**
+         * Reads a signed value written by bit_writer::write_signed
+         * @return Value
+         */
+        int64_t read_signed() {
+            if (read(1) == 0) {
+                return 0;
+            }
+            if (read(1) == 0) {
+                return unzigzag(read(6));
+            }
+            if (read(1) == 0) {
+                return unzigzag(read(13));
+            }
+            return unzigzag(read(32));
+        }
+    };
+
+    /**
+     * Encodes the points of a series: the first price in 32 bits, then for every point the change of the gap between
+     * days (0 for a daily series) and the change of the price (0 when it did not move)
+     * @param points Points of one series, sorted by day
+     * @param count Number of points (at least one)
+     * @param out Destination of the bit stream
+     */
+    void encode_block(const price_point* points, const size_t count, std::string& out) {
+        bit_writer writer(out);
+        writer.write(static_cast<uint32_t>(points[0].cents), 32);
+        int64_t gap = 1;
+        for (size_t i = 1; i < count; i++) {
+            const int64_t next_gap = points[i].day - points[i - 1].day;
+            writer.write_signed(next_gap - gap);
+            writer.write_signed(static_cast<int64_t>(points[i].cents) - points[i - 1].cents);
+            gap = next_gap;
+        }
+        writer.finish();
+    }
+}
+
+// Price segment
+// ---------------------------------------------------------------------------------------------------------------------
+price_segment::price_segment(const std::string& path) : file(path) {
+    const char* data = file.data();
+    if (file.size() < HEADER_BYTES || read_u32(data) != SEGMENT_MAGIC || read_u32(data + 4) != SEGMENT_VERSION) {
+        throw price_error(path + " is not a price segment");
+    }
+    first = static_cast<int32_t>(read_u32(data + 8));
+    last = static_cast<int32_t>(read_u32(data + 12));
+    count = read_u32(data + 16);
+    index = read_u32(data + 20);
+    if (index < HEADER_BYTES || index + count * ENTRY_BYTES != file.size()) {
+        throw price_error(path + " has a truncated index");
+    }
+}
+
+price_segment::block price_segment::entry(const size_t i) const {
+    const char* data = file.data() + index + i * ENTRY_BYTES;
+    return {read_u32(data), static_cast<int32_t>(read_u32(data + 4)), static_cast<int32_t>(read_u32(data + 8)),
+            read_u32(data + 12), static_cast<int32_t>(read_u32(data + 16)), read_u32(data + 20), read_u32(data + 24)};
+}
+
+std::optional<price_segment::block> price_segment::find(const uint32_t series) const {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (read_u32(file.data() + index + middle * ENTRY_BYTES) < series) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == count) {
+        return std::nullopt;
+    }
+    const block found = entry(low);
+    return found.series == series ? std::optional(found) : std::nullopt;
+}
+
+void price_segment::decode(const block& entry, std::vector<price_point>& points) const {
+    points.clear();
+    points.reserve(entry.points);
+    bit_reader reader(file.data() + entry.offset, entry.bytes);
+    int32_t day = entry.first_day;
+    auto cents = static_cast<int32_t>(reader.read(32));
+    points.push_back({entry.series, day, cents});
+    int64_t gap = 1;
+    for (uint32_t i = 1; i < entry.points; i++) {
+        gap += reader.read_signed();
+        day += static_cast<int32_t>(gap);
+        cents += static_cast<int32_t>(reader.read_signed());
+        points.push_back({entry.series, day, cents});
+    }
+}
+
+size_t price_segment::points() const {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += entry(i).points;
+    }
+    return total;
+}
+
+// Price store
+// ---------------------------------------------------------------------------------------------------------------------
+price_store::price_store(const std::string& path) : directory(path) {
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error) {
+        throw price_error("Creating " + directory + " (" + error.message() + ")");
+    }
+
+    std::ifstream catalog(fs::path(directory) / CATALOG_FILE);
+    for (std::string key; std::getline(catalog, key);) {
+        ids.emplace(key, static_cast<uint32_t>(keys.size()));
+        keys.push_back(std::move(key));
+    }
+    saved_keys = keys.size();
+
+    for (const auto& item : fs::directory_iterator(directory)) {
+        if (item.is_regular_file() && item.path().extension() == SEGMENT_EXTENSION) {
+            segments.emplace_back(item.path().string());
+        }
+    }
+    std::ranges::sort(segments, {}, &price_segment::first_day);
+
+    // Records of an interrupted write (a partial record, an unknown series) or of a head sealed just before a crash
+    // are dropped
+    const fs::path head_path = fs::path(directory) / HEAD_FILE;
+    if (fs::exists(head_path)) {
+        const mapped_file log(head_path.string());
+        const int32_t sealed = sealed_until();
+        for (size_t offset = 0; offset + sizeof(price_point) <= log.size(); offset += sizeof(price_point)) {
+            price_point point{};
+            std::memcpy(&point, log.data() + offset, sizeof(point));
+            if (point.series < keys.size() && point.day > sealed) {
+                head.push_back(point);
+            }
+        }
+        head_sorted = false;
+    }
+}
+
+void price_store::normalize_head() {
+    if (head_sorted) {
+        return;
+    }
+    // Stable: among the points of a day, the last one written is kept
+    std::ranges::stable_sort(head, [](const price_point& a, const price_point& b) {
+        return a.series != b.series ? a.series < b.series : a.day < b.day;
+    });
+    auto kept = head.begin();
+    for (auto point = head.begin(); point != head.end(); ++point) {
+        if (kept != head.begin() && (kept - 1)->series == point->series && (kept - 1)->day == point->day) {
+            *(kept - 1) = *point;
+        } else {
+            *kept++ = *point;
+        }
+    }
+    head.erase(kept, head.end());
+    head_sorted = true;
+}
+
+int32_t price_store::sealed_until() const {
+    return segments.empty() ? INT32_MIN : segments.back().last_day();
+}
+
+uint32_t price_store::series(const std::string& key) {
+    const auto [entry, inserted] = ids.try_emplace(key, static_cast<uint32_t>(keys.size()));
+    if (inserted) {
+        keys.push_back(key);
+    }
+    return entry->second;
+}
+
+std::optional<uint32_t> price_store::find(const std::string& key) const {
+    const auto entry = ids.find(key);
+    return entry != ids.end() ? std::optional(entry->second) : std::nullopt;
+}
+
+void price_store::append(const uint32_t series, const int32_t day, const int32_t cents) {
+    if (day <= sealed_until()) {
+        throw price_error("Day " + format_day(day) + " is already sealed (up to " + format_day(sealed_until()) + ")");
+    }
+    pending.push_back({series, day, std::clamp(cents, 0, MAX_CENTS - 1)});
+}
+
+bool price_store::flush() {
+    // Keys first: head records of series missing from the catalog would be dropped
+    if (keys.size() > saved_keys) {
+        std::ofstream catalog(fs::path(directory) / CATALOG_FILE, std::ios::app);
+        for (size_t i = saved_keys; i < keys.size(); i++) {
+            catalog << keys[i] << '\n';
+        }
+        if (!catalog.flush()) {
+            throw price_error("Writing " + std::string(CATALOG_FILE));
+        }
+        saved_keys = keys.size();
+    }
+    if (!pending.empty()) {
+        std::ofstream log(fs::path(directory) / HEAD_FILE, std::ios::binary | std::ios::app);
+        log.write(reinterpret_cast<const char*>(pending.data()),
+                  static_cast<std::streamsize>(pending.size() * sizeof(price_point)));
+        if (!log.flush()) {
+            throw price_error("Writing " + std::string(HEAD_FILE));
+        }
+        head.insert(head.end(), pending.begin(), pending.end());
+        pending.clear();
+        head_sorted = false;
+    }
+
+    if (head.empty()) {
+        return false;
+    }
+    const auto [first, last] = std::ranges::minmax_element(head, {}, &price_point::day);
+    if (last->day - first->day + 1 < SEGMENT_DAYS) {
+        return false;
+    }
+    seal();
+    return true;
+}
+
+void price_store::seal() {
+    normalize_head();
+    if (head.empty()) {
+        return;
+    }
+
+    std::string blocks;
+    std::string index;
+    int32_t first = INT32_MAX;
+    int32_t last = INT32_MIN;
+    uint32_t count = 0;
+    for (size_t begin = 0; begin < head.size();) {
+        size_t end = begin;
+        while (end < head.size() && head[end].series == head[begin].series) {
+            end++;
+        }
+        const size_t offset = HEADER_BYTES + blocks.size();
+        encode_block(head.data() + begin, end - begin, blocks);
+        for (const uint32_t field : {head[begin].series, static_cast<uint32_t>(head[begin].day),
+                                     static_cast<uint32_t>(head[end - 1].day), static_cast<uint32_t>(end - begin),
+                                     static_cast<uint32_t>(head[end - 1].cents), static_cast<uint32_t>(offset),
+                                     static_cast<uint32_t>(HEADER_BYTES + blocks.size() - offset)}) {
+            write_u32(index, field);
+        }
+        first = std::min(first, head[begin].day);
+        last = std::max(last, head[end - 1].day);
+        count++;
+        begin = end;
+    }
+    blocks.resize((blocks.size() + 3) & ~size_t{3}); // Aligns the index
+
+    std::string header;
+    for (const uint32_t field : {SEGMENT_MAGIC, SEGMENT_VERSION, static_cast<uint32_t>(first),
+                                 static_cast<uint32_t>(last), count,
+                                 static_cast<uint32_t>(HEADER_BYTES + blocks.size())}) {
+        write_u32(header, field);
+    }
+
+    // Written aside and renamed into place, then the head is emptied: a crash in between leaves head points the
+    // segment already holds, which are dropped on load
+    const fs::path segment_path = fs::path(directory) / (format_day(first) + "_" + format_day(last) +
+                                                         SEGMENT_EXTENSION);
+    const fs::path tmp_path = segment_path.string() + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        file << header << blocks << index;
+        if (!file.flush()) {
+            throw price_error("Writing " + tmp_path.string());
+        }
+    }
+    std::error_code error;
+    fs::rename(tmp_path, segment_path, error);
+    if (error) {
+        throw price_error("Renaming " + tmp_path.string() + " (" + error.message() + ")");
+    }
+    std::ofstream(fs::path(directory) / HEAD_FILE, std::ios::binary | std::ios::trunc);
+    segments.emplace_back(segment_path.string());
+    head.clear();
+}
+
+std::vector<int64_t> price_store::value(const std::vector<holding>& holdings, const int32_t from,
+                                        const int32_t to) {
+    if (to < from) {
+        return {};
+    }
+    normalize_head();
+
+    // Difference array: every price change adds quantity * change to its day, the prefix sums are the daily values
+    std::vector<int64_t> values(static_cast<size_t>(to - from) + 1);
+    std::vector<price_point> points;
+    for (const holding& held : holdings) {
+        const auto quantity = static_cast<int64_t>(held.quantity);
+        int64_t current = 0; // Price carried into the range
+        bool started = false;
+        const auto apply = [&](const price_point& point) {
+            if (point.day < from) {
+                current = point.cents;
+                return;
+            }
+            if (!started) {
+                values[0] += quantity * current;
+                started = true;
+            }
+            values[static_cast<size_t>(point.day - from)] += quantity * (point.cents - current);
+            current = point.cents;
+        };
+
+        for (const price_segment& segment : segments) {
+            if (segment.first_day() > to) {
+                break;
+            }
+            const std::optional<price_segment::block> entry = segment.find(held.series);
+            if (!entry) {
+                continue;
+            }
+            if (entry->last_day < from) {
+                current = entry->last_cents; // Before the range: the index holds the only price needed
+                continue;
+            }
+            segment.decode(*entry, points);
+            decoded++;
+            for (const price_point& point : points) {
+                if (point.day > to) {
+                    break;
+                }
+                apply(point);
+            }
+        }
+        const auto [begin, end] = std::ranges::equal_range(head, held.series, {}, &price_point::series);
+        for (auto point = begin; point != end && point->day <= to; ++point) {
+            apply(*point);
+        }
+        if (!started) {
+            values[0] += quantity * current;
+        }
+    }
+    for (size_t i = 1; i < values.size(); i++) {
+        values[i] += values[i - 1];
+    }
+    return values;
+}
+
+price_stats price_store::stats() const {
+    price_stats stats;
+    stats.series = keys.size();
+    stats.segments = segments.size();
+    stats.head_points = head.size() + pending.size();
+    stats.decoded_blocks = decoded;
+    for (const price_segment& segment : segments) {
+        stats.sealed_points += segment.points();
+        stats.bytes += segment.size();
+    }
+    stats.bytes += stats.head_points * sizeof(price_point);
+    return stats;
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string series_key(const std::string_view scryfall_id, const std::string_view kind) {
+    std::string key;
+    key.reserve(scryfall_id.size() + kind.size() + 1);
+    key.append(scryfall_id).append(":").append(kind);
+    return key;
+}
+
+std::optional<int32_t> parse_cents(const std::string_view text) {
+    int64_t cents = 0;
+    int decimals = -1;
+    for (const char c : text) {
+        if (c == '.' && decimals < 0) {
+            decimals = 0;
+        } else if (c >= '0' && c <= '9' && decimals < 2 && cents < MAX_CENTS) {
+            cents = cents * 10 + (c - '0');
+            decimals += decimals >= 0 ? 1 : 0;
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (text.empty() || text == ".") {
+        return std::nullopt;
+    }
+    for (int i = std::max(decimals, 0); i < 2; i++) {
+        cents *= 10;
+    }
+    return cents < MAX_CENTS ? std::optional(static_cast<int32_t>(cents)) : std::nullopt;
+}
+
+int32_t parse_day(const std::string_view text) {
+    using namespace std::chrono;
+    if (text.empty()) {
+        return static_cast<int32_t>(floor<days>(system_clock::now()).time_since_epoch().count());
+    }
+    int year = 0;
+    unsigned month = 0;
+    unsigned day = 0;
+    char dash1 = 0;
+    char dash2 = 0;
+    std::istringstream in{std::string(text)};
+    in >> year >> dash1 >> month >> dash2 >> day;
+    const year_month_day date{std::chrono::year(year), std::chrono::month(month), std::chrono::day(day)};
+    if (!in || dash1 != '-' || dash2 != '-' || !in.eof() || !date.ok()) {
+        throw price_error("Invalid date: " + std::string(text));
+    }
+    return static_cast<int32_t>(sys_days(date).time_since_epoch().count());
+}
+
+std::string format_day(const int32_t day) {
+    using namespace std::chrono;
+    const year_month_day date{sys_days(days(day))};
+    std::ostringstream out;
+    out << std::setfill('0') << std::setw(4) << static_cast<int>(date.year()) << '-' << std::setw(2)
+        << static_cast<unsigned>(date.month()) << '-' << std::setw(2) << static_cast<unsigned>(date.day());
+    return out.str();
+}
+
+std::vector<holding> load_holdings(sqlite3* DB, const price_store& store, const std::string_view currency) {
+    const std::string foil_kind = std::string(currency) + "_foil";
+    const bool has_foil_kind = std::ranges::find(KINDS, foil_kind) != KINDS.end();
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(DB, HOLDINGS_QUERY, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw query_error(sqlite3_errmsg(DB));
+    }
+
+    std::vector<holding> holdings;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const auto* id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        const auto* foil = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        const bool is_foil = foil != nullptr && (foil[0] == '1' || foil[0] == 't' || foil[0] == 'T' ||
+                                                 foil[0] == 'y' || foil[0] == 'Y');
+        const sqlite3_int64 quantity = sqlite3_column_int64(stmt, 1);
+        if (id == nullptr || quantity <= 0) {
+            continue;
+        }
+        const std::optional<uint32_t> series = store.find(series_key(id, is_foil && has_foil_kind ? foil_kind :
+                                                                              currency));
+        if (series) {
+            holdings.push_back({*series, static_cast<uint64_t>(quantity)});
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw query_error(sqlite3_errmsg(DB));
+    }
+    return holdings;
+}
+
+std::string print_value_history(const int32_t from, const std::vector<int64_t>& values) {
+    std::ostringstream out;
+    if (values.empty()) {
+        return out.str();
+    }
+    out << std::fixed << std::setprecision(2);
+    const size_t step = std::max<size_t>((values.size() + VALUE_ROWS - 2) / (VALUE_ROWS - 1), 1);
+    for (size_t i = 0; i < values.size(); i += step) {
+        out << "  " << format_day(from + static_cast<int32_t>(i)) << ": " << static_cast<double>(values[i]) / 100
+            << "\n";
+    }
+    if ((values.size() - 1) % step != 0) {
+        out << "  " << format_day(from + static_cast<int32_t>(values.size() - 1)) << ": "
+            << static_cast<double>(values.back()) / 100 << "\n";
+    }
+    const auto [low, high] = std::ranges::minmax_element(values);
+    out << "Change: " << static_cast<double>(values.back() - values.front()) / 100 << " (low "
+        << static_cast<double>(*low) / 100 << ", high " << static_cast<double>(*high) / 100 << ")\n";
+    return out.str();
+}
+
+std::string print_price_stats(const price_stats& stats) {
+    std::ostringstream out;
+    const size_t points = stats.sealed_points + stats.head_points;
+    out << std::fixed << std::setprecision(2);
+    out << "Price store: " << stats.series << " series, " << points << " points (" << stats.head_points
+        << " in the head, " << stats.segments << " segments), " << static_cast<double>(stats.bytes) / (1024.0 * 1024.0)
+        << " MB (" << (points > 0 ? static_cast<double>(stats.bytes) / static_cast<double>(points) : 0.0)
+        << " bytes per point)\n";
+    return out.str();
+}
@@ -0,0 +1,290 @@
+/**
+ * Compressed time-series store of daily card prices header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef PRICES_H
+#define PRICES_H
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace price_constants {
+    inline constexpr std::array<std::string_view, 5> KINDS = {"usd", "usd_foil", "eur", "eur_foil",
+                                                              "tix"}; ///< Prices recorded per printing
+    inline constexpr int32_t SEGMENT_DAYS = 32; ///< Days the head spans before it is sealed into a segment
+    inline constexpr uint32_t SEGMENT_MAGIC = 0x53504246; ///< First bytes of a segment file ("FBPS")
+    inline constexpr uint32_t SEGMENT_VERSION = 1; ///< Version of the segment format
+    inline const char* CATALOG_FILE = "series.txt"; ///< Series keys, one per line (the line number is the id)
+    inline const char* HEAD_FILE = "head.log"; ///< Points not sealed yet, as fixed size records
+    inline const char* SEGMENT_EXTENSION = ".seg"; ///< Extension of the sealed segments
+    /**
+     * SQL statement reading the printings of the collection. A bulk dump in several languages has a card row per
+     * language of a printing, so every collection row is matched with a single one: the English card if there is one,
+     * else the one with the lowest Scryfall id
+     */
+    inline const char* HOLDINGS_QUERY = "SELECT c.scryfall_id, SUM(r.quantity), r.foil FROM raw_collection r JOIN "
+                                        "card c ON c.\"set\" = r.\"set\" COLLATE NOCASE AND c.collector_number = "
+                                        "r.number WHERE NOT EXISTS (SELECT 1 FROM card o WHERE o.\"set\" = c.\"set\" "
+                                        "AND o.collector_number = c.collector_number AND (o.lang IS NOT 'en', "
+                                        "o.scryfall_id) < (c.lang IS NOT 'en', c.scryfall_id)) "
+                                        "GROUP BY c.scryfall_id, r.foil;";
+    inline constexpr size_t VALUE_ROWS = 12; ///< Days printed for a value history
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold a price point, as stored in the head file
+ */
+struct price_point {
+    uint32_t series; ///< Series id
+    int32_t day; ///< Days since 1970-01-01
+    int32_t cents; ///< Price in hundredths of the currency
+};
+
+/**
+ * Struct to hold a printing of the collection valued by a series
+ */
+struct holding {
+    uint32_t series; ///< Series id
+    uint64_t quantity; ///< Copies
+};
+
+/**
+ * Struct to hold the statistics of a price store
+ */
+struct price_stats {
+    size_t series = 0; ///< Known series
+    size_t segments = 0; ///< Sealed segments
+    size_t sealed_points = 0; ///< Points in the segments
+    size_t head_points = 0; ///< Points waiting in the head
+    size_t bytes = 0; ///< Size of the segments and the head on disk
+    size_t decoded_blocks = 0; ///< Blocks decoded by queries
+};
+
+/**
+ * Read-only view of a sealed segment file. A segment holds one compressed block per series, covering the same days,
+ * followed by an index of the blocks sorted by series:
+ *   header: magic, version, first day, last day, series count, index offset (u32 each)
+ *   blocks: bit streams (first price in 32 bits, then per point a day delta-of-delta and a price delta)
+ *   index:  series, first day, last day, points, last price, block offset, block bytes (u32 each)
+ * The header days are the sparse time index of the store: segments outside a query are never touched, and the last
+ * price of every block is kept in the index so that carrying a price into a range needs no decoding
+ */
+class price_segment {
+public:
+    /**
+     * Struct to hold an index entry
+     */
+    struct block {
+        uint32_t series; ///< Series id
+        int32_t first_day; ///< Day of the first point
+        int32_t last_day; ///< Day of the last point
+        uint32_t points; ///< Number of points
+        int32_t last_cents; ///< Price of the last point
+        uint32_t offset; ///< Offset of the bit stream in the file
+        uint32_t bytes; ///< Length of the bit stream
+    };
+
+    /**
+     * Maps a segment
+     * @param path Path of the segment file
+     * @throw price_error if the file is not a valid segment
+     */
+    explicit price_segment(const std::string& path);
+
+    /**
+     * Finds the block of a series
+     * @param series Series id
+     * @return Index entry, or nullopt if the series has no points in the segment
+     */
+    [[nodiscard]] std::optional<block> find(uint32_t series) const;
+
+    /**
+     * Decodes a block
+     * @param entry Index entry of the block
+     * @param points Destination of the points (cleared first)
+     */
+    void decode(const block& entry, std::vector<price_point>& points) const;
+
+    [[nodiscard]] int32_t first_day() const {return first;} ///< First day of the segment
+    [[nodiscard]] int32_t last_day() const {return last;} ///< Last day of the segment
+    [[nodiscard]] size_t blocks() const {return count;} ///< Number of blocks
+    [[nodiscard]] size_t size() const {return file.size();} ///< Size of the file
+    [[nodiscard]] size_t points() const; ///< Number of points in the segment
+private:
+    mapped_file file; ///< Mapped segment
+    int32_t first = 0; ///< First day
+    int32_t last = 0; ///< Last day
+    size_t count = 0; ///< Number of blocks
+    size_t index = 0; ///< Offset of the index
+
+    /**
+     * Reads an index entry
+     * @param i Entry position
+     * @return Index entry
+     */
+    [[nodiscard]] block entry(size_t i) const;
+};
+
+/**
+ * Append-only store of daily price series, one series per printing and kind of price (see KINDS). New points go to
+ * the head, a log of fixed size records; once the head spans SEGMENT_DAYS it is sealed into an immutable memory
+ * mapped segment with one delta-of-delta encoded block per series. A daily series whose price does not move costs two
+ * bits per day in a segment, against a row per day in a SQLite table. Days only move forward: a point older than the
+ * last sealed day is rejected, and a point repeated for the same day replaces the previous one
+ */
+class price_store {
+    std::string directory; ///< Directory of the store
+    std::vector<std::string> keys; ///< Series keys by id
+    std::unordered_map<std::string, uint32_t> ids; ///< Series ids by key
+    size_t saved_keys = 0; ///< Keys already in the catalog file
+    std::vector<price_segment> segments; ///< Sealed segments from the oldest
+    std::vector<price_point> head; ///< Points in the head file, sorted by series and day once normalized
+    bool head_sorted = true; ///< Whether the head is sorted and deduplicated
+    std::vector<price_point> pending; ///< Points appended since the last flush
+    size_t decoded = 0; ///< Blocks decoded by queries
+
+    /**
+     * Sorts the head by series and day, keeping the last point written for a day (the contents do not change)
+     */
+    void normalize_head();
+
+    /**
+     * Last sealed day
+     * @return Last day of the newest segment (INT32_MIN without segments)
+     */
+    [[nodiscard]] int32_t sealed_until() const;
+public:
+    /**
+     * Opens a store, creating its directory if needed
+     * @param path Directory of the store
+     * @throw price_error if the directory or its files cannot be read
+     */
+    explicit price_store(const std::string& path);
+
+    /**
+     * Looks up a series, adding it if it is new
+     * @param key Series key (scryfall id and kind, see series_key)
+     * @return Series id
+     */
+    uint32_t series(const std::string& key);
+
+    /**
+     * Looks up a series
+     * @param key Series key
+     * @return Series id, or nullopt for an unknown series
+     */
+    [[nodiscard]] std::optional<uint32_t> find(const std::string& key) const;
+
+    /**
+     * Appends a point to the head (written by flush)
+     * @param series Series id
+     * @param day Day of the price
+     * @param cents Price in hundredths
+     * @throw price_error if the day is already sealed
+     */
+    void append(uint32_t series, int32_t day, int32_t cents);
+
+    /**
+     * Writes the new series and head points, then seals the head if it spans SEGMENT_DAYS
+     * @return True if a segment was sealed
+     * @throw price_error if the files cannot be written
+     */
+    bool flush();
+
+    /**
+     * Seals the head into a new segment and empties it
+     * @throw price_error if the segment cannot be written
+     */
+    void seal();
+
+    /**
+     * Values holdings day by day, carrying the last known price of every series forward. Only the blocks of the
+     * segments overlapping the range are decoded. It sorts the head on first use and counts the decoded blocks, so
+     * it is not safe to call from several threads at once
+     * @param holdings Printings and quantities
+     * @param from First day
+     * @param to Last day
+     * @return Total value in hundredths for every day from first to last
+     */
+    [[nodiscard]] std::vector<int64_t> value(const std::vector<holding>& holdings, int32_t from, int32_t to);
+
+    /**
+     * Statistics of the store
+     * @return Statistics
+     */
+    [[nodiscard]] price_stats stats() const;
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Builds the key of a series
+ * @param scryfall_id Scryfall id of the printing
+ * @param kind Kind of price (see KINDS)
+ * @return Series key
+ */
+std::string series_key(std::string_view scryfall_id, std::string_view kind);
+
+/**
+ * Parses a price as Scryfall writes it ("0.25")
+ * @param text Decimal price
+ * @return Price in hundredths, or nullopt if the text is not a price
+ */
+std::optional<int32_t> parse_cents(std::string_view text);
+
+/**
+ * Parses a day
+ * @param text Date as YYYY-MM-DD (empty for today, in UTC)
+ * @return Days since 1970-01-01
+ * @throw price_error if the date is invalid
+ */
+int32_t parse_day(std::string_view text);
+
+/**
+ * Formats a day
+ * @param day Days since 1970-01-01
+ * @return Date as YYYY-MM-DD
+ */
+std::string format_day(int32_t day);
+
+/**
+ * Reads the printings of the collection and their series
+ * @param DB Sqlite database object
+ * @param store Price store
+ * @param currency Kind of price of the non-foil copies (usd, eur or tix; foils use its _foil kind when it exists)
+ * @return Holdings with a known series
+ * @throw query_error if the collection cannot be read
+ */
+std::vector<holding> load_holdings(sqlite3* DB, const price_store& store, std::string_view currency);
+
+/**
+ * Prints a value history
+ * @param from First day of the history
+ * @param values Value of every day in hundredths
+ * @return String with a sample of VALUE_ROWS days and the change over the range
+ */
+std::string print_value_history(int32_t from, const std::vector<int64_t>& values);
+
+/**
+ * Prints the statistics of a price store
+ * @param stats Price store statistics
+ * @return String with the report
+ */
+std::string print_price_stats(const price_stats& stats);
+
+#endif //PRICES_H
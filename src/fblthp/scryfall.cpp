@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+#include "scryfall.h"
+#include "exceptions.h"
+
+namespace fs = std::filesystem;
+using namespace scryfall_constants;
+using clock_type = std::chrono::steady_clock;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Appends received data to a string body (curl write callback)
+     * @param data Received data
+     * @param size Size of an element
+     * @param count Number of elements
+     * @param body String body
+     * @return Number of bytes consumed
+     */
+    size_t append_body(const char* data, const size_t size, const size_t count, void* body) {
+        static_cast<std::string*>(body)->append(data, size * count);
+        return size * count;
+    }
+
+    /**
+     * Struct to hold the state of a paginated listing shared by the callbacks of its pages
+     */
+    struct listing {
+        page_summary summary; ///< Summary so far
+        clock_type::time_point start; ///< Time of the first request
+        std::function<void(const nlohmann::json&)> on_page; ///< Page callback
+        std::function<void(const page_summary&)> on_done; ///< Completion callback
+    };
+
+    /**
+     * Queues a page of a listing, queueing the next one from its callback
+     * @param client Scryfall client
+     * @param url URL of the page
+     * @param state Listing state
+     */
+    void request_page(scryfall_client& client, const std::string& url, const std::shared_ptr<listing>& state) {
+        client.get(url, [&client, state](scryfall_response& response) {
+            page_summary& summary = state->summary;
+            summary.status = response.status;
+            summary.bytes += response.body.size();
+
+            std::string next_page;
+            if (!response.ok()) {
+                summary.error = response.error.empty() ? "HTTP " + std::to_string(response.status) : response.error;
+            } else if (const nlohmann::json page = nlohmann::json::parse(response.body, nullptr, false);
+                       page.is_discarded()) {
+                summary.error = "Invalid JSON in " + response.url;
+            } else {
+                summary.pages++;
+                if (const auto data = page.find("data"); data != page.end() && data->is_array()) {
+                    summary.objects += data->size();
+                }
+                if (state->on_page) {
+                    state->on_page(page);
+                }
+                if (page.value("has_more", false)) {
+                    next_page = page.value("next_page", "");
+                    if (next_page.empty()) {
+                        summary.error = "Missing next_page in " + response.url;
+                    }
+                }
+            }
+
+            if (summary.error.empty() && !next_page.empty()) {
+                request_page(client, next_page, state);
+                return;
+            }
+            summary.ms = std::chrono::duration<double, std::milli>(clock_type::now() - state->start).count();
+            if (state->on_done) {
+                state->on_done(summary);
+            }
+        });
+    }
+}
+
+// Scryfall client
+// ---------------------------------------------------------------------------------------------------------------------
+scryfall_client::scryfall_client(scryfall_options client_options)
+    : options(std::move(client_options)), limiter(options.requests_per_second, options.burst) {
+    static std::once_flag curl_initialized;
+    std::call_once(curl_initialized, [] {curl_global_init(CURL_GLOBAL_DEFAULT);});
+
+    multi = curl_multi_init();
+    if (multi == nullptr) {
+        throw scryfall_error("Initializing curl");
+    }
+    options.max_connections = std::max(options.max_connections, 1L);
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, options.max_connections);
+    headers = curl_slist_append(headers, ACCEPT);
+}
+
+scryfall_client::~scryfall_client() {
+    for (auto& [handle, request] : active) {
+        curl_multi_remove_handle(multi, handle);
+        curl_easy_cleanup(handle);
+        curl_slist_free_all(request->conditional);
+        if (request->file != nullptr) {
+            std::fclose(request->file);
+            std::error_code error;
+            fs::remove(request->file_path + PART_SUFFIX, error);
+        }
+    }
+    for (CURL* handle : idle_handles) {
+        curl_easy_cleanup(handle);
+    }
+    curl_multi_cleanup(multi);
+    curl_slist_free_all(headers);
+}
+
+void scryfall_client::get(const std::string& url, scryfall_callback callback) {
+    auto request = std::make_unique<transfer>();
+    request->url = resolve(url);
+    request->limited = request->url.starts_with(options.base_url);
+    request->callback = std::move(callback);
+    pending.push_back(std::move(request));
+}
+
+void scryfall_client::download(const std::string& url, const std::string& file_path, scryfall_callback callback) {
+    auto request = std::make_unique<transfer>();
+    request->url = resolve(url);
+    request->file_path = file_path;
+    request->limited = request->url.starts_with(options.base_url);
+    request->callback = std::move(callback);
+    pending.push_back(std::move(request));
+}
+
+std::string scryfall_client::request_headers() {
+    return std::string("User-Agent: ") + USER_AGENT + "\n" + ACCEPT;
+}
+
+void scryfall_client::set_observer(scryfall_observer response_observer) {
+    observer = std::move(response_observer);
+}
+
+void scryfall_client::set_cache(http_cache* response_cache) {
+    cache = response_cache;
+}
+
+std::string scryfall_client::resolve(const std::string& url) const {
+    if (url.starts_with("http://") || url.starts_with("https://")) {
+        return url;
+    }
+    if (!url.empty() && url.front() == '/' && !options.base_url.empty() && options.base_url.back() == '/') {
+        return options.base_url + url.substr(1);
+    }
+    return options.base_url + url;
+}
+
+void scryfall_client::run() {
+    while (!pending.empty() || !delayed.empty() || !active.empty()) {
+        admit();
+
+        int still_running = 0;
+        if (const CURLMcode code = curl_multi_perform(multi, &still_running); code != CURLM_OK) {
+            throw scryfall_error(curl_multi_strerror(code));
+        }
+        int queued = 0;
+        while (const CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+            if (message->msg == CURLMSG_DONE) {
+                CURL* handle = message->easy_handle;
+                const CURLcode result = message->data.result;
+                finish(handle, result);
+            }
+        }
+
+        if (pending.empty() && delayed.empty() && active.empty()) {
+            break;
+        }
+        if (const CURLMcode code = curl_multi_poll(multi, nullptr, 0, poll_timeout(), nullptr); code != CURLM_OK) {
+            throw scryfall_error(curl_multi_strerror(code));
+        }
+    }
+}
+
+void scryfall_client::admit() {
+    const auto now = clock_type::now();
+
+    // Retries whose wait is over go back in line
+    for (auto it = delayed.begin(); it != delayed.end();) {
+        if ((*it)->not_before <= now) {
+            pending.push_back(std::move(*it));
+            it = delayed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Fresh cached responses need neither a token nor a connection. Rate limited requests wait for a token without
+    // holding back unlimited ones queued behind them
+    std::vector<std::unique_ptr<transfer>> cached;
+    std::vector<std::unique_ptr<transfer>> ready;
+    bool tokens_left = true;
+    const auto limit = static_cast<size_t>(options.max_connections);
+    const size_t slots = active.size() < limit ? limit - active.size() : 0;
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (cache != nullptr && (*it)->file_path.empty()) {
+            if (const cache_entry* entry = cache->find((*it)->url); entry != nullptr && cache->fresh(*entry)) {
+                cached.push_back(std::move(*it));
+                it = pending.erase(it);
+                continue;
+            }
+        }
+        if (ready.size() >= slots) {
+            ++it;
+            continue;
+        }
+        if ((*it)->limited && (!tokens_left || !limiter.try_acquire(now))) {
+            tokens_left = false;
+            ++it;
+            continue;
+        }
+        ready.push_back(std::move(*it));
+        it = pending.erase(it);
+    }
+    for (auto& request : ready) {
+        start(std::move(request));
+    }
+    for (auto& request : cached) {
+        serve_cached(std::move(request));
+    }
+}
+
+int scryfall_client::poll_timeout() {
+    const auto now = clock_type::now();
+    auto wait = std::chrono::milliseconds(POLL_TIMEOUT_MS);
+    if (active.size() < static_cast<size_t>(options.max_connections)) {
+        for (const auto& request : pending) {
+            const auto until_token = request->limited ? limiter.wait_time(now) : clock_type::duration::zero();
+            wait = std::min(wait, std::chrono::ceil<std::chrono::milliseconds>(until_token));
+        }
+    }
+    for (const auto& request : delayed) {
+        wait = std::min(wait, std::chrono::ceil<std::chrono::milliseconds>(
+            std::max(request->not_before - now, clock_type::duration::zero())));
+    }
+    return static_cast<int>(wait.count());
+}
+
+void scryfall_client::start(std::unique_ptr<transfer> request) {
+    CURL* handle;
+    if (idle_handles.empty()) {
+        handle = curl_easy_init();
+        if (handle == nullptr) {
+            throw scryfall_error("Creating transfer for " + request->url);
+        }
+    } else {
+        handle = idle_handles.back();
+        idle_handles.pop_back();
+    }
+
+    if (request->retries == 0) {
+        request->start = clock_type::now();
+    }
+    request->body.clear();
+    request->error[0] = '\0';
+    if (!request->file_path.empty()) {
+        request->file = std::fopen((request->file_path + PART_SUFFIX).c_str(), "wb");
+        if (request->file == nullptr) {
+            idle_handles.push_back(handle);
+            scryfall_response response;
+            response.url = request->url;
+            response.error = "Unable to open " + request->file_path + PART_SUFFIX;
+            response.retries = request->retries;
+            if (observer) {
+                observer(response);
+            }
+            if (request->callback) {
+                request->callback(response);
+            }
+            return;
+        }
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, nullptr); // fwrite
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, request->file);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, append_body);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &request->body);
+    }
+    curl_easy_setopt(handle, CURLOPT_URL, request->url.c_str());
+    curl_slist_free_all(request->conditional);
+    request->conditional = nullptr;
+    if (const cache_entry* entry = cache != nullptr && request->file_path.empty() ? cache->find(request->url) : nullptr;
+        entry != nullptr && (!entry->etag.empty() || !entry->last_modified.empty())) {
+        request->conditional = curl_slist_append(request->conditional, ACCEPT);
+        if (!entry->etag.empty()) {
+            request->conditional = curl_slist_append(request->conditional, ("If-None-Match: " + entry->etag).c_str());
+        }
+        if (!entry->last_modified.empty()) {
+            request->conditional = curl_slist_append(request->conditional,
+                                                     ("If-Modified-Since: " + entry->last_modified).c_str());
+        }
+    }
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request->conditional != nullptr ? request->conditional : headers);
+    curl_easy_setopt(handle, CURLOPT_USERAGENT, USER_AGENT);
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, ""); // Every encoding curl supports
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS); // HTTP/1.1 for plain http
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L); // Prefer a stream on an existing connection to a new one
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, request->error);
+
+    if (const CURLMcode code = curl_multi_add_handle(multi, handle); code != CURLM_OK) {
+        curl_easy_cleanup(handle);
+        throw scryfall_error(curl_multi_strerror(code));
+    }
+    active.emplace(handle, std::move(request));
+    sent++;
+}
+
+void scryfall_client::finish(CURL* handle, const CURLcode result) {
+    auto node = active.extract(handle);
+    std::unique_ptr<transfer> request = std::move(node.mapped());
+    curl_multi_remove_handle(multi, handle);
+
+    long status = 0;
+    if (result == CURLE_OK) {
+        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+    }
+    curl_off_t retry_after = 0;
+    curl_easy_getinfo(handle, CURLINFO_RETRY_AFTER, &retry_after);
+    std::string etag;
+    std::string last_modified;
+    if (cache != nullptr && request->file_path.empty() && status == 200) {
+        curl_header* header = nullptr;
+        if (curl_easy_header(handle, "ETag", 0, CURLH_HEADER, -1, &header) == CURLHE_OK) {
+            etag = header->value;
+        }
+        if (curl_easy_header(handle, "Last-Modified", 0, CURLH_HEADER, -1, &header) == CURLHE_OK) {
+            last_modified = header->value;
+        }
+    }
+    curl_easy_reset(handle);
+    idle_handles.push_back(handle);
+    curl_slist_free_all(request->conditional);
+    request->conditional = nullptr;
+
+    const std::string part_path = request->file_path + PART_SUFFIX;
+    if (request->file != nullptr) {
+        std::fclose(request->file);
+        request->file = nullptr;
+    }
+
+    // Rate limited or temporarily unavailable: wait as long as the server asks and send it again
+    if ((status == 429 || status == 503) && request->retries < MAX_RETRIES) {
+        if (observer) {
+            scryfall_response attempt; // Every attempt is observed, so rate limited requests are audited too
+            attempt.url = request->url;
+            attempt.status = status;
+            attempt.error = request->file_path.empty() ? request->body : "HTTP " + std::to_string(status);
+            attempt.retries = request->retries;
+            observer(attempt);
+        }
+        request->retries++;
+        request->not_before = clock_type::now() +
+                              std::chrono::seconds(retry_after > 0 ? retry_after : DEFAULT_RETRY_AFTER_S);
+        delayed.push_back(std::move(request));
+        return;
+    }
+
+    scryfall_response response;
+    response.url = request->url;
+    response.status = status;
+    response.retries = request->retries;
+    response.ms = std::chrono::duration<double, std::milli>(clock_type::now() - request->start).count();
+    if (result != CURLE_OK) {
+        response.error = request->error[0] != '\0' ? request->error : curl_easy_strerror(result);
+    } else if (!response.ok()) {
+        response.error = request->file_path.empty() ? request->body : "HTTP " + std::to_string(status);
+    }
+    if (!request->file_path.empty()) {
+        std::error_code error;
+        if (response.ok()) {
+            fs::rename(part_path, request->file_path, error);
+            if (error) {
+                response.status = 0;
+                response.error = "Renaming " + part_path + " (" + error.message() + ")";
+            }
+        } else {
+            fs::remove(part_path, error);
+        }
+    } else {
+        response.body = std::move(request->body);
+    }
+
+    if (observer) {
+        observer(response);
+    }
+    if (cache != nullptr && request->file_path.empty()) {
+        if (status == 304) {
+            if (!cache->serve(request->url, response.body, true)) {
+                pending.push_back(std::move(request)); // Damaged entry (now dropped): fetch it in full
+                return;
+            }
+            response.status = 200;
+            response.error.clear();
+        } else if (status == 200) {
+            cache->store(request->url, etag, last_modified, response.body);
+        }
+    }
+    if (request->callback) {
+        request->callback(response);
+    }
+}
+
+void scryfall_client::serve_cached(std::unique_ptr<transfer> request) {
+    scryfall_response response;
+    response.url = request->url;
+    if (!cache->serve(request->url, response.body, false)) {
+        pending.push_back(std::move(request)); // Damaged entry (now dropped): fetch it instead
+        return;
+    }
+    response.status = 200;
+    if (request->callback) {
+        request->callback(response);
+    }
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+void fetch_all_pages(scryfall_client& client, const std::string& endpoint,
+                     std::function<void(const nlohmann::json&)> on_page,
+                     std::function<void(const page_summary&)> on_done) {
+    auto state = std::make_shared<listing>();
+    state->summary.endpoint = endpoint;
+    state->start = clock_type::now();
+    state->on_page = std::move(on_page);
+    state->on_done = std::move(on_done);
+    request_page(client, endpoint, state);
+}
+
+std::string print_page_summary(const page_summary& summary) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << summary.endpoint << ": ";
+    if (!summary.error.empty()) {
+        out << "failed after " << summary.pages << " pages (" << summary.error << ")\n";
+    } else {
+        out << summary.pages << " pages, " << summary.objects << " objects, "
+            << static_cast<double>(summary.bytes) / (1024.0 * 1024.0) << " MB in " << summary.ms << " ms\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,236 @@
+/**
+ * Scryfall client header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef SCRYFALL_H
+#define SCRYFALL_H
+#include <chrono>
+#include <curl/curl.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "http_cache.h"
+#include "token_bucket.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace scryfall_constants {
+    inline const char* BASE_URL = "https://api.scryfall.com/"; ///< Scryfall API root
+    inline const char* USER_AGENT = "fblthp-archive-1.0"; ///< User agent sent with every request
+    inline const char* ACCEPT = "Accept: application/json;q=0.9,*/*;q=0.8"; ///< Accept header sent with every request
+    inline const char* PART_SUFFIX = ".part"; ///< Suffix of downloads in progress
+    inline constexpr double REQUESTS_PER_SECOND = 10; ///< Sustained API request rate allowed by Scryfall
+    inline constexpr double BURST = 1; ///< API requests sent back to back after an idle period
+    inline constexpr long MAX_CONNECTIONS = 8; ///< Connections per host (HTTP/2 multiplexes over fewer)
+    inline constexpr int MAX_RETRIES = 3; ///< Retries of a rate limited (429) or unavailable (503) request
+    inline constexpr long DEFAULT_RETRY_AFTER_S = 1; ///< Wait before a retry when the server does not say
+    inline constexpr int POLL_TIMEOUT_MS = 1000; ///< Longest wait for network activity in the event loop
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the settings of a Scryfall client
+ */
+struct scryfall_options {
+    std::string base_url = scryfall_constants::BASE_URL; ///< API root (requests under it are rate limited)
+    double requests_per_second = scryfall_constants::REQUESTS_PER_SECOND; ///< Sustained API request rate
+    double burst = scryfall_constants::BURST; ///< API requests sent back to back after an idle period
+    long max_connections = scryfall_constants::MAX_CONNECTIONS; ///< Connections per host and transfers in flight
+};
+
+/**
+ * Struct to hold the outcome of a request
+ */
+struct scryfall_response {
+    std::string url; ///< Requested URL
+    long status = 0; ///< HTTP status (0 if the transfer failed)
+    std::string body; ///< Response body (empty for downloads)
+    std::string error; ///< Transfer error or body of a failed request (empty on success)
+    int retries = 0; ///< Number of retries before this response
+    double ms = 0; ///< Time from the first send to the response
+
+    /**
+     * Checks whether the request succeeded
+     * @return True for a 2xx status
+     */
+    [[nodiscard]] bool ok() const {return status >= 200 && status < 300;}
+};
+
+/**
+ * Struct to hold the summary of a paginated listing
+ */
+struct page_summary {
+    std::string endpoint; ///< Requested endpoint
+    int pages = 0; ///< Number of pages received
+    size_t objects = 0; ///< Number of objects in the data arrays of the pages
+    size_t bytes = 0; ///< Size of the pages
+    long status = 0; ///< Status of the last page
+    std::string error; ///< Error of the listing (empty on success)
+    double ms = 0; ///< Time from the first request to the last page
+};
+
+typedef std::function<void(scryfall_response&)> scryfall_callback; ///< Called with the response of a request
+typedef std::function<void(const scryfall_response&)> scryfall_observer; ///< Called with every response (audit log)
+
+/**
+ * Asynchronous Scryfall client on the curl multi interface. Requests are queued and sent from run(), which keeps up to
+ * max_connections transfers in flight per host over reused (HTTP/2 multiplexed where available) connections. Requests
+ * under the base URL go through a token bucket matching Scryfall's rate limit; other hosts (the file servers for
+ * icons and images) are not limited. Callbacks run on the thread calling run() and may queue further requests. With
+ * a cache set, fresh cached GET responses are served without a request and stale ones are revalidated
+ */
+class scryfall_client {
+    /**
+     * Struct to hold a queued or running request
+     */
+    struct transfer {
+        std::string url; ///< Requested URL
+        std::string file_path; ///< Destination of a download (empty to keep the body in memory)
+        scryfall_callback callback; ///< Completion callback
+        std::string body; ///< Body received so far
+        FILE* file = nullptr; ///< Partial download file
+        int retries = 0; ///< Retries so far
+        bool limited = false; ///< Whether the request goes through the rate limiter
+        std::chrono::steady_clock::time_point not_before; ///< Earliest time for a retry
+        std::chrono::steady_clock::time_point start; ///< Time of the first send
+        curl_slist* conditional = nullptr; ///< Headers with the cache validators (nullptr if there is no entry)
+        char error[CURL_ERROR_SIZE] = {}; ///< Transfer error message
+    };
+
+    scryfall_options options; ///< Client settings
+    CURLM* multi = nullptr; ///< Multi handle (owns the connection cache)
+    curl_slist* headers = nullptr; ///< Headers sent with every request
+    std::vector<CURL*> idle_handles; ///< Easy handles ready to be reused
+    std::deque<std::unique_ptr<transfer>> pending; ///< Requests waiting for a token or a connection
+    std::vector<std::unique_ptr<transfer>> delayed; ///< Retries waiting for their retry time
+    std::unordered_map<CURL*, std::unique_ptr<transfer>> active; ///< Transfers in flight by easy handle
+    token_bucket limiter; ///< API rate limiter
+    scryfall_observer observer; ///< Response observer
+    http_cache* cache = nullptr; ///< Response cache (nullptr to always fetch)
+    size_t sent = 0; ///< Requests sent, retries included
+
+    /**
+     * Sends a request on an idle (or new) easy handle
+     * @param request Request to send
+     */
+    void start(std::unique_ptr<transfer> request);
+
+    /**
+     * Completes a request from a fresh cache entry without sending it
+     * @param request Cached request
+     */
+    void serve_cached(std::unique_ptr<transfer> request);
+
+    /**
+     * Completes a transfer, retrying it or calling its callback
+     * @param handle Easy handle of the transfer
+     * @param result Result of the transfer
+     */
+    void finish(CURL* handle, CURLcode result);
+
+    /**
+     * Starts the queued requests allowed by the rate limiter and the connection limit
+     */
+    void admit();
+
+    /**
+     * Time the event loop may wait for network activity before a queued request is due
+     * @return Timeout in milliseconds
+     */
+    [[nodiscard]] int poll_timeout();
+public:
+    /**
+     * Creates a client
+     * @param client_options Client settings
+     * @throw scryfall_error if curl cannot be initialized
+     */
+    explicit scryfall_client(scryfall_options client_options = {});
+    ~scryfall_client();
+    scryfall_client(const scryfall_client&) = delete;
+    scryfall_client& operator=(const scryfall_client&) = delete;
+
+    /**
+     * Queues a GET request
+     * @param url Absolute URL, or endpoint relative to the base URL
+     * @param callback Called with the response
+     */
+    void get(const std::string& url, scryfall_callback callback);
+
+    /**
+     * Queues a download. The file is written next to its destination and renamed into place once complete
+     * @param url Absolute URL, or endpoint relative to the base URL
+     * @param file_path Destination of the download
+     * @param callback Called with the response (without body)
+     */
+    void download(const std::string& url, const std::string& file_path, scryfall_callback callback);
+
+    /**
+     * Sends the queued requests, and any queued by their callbacks, until none is left
+     * @throw scryfall_error if the event loop fails
+     */
+    void run();
+
+    /**
+     * Sets the observer called with every response before its callback
+     * @param response_observer Observer
+     */
+    void set_observer(scryfall_observer response_observer);
+
+    /**
+     * Sets the cache used by GET requests (downloads are not cached)
+     * @param response_cache Cache outliving the client, or nullptr to disable caching
+     */
+    void set_cache(http_cache* response_cache);
+
+    /**
+     * Headers sent with every request, as logged in the request history
+     * @return Newline separated headers
+     */
+    [[nodiscard]] static std::string request_headers();
+
+    /**
+     * Resolves an endpoint against the base URL
+     * @param url Absolute URL, or endpoint relative to the base URL
+     * @return Absolute URL
+     */
+    [[nodiscard]] std::string resolve(const std::string& url) const;
+
+    /**
+     * Number of requests sent so far, retries included
+     * @return Requests sent
+     */
+    [[nodiscard]] size_t requests() const {return sent;}
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Queues a paginated listing, following next_page until has_more is false. Independent listings queued together are
+ * fetched concurrently (the pages of one listing are necessarily sequential)
+ * @param client Scryfall client
+ * @param endpoint Endpoint of the first page
+ * @param on_page Called with every parsed page
+ * @param on_done Called with the summary once the last page arrives or a page fails
+ */
+void fetch_all_pages(scryfall_client& client, const std::string& endpoint,
+                     std::function<void(const nlohmann::json&)> on_page,
+                     std::function<void(const page_summary&)> on_done);
+
+/**
+ * Prints the summary of a paginated listing
+ * @param summary Listing summary
+ * @return String with the pages, objects and timings of the listing
+ */
+std::string print_page_summary(const page_summary& summary);
+
+#endif //SCRYFALL_H
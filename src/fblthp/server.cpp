@@ -0,0 +1,716 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "exceptions.h"
+
+using namespace server_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    constexpr uint64_t LISTEN_ID = 0; ///< Event id of the listening socket
+    constexpr uint64_t WAKE_ID = 1; ///< Event id of the response eventfd
+    constexpr uint64_t SIGNAL_ID = 2; ///< Event id of the signalfd
+    constexpr uint64_t FIRST_CLIENT_ID = 3; ///< Event id of the first client
+    constexpr std::string_view RARITY_LETTERS = "CURMSB?"; ///< Letter by rarity value
+
+    /**
+     * Builds the message of a failed system call
+     * @param action What was being done
+     * @return Message with the errno description
+     */
+    std::string system_error(const std::string& action) {
+        return action + " (" + std::strerror(errno) + ")";
+    }
+
+    /**
+     * Reads the data version of a connection, which changes every time another connection commits to the file
+     * @param reader Database connection
+     * @return Data version (empty on error)
+     */
+    std::string read_data_version(db_connection& reader) {
+        sqlite3_stmt* stmt = reader.cached(DATA_VERSION);
+        std::string version;
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_reset(stmt);
+        return version;
+    }
+
+    /**
+     * Checks whether a server answers on a socket path
+     * @param address Address of the socket
+     * @return True if a connection to the socket succeeds
+     */
+    bool socket_answers(const sockaddr_un& address) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        const bool answers = connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        close(fd);
+        return answers;
+    }
+
+    /**
+     * Reads a text field of a request
+     * @param request Request object
+     * @param field Field name
+     * @param required Whether the field must be present
+     * @return Value of the field (empty if it is absent and not required)
+     * @throw query_error if the field is required and absent, or not a string
+     */
+    std::string_view text_field(const nlohmann::json& request, const std::string& field, const bool required) {
+        const auto it = request.find(field);
+        if (it == request.end() || it->is_null()) {
+            if (required) {
+                throw query_error("Missing field " + field);
+            }
+            return {};
+        }
+        if (!it->is_string()) {
+            throw query_error("Field " + field + " must be a string");
+        }
+        return it->get_ref<const std::string&>();
+    }
+
+    /**
+     * Reads a column of the current row of a statement into a JSON value
+     * @param stmt Statement
+     * @param column Column index
+     * @return Text of the column, or null
+     */
+    nlohmann::ordered_json column_json(sqlite3_stmt* stmt, const int column) {
+        if (sqlite3_column_type(stmt, column) == SQLITE_NULL) {
+            return nullptr;
+        }
+        return std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, column)),
+                           sqlite3_column_bytes(stmt, column));
+    }
+
+    /**
+     * Answers a card request through a reader connection
+     * @param reader Read-only connection of the worker
+     * @param set Set code
+     * @param number Collector number
+     * @return Card object, or null if the printing is unknown
+     * @throw database_error if the card cannot be read
+     */
+    nlohmann::ordered_json read_card(db_connection& reader, const std::string_view set, const std::string_view number) {
+        sqlite3_stmt* stmt = reader.cached(CARD_QUERY);
+        sqlite3_bind_text(stmt, 1, set.data(), static_cast<int>(set.size()), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, number.data(), static_cast<int>(number.size()), SQLITE_STATIC);
+        nlohmann::ordered_json card = nullptr;
+        const int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            card = nlohmann::ordered_json::object();
+            for (int column = 0; column < sqlite3_column_count(stmt); column++) {
+                card[sqlite3_column_name(stmt, column)] = column_json(stmt, column);
+            }
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+            throw database_error(std::string("Reading card (") + sqlite3_errmsg(reader.get()) + ")");
+        }
+        return card;
+    }
+}
+
+// Snapshot functions
+// ---------------------------------------------------------------------------------------------------------------------
+server_snapshot::server_snapshot(db_connection& reader, const trigram_index& previous)
+    : copies(store), names(previous) {
+    const auto start = std::chrono::steady_clock::now();
+    reader.exec("BEGIN;");
+    try {
+        data_version = read_data_version(reader);
+        store = load_collection(reader.get());
+        names.refresh(reader.get());
+        reader.exec("COMMIT;");
+    } catch (...) {
+        sqlite3_exec(reader.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+    copies = copy_table(store);
+
+    // Rows grouped by card name (counting sort on the name ids)
+    const size_t name_count = store.names.values.size();
+    printing_offsets.assign(name_count + 1, 0);
+    for (const uint32_t name : store.name) {
+        printing_offsets[name + 1]++;
+    }
+    for (size_t name = 0; name < name_count; name++) {
+        printing_offsets[name + 1] += printing_offsets[name];
+    }
+    std::vector<uint32_t> next(printing_offsets.begin(), printing_offsets.end() - 1);
+    printing_rows.resize(store.size());
+    for (uint32_t row = 0; row < store.size(); row++) {
+        printing_rows[next[store.name[row]]++] = row;
+    }
+    load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Server functions
+// ---------------------------------------------------------------------------------------------------------------------
+collection_server::collection_server(server_options settings) : options(std::move(settings)) {
+    // SIGINT and SIGTERM are read from a signalfd, blocked before the threads start so none of them takes them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous_signals);
+
+    try {
+        // Reader connections and the first snapshot, so the first requests are already served from memory
+        const unsigned int workers = options.readers > 0 ? options.readers
+                                                         : std::max(std::thread::hardware_concurrency(), 1u);
+        refresh_reader = std::make_unique<db_connection>(options.db_path, database_profiles::READ_ONLY,
+                                                         SQLITE_OPEN_READONLY);
+        for (unsigned int i = 0; i < workers; i++) {
+            readers.push_back(std::make_unique<db_connection>(options.db_path, database_profiles::READ_ONLY,
+                                                              SQLITE_OPEN_READONLY));
+        }
+        snapshot = std::make_shared<const server_snapshot>(*refresh_reader, trigram_index());
+
+        // Clients are capped below the descriptor limit, raised to its hard maximum
+        if (rlimit limit{}; getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+            if (limit.rlim_cur < limit.rlim_max) {
+                limit.rlim_cur = limit.rlim_max;
+                setrlimit(RLIMIT_NOFILE, &limit);
+                getrlimit(RLIMIT_NOFILE, &limit);
+            }
+            const size_t reserved = RESERVED_FDS + 3 * readers.size(); // Database, WAL and shared memory per reader
+            max_clients = std::min<size_t>(MAX_CLIENTS, limit.rlim_cur > reserved ? limit.rlim_cur - reserved : 1);
+        }
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options.socket_path.empty() || options.socket_path.size() >= sizeof(address.sun_path)) {
+            throw server_error("Invalid socket path " + options.socket_path);
+        }
+        std::memcpy(address.sun_path, options.socket_path.c_str(), options.socket_path.size() + 1);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            throw server_error(system_error("Creating socket"));
+        }
+        if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            // A socket file left by a server that did not shut down cleanly is replaced
+            if (errno != EADDRINUSE) {
+                throw server_error(system_error("Binding " + options.socket_path));
+            }
+            if (socket_answers(address)) {
+                throw server_error("Another server answers on " + options.socket_path);
+            }
+            unlink(options.socket_path.c_str());
+            if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                throw server_error(system_error("Binding " + options.socket_path));
+            }
+        }
+        bound = true;
+        if (listen(listen_fd, LISTEN_BACKLOG) != 0) {
+            throw server_error(system_error("Listening on " + options.socket_path));
+        }
+
+        signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (signal_fd < 0 || wake_fd < 0 || epoll_fd < 0) {
+            throw server_error(system_error("Creating event loop"));
+        }
+        for (const auto& [fd, id] : {std::pair{listen_fd, LISTEN_ID}, {wake_fd, WAKE_ID}, {signal_fd, SIGNAL_ID}}) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = id;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                throw server_error(system_error("Registering event"));
+            }
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+    next_client = FIRST_CLIENT_ID;
+
+    for (const auto& reader : readers) {
+        threads.emplace_back([this, connection = reader.get()] {serve_requests(*connection);});
+    }
+    threads.emplace_back([this] {refresh_snapshots();});
+}
+
+collection_server::~collection_server() {
+    stopping.store(true);
+    { const std::lock_guard lock(jobs_mutex); } // Pairs with the waits so the wake ups are not missed
+    jobs_ready.notify_all();
+    { const std::lock_guard lock(refresh_mutex); }
+    refresh_wake.notify_all();
+    threads.clear();
+    while (!clients.empty()) {
+        close_client(clients.begin()->first);
+    }
+    release();
+}
+
+void collection_server::release() {
+    for (int* fd : {&listen_fd, &epoll_fd, &wake_fd, &signal_fd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    if (bound) {
+        unlink(options.socket_path.c_str());
+        bound = false;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous_signals, nullptr);
+}
+
+std::shared_ptr<const server_snapshot> collection_server::resident() const {
+    const std::lock_guard lock(snapshot_mutex);
+    return snapshot;
+}
+
+server_stats collection_server::stats() const {
+    const std::lock_guard lock(stats_mutex);
+    return counters;
+}
+
+void collection_server::run() {
+    std::array<epoll_event, MAX_EVENTS> events{};
+    std::vector<uint64_t> turns;
+    while (!stopping.load()) {
+        const int ready = epoll_wait(epoll_fd, events.data(), MAX_EVENTS, backlog.empty() ? -1 : 0);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw server_error(system_error("Waiting for events"));
+        }
+        for (int i = 0; i < ready; i++) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                accept_clients();
+            } else if (id == WAKE_ID) {
+                uint64_t count;
+                [[maybe_unused]] const ssize_t drained = read(wake_fd, &count, sizeof(count));
+                deliver_responses();
+            } else if (id == SIGNAL_ID) {
+                signalfd_siginfo info{};
+                [[maybe_unused]] const ssize_t drained = read(signal_fd, &info, sizeof(info));
+                stopping.store(true);
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                close_client(id); // Gone in both directions, nothing can be sent to it anymore
+            } else if (events[i].events & EPOLLIN) {
+                read_client(id);
+            } else {
+                advance_client(id);
+            }
+        }
+        turns.swap(backlog);
+        for (const uint64_t id : turns) {
+            advance_client(id);
+        }
+        turns.clear();
+    }
+}
+
+void collection_server::serve_requests(db_connection& reader) {
+    while (true) {
+        job next;
+        {
+            std::unique_lock lock(jobs_mutex);
+            jobs_ready.wait(lock, [this] {return stopping.load() || !jobs.empty();});
+            if (stopping.load()) {
+                return;
+            }
+            next = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        completion result = answer(next.request, &reader);
+        result.client = next.client;
+        result.received = next.received;
+
+        // The event loop is only woken by the first response of a batch, it takes them all at once
+        bool first;
+        {
+            const std::lock_guard lock(done_mutex);
+            first = done.empty();
+            done.push_back(std::move(result));
+        }
+        if (first) {
+            constexpr uint64_t one = 1;
+            [[maybe_unused]] const ssize_t written = write(wake_fd, &one, sizeof(one));
+        }
+    }
+}
+
+void collection_server::refresh_snapshots() {
+    std::string version = resident()->data_version;
+    while (true) {
+        {
+            std::unique_lock lock(refresh_mutex);
+            if (refresh_wake.wait_for(lock, std::chrono::milliseconds(REFRESH_INTERVAL_MS),
+                                      [this] {return stopping.load();})) {
+                return;
+            }
+        }
+        try {
+            if (read_data_version(*refresh_reader) == version) {
+                continue;
+            }
+            auto next = std::make_shared<const server_snapshot>(*refresh_reader, resident()->names);
+            version = next->data_version;
+            {
+                const std::lock_guard lock(snapshot_mutex);
+                snapshot = std::move(next);
+            }
+            const std::lock_guard lock(stats_mutex);
+            counters.refreshes++;
+        } catch (const std::exception&) {
+            // The current snapshot keeps being served and the next poll tries again
+        }
+    }
+}
+
+collection_server::completion collection_server::answer(const nlohmann::json& request, db_connection* reader) const {
+    completion result{};
+    result.op = "invalid";
+    nlohmann::ordered_json response;
+    try {
+        if (!request.is_object()) {
+            throw query_error("Malformed request");
+        }
+        if (const auto id = request.find("id"); id != request.end()) {
+            response["id"] = *id;
+        }
+        response["ok"] = true;
+        const std::string op(text_field(request, "op", true));
+        const std::shared_ptr<const server_snapshot> state = resident();
+        const collection_store& store = state->store;
+        result.op = op;
+
+        if (op == "ping") {
+            response["data_version"] = state->data_version;
+        } else if (op == "query") {
+            const collection_filter filter = parse_filter(text_field(request, "filter", false), store);
+            const std::vector<uint64_t> by_set = sum_quantity_by_set(store, filter);
+            uint64_t copies = 0;
+            nlohmann::ordered_json sets = nlohmann::ordered_json::object();
+            for (size_t set = 0; set < by_set.size(); set++) {
+                if (by_set[set] > 0) {
+                    copies += by_set[set];
+                    sets[store.sets.values[set]] = by_set[set];
+                }
+            }
+            response["rows"] = select_rows(store, filter).size();
+            response["copies"] = copies;
+            response["sets"] = std::move(sets);
+        } else if (op == "search") {
+            size_t limit = DEFAULT_RESULTS;
+            if (const auto field = request.find("limit"); field != request.end() && !field->is_null()) {
+                if (!field->is_number_unsigned()) {
+                    throw query_error("Field limit must be a positive integer");
+                }
+                limit = std::min<size_t>(field->get<size_t>(), MAX_RESULTS);
+            }
+            nlohmann::ordered_json hits = nlohmann::ordered_json::array();
+            for (const auto& hit : state->names.search(text_field(request, "name", true), limit)) {
+                hits.push_back({{"name", hit.name}, {"kind", hit.kind == name_kind::SET ? "set" : "card"},
+                                {"score", hit.score}});
+            }
+            response["hits"] = std::move(hits);
+        } else if (op == "owned") {
+            std::optional<bool> foil;
+            if (const auto field = request.find("foil"); field != request.end() && !field->is_null()) {
+                if (!field->is_boolean()) {
+                    throw query_error("Field foil must be a boolean");
+                }
+                foil = field->get<bool>();
+            }
+            const std::optional<copy_entry> entry = state->copies.find(copy_key(
+                text_field(request, "name", true), text_field(request, "set", false), foil));
+            response["copies"] = entry ? entry->quantity : 0;
+        } else if (op == "printings") {
+            nlohmann::ordered_json printings = nlohmann::ordered_json::array();
+            if (const auto name = store.names.find(text_field(request, "name", true))) {
+                for (uint32_t i = state->printing_offsets[*name]; i < state->printing_offsets[*name + 1]; i++) {
+                    const uint32_t row = state->printing_rows[i];
+                    printings.push_back({{"set", store.sets.values[store.set[row]]},
+                                         {"number", store.numbers.values[store.number[row]]},
+                                         {"rarity", std::string(1, RARITY_LETTERS[store.rarity[row]])},
+                                         {"quantity", store.quantity[row]}, {"foil", store.foil[row] == 1},
+                                         {"colors", color_letters(store.colors[row])},
+                                         {"color_id", color_letters(store.color_identity[row])}});
+                }
+            }
+            response["printings"] = std::move(printings);
+        } else if (op == "card") {
+            response["card"] = read_card(*reader, text_field(request, "set", true),
+                                         text_field(request, "number", true));
+        } else if (op == "stats") {
+            const server_stats current = stats();
+            nlohmann::ordered_json latency = nlohmann::ordered_json::object();
+            for (const auto& [name, histogram] : current.latency) {
+                latency[name] = {{"count", histogram.count()},
+                                 {"p50_us", static_cast<double>(histogram.percentile(0.5)) / 1e3},
+                                 {"p99_us", static_cast<double>(histogram.percentile(0.99)) / 1e3},
+                                 {"max_us", static_cast<double>(histogram.max()) / 1e3}};
+            }
+            response["requests"] = current.requests;
+            response["errors"] = current.errors;
+            response["clients"] = current.clients;
+            response["rejected"] = current.rejected;
+            response["refreshes"] = current.refreshes;
+            response["readers"] = readers.size();
+            response["rows"] = store.size();
+            response["names"] = state->names.size();
+            response["data_version"] = state->data_version;
+            response["load_ms"] = state->load_ms;
+            response["latency"] = std::move(latency);
+        } else {
+            result.op = "unknown";
+            throw query_error("Unknown operation " + op);
+        }
+    } catch (const std::exception& e) {
+        const nlohmann::ordered_json id = response.contains("id") ? response["id"] : nullptr;
+        response = nlohmann::ordered_json::object();
+        if (!id.is_null()) {
+            response["id"] = id;
+        }
+        response["ok"] = false;
+        response["error"] = e.what();
+        result.failed = true;
+    }
+    result.response = response.dump(-1, ' ', false, nlohmann::ordered_json::error_handler_t::replace) + "\n";
+    return result;
+}
+
+void collection_server::accept_clients() {
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return; // EAGAIN once the queue is empty
+        }
+        if (clients.size() >= max_clients) {
+            static const std::string rejected = R"({"ok":false,"error":"Too many clients"})" "\n";
+            [[maybe_unused]] const ssize_t sent = send(fd, rejected.data(), rejected.size(),
+                                                       MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(fd);
+            const std::lock_guard lock(stats_mutex);
+            counters.rejected++;
+            continue;
+        }
+
+        const uint64_t id = next_client++;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        clients.emplace(id, client{fd, {}, {}, 0, EPOLLIN});
+        const std::lock_guard lock(stats_mutex);
+        counters.clients++;
+    }
+}
+
+void collection_server::read_client(const uint64_t id) {
+    const auto it = clients.find(id);
+    if (it == clients.end()) {
+        return;
+    }
+    client& peer = it->second;
+    std::array<char, READ_CHUNK> buffer;
+    while (peer.in.size() < MAX_REQUEST_BYTES) {
+        const ssize_t count = recv(peer.fd, buffer.data(), buffer.size(), 0);
+        if (count > 0) {
+            peer.in.append(buffer.data(), count);
+        } else if (count == 0) {
+            // The client is done writing, its buffered requests are still answered (the last one unterminated)
+            if (!peer.in.empty() && peer.in.back() != '\n') {
+                peer.in += '\n';
+            }
+            peer.closing = true;
+            break;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            close_client(id);
+            return;
+        }
+    }
+    advance_client(id);
+}
+
+bool collection_server::send_pending(client& peer) {
+    while (peer.sent < peer.out.size()) {
+        const ssize_t count = send(peer.fd, peer.out.data() + peer.sent, peer.out.size() - peer.sent, MSG_NOSIGNAL);
+        if (count > 0) {
+            peer.sent += count;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+    peer.out.clear();
+    peer.sent = 0;
+    return true;
+}
+
+void collection_server::advance_client(const uint64_t id) {
+    const auto it = clients.find(id);
+    if (it == clients.end()) {
+        return;
+    }
+    client& peer = it->second;
+    for (size_t turn = 0; true; turn++) {
+        // Answer or hand off the next request once the previous response is sent
+        if (!peer.busy && peer.out.empty()) {
+            for (size_t end = peer.in.find('\n'); end != std::string::npos; end = peer.in.find('\n')) {
+                std::string line = peer.in.substr(0, end);
+                peer.in.erase(0, end + 1);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (line.empty()) {
+                    continue;
+                }
+                dispatch(id, peer, line);
+                break;
+            }
+            if (!peer.busy && peer.out.empty() && peer.in.size() >= MAX_REQUEST_BYTES) {
+                peer.out = R"({"ok":false,"error":"Request longer than )" + std::to_string(MAX_REQUEST_BYTES) +
+                           R"( bytes"})" "\n";
+                peer.in.clear();
+                peer.closing = true;
+            }
+        }
+        if (!send_pending(peer)) {
+            close_client(id);
+            return;
+        }
+        if (peer.busy || !peer.out.empty()) {
+            break; // Waiting for a worker or for the socket
+        }
+        if (peer.in.find('\n') != std::string::npos) {
+            if (turn + 1 < LOOP_BATCH) {
+                continue; // The response was sent at once, the next request can go
+            }
+            backlog.push_back(id); // The other clients go first
+            break;
+        }
+        if (peer.closing) {
+            close_client(id);
+            return;
+        }
+        break;
+    }
+
+    // Read only while the buffer has room, so a client flooding requests waits for its responses
+    uint32_t events = 0;
+    if (!peer.closing && peer.in.size() < MAX_REQUEST_BYTES) {
+        events |= EPOLLIN;
+    }
+    if (!peer.out.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != peer.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, peer.fd, &event);
+        peer.events = events;
+    }
+}
+
+void collection_server::deliver_responses() {
+    std::vector<completion> ready;
+    {
+        const std::lock_guard lock(done_mutex);
+        ready.swap(done);
+    }
+    const auto now = clock_type::now();
+    for (auto& response : ready) {
+        count_response(response, now);
+        const auto it = clients.find(response.client);
+        if (it == clients.end()) {
+            continue; // Closed while its request was with the workers
+        }
+        it->second.out += response.response;
+        it->second.busy = false;
+        advance_client(response.client);
+    }
+}
+
+void collection_server::dispatch(const uint64_t id, client& peer, const std::string& line) {
+    const auto received = clock_type::now();
+    nlohmann::json request = nlohmann::json::parse(line, nullptr, false);
+    const auto op = request.is_object() ? request.find("op") : request.end();
+    const bool on_loop = op == request.end() || !op->is_string() ||
+                         std::ranges::find(LOOP_OPERATIONS, op->get_ref<const std::string&>()) != LOOP_OPERATIONS.end();
+    if (on_loop) {
+        completion result = answer(request, nullptr);
+        result.received = received;
+        count_response(result, clock_type::now());
+        peer.out += result.response;
+        return;
+    }
+
+    peer.busy = true;
+    {
+        const std::lock_guard lock(jobs_mutex);
+        jobs.push_back({id, std::move(request), received});
+    }
+    jobs_ready.notify_one();
+}
+
+void collection_server::count_response(const completion& response, const clock_type::time_point answered) {
+    const std::lock_guard lock(stats_mutex);
+    counters.requests++;
+    counters.errors += response.failed ? 1 : 0;
+    counters.latency[response.op].record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(answered - response.received).count());
+}
+
+void collection_server::close_client(const uint64_t id) {
+    const auto it = clients.find(id);
+    if (it == clients.end()) {
+        return;
+    }
+    close(it->second.fd); // Also removes it from the epoll set
+    clients.erase(it);
+}
+
+// Print functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string print_server_stats(const server_stats& stats) {
+    std::ostringstream out;
+    out << "Served " << stats.requests << " requests (" << stats.errors << " errors) to " << stats.clients
+        << " clients (" << stats.rejected << " rejected), " << stats.refreshes << " snapshot refreshes\n";
+    out << std::fixed << std::setprecision(1);
+    for (const auto& [op, histogram] : stats.latency) {
+        out << "  " << std::left << std::setw(10) << op << std::right << std::setw(10) << histogram.count()
+            << " requests, p50 " << static_cast<double>(histogram.percentile(0.5)) / 1e3 << " us, p99 "
+            << static_cast<double>(histogram.percentile(0.99)) / 1e3 << " us, max "
+            << static_cast<double>(histogram.max()) / 1e3 << " us\n";
+    }
+    return out.str();
+}
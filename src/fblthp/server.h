@@ -0,0 +1,317 @@
+/**
+ * Collection server over a Unix domain socket header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "collection.h"
+#include "database.h"
+#include "decks.h"
+#include "profiler.h"
+#include "trigram.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace server_constants {
+    inline const char* CARD_QUERY = "SELECT scryfall_id, name, mana_cost, type_line, oracle_text, rarity, colors, "
+                                    "color_identity, power, toughness FROM card "
+                                    "WHERE \"set\" = ? AND collector_number = ?;"; ///< SQL statement of a card
+    inline const char* DATA_VERSION = "PRAGMA data_version;"; ///< SQL statement reading the data version
+    inline constexpr size_t MAX_REQUEST_BYTES = 64 * 1024; ///< Longest request line (longer ones close the client)
+    inline constexpr size_t MAX_CLIENTS = 4096; ///< Clients served at once (capped by the file descriptor limit)
+    inline constexpr size_t RESERVED_FDS = 64; ///< Descriptors kept for the database files and the server itself
+    inline constexpr int LISTEN_BACKLOG = 1024; ///< Pending connections the socket queues
+    inline constexpr int MAX_EVENTS = 256; ///< Events taken from epoll per wait
+    inline constexpr size_t LOOP_BATCH = 32; ///< Pipelined requests of a client answered before the others get a turn
+    inline constexpr size_t READ_CHUNK = 16 * 1024; ///< Bytes read from a client at once
+    inline constexpr int REFRESH_INTERVAL_MS = 1000; ///< Interval between two checks for commits to the database
+    inline constexpr size_t DEFAULT_RESULTS = 10; ///< Search hits returned when the request sets no limit
+    inline constexpr size_t MAX_RESULTS = 100; ///< Largest search limit
+
+    /**
+     * Operations answered on the event loop: constant time lookups in the snapshot, cheaper than the hand off to a
+     * worker and back. The others (scans, searches and database reads) go to the workers
+     */
+    inline constexpr std::array<std::string_view, 4> LOOP_OPERATIONS = {"ping", "owned", "printings", "stats"};
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the settings of a server
+ */
+struct server_options {
+    std::string db_path; ///< Path of the database
+    std::string socket_path; ///< Path of the Unix domain socket
+    unsigned int readers = 0; ///< Reader connections, one per worker (0 for the hardware concurrency)
+};
+
+/**
+ * Resident state of the server, built from one read transaction and shared by the workers until a commit to the
+ * database replaces it. It is never modified once published, so the workers read it without locks
+ */
+struct server_snapshot {
+    collection_store store; ///< Collection in a columnar store
+    copy_table copies; ///< Copies owned by name, set and finish
+    trigram_index names; ///< Card and set names
+    std::vector<uint32_t> printing_offsets; ///< Start of every card name in printing_rows (plus the end)
+    std::vector<uint32_t> printing_rows; ///< Rows of the store grouped by card name
+    std::string data_version; ///< Data version of the database when the snapshot was read
+    double load_ms = 0; ///< Time the snapshot took to build
+
+    /**
+     * Builds a snapshot
+     * @param reader Read-only connection (runs the reads in one transaction)
+     * @param previous Names of the previous snapshot, refreshed with the changes since (rebuilt if a name is gone)
+     * @throw query_error if the collection cannot be read
+     * @throw database_error if the read transaction fails
+     */
+    server_snapshot(db_connection& reader, const trigram_index& previous);
+};
+
+/**
+ * Struct to hold the statistics of a server
+ */
+struct server_stats {
+    uint64_t clients = 0; ///< Clients accepted
+    uint64_t rejected = 0; ///< Clients turned away at MAX_CLIENTS
+    uint64_t requests = 0; ///< Requests answered
+    uint64_t errors = 0; ///< Requests answered with an error
+    uint64_t refreshes = 0; ///< Snapshots rebuilt after a commit
+    std::map<std::string, latency_histogram> latency; ///< Time from receiving to answering a request by operation
+};
+
+/**
+ * Long-running server keeping the collection resident and answering lookups over a Unix domain socket. Requests and
+ * responses are JSON objects, one per line: {"op": "...", ...} with an optional "id" echoed back, answered with
+ * {"ok": true, ...} or {"ok": false, "error": "..."}. Operations:
+ *   ping                                   liveness check
+ *   query {filter}                         rows, copies and copies by set matching a filter (see parse_filter)
+ *   search {name, limit}                   card and set names by partial or misspelled name
+ *   owned {name, set, foil}                copies owned of a card, optionally of a set and a finish
+ *   printings {name}                       collection rows of a card name
+ *   card {set, number}                     Scryfall card of a printing, read through a reader connection
+ *   stats                                  server counters and latency percentiles by operation
+ * A single thread runs an epoll loop that accepts clients, reads requests and writes responses without blocking.
+ * It answers the LOOP_OPERATIONS itself and hands the other requests to a pool of workers, each owning a read-only
+ * connection with its statement cache, which answer from the resident snapshot or the database. A client has one
+ * request in flight, so its responses keep the order of its requests, and it is not read while a request line is
+ * already buffered or its responses wait to be sent. A refresher polls the data version and, after a commit by
+ * another connection (an import, an ingest), builds a new snapshot off the request path and swaps it in
+ */
+class collection_server {
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * Struct to hold a request waiting for a worker
+     */
+    struct job {
+        uint64_t client; ///< Client id
+        nlohmann::json request; ///< Parsed request
+        clock_type::time_point received; ///< Time the request was read
+    };
+
+    /**
+     * Struct to hold the response of a worker
+     */
+    struct completion {
+        uint64_t client; ///< Client id
+        std::string response; ///< Response line (newline terminated)
+        std::string op; ///< Operation of the request
+        bool failed; ///< Whether the response is an error
+        clock_type::time_point received; ///< Time the request was read
+    };
+
+    /**
+     * Struct to hold a connected client (owned by the event loop)
+     */
+    struct client {
+        int fd; ///< Socket
+        std::string in; ///< Bytes read and not yet handled
+        std::string out; ///< Bytes to send
+        size_t sent = 0; ///< Bytes of out already sent
+        uint32_t events = 0; ///< Events the socket is registered for
+        bool busy = false; ///< Whether a request of the client is with the workers
+        bool closing = false; ///< Whether the client is closed once out is sent
+    };
+
+    server_options options; ///< Settings
+    int listen_fd = -1; ///< Listening socket
+    int epoll_fd = -1; ///< Event loop
+    int wake_fd = -1; ///< eventfd signalled when responses are ready
+    int signal_fd = -1; ///< signalfd of SIGINT and SIGTERM
+    bool bound = false; ///< Whether the socket file was created by the server
+    size_t max_clients = server_constants::MAX_CLIENTS; ///< Clients served at once
+    std::unordered_map<uint64_t, client> clients; ///< Connected clients by id
+    uint64_t next_client = 0; ///< Id of the next client
+    std::vector<uint64_t> backlog; ///< Clients with requests left in their buffer after their turn
+    sigset_t previous_signals{}; ///< Signal mask before the server blocked SIGINT and SIGTERM
+    std::atomic<bool> stopping{false}; ///< Set when the server shuts down
+
+    mutable std::mutex snapshot_mutex; ///< Guards the published snapshot pointer
+    std::shared_ptr<const server_snapshot> snapshot; ///< Published snapshot
+
+    std::mutex jobs_mutex; ///< Guards the job queue
+    std::condition_variable jobs_ready; ///< Wakes a worker for a job or shutdown
+    std::deque<job> jobs; ///< Requests waiting for a worker
+    std::mutex done_mutex; ///< Guards the completions
+    std::vector<completion> done; ///< Responses waiting for the event loop
+
+    mutable std::mutex stats_mutex; ///< Guards the statistics (the stats operation reads them from a worker)
+    server_stats counters; ///< Statistics
+
+    std::unique_ptr<db_connection> refresh_reader; ///< Connection of the refresher
+    std::vector<std::unique_ptr<db_connection>> readers; ///< Connections of the workers
+    std::mutex refresh_mutex; ///< Guards the refresher wake up
+    std::condition_variable refresh_wake; ///< Wakes the refresher for shutdown
+    std::vector<std::jthread> threads; ///< Workers and refresher
+
+    /**
+     * Answers requests until the server shuts down
+     * @param reader Read-only connection of the worker
+     */
+    void serve_requests(db_connection& reader);
+
+    /**
+     * Rebuilds the snapshot after every commit to the database until the server shuts down
+     */
+    void refresh_snapshots();
+
+    /**
+     * Answers a request
+     * @param request Parsed request (discarded or not an object if it is malformed)
+     * @param reader Read-only connection of the worker (null on the event loop)
+     * @return Response to the request
+     */
+    completion answer(const nlohmann::json& request, db_connection* reader) const;
+
+    /**
+     * Answers a request line of a client on the event loop, or hands it to the workers
+     * @param id Client id
+     * @param peer Client
+     * @param line Request line
+     */
+    void dispatch(uint64_t id, client& peer, const std::string& line);
+
+    /**
+     * Adds an answered request to the statistics
+     * @param response Response to the request
+     * @param answered Time the response was handed to the event loop
+     */
+    void count_response(const completion& response, clock_type::time_point answered);
+
+    /**
+     * Accepts the pending clients
+     */
+    void accept_clients();
+
+    /**
+     * Reads from a client and hands its next request to the workers
+     * @param id Client id
+     */
+    void read_client(uint64_t id);
+
+    /**
+     * Sends as much of the pending responses of a client as its socket takes
+     * @param peer Client
+     * @return False if the socket failed
+     */
+    static bool send_pending(client& peer);
+
+    /**
+     * Moves a client forward: hands its next buffered request to the workers once its previous response is sent,
+     * sends its responses, closes it once a closing client has nothing left, and updates the events its socket is
+     * registered for
+     * @param id Client id
+     */
+    void advance_client(uint64_t id);
+
+    /**
+     * Delivers the responses of the workers to their clients
+     */
+    void deliver_responses();
+
+    /**
+     * Closes a client
+     * @param id Client id
+     */
+    void close_client(uint64_t id);
+
+    /**
+     * Closes the descriptors of the server, removes its socket file and restores the signal mask
+     */
+    void release();
+public:
+    /**
+     * Builds the first snapshot, opens the reader connections and binds the socket. A socket file no server
+     * answers on is replaced
+     * @param settings Server settings
+     * @throw server_error if the socket cannot be bound or another server answers on it
+     * @throw database_error if a reader connection cannot be opened
+     * @throw query_error if the collection cannot be read
+     */
+    explicit collection_server(server_options settings);
+
+    /**
+     * Stops the workers, closes the clients and removes the socket file
+     */
+    ~collection_server();
+    collection_server(const collection_server&) = delete;
+    collection_server& operator=(const collection_server&) = delete;
+
+    /**
+     * Serves clients until SIGINT or SIGTERM
+     * @throw server_error if the event loop fails
+     */
+    void run();
+
+    /**
+     * Statistics of the server
+     * @return Copy of the statistics
+     */
+    [[nodiscard]] server_stats stats() const;
+
+    /**
+     * Number of reader connections
+     * @return Workers answering requests
+     */
+    [[nodiscard]] size_t reader_count() const {return readers.size();}
+
+    /**
+     * Published snapshot
+     * @return Snapshot (kept alive by the caller while it reads it)
+     */
+    [[nodiscard]] std::shared_ptr<const server_snapshot> resident() const;
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Prints the statistics of a server
+ * @param stats Server statistics
+ * @return String with the counters and a latency line per operation
+ */
+std::string print_server_stats(const server_stats& stats);
+
+#endif //SERVER_H
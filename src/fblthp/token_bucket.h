@@ -0,0 +1,77 @@
+/**
+ * Token bucket rate limiter header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+#include <algorithm>
+#include <chrono>
+
+/**
+ * Token bucket rate limiter. Tokens accrue continuously at the configured rate up to the burst size and every request
+ * spends one, so the long-run request rate never exceeds the limit while idle time is not wasted on fixed sleeps.
+ * Not thread safe: it is owned by the thread driving the requests
+ */
+class token_bucket {
+public:
+    using clock = std::chrono::steady_clock;
+private:
+    double rate; ///< Tokens added per second
+    double burst; ///< Maximum number of stored tokens
+    double tokens; ///< Tokens currently available
+    clock::time_point last; ///< Last time the tokens were refilled
+
+    /**
+     * Adds the tokens accrued since the last refill
+     * @param now Current time
+     */
+    void refill(const clock::time_point now) {
+        if (now > last) {
+            tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * rate);
+            last = now;
+        }
+    }
+public:
+    /**
+     * Creates a full bucket
+     * @param requests_per_second Sustained request rate (0 or less for no limit)
+     * @param burst_size Requests that may be sent back to back after an idle period (at least 1)
+     */
+    token_bucket(const double requests_per_second, const double burst_size)
+        : rate(requests_per_second), burst(std::max(burst_size, 1.0)), tokens(burst), last(clock::now()) {}
+
+    /**
+     * Spends a token if one is available
+     * @param now Current time
+     * @return True if the request may be sent now
+     */
+    bool try_acquire(const clock::time_point now = clock::now()) {
+        if (rate <= 0) {
+            return true; // Unlimited
+        }
+        refill(now);
+        if (tokens >= 1.0) {
+            tokens -= 1.0;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Time until the next token is available
+     * @param now Current time
+     * @return Wait time (zero if a token is available)
+     */
+    clock::duration wait_time(const clock::time_point now = clock::now()) {
+        refill(now);
+        if (tokens >= 1.0 || rate <= 0) {
+            return clock::duration::zero();
+        }
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>((1.0 - tokens) / rate));
+    }
+};
+
+#endif //TOKEN_BUCKET_H
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "trigram.h"
+#include "exceptions.h"
+
+using namespace trigram_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Checks whether a byte is part of a word (ASCII alphanumerics and every non-ASCII byte, so UTF-8 letters are
+     * kept as they are)
+     * @param c Byte to check
+     * @return True if the byte is part of a word
+     */
+    bool is_word_byte(const unsigned char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+    }
+
+    /**
+     * Lowercases a name and collapses every run of other characters to one space, without padding
+     * @param name Name to clean
+     * @return Words of the name separated by single spaces
+     */
+    std::string clean_name(const std::string_view name) {
+        std::string clean;
+        clean.reserve(name.size());
+        for (const char c : name) {
+            const auto byte = static_cast<unsigned char>(c);
+            if (is_word_byte(byte)) {
+                clean += byte < 0x80 ? static_cast<char>(byte | 0x20 * (byte >= 'A' && byte <= 'Z')) : c;
+            } else if (!clean.empty() && clean.back() != ' ') {
+                clean += ' ';
+            }
+        }
+        if (!clean.empty() && clean.back() == ' ') {
+            clean.pop_back();
+        }
+        return clean;
+    }
+
+    /**
+     * Key of a name in the set of indexed names
+     * @param name Name
+     * @param kind Kind of the name
+     * @return Name prefixed with its kind
+     */
+    std::string name_key(const std::string_view name, const name_kind kind) {
+        std::string key(1, static_cast<char>(kind));
+        key += name;
+        return key;
+    }
+
+    /**
+     * Appends an id to a varint encoded posting list
+     * @param bytes Encoded list
+     * @param gap Difference with the previous id
+     */
+    void append_varint(std::vector<uint8_t>& bytes, uint32_t gap) {
+        while (gap >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(gap | 0x80));
+            gap >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(gap));
+    }
+}
+
+// Trigram index
+// ---------------------------------------------------------------------------------------------------------------------
+void trigram_index::decode(const posting_list& list, std::vector<uint32_t>& ids) {
+    ids.clear();
+    ids.reserve(list.count);
+    uint32_t id = 0;
+    for (size_t i = 0; i < list.bytes.size();) {
+        uint32_t gap = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            byte = list.bytes[i++];
+            gap |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        id += gap;
+        ids.push_back(id);
+    }
+}
+
+void trigram_index::add(const std::string_view name, const name_kind kind) {
+    if (name.empty() || !known.insert(name_key(name, kind)).second) {
+        return;
+    }
+
+    const auto id = static_cast<uint32_t>(names.size());
+    names.emplace_back(name);
+    normalized.push_back(normalize_name(name));
+    kinds.push_back(kind);
+    const std::vector<uint32_t> trigrams = extract_trigrams(normalized.back());
+    trigram_counts.push_back(static_cast<uint16_t>(std::min<size_t>(trigrams.size(), UINT16_MAX)));
+    for (const uint32_t trigram : trigrams) {
+        posting_list& list = postings[trigram];
+        append_varint(list.bytes, list.count == 0 ? id : id - list.last); // Ids only grow: append to the tail
+        list.last = id;
+        list.count++;
+    }
+}
+
+size_t trigram_index::refresh(sqlite3* DB) {
+    // Every name is read (a hash lookup each), the trigrams are only extracted for the names not indexed yet
+    std::vector<std::pair<std::string, name_kind>> current;
+    size_t indexed = 0;
+    const auto read_names = [&](const char* query, const name_kind kind) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(DB, query, -1, &stmt, nullptr) != SQLITE_OK) {
+            throw query_error(sqlite3_errmsg(DB));
+        }
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            std::string name(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                             sqlite3_column_bytes(stmt, 0));
+            indexed += known.contains(name_key(name, kind));
+            current.emplace_back(std::move(name), kind);
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            throw query_error(sqlite3_errmsg(DB));
+        }
+    };
+    read_names(CARD_NAMES_QUERY, name_kind::CARD);
+    read_names(SET_NAMES_QUERY, name_kind::SET);
+
+    // Names are distinct per kind, so fewer indexed names found than indexed means some were renamed or deleted
+    if (indexed < known.size()) {
+        *this = trigram_index();
+    }
+    const size_t before = names.size();
+    for (const auto& [name, kind] : current) {
+        add(name, kind);
+    }
+    return names.size() - before;
+}
+
+std::vector<search_hit> trigram_index::search(const std::string_view query, const size_t limit) const {
+    const std::string clean = clean_name(query);
+    if (clean.empty() || limit == 0) {
+        return {};
+    }
+
+    // Substring matches: ids in every list of the query's own trigrams (short queries match word prefixes)
+    std::vector<std::pair<uint32_t, double>> ranked;
+    const std::string inner = clean.size() >= 3 ? clean : std::string(3 - clean.size(), ' ') + clean;
+    std::vector<std::vector<uint32_t>> lists;
+    for (const uint32_t trigram : extract_trigrams(inner)) {
+        const auto list = postings.find(trigram);
+        if (list == postings.end()) {
+            lists.clear();
+            break;
+        }
+        decode(list->second, lists.emplace_back());
+    }
+    if (!lists.empty()) {
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) {return a.size() < b.size();});
+        std::vector<uint32_t> candidates = std::move(lists.front());
+        std::vector<uint32_t> next;
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+            intersect_sorted(candidates, lists[i], next);
+            candidates.swap(next);
+        }
+        for (const uint32_t id : candidates) {
+            const std::string& name = normalized[id];
+            size_t at = name.find(inner);
+            if (at == std::string::npos) {
+                continue; // All trigrams present, but not together
+            }
+            at += inner.size() - clean.size();
+            // Closer lengths rank higher, and so do matches at the start of the name or of a word
+            const double coverage = static_cast<double>(clean.size()) / static_cast<double>(name.size() - 3);
+            const double start = at == 2 ? 1.0 : name[at - 1] == ' ' ? 0.5 : 0.0;
+            ranked.emplace_back(id, 1.0 + start + std::min(coverage, 1.0));
+        }
+    }
+
+    // Misspellings: rank names by how much of the padded query they contain, averaged with the similarity of the whole
+    // trigram sets so that shorter names win ties
+    if (ranked.size() < limit) {
+        const std::vector<uint32_t> trigrams = extract_trigrams(normalize_name(query));
+        std::vector<uint16_t> shared(names.size()); // Dense counters: cheaper than hashing every posting
+        std::vector<uint32_t> touched;
+        std::vector<uint32_t> ids;
+        for (const uint32_t trigram : trigrams) {
+            if (const auto list = postings.find(trigram); list != postings.end()) {
+                decode(list->second, ids);
+                for (const uint32_t id : ids) {
+                    if (shared[id]++ == 0) {
+                        touched.push_back(id);
+                    }
+                }
+            }
+        }
+        for (const auto& [id, score] : ranked) {
+            shared[id] = 0; // Already a substring match
+        }
+        for (const uint32_t id : touched) {
+            const double containment = static_cast<double>(shared[id]) / static_cast<double>(trigrams.size());
+            const double jaccard = static_cast<double>(shared[id]) /
+                                   static_cast<double>(trigrams.size() + trigram_counts[id] - shared[id]);
+            const double similarity = (containment + jaccard) / 2;
+            if (shared[id] > 0 && similarity >= MIN_SIMILARITY) {
+                ranked.emplace_back(id, similarity);
+            }
+        }
+    }
+
+    const size_t hits = std::min(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(hits), ranked.end(),
+                      [this](const auto& a, const auto& b) {
+                          return a.second != b.second ? a.second > b.second : names[a.first] < names[b.first];
+                      });
+    std::vector<search_hit> result;
+    result.reserve(hits);
+    for (size_t i = 0; i < hits; i++) {
+        result.push_back({names[ranked[i].first], kinds[ranked[i].first], ranked[i].second});
+    }
+    return result;
+}
+
+size_t trigram_index::posting_bytes() const {
+    size_t bytes = 0;
+    for (const auto& [trigram, list] : postings) {
+        bytes += list.bytes.size();
+    }
+    return bytes;
+}
+
+// Functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::string normalize_name(const std::string_view name) {
+    return "  " + clean_name(name) + " ";
+}
+
+std::vector<uint32_t> extract_trigrams(const std::string_view normalized) {
+    std::vector<uint32_t> trigrams;
+    for (size_t i = 0; i + 3 <= normalized.size(); i++) {
+        trigrams.push_back(static_cast<uint32_t>(static_cast<unsigned char>(normalized[i])) << 16 |
+                           static_cast<uint32_t>(static_cast<unsigned char>(normalized[i + 1])) << 8 |
+                           static_cast<uint32_t>(static_cast<unsigned char>(normalized[i + 2])));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+void intersect_sorted(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out) {
+    out.clear();
+    size_t i = 0;
+    size_t j = 0;
+
+#if defined(__SSE2__)
+    // Compare a block of four ids of a with every rotation of a block of b, then advance the block with the lower
+    // maximum (ids are unique, so each id of a matches at most once)
+    while (i + 4 <= a.size() && j + 4 <= b.size()) {
+        const __m128i block_a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+        const __m128i block_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + j));
+        const __m128i equal = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(block_a, block_b),
+                         _mm_cmpeq_epi32(block_a, _mm_shuffle_epi32(block_b, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(block_a, _mm_shuffle_epi32(block_b, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(block_a, _mm_shuffle_epi32(block_b, _MM_SHUFFLE(2, 1, 0, 3)))));
+        for (auto mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(equal))); mask != 0;
+             mask &= mask - 1) {
+            out.push_back(a[i + static_cast<size_t>(std::countr_zero(mask))]);
+        }
+        const uint32_t max_a = a[i + 3];
+        const uint32_t max_b = b[j + 3];
+        i += max_a <= max_b ? 4 : 0;
+        j += max_b <= max_a ? 4 : 0;
+    }
+#endif
+
+    // Scalar merge of the tails (or of the whole arrays without SIMD support)
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            out.push_back(a[i]);
+            i++;
+            j++;
+        }
+    }
+}
+
+std::string print_search_hits(const std::vector<search_hit>& hits) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    for (const auto& hit : hits) {
+        out << "  " << (hit.kind == name_kind::SET ? "[set] " : "") << hit.name << " (" << hit.score << ")\n";
+    }
+    return out.str();
+}
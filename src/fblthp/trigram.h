@@ -0,0 +1,148 @@
+/**
+ * Trigram index for fuzzy name search header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+#include <cstdint>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace trigram_constants {
+    inline const char* CARD_NAMES_QUERY = "SELECT DISTINCT name FROM raw_collection "
+                                          "WHERE name IS NOT NULL;"; ///< SQL statement reading the card names
+    inline const char* SET_NAMES_QUERY = "SELECT DISTINCT name FROM mtg_set "
+                                         "WHERE name IS NOT NULL;"; ///< SQL statement reading the set names
+    inline constexpr double MIN_SIMILARITY = 0.4; ///< Trigram similarity a fuzzy match needs
+    inline constexpr size_t RESULTS = 10; ///< Default number of results
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Kind of an indexed name
+ */
+enum class name_kind : uint8_t {CARD, SET};
+
+/**
+ * Struct to hold a search result
+ */
+struct search_hit {
+    std::string_view name; ///< Matched name (owned by the index)
+    name_kind kind; ///< Kind of the name
+    double score; ///< Rank of the hit (above 1 for substring matches, trigram similarity up to 1 otherwise)
+};
+
+/**
+ * In-memory trigram index over card and set names. Names are normalized (lowercase alphanumerics, one space between
+ * words, padded) and every trigram keeps a posting list of the ids of the names containing it, stored as a varint
+ * encoded delta sequence. Ids only grow, so new names are appended to the tails of the lists and a refresh only indexes
+ * the names it has not seen; names cannot be taken out of the lists, so the index is rebuilt when one of its names
+ * is no longer in the database (a row renamed or deleted). Queries intersect the lists of their trigrams (with SIMD) to find substring matches, falling back to
+ * trigram similarity ranking for misspellings
+ */
+class trigram_index {
+    /**
+     * Struct to hold a compressed posting list
+     */
+    struct posting_list {
+        std::vector<uint8_t> bytes; ///< Varint encoded gaps between ids
+        uint32_t last = 0; ///< Last id of the list
+        uint32_t count = 0; ///< Number of ids
+    };
+
+    std::vector<std::string> names; ///< Names by id
+    std::vector<std::string> normalized; ///< Normalized names by id
+    std::vector<name_kind> kinds; ///< Kinds by id
+    std::vector<uint16_t> trigram_counts; ///< Distinct trigrams of every name
+    std::unordered_set<std::string> known; ///< Indexed names (with their kind prefix), to skip duplicates
+    std::unordered_map<uint32_t, posting_list> postings; ///< Posting lists by trigram
+
+    /**
+     * Decodes a posting list
+     * @param list Posting list
+     * @param ids Destination of the ids (cleared first)
+     */
+    static void decode(const posting_list& list, std::vector<uint32_t>& ids);
+public:
+    /**
+     * Adds a name to the index (names already indexed are ignored)
+     * @param name Name to index
+     * @param kind Kind of the name
+     */
+    void add(std::string_view name, name_kind kind);
+
+    /**
+     * Brings the index in line with the card and set names of the database: names not indexed yet are appended, and
+     * the whole index is rebuilt if an indexed name is gone. Call it again after an import to pick up its changes
+     * @param DB Sqlite database object
+     * @return Number of names indexed by this refresh (every name after a rebuild)
+     * @throw query_error if the names cannot be read
+     */
+    size_t refresh(sqlite3* DB);
+
+    /**
+     * Searches the index
+     * @param query Partial or misspelled name
+     * @param limit Maximum number of hits
+     * @return Hits from best to worst
+     */
+    [[nodiscard]] std::vector<search_hit> search(std::string_view query,
+                                                 size_t limit = trigram_constants::RESULTS) const;
+
+    /**
+     * Number of indexed names
+     * @return Names in the index
+     */
+    [[nodiscard]] size_t size() const {return names.size();}
+
+    /**
+     * Size of the compressed posting lists
+     * @return Bytes used by the posting lists
+     */
+    [[nodiscard]] size_t posting_bytes() const;
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Normalizes a name for trigram extraction: lowercase ASCII alphanumerics, every other run of characters collapsed
+ * to a space, padded with two leading and one trailing space
+ * @param name Name to normalize
+ * @return Normalized name
+ */
+std::string normalize_name(std::string_view name);
+
+/**
+ * Extracts the distinct trigrams of a normalized name
+ * @param normalized Normalized name
+ * @return Sorted trigram keys (three bytes packed in an integer)
+ */
+std::vector<uint32_t> extract_trigrams(std::string_view normalized);
+
+/**
+ * Intersects two sorted id arrays, comparing four ids against four at a time with SIMD when available
+ * @param a First sorted array
+ * @param b Second sorted array
+ * @param out Destination of the common ids (cleared first, may not alias the inputs)
+ */
+void intersect_sorted(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out);
+
+/**
+ * Prints search hits
+ * @param hits Search hits
+ * @return String with one line per hit
+ */
+std::string print_search_hits(const std::vector<search_hit>& hits);
+
+#endif //TRIGRAM_H
@@ -0,0 +1,140 @@
+/**
+ * Content hashing for the project
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef HASH_H
+#define HASH_H
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace hash_constants {
+    inline constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL; ///< XXH64 prime 1
+    inline constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL; ///< XXH64 prime 2
+    inline constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL; ///< XXH64 prime 3
+    inline constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL; ///< XXH64 prime 4
+    inline constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL; ///< XXH64 prime 5
+}
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+namespace hash_detail {
+    inline uint64_t read64(const unsigned char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return std::endian::native == std::endian::little ? v : std::byteswap(v);
+    }
+
+    inline uint32_t read32(const unsigned char* p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return std::endian::native == std::endian::little ? v : std::byteswap(v);
+    }
+
+    inline uint64_t round(uint64_t acc, const uint64_t input) {
+        acc += input * hash_constants::PRIME64_2;
+        acc = std::rotl(acc, 31);
+        return acc * hash_constants::PRIME64_1;
+    }
+
+    inline uint64_t merge_round(uint64_t acc, const uint64_t val) {
+        acc ^= round(0, val);
+        return acc * hash_constants::PRIME64_1 + hash_constants::PRIME64_4;
+    }
+}
+
+/**
+ * Hashes a buffer with XXH64. The four independent accumulators consume 32 bytes per iteration, which keeps several
+ * multiplications in flight at once and runs at memory bandwidth on large inputs
+ * @param data Start of the buffer
+ * @param len Length of the buffer in bytes
+ * @param seed Hash seed
+ * @return 64-bit hash (compatible with the reference XXH64)
+ */
+inline uint64_t xxh64(const void* data, const size_t len, const uint64_t seed = 0) {
+    using namespace hash_constants;
+    using namespace hash_detail;
+
+    const auto* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const unsigned char* const limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += static_cast<uint64_t>(len);
+
+    for (; end - p >= 8; p += 8) {
+        h ^= round(0, read64(p));
+        h = std::rotl(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        h = std::rotl(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= static_cast<uint64_t>(*p) * PRIME64_5;
+        h = std::rotl(h, 11) * PRIME64_1;
+    }
+
+    // Avalanche
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * Hashes a string with XXH64
+ * @param data String to hash
+ * @param seed Hash seed
+ * @return 64-bit hash
+ */
+inline uint64_t xxh64(const std::string_view data, const uint64_t seed = 0) {
+    return xxh64(data.data(), data.size(), seed);
+}
+
+/**
+ * Formats a hash as a fixed width hexadecimal string
+ * @param hash Hash value
+ * @return 16 lowercase hexadecimal digits
+ */
+inline std::string hash_to_hex(uint64_t hash) {
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; i--) {
+        hex[i] = "0123456789abcdef"[hash & 0xF];
+        hash >>= 4;
+    }
+    return hex;
+}
+
+#endif //HASH_H
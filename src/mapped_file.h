@@ -0,0 +1,94 @@
+/**
+ * Memory mapped files for the project
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions.h"
+
+/**
+ * RAII wrapper around a memory mapped file. The whole file is mapped on construction and unmapped on destruction.
+ * Private mappings are copy-on-write: writing to them never reaches the file on disk, only the touched pages are
+ * copied by the kernel.
+ */
+class mapped_file {
+    char* ptr = nullptr; ///< Start of the mapping (nullptr for empty files)
+    size_t len = 0; ///< Length of the mapping in bytes
+public:
+    /**
+     * Maps a file into memory
+     * @param path Path of the file
+     * @param writable Whether the mapping is private and writable (copy-on-write) instead of read-only
+     * @throw file_mapping_error if the file cannot be opened or mapped
+     */
+    explicit mapped_file(const std::string& path, bool writable = false) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw file_mapping_error("Unable to open " + path + " (" + std::strerror(errno) + ")");
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            const int err = errno;
+            close(fd);
+            throw file_mapping_error("Unable to stat " + path + " (" + std::strerror(err) + ")");
+        }
+
+        len = static_cast<size_t>(st.st_size);
+        if (len > 0) {
+            const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+            void* addr = mmap(nullptr, len, prot, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int err = errno;
+                close(fd);
+                throw file_mapping_error("Unable to map " + path + " (" + std::strerror(err) + ")");
+            }
+            ptr = static_cast<char*>(addr);
+            madvise(ptr, len, MADV_SEQUENTIAL);
+        }
+        close(fd); // The mapping keeps its own reference to the file
+    }
+
+    ~mapped_file() {
+        if (ptr != nullptr) {
+            munmap(ptr, len);
+        }
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    mapped_file(mapped_file&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), len(std::exchange(other.len, 0)) {}
+
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            if (ptr != nullptr) {
+                munmap(ptr, len);
+            }
+            ptr = std::exchange(other.ptr, nullptr);
+            len = std::exchange(other.len, 0);
+        }
+        return *this;
+    }
+
+    char* data() noexcept { return ptr; } ///< Start of the mapping (only writable for private writable mappings)
+    const char* data() const noexcept { return ptr; } ///< Start of the mapping
+    size_t size() const noexcept { return len; } ///< Size of the mapping in bytes
+    std::string_view view() const noexcept { return {ptr, len}; } ///< Contents of the mapping
+};
+
+#endif //MAPPED_FILE_H
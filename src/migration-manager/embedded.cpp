@@ -0,0 +1,33 @@
+#include <memory>
+
+#include "embedded.h"
+#include "embedded_bundle.h" // Generated from the migrations directory by cmake/embed_migrations.cmake
+#include "exceptions.h"
+#include "hash.h"
+
+// Embedded migration functions
+// ---------------------------------------------------------------------------------------------------------------------
+void embedded_detail::malformed_migration(const char* reason) {
+    throw parse_migration_error(reason);
+}
+
+std::vector<migration> embedded_migrations() {
+    // Built once, later scans share the statements
+    static const std::vector<migration> migrations = [] {
+        std::vector<migration> bundle;
+        bundle.reserve(embedded_bundle::MIGRATIONS.size());
+        for (const auto& [name, sql, up_stmt, down_stmt] : embedded_bundle::MIGRATIONS) {
+            migration mig;
+            mig.name = name;
+            mig.path = std::string(embedded_constants::PATH_PREFIX) + std::string(name);
+            mig.size = sql.size();
+            mig.checksum = xxh64(sql);
+            mig.body = std::make_shared<const migration_body>(std::string(up_stmt), std::string(down_stmt));
+            mig.embedded = true;
+            bundle.push_back(std::move(mig));
+        }
+        return bundle;
+    }();
+
+    return migrations;
+}
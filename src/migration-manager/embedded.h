@@ -0,0 +1,166 @@
+/**
+ * Embedded migrations header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.0
+ */
+
+#ifndef EMBEDDED_H
+#define EMBEDDED_H
+#include <array>
+#include <string_view>
+#include <vector>
+
+#include "migrations.h"
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace embedded_constants {
+    inline const char* PATH_PREFIX = "embedded:"; ///< Prefix of the paths given to embedded migrations
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold a migration compiled into the binary. The statements are views into the embedded file contents,
+ * split when the bundle is compiled
+ */
+struct embedded_migration {
+    std::string_view name; ///< Migration name
+    std::string_view sql; ///< Contents of the migration file
+    std::string_view up_stmt; ///< Upgrade SQL statement
+    std::string_view down_stmt; ///< Downgrade SQL statement
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+namespace embedded_detail {
+    /**
+     * Reports a malformed migration during constant evaluation. It is deliberately not constexpr: reaching it stops
+     * the build, and the compiler points at the call with the reason
+     * @param reason Description of the problem
+     */
+    [[noreturn]] void malformed_migration(const char* reason);
+
+    /**
+     * Struct to hold where the statements of a migration start and end
+     */
+    struct split_migration {
+        std::string_view up_stmt; ///< Upgrade SQL statement
+        std::string_view down_stmt; ///< Downgrade SQL statement
+    };
+
+    /**
+     * Splits a migration file with the same line-based rules as parse_migration_sql. Each direction must appear in
+     * exactly one closed block, so its statement is a contiguous part of the file
+     * @param sql Contents of the migration file
+     * @return Views of the statements
+     */
+    constexpr split_migration split(const std::string_view sql) {
+        using namespace migration_constants;
+        split_migration result;
+        size_t up_start = 0;
+        size_t down_start = 0;
+        bool is_upgrade = false;
+        bool is_downgrade = false;
+        bool has_upgrade = false;
+        bool has_downgrade = false;
+
+        size_t pos = 0;
+        while (pos < sql.size()) {
+            const size_t line_start = pos;
+            size_t line_end = sql.find('\n', pos);
+            if (line_end == std::string_view::npos) {
+                line_end = sql.size();
+            }
+            const std::string_view line = sql.substr(pos, line_end - pos);
+            pos = line_end + 1;
+
+            if (line == UP_START_TAG) {
+                if (is_downgrade) {
+                    malformed_migration("Start up statement before end down");
+                }
+                if (is_upgrade || has_upgrade) {
+                    malformed_migration("More than one up statement");
+                }
+                is_upgrade = true;
+                up_start = pos;
+            } else if (line == DOWN_START_TAG) {
+                if (is_upgrade) {
+                    malformed_migration("Start down statement before end up");
+                }
+                if (is_downgrade || has_downgrade) {
+                    malformed_migration("More than one down statement");
+                }
+                is_downgrade = true;
+                down_start = pos;
+            } else if (line == UP_END_TAG) {
+                if (!is_upgrade) {
+                    malformed_migration("End up statement before start");
+                }
+                is_upgrade = false;
+                has_upgrade = true;
+                result.up_stmt = sql.substr(up_start, line_start - up_start);
+            } else if (line == DOWN_END_TAG) {
+                if (!is_downgrade) {
+                    malformed_migration("End down statement before start");
+                }
+                is_downgrade = false;
+                has_downgrade = true;
+                result.down_stmt = sql.substr(down_start, line_start - down_start);
+            }
+        }
+
+        if (is_upgrade || is_downgrade) {
+            malformed_migration("Statement not closed");
+        }
+        if (!has_upgrade || !has_downgrade) {
+            malformed_migration("Missing up or down statement");
+        }
+        return result;
+    }
+}
+
+/**
+ * Checks at compile time that a migration file splits into its upgrade and downgrade statements
+ * @param sql Contents of the migration file
+ * @return True (a malformed file is not a constant expression and fails the build)
+ */
+consteval bool is_valid_migration(const std::string_view sql) {
+    embedded_detail::split(sql);
+    return true;
+}
+
+/**
+ * Builds an embedded migration at compile time
+ * @param name Migration name
+ * @param sql Contents of the migration file
+ * @return Embedded migration
+ */
+consteval embedded_migration make_embedded_migration(const std::string_view name, const std::string_view sql) {
+    const auto [up_stmt, down_stmt] = embedded_detail::split(sql);
+    return embedded_migration{name, sql, up_stmt, down_stmt};
+}
+
+/**
+ * Checks at compile time that the migrations of a bundle are in execution order and have unique names
+ * @param migrations Embedded migrations
+ * @return True if every name sorts strictly after the previous one
+ */
+template<size_t N>
+consteval bool is_ordered_bundle(const std::array<embedded_migration, N>& migrations) {
+    for (size_t i = 1; i < N; i++) {
+        if (!(migrations[i - 1].name < migrations[i].name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Retrieves the migrations compiled into the binary, ready to execute (nothing is read or parsed at runtime)
+ * @return List of migrations, sorted by name
+ */
+std::vector<migration> embedded_migrations();
+
+#endif //EMBEDDED_H
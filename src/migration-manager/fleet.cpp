@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <glob.h>
+
+#include "fleet.h"
+#include "migrations.h"
+#include "database.h"
+#include "exceptions.h"
+
+using namespace fleet_constants;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Migrates one database of the fleet
+     * @param migrations Shared migration set (statements already loaded)
+     * @param db_path Path of the database
+     * @param operation Operation to execute
+     * @param arg Argument for the operation
+     * @return Result of the database
+     */
+    fleet_result migrate_database(const std::vector<migration>& migrations, const std::string& db_path,
+                                  const std::string& operation, const std::string& arg) {
+        fleet_result result;
+        result.db_path = db_path;
+        const auto start = std::chrono::steady_clock::now();
+
+        try {
+            const db_connection DB(db_path);
+            if (!init_migration_table(DB.get())) {
+                throw migration_execution_error("Unable to initialize migration table: " +
+                                                std::string(sqlite3_errmsg(DB.get())));
+            }
+            manager db_manager = create_migration_manager(migrations, DB.get());
+            db_manager.quiet = true;
+            const int initial_idx = db_manager.last_executed_idx;
+            try {
+                execute_migration(db_manager, operation, arg);
+            } catch (...) {
+                close_migration_manager(db_manager);
+                throw;
+            }
+            result.migrations = std::abs(db_manager.last_executed_idx - initial_idx);
+            close_migration_manager(db_manager);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+}
+
+// Fleet functions
+// ---------------------------------------------------------------------------------------------------------------------
+std::vector<std::string> resolve_fleet(const std::string& targets) {
+    std::vector<std::string> db_paths;
+
+    if (targets.find_first_of(GLOB_CHARACTERS) != std::string::npos) {
+        glob_t matches{};
+        if (glob(targets.c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; i++) {
+                db_paths.emplace_back(matches.gl_pathv[i]);
+            }
+        }
+        globfree(&matches);
+    } else {
+        std::ifstream manifest(targets);
+        std::string line;
+        while (std::getline(manifest, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty() && line[0] != '#') {
+                db_paths.push_back(line);
+            }
+        }
+    }
+
+    return db_paths;
+}
+
+std::vector<fleet_result> execute_fleet(const std::string& migrations_path, const std::string& index_path,
+                                        const std::vector<std::string>& db_paths,
+                                        const std::string& operation, const std::string& arg, unsigned int threads) {
+    // Scan and parse the migration set once, the workers only read it
+    std::vector<migration> migrations = scan_local_migrations(migrations_path);
+    const migration_index cached = load_migration_index(index_path);
+    apply_migration_index(migrations, cached);
+    migration_index index;
+    for (auto& mig : migrations) {
+        load_migration(mig);
+        index.insert({mig.name, index_entry{mig.size, mig.mtime, mig.checksum}});
+    }
+    if (index != cached) {
+        save_migration_index(index_path, index);
+    }
+    const std::vector<migration>& shared = migrations;
+
+    std::vector<fleet_result> results(db_paths.size());
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads = static_cast<unsigned int>(std::clamp<size_t>(threads, 1, std::max<size_t>(db_paths.size(), 1)));
+
+    std::atomic<size_t> next_db{0};
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(threads);
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back([&] {
+                for (size_t idx = next_db++; idx < db_paths.size(); idx = next_db++) {
+                    results[idx] = migrate_database(shared, db_paths[idx], operation, arg);
+                }
+            });
+        }
+    } // Join
+
+    return results;
+}
+
+std::string print_fleet_results(const std::vector<fleet_result>& results) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+
+    size_t failed = 0;
+    int migrations = 0;
+    double total_ms = 0;
+    for (const auto& result : results) {
+        if (result.error.empty()) {
+            out << "OK     " << result.db_path << " (" << result.migrations << " migrations, " << result.ms << " ms)\n";
+        } else {
+            out << "FAILED " << result.db_path << " (" << result.ms << " ms): " << result.error << "\n";
+            failed++;
+        }
+        migrations += result.migrations;
+        total_ms += result.ms;
+    }
+    out << "Migrated " << results.size() - failed << "/" << results.size() << " databases (" << migrations
+        << " migrations, " << total_ms << " ms of database time), " << failed << " failed\n";
+
+    return out.str();
+}
@@ -0,0 +1,66 @@
+/**
+ * Fleet migrations header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+#include <string>
+#include <vector>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace fleet_constants {
+    inline const char* GLOB_CHARACTERS = "*?["; ///< Characters telling a glob pattern apart from a manifest path
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the outcome of migrating one database of a fleet
+ */
+struct fleet_result {
+    std::string db_path; ///< Path of the database
+    int migrations = 0; ///< Number of migrations applied or reverted
+    double ms = 0; ///< Wall time spent on the database
+    std::string error; ///< Error message (empty on success)
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Resolves the databases of a fleet
+ * @param targets Glob pattern (if it contains *, ? or [) or path of a manifest with one database path per line
+ * (empty lines and lines starting with # are ignored)
+ * @return Database paths, in pattern or manifest order
+ */
+std::vector<std::string> resolve_fleet(const std::string& targets);
+
+/**
+ * Executes a migration operation on many databases at once. The migration directory is scanned and every migration
+ * parsed a single time, then a pool of workers migrates the databases, each worker with its own connection and a
+ * private copy of the migration records sharing the parsed statements
+ * @param migrations_path Path of the migrations directory
+ * @param index_path Path of the scan index file (empty to keep no index)
+ * @param db_paths Paths of the databases
+ * @param operation Operation to execute
+ * @param arg Argument for the operation (should be checked if valid before calling this function)
+ * @param threads Number of workers (0 to use one per available core)
+ * @return One result per database, in the same order as the paths
+ * @throw parse_migration_error if a migration file is malformed
+ */
+std::vector<fleet_result> execute_fleet(const std::string& migrations_path, const std::string& index_path,
+                                        const std::vector<std::string>& db_paths,
+                                        const std::string& operation, const std::string& arg, unsigned int threads);
+
+/**
+ * Prints the results of a fleet operation
+ * @param results Fleet results
+ * @return String with one line per database and a summary
+ */
+std::string print_fleet_results(const std::vector<fleet_result>& results);
+
+#endif //FLEET_H
@@ -2,22 +2,35 @@
  * Migration manager for handling database migrations
  * @author diagmatrix
  * @date 2024
- * @version 1.1
+ * @version 1.12
  */
 
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
 #include <sqlite3.h>
 #include <regex>
 #include <string.h>
 #include <map>
 #include <cstdlib>
+#include <optional>
 
 #include "migrations.h"
+#include "snapshot.h"
+#include "fleet.h"
+#include "online.h"
 #include "env.h"
+#include "exceptions.h"
+#include "profiler.h"
 
 const std::map<std::string, std::string> DEFAULT_ENV = {
     {"MIGRATIONS_DB", "default.db"},
-    {"MIGRATIONS_FOLDER", "migrations"}    
+    {"MIGRATIONS_FOLDER", "migrations"},
+    {"MIGRATIONS_SNAPSHOT", "migrations.snapshot"},
+    {"MIGRATIONS_INDEX", "migrations.index"},
+    {"MIGRATIONS_THREADS", "0"},
+    {"MIGRATIONS_TRACE", ""}
 }; ///< Default environment variables
 const char* HELP_MESSAGE =
     "doorkeeper <option> [argument]\n"
@@ -25,18 +38,26 @@ const char* HELP_MESSAGE =
     "  -h, --help\t\tShow this help message\n"
     "  -e, --environment\t\tUse custom environment\n"
     "  -s, --status\t\tShow the migrations status\n"
+    "  -v, --verify\t\tCheck applied migrations against their files\n"
     "  -u, --upgrade\t\tMigrate the database upwards\n"
     "  -d, --downgrade\tMigrate the database downwards\n"
     "  -g, --generate\tGenerate a new migration\n"
+    "  -b, --baseline\tWrite a schema snapshot used to provision empty databases\n"
+    "  -f, --fleet\t\tUpgrade or downgrade many databases at once\n"
+    "  -o, --online\t\tUpgrade or downgrade a shadow copy and swap it in. Offline: writes are blocked\n"
+    "\t\t\tuntil the swap, and refused while other processes have the database open\n"
     "Arguments for environment:\n"
     "  <file>\t\tPath to environment file\n"
-    "Arguments for upgrade and downgrade:\n"
+    "Arguments for upgrade, downgrade and baseline:\n"
     "  head\t\t\tMigrate to the latest version\n"
     "  base\t\t\tMigrate to the initial version\n"
     "  <number>\t\tMigrate up or down <number> of versions\n"
+    "Arguments for fleet:\n"
+    "  <pattern>\t\tGlob pattern matching the databases\n"
+    "  <file>\t\tManifest with one database path per line\n"
     "Arguments for generate:\n"
     "  <name>\t\tName to give to migration\n"; ///< Help message
-enum OPTIONS {HELP, ENVIRONMENT, STATUS, UPGRADE, DOWNGRADE, GENERATE}; ///< Migration manager options
+enum OPTIONS {HELP, ENVIRONMENT, STATUS, VERIFY, UPGRADE, DOWNGRADE, GENERATE, BASELINE, FLEET, ONLINE}; ///< Migration manager options
 
 bool str_eq(const char* str1, const char* str2) {return strcmp(str1, str2) == 0;} ///< Compare if two strings are equal
 int get_option(const char* argument); ///< Check if an argument is an option and returns the option or -1 if false
@@ -53,20 +74,20 @@ int main(int argc, const char* argv[]) {
     std::map<int, std::string> commands;
     for (int i = 1; i < argc; i++) {
         option = get_option(argv[i]);
-        if (option == HELP || option == STATUS) {
+        if (option == HELP || option == STATUS || option == VERIFY || option == ONLINE) {
             try {
                 commands.insert({option, ""});
             } catch(const std::exception& e) {
                 std::cout << "Error: Duplicate option" << std::endl;
                 return EXIT_FAILURE;
             }
-        } else if (option == UPGRADE || option == DOWNGRADE) {
+        } else if (option == UPGRADE || option == DOWNGRADE || option == BASELINE) {
             if (++i >= argc) { // Next argument
                 std::cout << "Error: Missing argument" << std::endl;
                 return EXIT_FAILURE;
             }
             std::string argument;
-            if (option == UPGRADE && str_eq(argv[i], "head")) {
+            if ((option == UPGRADE || option == BASELINE) && str_eq(argv[i], "head")) {
                 argument = migration_constants::HEAD;
             } else if (option == DOWNGRADE && str_eq(argv[i], "base")) {
                 argument = migration_constants::BASE;
@@ -82,7 +103,7 @@ int main(int argc, const char* argv[]) {
                 std::cout << "Error: Duplicate option" << std::endl;
                 return EXIT_FAILURE;
             }
-        } else if (option == GENERATE || option == ENVIRONMENT) {
+        } else if (option == GENERATE || option == ENVIRONMENT || option == FLEET) {
             if (++i >= argc) { // Next argument
                 std::cout << "Error: Missing argument" << std::endl;
                 return EXIT_FAILURE;
@@ -110,6 +131,19 @@ int main(int argc, const char* argv[]) {
     }
     load_env(env_file, DEFAULT_ENV);
 
+    // Profile the statements of every connection when requested (reported when main returns)
+    const profiler_session profiling(std::getenv("MIGRATIONS_TRACE"));
+
+    // Fleet targets (modifier of upgrade and downgrade)
+    std::string fleet_targets;
+    if (const auto fleet = commands.find(FLEET); fleet != commands.end()) {
+        fleet_targets = fleet->second;
+        commands.erase(fleet);
+    }
+
+    // Online mode (modifier of upgrade and downgrade)
+    const bool online = commands.erase(ONLINE) > 0;
+
     // Check only 1 option and get option
     if (commands.size() > 1) {
         std::cout << "Error: Too many options" << std::endl;
@@ -122,47 +156,157 @@ int main(int argc, const char* argv[]) {
     option = command->first;
     std::string argument = command->second;
 
+    // Migrate a fleet of databases (each worker opens its own connections)
+    if (!fleet_targets.empty()) {
+        if (option != UPGRADE && option != DOWNGRADE) {
+            std::cout << "Error: Fleet mode only supports upgrade and downgrade" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (online) {
+            std::cout << "Error: Fleet mode cannot be combined with online mode" << std::endl;
+            return EXIT_FAILURE;
+        }
+        const std::vector<std::string> db_paths = resolve_fleet(fleet_targets);
+        if (db_paths.empty()) {
+            std::cout << "Error: No databases found for " << fleet_targets << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            const char* operation = option == UPGRADE ? migration_constants::UPGRADE : migration_constants::DOWNGRADE;
+            const auto threads = static_cast<unsigned int>(std::stoul(std::getenv("MIGRATIONS_THREADS")));
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<fleet_result> results = execute_fleet(std::getenv("MIGRATIONS_FOLDER"),
+                                                                    std::getenv("MIGRATIONS_INDEX"), db_paths,
+                                                                    operation, argument, threads);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << print_fleet_results(results) << "Finished in " << std::fixed << std::setprecision(2) << ms
+                      << " ms" << std::endl;
+            const bool failed = std::ranges::any_of(results, [](const auto& r) {return !r.error.empty();});
+            return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Migrate a shadow copy and swap it in (offline: writes stay blocked until the swap)
+    if (online) {
+        if (option != UPGRADE && option != DOWNGRADE) {
+            std::cout << "Error: Online mode only supports upgrade and downgrade" << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            const char* operation = option == UPGRADE ? migration_constants::UPGRADE : migration_constants::DOWNGRADE;
+            const online_report report = execute_online_migration(std::getenv("MIGRATIONS_DB"),
+                                                                  std::getenv("MIGRATIONS_FOLDER"),
+                                                                  std::getenv("MIGRATIONS_INDEX"), operation, argument);
+            std::cout << print_online_report(report);
+        } catch (const migration_execution_error& e) {
+            std::cout << e.what() << " - Live database untouched" << std::endl;
+            return EXIT_FAILURE;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Build a snapshot (works on an in-memory database, the target database is not needed)
+    if (option == BASELINE) {
+        try {
+            const int migrations = create_snapshot(std::getenv("MIGRATIONS_FOLDER"), argument,
+                                                   std::getenv("MIGRATIONS_SNAPSHOT"), std::getenv("MIGRATIONS_INDEX"));
+            std::cout << "Snapshot written to " << std::getenv("MIGRATIONS_SNAPSHOT") << " (" << migrations
+                      << " migrations)" << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Embedded builds have no migrations directory to write to
+    if (migration_constants::EMBEDDED && option == GENERATE) {
+        std::cout << "Error: Generate is not available with embedded migrations" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     // Open the database
-    sqlite3* DB;
-    if (int error = sqlite3_open(std::getenv("MIGRATIONS_DB"), &DB); error != SQLITE_OK) {
-        std::cout << sqlite3_errmsg(DB) << "\n";
+    std::optional<db_connection> connection;
+    try {
+        connection.emplace(std::getenv("MIGRATIONS_DB"));
+    } catch (const database_error& e) {
+        std::cout << e.what() << std::endl;
         return EXIT_FAILURE;
     }
+    sqlite3* DB = connection->get();
 
     // Initialize the migration table and manager
     if (!init_migration_table(DB)) {
         std::cout << "Error: Unable to initialize migration table: " << sqlite3_errmsg(DB) << std::endl;
-        sqlite3_close(DB);
         return EXIT_FAILURE;
     }
-    manager migrations_manager = create_migration_manager(std::getenv("MIGRATIONS_FOLDER"), DB);
+
+    // Provision empty databases from the snapshot, leaving only the newer migrations to replay
+    if (option == UPGRADE && is_empty_database(DB)) {
+        try {
+            const int target = argument == migration_constants::HEAD ? INT32_MAX : std::stoi(argument);
+            const int restored = restore_snapshot(DB, std::getenv("MIGRATIONS_FOLDER"),
+                                                  std::getenv("MIGRATIONS_SNAPSHOT"), std::getenv("MIGRATIONS_INDEX"),
+                                                  target);
+            if (restored > 0 && argument != migration_constants::HEAD) {
+                argument = std::to_string(target - restored);
+            }
+        } catch (const snapshot_error& e) {
+            std::cout << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    manager migrations_manager = create_migration_manager(std::getenv("MIGRATIONS_FOLDER"), DB,
+                                                           std::getenv("MIGRATIONS_INDEX"));
 
     // Perform the requested operation
     switch (option) {
         case UPGRADE:
-            execute_migration(migrations_manager, migration_constants::UPGRADE, argument);
-            break;
         case DOWNGRADE:
-            execute_migration(migrations_manager, migration_constants::DOWNGRADE, argument);
+            try {
+                const char* operation = option == UPGRADE ? migration_constants::UPGRADE : migration_constants::DOWNGRADE;
+                execute_migration(migrations_manager, operation, argument);
+            } catch (const migration_execution_error& e) {
+                std::cout << e.what() << " - Rolled back" << std::endl;
+                close_migration_manager(migrations_manager);
+                return EXIT_FAILURE;
+            } catch (const std::exception& e) {
+                std::cout << e.what() << std::endl;
+                close_migration_manager(migrations_manager);
+                return EXIT_FAILURE;
+            }
             break;
         case STATUS:
             std::cout << print_migrations(migrations_manager.migrations);
             break;
+        case VERIFY: {
+            const verify_report report = verify_migrations(migrations_manager);
+            std::cout << print_verify_report(report);
+            if (!report.modified.empty()) {
+                close_migration_manager(migrations_manager);
+                return EXIT_FAILURE;
+            }
+            break;
+        }
         case GENERATE:
             if (!generate_migration(migrations_manager, argument)) {
                 std::cout << "Error: Unable to generate migration\n";
-                sqlite3_close(DB);
                 return EXIT_FAILURE;
             }
             std::cout << "Migration generated successfully\n";
             break;
         default:
             std::cout << "Error: This should be unreachable\n";
-            sqlite3_close(DB);
             return EXIT_FAILURE;
     }
 
-    sqlite3_close(DB);
+    close_migration_manager(migrations_manager);
     return EXIT_SUCCESS;
 }
 
@@ -182,6 +326,18 @@ int get_option(const char* argument) {
     if (str_eq(argument, "-s") || str_eq(argument, "--status")) {
         return STATUS;
     }
+    if (str_eq(argument, "-v") || str_eq(argument, "--verify")) {
+        return VERIFY;
+    }
+    if (str_eq(argument, "-b") || str_eq(argument, "--baseline")) {
+        return BASELINE;
+    }
+    if (str_eq(argument, "-f") || str_eq(argument, "--fleet")) {
+        return FLEET;
+    }
+    if (str_eq(argument, "-o") || str_eq(argument, "--online")) {
+        return ONLINE;
+    }
     if (str_eq(argument, "-g") || str_eq(argument, "--generate")) {
         return GENERATE;
     }
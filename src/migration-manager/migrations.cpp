@@ -1,33 +1,129 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <ranges>
+#include <sstream>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 
 #include "migrations.h"
 #include "exceptions.h"
+#include "hash.h"
+#include "mapped_file.h"
+#ifdef DOORKEEPER_EMBEDDED
+#include "embedded.h"
+#endif
 
 namespace fs = std::filesystem;
 using namespace migration_constants;
 
+namespace {
+    /**
+     * Executes SQL statements on the database
+     * @param DB Sqlite database object
+     * @param sql SQL statements
+     * @param context Description of the step for the error message
+     * @throw migration_execution_error if the statements fail
+     */
+    void exec_migration_stmt(sqlite3* DB, const char* sql, const std::string& context) {
+        if (sqlite3_exec(DB, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            const std::string err_msg = context + " (" + sqlite3_errmsg(DB) + ")";
+            throw migration_execution_error(err_msg);
+        }
+    }
+
+    /**
+     * Retrieves a bookkeeping statement from the cache of a migration manager
+     * @param manager Migration manager object
+     * @param sql SQL statement
+     * @return Prepared statement
+     * @throw migration_execution_error if the statement cannot be prepared
+     */
+    sqlite3_stmt* bookkeeping_stmt(manager& manager, const char* sql) {
+        try {
+            return manager.statements.get(sql);
+        } catch (const database_error&) {
+            const std::string err_msg = "Preparing bookkeeping statement (" + std::string(sqlite3_errmsg(manager.DB)) +
+                                        ")";
+            throw migration_execution_error(err_msg);
+        }
+    }
+
+    /**
+     * Runs a cached bookkeeping statement with a migration name (and optionally its checksum) as parameters
+     * @param DB Sqlite database object
+     * @param stmt Prepared statement
+     * @param name Migration name
+     * @param context Description of the step for the error message
+     * @param checksum Migration checksum (bound as the second parameter if not empty)
+     * @throw migration_execution_error if the statement fails
+     */
+    void step_bookkeeping(sqlite3* DB, sqlite3_stmt* stmt, const std::string& name, const std::string& context,
+                          const std::string& checksum = "") {
+        sqlite3_bind_text(stmt, 1, name.c_str(), static_cast<int>(name.size()), SQLITE_STATIC);
+        if (!checksum.empty()) {
+            sqlite3_bind_text(stmt, 2, checksum.c_str(), static_cast<int>(checksum.size()), SQLITE_STATIC);
+        }
+        const int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (rc != SQLITE_DONE) {
+            const std::string err_msg = context + " (" + sqlite3_errmsg(DB) + ")";
+            throw migration_execution_error(err_msg);
+        }
+    }
+
+    /**
+     * Loads the statements of a migration about to run. Migrations are parsed lazily, so a malformed file only shows
+     * up partway through an operation and must roll it back like a failing statement
+     * @param mig Migration to load
+     * @return Parsed statements
+     * @throw migration_execution_error if the file cannot be read or its tags are malformed
+     */
+    const migration_body& load_step(migration& mig) {
+        try {
+            return load_migration(mig);
+        } catch (const parse_migration_error& e) {
+            const std::string err_msg = "Loading " + mig.name + " (" + e.what() + ")";
+            throw migration_execution_error(err_msg);
+        }
+    }
+
+    /**
+     * Formats a duration for the migration reports
+     * @param ms Duration in milliseconds
+     * @return Duration with two decimals and its unit
+     */
+    std::string format_ms(const double ms) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << ms << " ms";
+        return out.str();
+    }
+}
+
 // Migration functions
 // ---------------------------------------------------------------------------------------------------------------------
-std::vector<migration> scan_migrations(const std::string& path, sqlite3* DB) {
-    std::vector<migration> migrations;
-    str_map local_migrations = scan_local_migrations(path);
-    str_map db_migrations = scan_db_migrations(DB);
+std::vector<migration> scan_migrations(const std::string& path, sqlite3* DB, const migration_index& index) {
+    std::vector<migration> migrations = scan_local_migrations(path);
+    apply_migration_index(migrations, index);
+
+    return match_db_migrations(std::move(migrations), DB);
+}
+
+std::vector<migration> match_db_migrations(std::vector<migration> migrations, sqlite3* DB) {
+    applied_map db_migrations = scan_db_migrations(DB);
 
     size_t found_migrations = 0;
-    for (const auto& local_key : local_migrations | std::views::keys) {
-        std::string name = fs::path(local_key).stem().string();
-        std::string exec_time;
-        const auto [up_stmt, down_stmt] = parse_migration(local_key);
-        const auto& db_migration = db_migrations.find(fs::path(local_key).stem().string());
-        if (db_migration != db_migrations.end()) {
+    for (auto& mig : migrations) {
+        mig.exec_time.clear();
+        mig.applied_checksum.clear();
+        if (const auto db_migration = db_migrations.find(mig.name); db_migration != db_migrations.end()) {
             found_migrations++;
-            name = db_migration->first;
-            exec_time = db_migration->second;
+            mig.exec_time = db_migration->second.exec_time;
+            mig.applied_checksum = db_migration->second.checksum;
         }
-        migrations.push_back(migration(name, exec_time,up_stmt, down_stmt));
     }
 
     if (found_migrations != db_migrations.size()) {
@@ -37,6 +133,26 @@ std::vector<migration> scan_migrations(const std::string& path, sqlite3* DB) {
     return migrations;
 }
 
+const migration_body& load_migration(migration& mig) {
+    if (mig.body == nullptr) {
+        const std::string sql = import_sql(mig.path);
+        if (sql.empty() && !(fs::exists(mig.path) && fs::is_regular_file(mig.path))) {
+            const std::string err_msg = "Unable to open file " + mig.path;
+            throw parse_migration_error(err_msg);
+        }
+        auto [up_stmt, down_stmt] = parse_migration_sql(sql, mig.path);
+        // The checksum from the scan index still holds if the file was not touched since it was scanned
+        const int64_t mtime = fs::last_write_time(mig.path).time_since_epoch().count();
+        if (mig.checksum == 0 || mig.size != sql.size() || mig.mtime != mtime) {
+            mig.checksum = xxh64(sql);
+        }
+        mig.size = sql.size();
+        mig.mtime = mtime;
+        mig.body = std::make_shared<const migration_body>(std::move(up_stmt), std::move(down_stmt));
+    }
+    return *mig.body;
+}
+
 int find_last_executed(const std::vector<migration>& migrations) {
     for (int i = static_cast<int>(migrations.size()) - 1; i >= 0; i--) {
         if (!migrations[i].exec_time.empty()) {
@@ -84,15 +200,46 @@ std::string print_migrations(const std::vector<migration>& migrations) {
 
 // Migration manager functions
 // ---------------------------------------------------------------------------------------------------------------------
-manager create_migration_manager(const std::string& path, sqlite3* DB) {
+manager create_migration_manager(const std::string& path, sqlite3* DB, const std::string& index_path) {
     manager manager;
     manager.path = path;
     manager.DB = DB;
-    manager.migrations = scan_migrations(path, DB);
+    manager.statements = statement_cache(DB);
+    manager.index_path = index_path;
+    manager.index = load_migration_index(index_path);
+    manager.migrations = scan_migrations(path, DB, manager.index);
     manager.last_executed_idx = find_last_executed(manager.migrations);
     return manager;
 }
 
+manager create_migration_manager(const std::vector<migration>& migrations, sqlite3* DB) {
+    manager manager;
+    manager.DB = DB;
+    manager.statements = statement_cache(DB);
+    manager.migrations = match_db_migrations(migrations, DB);
+    manager.last_executed_idx = find_last_executed(manager.migrations);
+    return manager;
+}
+
+void close_migration_manager(manager& manager) {
+    manager.statements.clear();
+
+    // Refresh the scan index with the files read during this run and drop the ones that no longer exist
+    if (manager.index_path.empty()) {
+        return; // No index kept, or built from a shared migration set whose owner keeps it
+    }
+    migration_index index;
+    for (const auto& mig : manager.migrations) {
+        if (mig.checksum != 0) {
+            index.insert({mig.name, index_entry{mig.size, mig.mtime, mig.checksum}});
+        }
+    }
+    if (index != manager.index) {
+        save_migration_index(manager.index_path, index);
+        manager.index = std::move(index);
+    }
+}
+
 void execute_migration(manager& manager, const std::string& operation, const std::string& arg) {
     int target_idx;
     if (arg == HEAD) {
@@ -103,41 +250,98 @@ void execute_migration(manager& manager, const std::string& operation, const std
         target_idx = std::stoi(arg);
     }
 
-    if (operation == UPGRADE) {
-        unsigned int idx = std::min(manager.last_executed_idx + target_idx + 1, static_cast<int>(manager.migrations.size()));
-        for (size_t i = std::min(manager.last_executed_idx + 1, static_cast<int>(manager.migrations.size())); i < idx; i++) {;
-            sqlite3_exec(manager.DB, manager.migrations[i].up_stmt.c_str(), nullptr, nullptr, nullptr);
-            if (sqlite3_errcode(manager.DB) != SQLITE_OK) {
-                const std::string err_msg = "Upgrading to " + manager.migrations[i].name + "(" + sqlite3_errmsg(manager.DB) + ")";
-                throw migration_execution_error(err_msg);
-            }
-            std::cout << "Upgraded to migration: " << manager.migrations[i].name << std::endl;
-            const std::string sql = "INSERT INTO migrations (name) VALUES ('" + manager.migrations[i].name + "');";
-            sqlite3_exec(manager.DB, sql.c_str(), nullptr, nullptr, nullptr);
-            if (sqlite3_errcode(manager.DB) != SQLITE_OK) {
-                const std::string err_msg = "Adding to migrations (" + std::string(sqlite3_errmsg(manager.DB)) + ")";
-                throw migration_execution_error(err_msg);
+    // Runs a step and reports how long it took
+    auto timed = [](auto&& step) {
+        const auto start = std::chrono::steady_clock::now();
+        step();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    const int initial_idx = manager.last_executed_idx;
+    exec_migration_stmt(manager.DB, "BEGIN IMMEDIATE;", "Starting transaction");
+    try {
+        const double total_ms = timed([&] {
+            if (operation == UPGRADE) {
+                sqlite3_stmt* insert_stmt = bookkeeping_stmt(manager, INSERT_MIGRATION);
+                unsigned int idx = std::min(manager.last_executed_idx + target_idx + 1, static_cast<int>(manager.migrations.size()));
+                for (size_t i = std::min(manager.last_executed_idx + 1, static_cast<int>(manager.migrations.size())); i < idx; i++) {
+                    migration& mig = manager.migrations[i];
+                    const double ms = timed([&] {
+                        exec_migration_stmt(manager.DB, load_step(mig).up_stmt.c_str(), "Upgrading to " + mig.name);
+                        mig.applied_checksum = hash_to_hex(mig.checksum);
+                        step_bookkeeping(manager.DB, insert_stmt, mig.name, "Adding to migrations",
+                                         mig.applied_checksum);
+                    });
+                    if (!manager.quiet) {
+                        std::cout << "Upgraded to migration: " << mig.name << " (" << format_ms(ms) << ")" << std::endl;
+                    }
+                    manager.last_executed_idx++;
+                }
+            } else if (operation == DOWNGRADE) {
+                sqlite3_stmt* delete_stmt = bookkeeping_stmt(manager, DELETE_MIGRATION);
+                int idx = std::max(manager.last_executed_idx - target_idx + 1, 0);
+                for (int i = manager.last_executed_idx; i >= idx; i--) {
+                    migration& mig = manager.migrations[i];
+                    const double ms = timed([&] {
+                        exec_migration_stmt(manager.DB, load_step(mig).down_stmt.c_str(), "Downgrading from " + mig.name);
+                        step_bookkeeping(manager.DB, delete_stmt, mig.name, "Removing from migrations");
+                    });
+                    if (!manager.quiet) {
+                        std::cout << "Downgraded migration " << mig.name << " (" << format_ms(ms) << ")" << std::endl;
+                    }
+                    manager.last_executed_idx--;
+                }
             }
-            manager.last_executed_idx++;
+            exec_migration_stmt(manager.DB, "COMMIT;", "Committing transaction");
+        });
+        if (!manager.quiet) {
+            std::cout << "Migrated " << std::abs(manager.last_executed_idx - initial_idx) << " migrations in "
+                      << format_ms(total_ms) << std::endl;
         }
-    } else if (operation == DOWNGRADE) {
-        int idx = std::max(manager.last_executed_idx - target_idx + 1, 0);
-        for (int i = manager.last_executed_idx; i >= idx; i--) {
-            sqlite3_exec(manager.DB, manager.migrations[i].down_stmt.c_str(), nullptr, nullptr, nullptr);
-            if (sqlite3_errcode(manager.DB) != SQLITE_OK) {
-                std::string err_msg = "Downgrading from " + manager.migrations[i].name + "(" + sqlite3_errmsg(manager.DB) + ")";
-                throw migration_execution_error(err_msg);
-            }
-            std::cout << "Downgraded migration " << manager.migrations[i].name << std::endl;
-            const std::string sql = "DELETE FROM migrations WHERE name = '" + manager.migrations[i].name + "';";
-            sqlite3_exec(manager.DB, sql.c_str(), nullptr, nullptr, nullptr);
-            if (sqlite3_errcode(manager.DB) != SQLITE_OK) {
-                const std::string err_msg = "Removing from migrations (" + std::string(sqlite3_errmsg(manager.DB)) + ")";
-                throw migration_execution_error(err_msg);
-            }
-            manager.last_executed_idx--;
+    } catch (...) {
+        sqlite3_exec(manager.DB, "ROLLBACK;", nullptr, nullptr, nullptr);
+        manager.last_executed_idx = initial_idx;
+        throw;
+    }
+}
+
+verify_report verify_migrations(manager& manager) {
+    verify_report report;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (auto& mig : manager.migrations) {
+        if (mig.exec_time.empty()) {
+            continue;
+        }
+        report.verified++;
+        // Always rehash, whatever the scan index says: a drifted file may keep its size and modification time
+        if (!mig.embedded) {
+            mig.checksum = hash_file(mig.path);
+        }
+        if (mig.applied_checksum.empty()) {
+            report.untracked.push_back(mig.name);
+        } else if (mig.applied_checksum != hash_to_hex(mig.checksum)) {
+            report.modified.push_back(mig.name);
         }
     }
+
+    report.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+std::string print_verify_report(const verify_report& report) {
+    std::string out;
+    for (const auto& name : report.modified) {
+        out += "Modified after being applied: " + name + "\n";
+    }
+    for (const auto& name : report.untracked) {
+        out += "No checksum recorded (applied before checksums): " + name + "\n";
+    }
+    out += "Verified " + std::to_string(report.verified) + " applied migrations in " + format_ms(report.ms) + ": " +
+           std::to_string(report.modified.size()) + " modified, " + std::to_string(report.untracked.size()) +
+           " without checksum\n";
+
+    return out;
 }
 
 bool generate_migration(const manager& manager, const std::string& name) {
@@ -174,106 +378,203 @@ bool init_migration_table(sqlite3* DB) {
     std::string sql = "CREATE TABLE IF NOT EXISTS migrations ("
                       "id INTEGER PRIMARY KEY AUTOINCREMENT,"
                       "name TEXT NOT NULL,"
-                      "executed_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP"
+                      "executed_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,"
+                      "checksum TEXT"
                       ");";
+    if (sqlite3_exec(DB, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
 
-    return sqlite3_exec(DB, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    // Tables created before checksums were recorded
+    bool has_checksum = false;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(DB, "PRAGMA table_info(migrations);", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const auto* column = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        has_checksum = has_checksum || std::string_view(column) == "checksum";
+    }
+    sqlite3_finalize(stmt);
+    if (!has_checksum) {
+        sql = "ALTER TABLE migrations ADD COLUMN checksum TEXT;";
+        return sqlite3_exec(DB, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    return true;
 }
 
-str_map scan_local_migrations(const std::string& path) {
-    str_map migrations;
+std::vector<migration> scan_local_migrations(const std::string& path) {
+#ifdef DOORKEEPER_EMBEDDED
+    static_cast<void>(path);
+    return embedded_migrations();
+#else
+    std::vector<migration> migrations;
     if (fs::exists(path) && fs::is_directory(path)) {
         for (const auto& entry : fs::directory_iterator(path)) {
             if (entry.is_regular_file() && entry.path().extension() == ".sql") {
-                migrations.insert({entry.path().string(), ""});
+                migration mig;
+                mig.name = entry.path().stem().string();
+                mig.path = entry.path().string();
+                mig.size = entry.file_size();
+                mig.mtime = entry.last_write_time().time_since_epoch().count();
+                migrations.push_back(std::move(mig));
             }
         }
     }
+    std::ranges::sort(migrations, {}, &migration::path);
 
     return migrations;
+#endif
 }
 
-str_map scan_db_migrations(sqlite3* DB) {
-    str_map migrations;
-    sqlite3_stmt* stmt;
+void apply_migration_index(std::vector<migration>& migrations, const migration_index& index) {
+    for (auto& mig : migrations) {
+        if (const auto cached = index.find(mig.name);
+            cached != index.end() && cached->second.size == mig.size && cached->second.mtime == mig.mtime) {
+            mig.checksum = cached->second.checksum;
+        }
+    }
+}
+
+migration_index load_migration_index(const std::string& index_path) {
+    migration_index index;
+    if (EMBEDDED || index_path.empty()) {
+        return index; // Nothing to scan
+    }
+    std::ifstream file(index_path);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line) || line != INDEX_HEADER) {
+        return index;
+    }
 
-    if (sqlite3_prepare_v2(DB, SELECT_ALL_MIGRATIONS, -1, &stmt, nullptr) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            std::string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-            migrations.insert({name, date});
+    // <name> <size> <mtime> <checksum>, one migration per line
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        index_entry entry;
+        if (fields >> name >> entry.size >> entry.mtime >> std::hex >> entry.checksum) {
+            index.insert({name, entry});
+        }
+    }
+
+    return index;
+}
+
+bool save_migration_index(const std::string& index_path, const migration_index& index) {
+    if (EMBEDDED || index_path.empty()) {
+        return true;
+    }
+    // Written next to the index and renamed over it, so readers never see a partial file
+    const std::string tmp_path = index_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << INDEX_HEADER << "\n";
+        for (const auto& [name, entry] : index) {
+            file << name << " " << entry.size << " " << entry.mtime << " " << hash_to_hex(entry.checksum) << "\n";
+        }
+        if (!file.good()) {
+            return false;
+        }
+    }
+    std::error_code error;
+    fs::rename(tmp_path, index_path, error);
+
+    return !error;
+}
+
+applied_map scan_db_migrations(sqlite3* DB) {
+    applied_map migrations;
+    sqlite3_stmt* prepared;
+
+    if (sqlite3_prepare_v2(DB, SELECT_ALL_MIGRATIONS, -1, &prepared, nullptr) == SQLITE_OK) {
+        db_statement stmt(prepared);
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            migrations.insert({std::string(stmt.column_text(0)),
+                               applied_migration{std::string(stmt.column_text(1)), std::string(stmt.column_text(2))}});
         }
     }
 
     return migrations;
 }
 
-str_pair parse_migration(const std::string& path) {
-    str_pair migration_stmt;
+uint64_t hash_file(const std::string& path) {
+    const mapped_file file(path);
+    return xxh64(file.data(), file.size());
+}
 
-    std::ifstream file(path);
-    if (!file.is_open()) {
+str_pair parse_migration(const std::string& path) {
+    if (!(fs::exists(path) && fs::is_regular_file(path))) {
         const std::string err_msg = "Unable to open file " + path;
         throw parse_migration_error(err_msg);
     }
 
+    return parse_migration_sql(import_sql(path), path);
+}
+
+str_pair parse_migration_sql(const std::string_view sql, const std::string& path) {
+    str_pair migration_stmt;
+
     bool is_upgrade = false;
     bool is_downgrade = false;
-    std::string line;
-    while(std::getline(file, line)) {
+    size_t pos = 0;
+    while (pos < sql.size()) {
+        size_t line_end = sql.find('\n', pos);
+        if (line_end == std::string_view::npos) {
+            line_end = sql.size();
+        }
+        const std::string_view line = sql.substr(pos, line_end - pos);
+        pos = line_end + 1;
+
         if (line == UP_START_TAG) {
             if (is_downgrade) {
-                file.close();
                 const std::string err_msg = "In " + path + " (Start up statement before end down)";
                 throw parse_migration_error(err_msg);
             }
             is_upgrade = true;
         } else if (line == DOWN_START_TAG) {
             if (is_upgrade) {
-                file.close();
                 const std::string err_msg = "In " + path + " (Start down statement before end up)";
                 throw parse_migration_error(err_msg);
             }
             is_downgrade = true;
         } else if (line == UP_END_TAG) {
             if (!is_upgrade) {
-                file.close();
                 const std::string err_msg = "In " + path + " (End up statement before start)";
                 throw parse_migration_error(err_msg);
             }
             is_upgrade = false;
         } else if (line == DOWN_END_TAG) {
             if (!is_downgrade) {
-                file.close();
                 const std::string err_msg = "In " + path + " (End down statement before start)";
                 throw parse_migration_error(err_msg);
             }
             is_downgrade = false;
         } else {
             if (is_upgrade) {
-                migration_stmt.first += line + "\n";
+                migration_stmt.first.append(line).append("\n");
             } else if (is_downgrade) {
-                migration_stmt.second += line + "\n";
+                migration_stmt.second.append(line).append("\n");
             }
         }
     }
 
-    file.close();
     return migration_stmt;
 }
 
 std::string import_sql(const std::string& path) {
     std::string sql;
     if (fs::exists(path) && fs::is_regular_file(path)) {
-        std::ifstream file(path);
+        std::ifstream file(path, std::ios::binary);
         if (file.is_open()) {
-            std::string line;
-            while (std::getline(file, line)) {
-                sql += line + "\n";
-            }
+            sql.resize(fs::file_size(path));
+            file.read(sql.data(), static_cast<std::streamsize>(sql.size()));
+            sql.resize(static_cast<size_t>(file.gcount()));
         }
     }
 
     return sql;
 }
-
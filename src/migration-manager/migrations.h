@@ -2,16 +2,21 @@
  * Migration manager header file
  * @author diagmatrix
  * @date 2024
- * @version 1.0.1
+ * @version 1.7
  */
 
 #ifndef MIGRATION_MANAGER_H
 #define MIGRATION_MANAGER_H
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <sqlite3.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "database.h"
+
 // Aliases
 // -----------------------------------------------------------------------------------------------------------------
 typedef std::pair<std::string, std::string> str_pair;
@@ -20,37 +25,111 @@ typedef std::map<std::string, std::string> str_map;
 // Constants
 // -----------------------------------------------------------------------------------------------------------------
 namespace migration_constants {
-    inline const char* SELECT_ALL_MIGRATIONS = "SELECT * FROM migrations;"; ///< SQL statement to retrieve all migrations
-    inline const char* UP_START_TAG = "-- MIGRATION UP START"; ///< Start line for upgrade statement
-    inline const char* UP_END_TAG = "-- MIGRATION UP END"; ///< End line for upgrade statement
-    inline const char* DOWN_START_TAG = "-- MIGRATION DOWN START"; ///< Start line for downgrade statement
-    inline const char* DOWN_END_TAG = "-- MIGRATION DOWN END"; ///< End line for downgrade statement
+    inline const char* SELECT_ALL_MIGRATIONS = "SELECT name, executed_at, checksum FROM migrations;"; ///< SQL statement to retrieve all migrations
+    inline const char* INSERT_MIGRATION = "INSERT INTO migrations (name, checksum) VALUES (?, ?);"; ///< SQL statement to record a migration
+    inline const char* DELETE_MIGRATION = "DELETE FROM migrations WHERE name = ?;"; ///< SQL statement to forget a migration
+    inline constexpr const char* UP_START_TAG = "-- MIGRATION UP START"; ///< Start line for upgrade statement
+    inline constexpr const char* UP_END_TAG = "-- MIGRATION UP END"; ///< End line for upgrade statement
+    inline constexpr const char* DOWN_START_TAG = "-- MIGRATION DOWN START"; ///< Start line for downgrade statement
+    inline constexpr const char* DOWN_END_TAG = "-- MIGRATION DOWN END"; ///< End line for downgrade statement
     inline const char* UPGRADE = "UP"; ///< Upgrade operation string
     inline const char* DOWNGRADE = "DOWN"; ///< Downgrade operation string
     inline const char* HEAD = "HEAD"; ///< Head migration string
     inline const char* BASE = "BASE"; ///< Base migration string
+    inline const char* INDEX_HEADER = "doorkeeper-index 1"; ///< First line (and format version) of the scan index
+#ifdef DOORKEEPER_EMBEDDED
+    inline constexpr bool EMBEDDED = true; ///< Migrations are compiled into the binary instead of scanned from disk
+#else
+    inline constexpr bool EMBEDDED = false; ///< Migrations are compiled into the binary instead of scanned from disk
+#endif
 }
 
 // Types
 // -----------------------------------------------------------------------------------------------------------------
 /**
- * Struct to hold migration information
+ * Struct to hold the statements of a migration
+ */
+struct migration_body {
+    std::string up_stmt; ///< Upgrade SQL statement
+    std::string down_stmt; ///< Downgrade SQL statement
+};
+
+/**
+ * Struct to hold migration information. The statements are only parsed when the migration is about to be executed
  */
 struct migration {
     std::string name; ///< Migration name
     std::string exec_time; ///< Execution time
-    std::string up_stmt; ///< Upgrade SQL statement
-    std::string down_stmt; ///< Downgrade SQL statement
+    std::string path; ///< Path of the migration file
+    uintmax_t size = 0; ///< Size of the migration file in bytes
+    int64_t mtime = 0; ///< Last modification time of the migration file (file clock ticks)
+    uint64_t checksum = 0; ///< Content hash of the migration file (0 if not known yet)
+    std::string applied_checksum; ///< Content hash recorded in the database when applied (empty if unknown)
+    std::shared_ptr<const migration_body> body; ///< Parsed statements (null until loaded)
+    bool embedded = false; ///< Whether the migration is compiled into the binary (no file behind its path)
 };
 
 /**
- * Scans the migrations found in a directory
+ * Struct to hold a scan index entry: what a migration file looked like the last time it was read
+ */
+struct index_entry {
+    uintmax_t size = 0; ///< Size of the migration file in bytes
+    int64_t mtime = 0; ///< Last modification time of the migration file (file clock ticks)
+    uint64_t checksum = 0; ///< Content hash of the migration file
+
+    bool operator==(const index_entry&) const = default;
+};
+
+typedef std::map<std::string, index_entry> migration_index; ///< Scan index keyed by migration name
+
+/**
+ * Struct to hold a migration record of the database
+ */
+struct applied_migration {
+    std::string exec_time; ///< Execution time
+    std::string checksum; ///< Content hash recorded when the migration was applied (empty if unknown)
+};
+
+typedef std::map<std::string, applied_migration> applied_map; ///< Database migration records keyed by name
+
+/**
+ * Struct to hold the result of verifying the applied migrations against their files
+ */
+struct verify_report {
+    size_t verified = 0; ///< Number of applied migrations checked
+    std::vector<std::string> modified; ///< Applied migrations whose file changed since they were applied
+    std::vector<std::string> untracked; ///< Applied migrations recorded before checksums were stored
+    double ms = 0; ///< Wall time of the verification
+};
+
+/**
+ * Scans the migrations found in a directory. Only the directory entries are read: checksums come from the scan index
+ * when the file size and modification time still match it, and the statements are left unparsed
  * @param path Path of the directory
  * @param DB Sqlite database object
+ * @param index Scan index of the directory
  * @return List of migration records found
  * @throw inconsistent_migrations_error if the migration numbers are inconsistent
  */
-std::vector<migration> scan_migrations(const std::string& path, sqlite3* DB);
+std::vector<migration> scan_migrations(const std::string& path, sqlite3* DB, const migration_index& index);
+
+/**
+ * Matches a list of local migrations against the migrations applied to a database
+ * @param migrations Local migrations, sorted by name
+ * @param DB Sqlite database object
+ * @return Local migrations with the execution time and checksum of the applied ones filled in
+ * @throw inconsistent_migrations_error if the database has migrations missing from the list
+ */
+std::vector<migration> match_db_migrations(std::vector<migration> migrations, sqlite3* DB);
+
+/**
+ * Loads the statements of a migration if they were not loaded yet. The file is only hashed when its checksum is not
+ * known yet or the file changed since it was scanned
+ * @param mig Migration to load
+ * @return Parsed statements
+ * @throw parse_migration_error if the file cannot be read or its tags are malformed
+ */
+const migration_body& load_migration(migration& mig);
 
 /**
  * Finds the last executed migration
@@ -74,25 +153,66 @@ struct manager {
     sqlite3* DB = nullptr; ///< Sqlite database object
     std::vector<migration> migrations; ///< List of migrations
     int last_executed_idx = -1; ///< Index of the last executed migration
+    statement_cache statements{nullptr}; ///< Bookkeeping statements (prepared on first use)
+    std::string index_path; ///< Path of the scan index file (empty to keep no index)
+    migration_index index; ///< Scan index of the migrations directory
+    bool quiet = false; ///< Whether to skip the progress output of the operations
 };
 
 /**
  * Creates a migration manager object
  * @param path Path of the migrations
  * @param DB Sqlite database object
+ * @param index_path Path of the scan index file (empty to keep no index)
+ * @return Manager object
+ */
+manager create_migration_manager(const std::string& path, sqlite3* DB, const std::string& index_path = "");
+
+/**
+ * Creates a migration manager object from an already scanned migration set. The statements loaded in the set are
+ * shared with the manager instead of being read again, and the manager keeps no scan index (the owner of the set does)
+ * @param migrations Migration set, sorted by name
+ * @param DB Sqlite database object
  * @return Manager object
+ * @throw inconsistent_migrations_error if the database has migrations missing from the set
  */
-manager create_migration_manager(const std::string& path, sqlite3* DB);
+manager create_migration_manager(const std::vector<migration>& migrations, sqlite3* DB);
 
 /**
- * Executes a migration operation
+ * Releases the statements cached by a migration manager (must be called before closing its database) and saves the
+ * scan index if any migration file was read since it was loaded
+ * @param manager Migration manager object
+ */
+void close_migration_manager(manager& manager);
+
+/**
+ * Executes a migration operation. All the migrations of the operation run in a single transaction, so either every
+ * step is applied or the database is left untouched
  * @param manager Migration manager object
  * @param operation Operation to execute
  * @param arg Argument for the operation (should be checked if valid before calling this function)
- * @return True if the operation was successful, false otherwise
+ * @throw migration_execution_error if any step fails or a migration file is malformed (the whole operation is rolled
+ * back)
  */
 void execute_migration(manager& manager, const std::string& operation, const std::string& arg);
 
+/**
+ * Verifies that the files of every applied migration still hash to the checksum recorded when they were applied.
+ * Every file is hashed, the scan index is never trusted here (an edit may keep the size and modification time), and
+ * straight from a memory mapping, so large seed migrations cost little more than a page-cache read
+ * @param manager Migration manager object
+ * @return Verification report
+ * @throw file_mapping_error if a migration file cannot be read
+ */
+verify_report verify_migrations(manager& manager);
+
+/**
+ * Prints a verification report
+ * @param report Verification report
+ * @return String with the drifted migrations and a summary
+ */
+std::string print_verify_report(const verify_report& report);
+
 /**
  * Generates a new migration file
  * @param manager Migration manager object
@@ -105,25 +225,57 @@ bool generate_migration(const manager& manager, const std::string& name);
 // -----------------------------------------------------------------------------------------------------------------
 
 /**
- * Initializes the migration table in the database
+ * Initializes the migration table in the database, adding the checksum column to tables created before it existed
  * @param DB Sqlite database object
  * @return True if the table was created successfully, false otherwise
  */
 bool init_migration_table(sqlite3* DB);
 
 /**
- * Retrieves the list of migrations from a local directory
- * @param path Path where the migrations exist
- * @return List of migrations found
+ * Retrieves the list of migrations from a local directory, without reading the files. Embedded builds return the
+ * migrations compiled into the binary instead, already loaded
+ * @param path Path where the migrations exist (ignored by embedded builds)
+ * @return List of migrations found, sorted by name
  */
-str_map scan_local_migrations(const std::string& path);
+std::vector<migration> scan_local_migrations(const std::string& path);
+
+/**
+ * Fills in the checksums of the migrations whose file size and modification time still match the scan index
+ * @param migrations List of migrations
+ * @param index Scan index
+ */
+void apply_migration_index(std::vector<migration>& migrations, const migration_index& index);
+
+/**
+ * Loads a scan index. The index lives outside the migrations directory (next to the database by default), so it
+ * never ends up in the version control of the migrations
+ * @param index_path Path of the scan index file
+ * @return Scan index (empty if the path is empty, or the file missing, unreadable or from another format version)
+ */
+migration_index load_migration_index(const std::string& index_path);
+
+/**
+ * Saves a scan index
+ * @param index_path Path of the scan index file (nothing is saved if empty)
+ * @param index Scan index
+ * @return True if the index was saved or there is no index to save, false otherwise
+ */
+bool save_migration_index(const std::string& index_path, const migration_index& index);
 
 /**
  * Retrieves the list of migrations from the database
  * @param DB Sqlite database object
  * @return List of migrations found
  */
-str_map scan_db_migrations(sqlite3* DB);
+applied_map scan_db_migrations(sqlite3* DB);
+
+/**
+ * Hashes a file through a memory mapping
+ * @param path Path of the file
+ * @return XXH64 hash of the file contents
+ * @throw file_mapping_error if the file cannot be mapped
+ */
+uint64_t hash_file(const std::string& path);
 
 /**
  * Parses a migration file path into its upgrade and downgrade components
@@ -132,6 +284,14 @@ str_map scan_db_migrations(sqlite3* DB);
  */
 str_pair parse_migration(const std::string& path);
 
+/**
+ * Parses the contents of a migration file into its upgrade and downgrade components
+ * @param sql Contents of the migration file
+ * @param path Path of the migration file (for error messages)
+ * @return Pair with the SQL strings for the upgrade and downgrade components
+ */
+str_pair parse_migration_sql(std::string_view sql, const std::string& path);
+
 /**
  * Imports a SQL file into a string
  * @param path Path for the SQL file
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sqlite3.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "online.h"
+#include "migrations.h"
+#include "database.h"
+#include "exceptions.h"
+
+namespace fs = std::filesystem;
+using namespace online_constants;
+using clock_type = std::chrono::steady_clock;
+
+// Helper functions
+// ---------------------------------------------------------------------------------------------------------------------
+namespace {
+    /**
+     * Milliseconds elapsed since a point in time
+     * @param start Start time
+     * @return Elapsed milliseconds
+     */
+    double elapsed_ms(const clock_type::time_point start) {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+
+    /**
+     * Removes a shadow database and its journal
+     * @param shadow_path Path of the shadow
+     */
+    void remove_shadow(const std::string& shadow_path) {
+        std::error_code error;
+        fs::remove(shadow_path, error);
+        fs::remove(shadow_path + "-journal", error);
+    }
+
+    /**
+     * Copies the live database into the shadow in one backup step (the caller's read transaction keeps every other
+     * connection from committing meanwhile)
+     * @param live Live database connection
+     * @param shadow Shadow database connection
+     * @return Number of pages copied
+     * @throw online_migration_error if the copy fails
+     */
+    int copy_database(const db_connection& live, sqlite3* shadow) {
+        sqlite3_backup* backup = sqlite3_backup_init(shadow, SCHEMA, live.get(), SCHEMA);
+        if (backup == nullptr) {
+            throw online_migration_error("Starting copy (" + std::string(sqlite3_errmsg(shadow)) + ")");
+        }
+        const int rc = sqlite3_backup_step(backup, -1);
+        const int pages = sqlite3_backup_pagecount(backup);
+        sqlite3_backup_finish(backup);
+        if (rc != SQLITE_DONE) {
+            throw online_migration_error("Copying database (" + std::string(sqlite3_errstr(rc)) + ")");
+        }
+        return pages;
+    }
+
+    /**
+     * Flushes a file to stable storage (the shadow is written without syncs and must be durable before the swap)
+     * @param path Path of the file
+     * @return True if the file was flushed
+     */
+    bool sync_file(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        const bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+
+    /**
+     * Finds the other processes holding a file open, by the descriptors they list in PROC_DIR. Only the processes
+     * of the same user can be inspected
+     * @param file Status of the file (matched by device and inode)
+     * @return Ids of the processes, without the current one
+     */
+    std::vector<std::string> processes_holding(const struct stat& file) {
+        std::vector<std::string> pids;
+        const std::string self = std::to_string(::getpid());
+        auto is_pid = [](const std::string& name) {
+            return !name.empty() && std::ranges::all_of(name, [](const char c) {return c >= '0' && c <= '9';});
+        };
+        std::error_code error;
+        for (const auto& process : fs::directory_iterator(PROC_DIR, error)) {
+            const std::string pid = process.path().filename().string();
+            if (!is_pid(pid) || pid == self) {
+                continue;
+            }
+            std::error_code fd_error; // Processes of other users, or gone meanwhile
+            for (const auto& fd : fs::directory_iterator(process.path() / "fd", fd_error)) {
+                struct stat target{};
+                if (::stat(fd.path().c_str(), &target) == 0 && target.st_dev == file.st_dev &&
+                    target.st_ino == file.st_ino) {
+                    pids.push_back(pid);
+                    break;
+                }
+            }
+        }
+        return pids;
+    }
+
+    /**
+     * Lists process ids for a message
+     * @param pids Ids of the processes
+     * @return Ids separated by commas
+     */
+    std::string join_pids(const std::vector<std::string>& pids) {
+        std::string joined;
+        for (const auto& pid : pids) {
+            joined += (joined.empty() ? "" : ", ") + pid;
+        }
+        return joined;
+    }
+
+    /**
+     * Renames the shadow over the live database. The replaced file is kept under a link until no other process is
+     * found holding it: a process that opened the database during the migration (it could read it, but its writes
+     * were kept waiting by the lock) would keep using the replaced file after the swap, so the swap is undone if there
+     * is one
+     * @param shadow_path Path of the shadow
+     * @param db_path Path of the live database
+     * @throw online_migration_error if the swap fails or another process holds the live database open
+     */
+    void swap_database(const std::string& shadow_path, const std::string& db_path) {
+        const std::string backup_path = db_path + BACKUP_SUFFIX;
+        std::error_code error;
+        fs::remove(backup_path, error);
+        struct stat live_file{};
+        if (::stat(db_path.c_str(), &live_file) != 0 || ::link(db_path.c_str(), backup_path.c_str()) != 0) {
+            throw online_migration_error("Linking " + backup_path + " (" + std::strerror(errno) + ")");
+        }
+        fs::rename(shadow_path, db_path, error);
+        if (error) {
+            fs::remove(backup_path, error);
+            throw online_migration_error("Renaming " + shadow_path + " (" + error.message() + ")");
+        }
+
+        const std::vector<std::string> holders = processes_holding(live_file);
+        if (holders.empty()) {
+            fs::remove(backup_path, error);
+            return;
+        }
+        const std::string pids = join_pids(holders);
+        fs::rename(backup_path, db_path, error);
+        if (error) {
+            throw online_migration_error(db_path + " is open in other processes (" + pids + ") and restoring it from " +
+                                         backup_path + " failed (" + error.message() + ")");
+        }
+        throw online_migration_error(db_path + " is open in other processes (" + pids + "), their writes to the " +
+                                     "replaced file would be lost. Close them and migrate again");
+    }
+}
+
+// Online migration functions
+// ---------------------------------------------------------------------------------------------------------------------
+online_report execute_online_migration(const std::string& db_path, const std::string& migrations_path,
+                                       const std::string& index_path, const std::string& operation,
+                                       const std::string& arg) {
+    online_report report;
+    const std::string shadow_path = db_path + SHADOW_SUFFIX;
+
+    struct stat live_file{};
+    if (!fs::is_regular_file(db_path) || ::stat(db_path.c_str(), &live_file) != 0) {
+        throw online_migration_error(db_path + " does not exist");
+    }
+    // Their connections would keep the replaced file: checked before the migration is spent, and again at the swap
+    if (const std::vector<std::string> holders = processes_holding(live_file); !holders.empty()) {
+        throw online_migration_error(db_path + " is open in other processes (" + join_pids(holders) + "). Close " +
+                                     "them first, the database is migrated offline");
+    }
+    db_connection live(db_path, database_profiles::DEFAULT, SQLITE_OPEN_READWRITE);
+    // A WAL database keeps committed pages in its -wal file, which a rename of the main file would leave behind
+    if (query_value(live.get(), "PRAGMA journal_mode;") == "wal") {
+        throw online_migration_error(db_path + " uses WAL journaling, switch it to a rollback journal first");
+    }
+
+    // A read transaction held from the copy to the swap: other connections can still read, but none can commit (an
+    // exclusive lock would also keep the backup from reading through this connection)
+    const auto locked = clock_type::now();
+    if (sqlite3_exec(live.get(), READ_LOCK, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        throw online_migration_error("Locking " + db_path + " (" + sqlite3_errmsg(live.get()) + ")");
+    }
+    try {
+        // Copy and migrate the shadow (closed before it is synced). Nothing reads the shadow until it is complete
+        // and it is synced once before the swap, so it is written with the bulk load profile
+        remove_shadow(shadow_path);
+        {
+            db_connection shadow(shadow_path, database_profiles::BULK_LOAD);
+            auto start = clock_type::now();
+            report.pages = copy_database(live, shadow.get());
+            report.copy_ms = elapsed_ms(start);
+
+            start = clock_type::now();
+            if (!init_migration_table(shadow.get())) {
+                throw online_migration_error("Initializing migration table (" +
+                                             std::string(sqlite3_errmsg(shadow.get())) + ")");
+            }
+            manager shadow_manager = create_migration_manager(migrations_path, shadow.get(), index_path);
+            const int initial_idx = shadow_manager.last_executed_idx;
+            try {
+                execute_migration(shadow_manager, operation, arg);
+            } catch (...) {
+                close_migration_manager(shadow_manager);
+                throw;
+            }
+            report.migrations = std::abs(shadow_manager.last_executed_idx - initial_idx);
+            close_migration_manager(shadow_manager);
+            report.migrate_ms = elapsed_ms(start);
+        }
+        const auto start = clock_type::now();
+        if (!sync_file(shadow_path)) {
+            throw online_migration_error("Syncing " + shadow_path);
+        }
+        report.migrate_ms += elapsed_ms(start);
+
+        swap_database(shadow_path, db_path);
+    } catch (...) {
+        sqlite3_exec(live.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+        remove_shadow(shadow_path);
+        throw;
+    }
+    live.exec("ROLLBACK;");
+    report.lock_ms = elapsed_ms(locked);
+
+    return report;
+}
+
+std::string print_online_report(const online_report& report) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "Copied " << report.pages << " pages in " << report.copy_ms << " ms\n";
+    out << "Migrated the shadow (" << report.migrations << " migrations) in " << report.migrate_ms << " ms\n";
+    out << "Swapped in after " << report.lock_ms << " ms of read lock (writes were blocked meanwhile)\n";
+    return out.str();
+}
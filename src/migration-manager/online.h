@@ -0,0 +1,70 @@
+/**
+ * Online migrations header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.3
+ */
+
+#ifndef ONLINE_H
+#define ONLINE_H
+#include <string>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace online_constants {
+    inline const char* SHADOW_SUFFIX = ".shadow"; ///< Suffix of the shadow copy, created next to the live database
+    inline const char* BACKUP_SUFFIX = ".swap"; ///< Suffix of the link keeping the replaced file during the swap
+    inline const char* PROC_DIR = "/proc"; ///< Process directory searched for other holders of the live database
+    inline const char* SCHEMA = "main"; ///< Schema copied into the shadow
+    /**
+     * Read transaction held on the live database until the swap (the query takes the shared lock)
+     */
+    inline const char* READ_LOCK = "BEGIN; SELECT COUNT(*) FROM sqlite_schema;";
+}
+
+// Types
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * Struct to hold the outcome of a shadow migration
+ */
+struct online_report {
+    int migrations = 0; ///< Number of migrations applied or reverted on the shadow
+    int pages = 0; ///< Number of pages copied
+    double copy_ms = 0; ///< Time spent copying the live database
+    double migrate_ms = 0; ///< Time spent migrating the shadow
+    double lock_ms = 0; ///< Time writes to the live database were blocked (copy, migration and swap)
+};
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Migrates a database offline through a shadow copy, so the live file is only replaced by a complete, durable and
+ * migrated copy. This is not an online migration: other connections cannot write for the length of the migration
+ * and there are no changes to catch up. The migration is refused if any other process holds the live file open
+ * (found through PROC_DIR, which only shows the processes of the same user: connections of other users are not
+ * detected). A read transaction then keeps every other connection from committing while the live database is
+ * copied into a shadow file, the migrations run on the shadow, and the shadow is renamed over the live file. A
+ * process that opened the database meanwhile would keep using the replaced file, so the swap is undone if one is
+ * found after the rename
+ * @param db_path Path of the live database (rollback journal mode, WAL databases are rejected)
+ * @param migrations_path Path of the migrations directory
+ * @param index_path Path of the scan index file (empty to keep no index)
+ * @param operation Operation to execute
+ * @param arg Argument for the operation (should be checked if valid before calling this function)
+ * @return Report of the migration
+ * @throw online_migration_error if the database is open in another process, or cannot be locked, copied or swapped
+ * @throw migration_execution_error if a migration fails (the live database is left untouched)
+ */
+online_report execute_online_migration(const std::string& db_path, const std::string& migrations_path,
+                                       const std::string& index_path, const std::string& operation,
+                                       const std::string& arg);
+
+/**
+ * Prints the report of a shadow migration
+ * @param report Shadow migration report
+ * @return String with the timings of every phase
+ */
+std::string print_online_report(const online_report& report);
+
+#endif //ONLINE_H
@@ -0,0 +1,143 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+
+#include "snapshot.h"
+#include "migrations.h"
+#include "exceptions.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+using namespace snapshot_constants;
+
+// Snapshot functions
+// ---------------------------------------------------------------------------------------------------------------------
+int create_snapshot(const std::string& migrations_path, const std::string& arg, const std::string& snapshot_path,
+                    const std::string& index_path) {
+    // Owned by the wrapper, so the connection is closed whichever step below throws
+    const db_connection memory_db(MEMORY_DB);
+    if (!init_migration_table(memory_db.get())) {
+        throw snapshot_error("Initializing migration table (" + std::string(sqlite3_errmsg(memory_db.get())) + ")");
+    }
+
+    manager memory_manager = create_migration_manager(migrations_path, memory_db.get(), index_path);
+    try {
+        execute_migration(memory_manager, migration_constants::UPGRADE, arg);
+    } catch (...) {
+        close_migration_manager(memory_manager);
+        throw;
+    }
+    const int migrations = memory_manager.last_executed_idx + 1;
+    close_migration_manager(memory_manager);
+
+    sqlite3_int64 size = 0;
+    unsigned char* image = sqlite3_serialize(memory_db.get(), SCHEMA, &size, 0);
+    if (image == nullptr) {
+        throw snapshot_error("Serializing database (out of memory)");
+    }
+
+    // Written next to the snapshot and renamed over it, so an interrupted run never leaves a truncated image
+    const std::string tmp_path = snapshot_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(image), size);
+        sqlite3_free(image);
+        if (!file.good()) {
+            const std::string err_msg = "Writing " + tmp_path;
+            throw snapshot_error(err_msg);
+        }
+    }
+    std::error_code error;
+    fs::rename(tmp_path, snapshot_path, error);
+    if (error) {
+        const std::string err_msg = "Renaming " + tmp_path + " (" + error.message() + ")";
+        throw snapshot_error(err_msg);
+    }
+
+    return migrations;
+}
+
+int restore_snapshot(sqlite3* DB, const std::string& migrations_path, const std::string& snapshot_path,
+                     const std::string& index_path, const int max_migrations) {
+    if (snapshot_path.empty() || !fs::is_regular_file(snapshot_path)) {
+        return 0;
+    }
+    const auto start = std::chrono::steady_clock::now();
+
+    // The image is used in place: a read-only deserialized database never writes to (or frees) its buffer
+    const mapped_file image(snapshot_path);
+    std::optional<db_connection> connection;
+    try {
+        connection.emplace(MEMORY_DB);
+    } catch (const database_error&) {
+        return 0;
+    }
+    sqlite3* snapshot_db = connection->get();
+    auto* data = reinterpret_cast<unsigned char*>(const_cast<char*>(image.data()));
+    const auto size = static_cast<sqlite3_int64>(image.size());
+    if (sqlite3_deserialize(snapshot_db, SCHEMA, data, size, size, SQLITE_DESERIALIZE_READONLY) != SQLITE_OK) {
+        std::cout << "Warning: Ignoring snapshot " << snapshot_path << " (" << sqlite3_errmsg(snapshot_db) << ")\n";
+        return 0;
+    }
+
+    // The snapshot must hold exactly the first local migrations, with unchanged files
+    const applied_map applied = scan_db_migrations(snapshot_db);
+    std::vector<migration> local = scan_local_migrations(migrations_path);
+    apply_migration_index(local, load_migration_index(index_path));
+    std::string mismatch;
+    if (applied.empty()) {
+        mismatch = "no migrations";
+    } else if (static_cast<int>(applied.size()) > max_migrations) {
+        mismatch = "newer than the requested target";
+    } else if (applied.size() > local.size()) {
+        mismatch = "more migrations than the migrations directory";
+    }
+    for (size_t i = 0; mismatch.empty() && i < applied.size(); i++) {
+        const auto record = applied.find(local[i].name);
+        if (record == applied.end()) {
+            mismatch = "missing " + local[i].name;
+        } else if (record->second.checksum !=
+                   hash_to_hex(local[i].checksum != 0 ? local[i].checksum : hash_file(local[i].path))) {
+            mismatch = local[i].name + " changed since the snapshot was taken";
+        }
+    }
+    if (!mismatch.empty()) {
+        std::cout << "Warning: Ignoring snapshot " << snapshot_path << " (" << mismatch << ")\n";
+        return 0;
+    }
+
+    // Copy every page in a single step
+    sqlite3_backup* backup = sqlite3_backup_init(DB, SCHEMA, snapshot_db, SCHEMA);
+    if (backup == nullptr) {
+        const std::string err_msg = "Restoring " + snapshot_path + " (" + sqlite3_errmsg(DB) + ")";
+        throw snapshot_error(err_msg);
+    }
+    const int rc = sqlite3_backup_step(backup, -1);
+    sqlite3_backup_finish(backup);
+    if (rc != SQLITE_DONE) {
+        const std::string err_msg = "Restoring " + snapshot_path + " (" + sqlite3_errstr(rc) + ")";
+        throw snapshot_error(err_msg);
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Restored snapshot " << snapshot_path << " (" << applied.size() << " migrations) in " << std::fixed
+              << std::setprecision(2) << ms << " ms" << std::endl;
+    return static_cast<int>(applied.size());
+}
+
+bool is_empty_database(sqlite3* DB) {
+    const char* sql = "SELECT (SELECT count(*) FROM migrations) + "
+                      "(SELECT count(*) FROM sqlite_master WHERE name NOT IN ('migrations', 'sqlite_sequence'));";
+    sqlite3_stmt* stmt;
+    bool empty = false;
+    if (sqlite3_prepare_v2(DB, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        empty = sqlite3_column_int64(stmt, 0) == 0;
+    }
+    sqlite3_finalize(stmt);
+
+    return empty;
+}
@@ -0,0 +1,60 @@
+/**
+ * Schema snapshots header file
+ * @author diagmatrix
+ * @date 2025
+ * @version 1.1
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <sqlite3.h>
+#include <string>
+
+// Constants
+// -----------------------------------------------------------------------------------------------------------------
+namespace snapshot_constants {
+    inline const char* MEMORY_DB = ":memory:"; ///< In-memory database the snapshots are built and loaded in
+    inline const char* SCHEMA = "main"; ///< Schema serialized into and restored from the snapshots
+}
+
+// Functions
+// -----------------------------------------------------------------------------------------------------------------
+
+/**
+ * Builds a snapshot of the database obtained by upgrading an empty database. The migrations are replayed in memory
+ * and the resulting image (a regular SQLite database file, including the migrations table and its checksums) is
+ * written to disk
+ * @param migrations_path Path of the migrations directory
+ * @param arg Upgrade argument (HEAD or number of migrations)
+ * @param snapshot_path Path of the snapshot file
+ * @param index_path Path of the scan index file (empty to keep no index)
+ * @return Number of migrations contained in the snapshot
+ * @throw snapshot_error if the snapshot cannot be serialized or written
+ * @throw migration_execution_error if a migration fails
+ */
+int create_snapshot(const std::string& migrations_path, const std::string& arg, const std::string& snapshot_path,
+                    const std::string& index_path);
+
+/**
+ * Restores a snapshot into an empty database. The snapshot is only used if its migrations are the first local ones
+ * and their files still match the recorded checksums, otherwise the database is left untouched. Files whose size and
+ * modification time match the scan index are not hashed again
+ * @param DB Sqlite database object (must be empty apart from the migrations table)
+ * @param migrations_path Path of the migrations directory
+ * @param snapshot_path Path of the snapshot file
+ * @param index_path Path of the scan index file (empty to hash every file)
+ * @param max_migrations Maximum number of migrations the snapshot may contain
+ * @return Number of migrations restored (0 if the snapshot is missing or unusable)
+ * @throw snapshot_error if the snapshot is usable but copying it into the database fails
+ */
+int restore_snapshot(sqlite3* DB, const std::string& migrations_path, const std::string& snapshot_path,
+                     const std::string& index_path, int max_migrations);
+
+/**
+ * Checks whether a database has nothing but an empty migrations table
+ * @param DB Sqlite database object
+ * @return True if no migration has been applied and there are no other tables
+ */
+bool is_empty_database(sqlite3* DB);
+
+#endif //SNAPSHOT_H